@@ -5,8 +5,10 @@
 #include "swimps-trace-file/swimps-trace-file.h"
 #include "swimps-tui/swimps-tui.h"
 #include "swimps-assert/swimps-assert.h"
+#include "swimps-thread/swimps-thread.h"
 
 #include <functional>
+#include <optional>
 #include <iostream>
 
 #include <sys/stat.h>
@@ -14,10 +16,51 @@
 
 using signalsafe::File;
 
-using CallTreeNode = swimps::analysis::Analysis::CallTreeNode;
 using swimps::error::ErrorCode;
 using swimps::trace::TraceFile;
 
+namespace {
+    //
+    // Compares the candidate trace file (the target trace file) against the baseline trace file.
+    //
+    ErrorCode diff(const swimps::option::Options& options) {
+        const auto analyseTraceFile = [](const std::string& path) -> std::optional<swimps::analysis::Analysis> {
+            auto traceFile = TraceFile::try_open_existing(
+                { path.c_str(), path.size() },
+                TraceFile::Permissions::ReadOnly
+            );
+
+            if (! traceFile.has_value()) {
+                return {};
+            }
+
+            return swimps::analysis::analyse(*traceFile);
+        };
+
+        // Neither trace file has anything to do with the other until they're compared, so they're read side by side.
+        swimps::thread::ThreadPool threadPool(2);
+        auto baselineAnalysed = threadPool.submit([&](){ return analyseTraceFile(options.diffBaselineTraceFile); });
+        auto candidateAnalysed = threadPool.submit([&](){ return analyseTraceFile(options.targetTraceFile); });
+
+        baselineAnalysed.wait();
+        candidateAnalysed.wait();
+
+        const auto baselineAnalysis = baselineAnalysed.get();
+        const auto candidateAnalysis = candidateAnalysed.get();
+        if (! baselineAnalysis.has_value() || ! candidateAnalysis.has_value()) {
+            return ErrorCode::OpenFailed;
+        }
+
+        const auto diff = swimps::analysis::compare(*baselineAnalysis, *candidateAnalysis);
+
+        if (options.flatProfile || ! options.tui) {
+            swimps::tui::print_diff(diff);
+        }
+
+        return options.tui ? swimps::tui::run(diff) : ErrorCode::None;
+    }
+}
+
 int main(int argc, char** argv) {
     auto maybeOptions = swimps::option::parse_command_line(
         argc,
@@ -31,6 +74,34 @@ int main(int argc, char** argv) {
     const auto options = *maybeOptions;
 
     swimps::log::setLevelToLog(options.logLevel);
+
+    if (! options.diffBaselineTraceFile.empty()) {
+        return static_cast<int>(diff(options));
+    }
+
+    if (! options.mergeTraceFiles.empty()) {
+        const bool merged = swimps::trace::merge_trace_files(
+            options.mergeTraceFiles,
+            options.targetTraceFile,
+            options.compressTrace ? TraceFile::Compression::LZ4 : TraceFile::Compression::None
+        );
+
+        if (! merged) {
+            swimps::log::format_and_write_to_log<512>(
+                swimps::log::LogLevel::Fatal,
+                "Failed to merge trace files into %.",
+                options.targetTraceFile.c_str()
+            );
+
+            return static_cast<int>(ErrorCode::MergeTraceFilesFailed);
+        }
+
+        // The merged trace file is loaded like any other, unless there's nothing to show of it.
+        if (! options.tui && ! options.flatProfile) {
+            return static_cast<int>(ErrorCode::None);
+        }
+    }
+
     if (! options.load) {
         const auto profileResult = swimps::profile::start(options);
         if (profileResult != swimps::error::ErrorCode::None) {
@@ -43,22 +114,67 @@ int main(int argc, char** argv) {
             return static_cast<int>(profileResult);
         }
 
-        TraceFile::from_raw(
-            { options.targetTraceFile.c_str(), options.targetTraceFile.size() }
+        const auto convertedTraceFile = TraceFile::from_raw(
+            { options.targetTraceFile.c_str(), options.targetTraceFile.size() },
+            options.compressTrace ? TraceFile::Compression::LZ4 : TraceFile::Compression::None
         );
+
+        if (! convertedTraceFile.has_value()) {
+            swimps::log::format_and_write_to_log<512>(
+                swimps::log::LogLevel::Fatal,
+                "Failed to convert the raw trace in %.",
+                options.targetTraceFile.c_str()
+            );
+
+            return static_cast<int>(ErrorCode::ConvertTraceFailed);
+        }
     }
 
-    auto traceFile = TraceFile::open_existing(
+    auto maybeTraceFile = TraceFile::try_open_existing(
         { options.targetTraceFile.c_str(), options.targetTraceFile.size() },
         TraceFile::Permissions::ReadOnly
     );
 
-    const auto trace = traceFile.read_trace();
-    const auto analysis = swimps::analysis::analyse(*trace);
+    if (! maybeTraceFile.has_value()) {
+        swimps::log::format_and_write_to_log<512>(
+            swimps::log::LogLevel::Fatal,
+            "Failed to open trace file %.",
+            options.targetTraceFile.c_str()
+        );
+
+        return static_cast<int>(ErrorCode::OpenFailed);
+    }
+
+    // Streaming the entries into the analysis means the whole trace never has to be in memory at once.
+    const auto analysis = swimps::analysis::analyse(*maybeTraceFile);
+
+    if (options.flatProfile) {
+        swimps::tui::print_flat_profile(analysis);
+    }
 
-    if (options.tui) {
-        return static_cast<int>(swimps::tui::run(*trace, analysis));
+    if (! options.tui) {
+        return static_cast<int>(ErrorCode::None);
     }
 
-    return static_cast<int>(ErrorCode::None);
+    // The TUI can narrow the analysis down to any window of time, but only then does it need the whole trace
+    // to slice up. The file is opened again for it, as the analysis above has already read this one to the end.
+    const auto indexTrace = [&options]() -> std::optional<swimps::analysis::TraceIndex> {
+        auto traceFile = TraceFile::try_open_existing(
+            { options.targetTraceFile.c_str(), options.targetTraceFile.size() },
+            TraceFile::Permissions::ReadOnly
+        );
+
+        if (! traceFile.has_value()) {
+            return {};
+        }
+
+        auto trace = traceFile->read_trace();
+        if (! trace.has_value()) {
+            return {};
+        }
+
+        return swimps::analysis::TraceIndex(std::move(*trace));
+    };
+
+    return static_cast<int>(swimps::tui::run(analysis, indexTrace));
 }
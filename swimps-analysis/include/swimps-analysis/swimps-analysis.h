@@ -1,8 +1,15 @@
 #pragma once
 
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <optional>
+#include <span>
+#include <unordered_map>
 #include <vector>
 
 #include "swimps-trace/swimps-trace.h"
+#include "swimps-trace-file/swimps-trace-file.h"
 
 namespace swimps::analysis {
     struct Analysis {
@@ -13,14 +20,474 @@ namespace swimps::analysis {
             >
         >;
 
-        struct CallTreeNode {
-            swimps::trace::sample_count_t frequency;
-            swimps::trace::stack_frame_id_t stackFrameID;
-            std::vector<CallTreeNode> children;
+        //!
+        //! \brief  Every distinct path of stack frames from the outermost in, and how many samples were taken along it.
+        //!
+        //! \note  The nodes are kept in one vector and refer to each other by index. A node's children are found
+        //!        by hashing the parent's index and the child's stack frame ID, so adding a backtrace of N stack frames
+        //!        is N lookups however many children each node has.
+        //!
+        class CallTree {
+        public:
+            using node_index_t = std::uint32_t;
+
+            //!
+            //! \brief  The index of the root node, which has no stack frame of its own; its children are the outermost frames.
+            //!
+            static constexpr node_index_t root = 0;
+
+            //!
+            //! \brief  Marks the lack of a parent, child or sibling.
+            //!
+            static constexpr node_index_t no_node = std::numeric_limits<node_index_t>::max();
+
+            struct Node {
+                swimps::trace::stack_frame_id_t stackFrameID = 0;
+
+                //!
+                //! \brief  How many samples were taken in this node or any below it.
+                //!
+                swimps::trace::sample_count_t frequency = 0;
+
+                node_index_t parent = no_node;
+                node_index_t firstChild = no_node;
+                node_index_t nextSibling = no_node;
+            };
+
+            //!
+            //! \brief  Creates a call tree holding just the root node.
+            //!
+            CallTree();
+
+            //!
+            //! \brief  Gets the child of a node with the given stack frame, adding it if there isn't one yet.
+            //!
+            //! \param[in]  parent        The parent node's index.
+            //! \param[in]  stackFrameID  The child's stack frame.
+            //!
+            //! \returns  The child's index. New children come after their existing siblings.
+            //!
+            //! \note  This function is *not* async signal safe.
+            //!
+            node_index_t add_child(node_index_t parent, swimps::trace::stack_frame_id_t stackFrameID);
+
+            //!
+            //! \brief  Finds the child of a node with the given stack frame.
+            //!
+            //! \param[in]  parent        The parent node's index.
+            //! \param[in]  stackFrameID  The child's stack frame.
+            //!
+            //! \returns  The child's index, or no_node if it hasn't got one.
+            //!
+            node_index_t find_child(node_index_t parent, swimps::trace::stack_frame_id_t stackFrameID) const noexcept;
+
+            //!
+            //! \brief  Counts samples taken at a node against it and every node above it.
+            //!
+            //! \param[in]  node         The node the samples were taken in.
+            //! \param[in]  sampleCount  How many samples there were.
+            //!
+            void add_samples(node_index_t node, swimps::trace::sample_count_t sampleCount) noexcept;
+
+            //!
+            //! \brief  Gets the node with the given index.
+            //!
+            //! \param[in]  node  The node's index, which must have come from this tree.
+            //!
+            //! \returns  The node, which stays valid until the next call to add_child.
+            //!
+            const Node& get(node_index_t node) const noexcept;
+
+            //!
+            //! \brief  Gets how many nodes are in the tree.
+            //!
+            //! \returns  The number of nodes, including the root.
+            //!
+            std::size_t size() const noexcept;
+
+        private:
+            void grow();
+
+            std::vector<Node> m_nodes;
+
+            // Where each node's next child goes, so children stay in the order they were added.
+            std::vector<node_index_t> m_lastChildren;
+
+            // Node indexes, placed by the hash of their parent and stack frame and probed linearly;
+            // no_node marks an empty slot. The root is never in here, as it's nobody's child.
+            std::vector<node_index_t> m_slots;
+        };
+
+        //!
+        //! \brief  Each distinct stack frame, and the strings they refer to.
+        //!
+        struct SymbolTable {
+            //!
+            //! \brief  The strings, which are shared with every other analysis of the same trace rather than copied.
+            //!
+            std::shared_ptr<const swimps::trace::StringTable> strings = std::make_shared<const swimps::trace::StringTable>();
+
+
+            std::unordered_map<swimps::trace::stack_frame_id_t, swimps::trace::StackFrame> stackFrames;
+
+            //!
+            //! \brief  Finds a stack frame by its ID.
+            //!
+            //! \param[in]  stackFrameID  The stack frame to look up.
+            //!
+            //! \returns  The stack frame, or nullptr if there isn't one with that ID.
+            //!
+            const swimps::trace::StackFrame* find(swimps::trace::stack_frame_id_t stackFrameID) const;
+        };
+
+        //!
+        //! \brief  How many samples were taken in a function, and in it or anything it called.
+        //!
+        struct FunctionProfile {
+            //!
+            //! \brief  The function's name, in the symbol table's strings.
+            //!
+            //! \note  Stack frames that couldn't be symbolised all share the empty name.
+            //!
+            swimps::trace::string_id_t functionName = 0;
+
+            //!
+            //! \brief  How many samples were taken with the function innermost.
+            //!
+            swimps::trace::sample_count_t selfSamples = 0;
+
+            //!
+            //! \brief  How many samples were taken with the function anywhere in their backtrace.
+            //!
+            //! \note  A sample in a recursive function is only counted once, however deep the recursion went.
+            //!
+            swimps::trace::sample_count_t inclusiveSamples = 0;
+
+            bool operator==(const FunctionProfile&) const = default;
+        };
+
+        //!
+        //! \brief  Every function with samples, in descending order of self samples, then inclusive samples.
+        //!
+        using FlatProfile = std::vector<FunctionProfile>;
+
+        //!
+        //! \brief  Which functions call which, and how many samples were taken in each call.
+        //!
+        //! \note  Each function's callers and callees are kept together, in compressed sparse row form,
+        //!        so looking them up doesn't depend on how many calls there are in all. Only the functions
+        //!        in a call have rows, so the graph's size doesn't depend on how many strings there are.
+        //!
+        class CallGraph {
+        public:
+            //!
+            //! \brief  A call from one function to another.
+            //!
+            struct Call {
+                swimps::trace::string_id_t caller = 0;
+                swimps::trace::string_id_t callee = 0;
+
+                //!
+                //! \brief  How many samples were taken with the caller calling the callee anywhere in their backtrace.
+                //!
+                //! \note  As with a function's inclusive samples, a sample is only counted once
+                //!        however many times the call appears in its backtrace.
+                //!
+                swimps::trace::sample_count_t samples = 0;
+            };
+
+            //!
+            //! \brief  One end of a call, as seen from the other: the function there, and the call's samples.
+            //!
+            struct Edge {
+                swimps::trace::string_id_t function = 0;
+                swimps::trace::sample_count_t samples = 0;
+
+                bool operator==(const Edge&) const = default;
+            };
+
+            CallGraph() = default;
+
+            //!
+            //! \brief  Creates a call graph from its calls.
+            //!
+            //! \param[in]  calls  Every distinct call.
+            //!
+            //! \note  This function is *not* async signal safe.
+            //!
+            explicit CallGraph(std::span<const Call> calls);
+
+            //!
+            //! \brief  Gets the functions that call a function.
+            //!
+            //! \param[in]  function  The function called.
+            //!
+            //! \returns  The callers, heaviest first. They stay valid for as long as the call graph does.
+            //!
+            std::span<const Edge> get_callers(swimps::trace::string_id_t function) const noexcept;
+
+            //!
+            //! \brief  Gets the functions that a function calls.
+            //!
+            //! \param[in]  function  The calling function.
+            //!
+            //! \returns  The callees, heaviest first. They stay valid for as long as the call graph does.
+            //!
+            std::span<const Edge> get_callees(swimps::trace::string_id_t function) const noexcept;
+
+            //!
+            //! \brief  Gets how many distinct calls there are.
+            //!
+            //! \returns  The number of calls.
+            //!
+            std::size_t size() const noexcept;
+
+        private:
+            std::optional<std::size_t> find_row(swimps::trace::string_id_t function) const noexcept;
+
+            // Every function in a call, in ascending order; a function's row is where it is in here.
+            std::vector<swimps::trace::string_id_t> m_functions;
+
+            // Row R's callers are m_callers[m_callerOffsets[R]] up to m_callers[m_callerOffsets[R + 1]],
+            // and likewise for its callees.
+            std::vector<std::size_t> m_callerOffsets;
+            std::vector<Edge> m_callers;
+            std::vector<std::size_t> m_calleeOffsets;
+            std::vector<Edge> m_callees;
         };
 
+        //!
+        //! \brief  The samples taken on one thread, analysed on their own.
+        //!
+        struct ThreadProfile {
+            //!
+            //! \brief  The thread's ID, or 0 for samples that weren't recorded with their thread.
+            //!
+            swimps::trace::thread_id_t threadID = 0;
+
+            //!
+            //! \brief  The thread's name, in the symbol table's strings; the empty name if it wasn't recorded.
+            //!
+            swimps::trace::string_id_t threadName = 0;
+
+            CallTree callTree;
+            FlatProfile flatProfile;
+        };
+
+        //!
+        //! \brief  Every thread with samples, in descending order of samples, then ascending order of ID.
+        //!
+        using ThreadProfiles = std::vector<ThreadProfile>;
+
+        //!
+        //! \brief  How many samples were taken in each backtrace that has any, in order of backtrace ID.
+        //!
+        //! \note  Use get_heaviest_backtraces to put them in order of sample count.
+        //!
         BacktraceFrequency backtraceFrequency;
-        std::vector<CallTreeNode> callTree;
+
+        CallTree callTree;
+        FlatProfile flatProfile;
+        CallGraph callGraph;
+        SymbolTable symbolTable;
+
+        //!
+        //! \brief  The call tree and flat profile of each thread's samples.
+        //!
+        //! \note  They're counted in the same pass over the samples as everything else. A trace whose samples
+        //!        were all taken on one thread has just the one, which is the same as the whole trace's.
+        //!
+        ThreadProfiles threadProfiles;
+
+        //!
+        //! \brief  Gets the call tree turned upside down: the root's children are the innermost stack frames
+        //!         samples were taken in, their children are what called them, and so on out to the outermost.
+        //!
+        //! \returns  The bottom up call tree, in which each node's frequency is how many samples were taken
+        //!           with its path (read from the node back up to the root) innermost.
+        //!
+        //! \note  It's built from callTree the first time it's asked for, then kept, so analyses that are never
+        //!        looked at from the bottom up never pay for it. Changes to callTree after that aren't reflected.
+        //!
+        //! \note  This function is *not* thread safe, nor async signal safe.
+        //!
+        const CallTree& get_bottom_up_call_tree() const;
+
+    private:
+        mutable std::optional<CallTree> m_bottomUpCallTree;
+    };
+
+    //!
+    //! \brief  An index of a trace held in memory, so that any window of time within it can be analysed
+    //!         without going through the whole trace again.
+    //!
+    class TraceIndex {
+    public:
+        //!
+        //! \brief  Indexes a trace.
+        //!
+        //! \param[in]  trace  The trace to index, which the index takes over; move it in to save copying it.
+        //!
+        //! \note  The samples are sorted where they are, so there's only ever the one copy of them.
+        //!
+        //! \note  This function is *not* async signal safe.
+        //!
+        explicit TraceIndex(swimps::trace::Trace trace);
+
+        //!
+        //! \brief  Gets the trace's strings.
+        //!
+        //! \returns  The strings, which every analysis of a window of the trace shares.
+        //!
+        const std::shared_ptr<const swimps::trace::StringTable>& get_strings() const noexcept;
+
+        //!
+        //! \brief  Gets the trace's threads.
+        //!
+        //! \returns  The threads.
+        //!
+        std::span<const swimps::trace::Thread> get_threads() const noexcept;
+
+        //!
+        //! \brief  Gets every sample, in order of when they were taken.
+        //!
+        //! \returns  The samples.
+        //!
+        std::span<const swimps::trace::Sample> get_samples() const noexcept;
+
+        //!
+        //! \brief  Gets the samples taken within a window of time.
+        //!
+        //! \param[in]  start  The start of the window, inclusive.
+        //! \param[in]  end    The end of the window, exclusive.
+        //!
+        //! \returns  The samples taken at or after start and before end, in order of when they were taken.
+        //!
+        //! \note  This is two binary searches, over the blocks and then within one.
+        //!
+        std::span<const swimps::trace::Sample> get_samples(
+            signalsafe::time::TimeSpecification start,
+            signalsafe::time::TimeSpecification end
+        ) const noexcept;
+
+        //!
+        //! \brief  Finds a backtrace by its ID.
+        //!
+        //! \param[in]  backtraceID  The backtrace to look up.
+        //!
+        //! \returns  The backtrace, or nullptr if there isn't one with that ID.
+        //!
+        const swimps::trace::Backtrace* find_backtrace(swimps::trace::backtrace_id_t backtraceID) const noexcept;
+
+        //!
+        //! \brief  Finds a stack frame by its ID.
+        //!
+        //! \param[in]  stackFrameID  The stack frame to look up.
+        //!
+        //! \returns  The stack frame, or nullptr if there isn't one with that ID.
+        //!
+        const swimps::trace::StackFrame* find_stack_frame(swimps::trace::stack_frame_id_t stackFrameID) const noexcept;
+
+    private:
+        //
+        // Where each entry with an ID is in the trace. IDs are handed out one after another from 1,
+        // so most are looked up in an array; any too big for that (which only a corrupt trace would have) are in a map.
+        //
+        class PositionsByID {
+        public:
+            void add(std::int64_t id, std::size_t position);
+            std::optional<std::size_t> find(std::int64_t id) const noexcept;
+
+        private:
+            std::vector<std::size_t> m_densePositions;
+            std::unordered_map<std::int64_t, std::size_t> m_sparsePositions;
+        };
+
+        //
+        // The earliest and latest timestamps in a block of samples.
+        //
+        struct Block {
+            signalsafe::time::TimeSpecification min;
+            signalsafe::time::TimeSpecification max;
+        };
+
+        // Sorted by timestamp, and split into blocks of a fixed size (but for the last).
+        std::vector<swimps::trace::Sample> m_samples;
+        std::vector<Block> m_blocks;
+
+        std::vector<swimps::trace::Backtrace> m_backtraces;
+        std::vector<swimps::trace::StackFrame> m_stackFrames;
+        std::vector<swimps::trace::Thread> m_threads;
+        std::shared_ptr<const swimps::trace::StringTable> m_strings;
+
+        PositionsByID m_backtracePositions;
+        PositionsByID m_stackFramePositions;
+    };
+
+    //!
+    //! \brief  How the samples of one run of a program (the candidate) differ from those of another (the baseline).
+    //!
+    //! \note  The two runs' stack frame and string IDs have nothing to do with each other,
+    //!        so their stack frames are matched up by function name.
+    //!
+    //! \note  Each run's samples are counted as a share of all of that run's samples,
+    //!        so runs of different lengths can be compared.
+    //!
+    struct Diff {
+        //!
+        //! \brief  A function's share of each run's samples.
+        //!
+        struct FunctionDelta {
+            //!
+            //! \brief  The function's name, in the diff's strings.
+            //!
+            swimps::trace::string_id_t functionName = 0;
+
+            //!
+            //! \brief  The shares of samples taken with the function innermost, from 0 to 1.
+            //!
+            double baselineSelf = 0;
+            double candidateSelf = 0;
+
+            //!
+            //! \brief  The shares of samples taken with the function anywhere in their backtrace, from 0 to 1.
+            //!
+            double baselineInclusive = 0;
+            double candidateInclusive = 0;
+
+            bool operator==(const FunctionDelta&) const = default;
+        };
+
+        //!
+        //! \brief  Every function with samples in either run, in descending order of how much its self share grew,
+        //!         then how much its inclusive share grew.
+        //!
+        using FunctionDeltas = std::vector<FunctionDelta>;
+
+        //!
+        //! \brief  The names of every function in either run.
+        //!
+        swimps::trace::StringTable strings;
+
+        swimps::trace::sample_count_t baselineSamples = 0;
+        swimps::trace::sample_count_t candidateSamples = 0;
+
+        FunctionDeltas functionDeltas;
+
+        //!
+        //! \brief  Both runs' call trees laid over each other, with each path of stack frames turned into
+        //!         the path of functions they were in.
+        //!
+        //! \note  Each node's stackFrameID is the ID of its function in the diff's strings,
+        //!        and its frequency is both runs' samples added together.
+        //!
+        Analysis::CallTree callTree;
+
+        //!
+        //! \brief  How many of each call tree node's samples came from each run, by node index.
+        //!
+        std::vector<swimps::trace::sample_count_t> baselineNodeSamples;
+        std::vector<swimps::trace::sample_count_t> candidateNodeSamples;
     };
 
     //!
@@ -33,5 +500,71 @@ namespace swimps::analysis {
     //! \note  This function is *not* async signal safe.
     //!
     Analysis analyse(const swimps::trace::Trace& trace);
-}
 
+    //!
+    //! \brief  Performs analysis upon a trace file, one entry at a time.
+    //!
+    //! \param[in]  traceFile  The trace file to analyse, from its current position.
+    //!
+    //! \returns  The analysis results.
+    //!
+    //! \note  Only the aggregates are kept, never the entries themselves,
+    //!        so memory use depends on how many distinct backtraces and stack frames there are, not how many samples.
+    //!
+    //! \note  If an entry can't be read, the analysis of the entries before it is returned.
+    //!
+    //! \note  This function is *not* async signal safe.
+    //!
+    Analysis analyse(swimps::trace::TraceFile& traceFile);
+
+    //!
+    //! \brief  Performs analysis upon the samples of a trace taken within a window of time.
+    //!
+    //! \param[in]  traceIndex  The index of the trace to analyse.
+    //! \param[in]  start       The start of the window, inclusive.
+    //! \param[in]  end         The end of the window, exclusive.
+    //!
+    //! \returns  The analysis results, as if the trace only had the samples in the window.
+    //!
+    //! \note  Only the backtraces and stack frames that the window's samples refer to are looked at,
+    //!        and the trace's strings are shared rather than copied, so a short window of a long trace
+    //!        is quick to analyse.
+    //!
+    //! \note  This function is *not* async signal safe.
+    //!
+    Analysis analyse(
+        const TraceIndex& traceIndex,
+        signalsafe::time::TimeSpecification start,
+        signalsafe::time::TimeSpecification end
+    );
+
+    //!
+    //! \brief  Picks out the backtraces with the most samples.
+    //!
+    //! \param[in]  backtraceFrequency  How many samples were taken in each backtrace, in any order.
+    //! \param[in]  count               The most backtraces to pick.
+    //!
+    //! \returns  The heaviest backtraces, heaviest first. Backtraces with the same number of samples
+    //!           are in descending order of ID.
+    //!
+    //! \note  Only the backtraces picked are sorted, so picking a few of many is roughly linear.
+    //!
+    //! \note  This function is *not* async signal safe.
+    //!
+    Analysis::BacktraceFrequency get_heaviest_backtraces(
+        const Analysis::BacktraceFrequency& backtraceFrequency,
+        std::size_t count = std::numeric_limits<std::size_t>::max()
+    );
+
+    //!
+    //! \brief  Compares the analyses of two runs of a program.
+    //!
+    //! \param[in]  baseline   The analysis to compare against.
+    //! \param[in]  candidate  The analysis to compare.
+    //!
+    //! \returns  How the candidate's samples differ from the baseline's.
+    //!
+    //! \note  This function is *not* async signal safe.
+    //!
+    Diff compare(const Analysis& baseline, const Analysis& candidate);
+}
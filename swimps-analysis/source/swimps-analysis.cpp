@@ -1,77 +1,971 @@
 #include "swimps-analysis/swimps-analysis.h"
 
+#include <algorithm>
 #include <functional>
+#include <memory>
+#include <span>
+#include <tuple>
+#include <type_traits>
+#include <variant>
 
+#include "swimps-assert/swimps-assert.h"
+#include "swimps-log/swimps-log.h"
+
+using signalsafe::time::TimeSpecification;
 using swimps::analysis::Analysis;
+using CallTree = swimps::analysis::Analysis::CallTree;
+using swimps::analysis::Diff;
+using swimps::analysis::TraceIndex;
+using swimps::error::ErrorCode;
+using swimps::log::format_and_write_to_log;
+using swimps::log::LogLevel;
+using swimps::trace::Backtrace;
+using swimps::trace::backtrace_id_t;
+using swimps::trace::Sample;
+using swimps::trace::sample_count_t;
 using swimps::trace::stack_frame_count_t;
+using swimps::trace::stack_frame_id_t;
+using swimps::trace::StackFrame;
+using swimps::trace::string_id_t;
+using swimps::trace::StringTable;
+using swimps::trace::Thread;
+using swimps::trace::thread_id_t;
 using swimps::trace::Trace;
+using swimps::trace::TraceFile;
 
 namespace {
-    Analysis::BacktraceFrequency get_backtrace_frequency(const Trace& trace) {
-        Analysis::BacktraceFrequency backtraceFrequency;
+    // Backtrace IDs are handed out one after another from 1, so their samples are counted in an array indexed by ID.
+    // Any ID above this (which only a corrupt trace would have) is counted in a map instead, so it can't make the array huge.
+    constexpr backtrace_id_t max_dense_backtrace_id = 1 << 24;
+
+    // Stack frame IDs are handed out the same way as backtrace IDs, so each stack frame's function is looked up
+    // in an array indexed by ID too. Any ID above this is looked up in the symbol table instead.
+    constexpr stack_frame_id_t max_dense_stack_frame_id = 1 << 24;
+
+    // Big enough that a block's timestamps are a tiny fraction of the index, and small enough to search quickly.
+    constexpr std::size_t samples_per_block = 4096;
+
+    constexpr bool is_before(const TimeSpecification& lhs, const TimeSpecification& rhs) noexcept {
+        return std::tie(lhs.seconds, lhs.nanoseconds) < std::tie(rhs.seconds, rhs.nanoseconds);
+    }
+
+    // Small enough that trees of a few nodes stay small, and a power of two so slots can be found by masking.
+    constexpr std::size_t initial_call_tree_slot_count = 64;
+
+    //
+    // Parent indexes and stack frame IDs are both small and close together, so they're thoroughly mixed
+    // (with the finaliser from MurmurHash3) to spread the children of neighbouring nodes across the table.
+    //
+    std::uint64_t hash_call_tree_child(const CallTree::node_index_t parent, const stack_frame_id_t stackFrameID) noexcept {
+        std::uint64_t hash = (static_cast<std::uint64_t>(stackFrameID) * 0x9e3779b97f4a7c15) ^ parent;
+        hash ^= hash >> 33;
+        hash *= 0xff51afd7ed558ccd;
+        hash ^= hash >> 33;
+        hash *= 0xc4ceb9fe1a85ec53;
+        hash ^= hash >> 33;
+
+        return hash;
+    }
+
+    //
+    // Gets each node's self samples: those that didn't go on to any of its children.
+    //
+    std::vector<sample_count_t> get_self_samples(const CallTree& callTree) {
+        std::vector<sample_count_t> selfSamples(callTree.size(), 0);
+
+        for (CallTree::node_index_t node = 1; node < callTree.size(); ++node) {
+            const auto& callTreeNode = callTree.get(node);
+            selfSamples[node] += callTreeNode.frequency;
+            selfSamples[callTreeNode.parent] -= callTreeNode.frequency;
+        }
+
+        return selfSamples;
+    }
+
+    //
+    // The functions a call tree reaches, numbered from 0 in ascending order of name,
+    // so that anything counted by function is only as big as the number of them.
+    //
+    struct NodeFunctions {
+        // The name of each function. The unnamed function is always there, and always first.
+        std::vector<string_id_t> names;
+
+        // Each node's function, by its number.
+        std::vector<std::uint32_t> nodes;
+    };
+
+    //
+    // Gets each node's function, by the name of its stack frame. Anything that can't be found,
+    // or refers to a string that doesn't exist, is put down to the unnamed function.
+    //
+    NodeFunctions get_node_functions(const CallTree& callTree, const Analysis::SymbolTable& symbolTable) {
+        const auto stringCount = symbolTable.strings->size();
+        const auto getName = [stringCount](const StackFrame& stackFrame) -> string_id_t {
+            return stackFrame.functionName < stringCount ? stackFrame.functionName : 0;
+        };
+
+        NodeFunctions nodeFunctions;
+        nodeFunctions.names.push_back(0);
+        for (const auto& [stackFrameID, stackFrame] : symbolTable.stackFrames) {
+            nodeFunctions.names.push_back(getName(stackFrame));
+        }
+
+        std::sort(nodeFunctions.names.begin(), nodeFunctions.names.end());
+        nodeFunctions.names.erase(std::unique(nodeFunctions.names.begin(), nodeFunctions.names.end()), nodeFunctions.names.end());
 
-        for (const auto& sample : trace.samples) {
-            auto existingIter = std::find_if(
-                backtraceFrequency.begin(),
-                backtraceFrequency.end(),
-                [sample](auto entry) {
-                    return entry.second == sample.backtraceID;
+        const auto getFunction = [&names = nodeFunctions.names](const string_id_t name) {
+            return static_cast<std::uint32_t>(std::lower_bound(names.cbegin(), names.cend(), name) - names.cbegin());
+        };
+
+        // A window of a trace only has the stack frames it reaches, whatever their IDs, so the array
+        // is kept in proportion to how many there are. Any ID beyond it is looked up in the symbol table instead.
+        const auto maxDenseStackFrameID = std::min<std::size_t>(max_dense_stack_frame_id, symbolTable.stackFrames.size() * 2);
+
+        std::vector<std::uint32_t> stackFrameFunctions;
+        for (const auto& [stackFrameID, stackFrame] : symbolTable.stackFrames) {
+            if (stackFrameID >= 1 && static_cast<std::size_t>(stackFrameID) <= maxDenseStackFrameID) {
+                if (static_cast<std::size_t>(stackFrameID) >= stackFrameFunctions.size()) {
+                    stackFrameFunctions.resize(stackFrameID + 1, 0);
                 }
-            );
 
-            if (existingIter != backtraceFrequency.end()) {
-                existingIter->first += 1;
-            } else {
-                backtraceFrequency.emplace_back(1, sample.backtraceID);
+                stackFrameFunctions[stackFrameID] = getFunction(getName(stackFrame));
+            }
+        }
+
+        nodeFunctions.nodes.assign(callTree.size(), 0);
+        for (CallTree::node_index_t node = 1; node < callTree.size(); ++node) {
+            const auto stackFrameID = callTree.get(node).stackFrameID;
+
+            if (stackFrameID >= 1 && static_cast<std::size_t>(stackFrameID) < stackFrameFunctions.size()) {
+                nodeFunctions.nodes[node] = stackFrameFunctions[stackFrameID];
+            } else if (static_cast<std::size_t>(stackFrameID) > maxDenseStackFrameID) {
+                const auto* const stackFrame = symbolTable.find(stackFrameID);
+                nodeFunctions.nodes[node] = stackFrame == nullptr ? 0 : getFunction(getName(*stackFrame));
+            }
+        }
+
+        return nodeFunctions;
+    }
+
+    //
+    // Visits every node of a call tree below the root depth first, calling enter on the way down to a node
+    // and leave on the way back up from it, without recursing (call trees can be very deep).
+    //
+    template <typename Enter, typename Leave>
+    void walk_depth_first(const CallTree& callTree, Enter&& enter, Leave&& leave) {
+        auto node = callTree.get(CallTree::root).firstChild;
+
+        while (node != CallTree::no_node) {
+            enter(node);
+
+            if (callTree.get(node).firstChild != CallTree::no_node) {
+                node = callTree.get(node).firstChild;
+                continue;
+            }
+
+            // Leave every node that has no more children to visit, then move on to the next sibling.
+            while (true) {
+                leave(node);
+
+                const auto& callTreeNode = callTree.get(node);
+                if (callTreeNode.nextSibling != CallTree::no_node) {
+                    node = callTreeNode.nextSibling;
+                    break;
+                }
+
+                node = callTreeNode.parent;
+                if (node == CallTree::root) {
+                    node = CallTree::no_node;
+                    break;
+                }
+            }
+        }
+    }
+
+    //
+    // Totals up each function's samples from the call tree, which already has every path's samples counted.
+    // While walking it, a count is kept of how many times each function is on the current path,
+    // so that a function's inclusive samples only come from the outermost node it appears in.
+    //
+    Analysis::FlatProfile get_flat_profile(const CallTree& callTree, const NodeFunctions& functions) {
+        const auto nodeSelfSamples = get_self_samples(callTree);
+        const auto& nodeFunctions = functions.nodes;
+        const auto functionCount = functions.names.size();
+
+        std::vector<sample_count_t> selfSamples(functionCount, 0);
+        std::vector<sample_count_t> inclusiveSamples(functionCount, 0);
+        std::vector<std::uint32_t> pathCounts(functionCount, 0);
+
+        walk_depth_first(
+            callTree,
+            [&](const CallTree::node_index_t node) {
+                const auto function = nodeFunctions[node];
+                if (pathCounts[function]++ == 0) {
+                    inclusiveSamples[function] += callTree.get(node).frequency;
+                }
+
+                selfSamples[function] += nodeSelfSamples[node];
+            },
+            [&](const CallTree::node_index_t node) {
+                pathCounts[nodeFunctions[node]] -= 1;
             }
+        );
+
+        Analysis::FlatProfile flatProfile;
+        for (std::size_t function = 0; function < functionCount; ++function) {
+            if (inclusiveSamples[function] != 0) {
+                flatProfile.push_back({ functions.names[function], selfSamples[function], inclusiveSamples[function] });
+            }
+        }
+
+        std::sort(flatProfile.begin(), flatProfile.end(), [](const auto& lhs, const auto& rhs) {
+            return std::tie(rhs.selfSamples, rhs.inclusiveSamples, lhs.functionName)
+                 < std::tie(lhs.selfSamples, lhs.inclusiveSamples, rhs.functionName);
+        });
+
+        return flatProfile;
+    }
+
+    //
+    // Lays calls out by one of their ends, so that the edges of the function in each row
+    // run from offsets[row] up to offsets[row + 1], heaviest first.
+    //
+    void lay_out_edges(
+        const std::span<const Analysis::CallGraph::Call> calls,
+        const std::span<const string_id_t> rowFunctions,
+        string_id_t Analysis::CallGraph::Call::* const from,
+        string_id_t Analysis::CallGraph::Call::* const to,
+        std::vector<std::size_t>& offsets,
+        std::vector<Analysis::CallGraph::Edge>& edges
+    ) {
+        const auto rowCount = rowFunctions.size();
+
+        std::vector<std::size_t> callRows;
+        callRows.reserve(calls.size());
+        for (const auto& call : calls) {
+            const auto row = std::lower_bound(rowFunctions.begin(), rowFunctions.end(), call.*from);
+            swimps_assert(row != rowFunctions.end() && *row == call.*from);
+            callRows.push_back(static_cast<std::size_t>(row - rowFunctions.begin()));
         }
 
-        std::sort(
-            backtraceFrequency.begin(),
-            backtraceFrequency.end(),
-            std::greater<>{}
+        offsets.assign(rowCount + 1, 0);
+        for (const auto row : callRows) {
+            offsets[row + 1] += 1;
+        }
+
+        for (std::size_t row = 0; row < rowCount; ++row) {
+            offsets[row + 1] += offsets[row];
+        }
+
+        edges.resize(calls.size());
+
+        auto nextEdges = offsets;
+        for (std::size_t call = 0; call < calls.size(); ++call) {
+            edges[nextEdges[callRows[call]]++] = { calls[call].*to, calls[call].samples };
+        }
+
+        for (std::size_t row = 0; row < rowCount; ++row) {
+            std::sort(
+                edges.begin() + offsets[row],
+                edges.begin() + offsets[row + 1],
+                [](const auto& lhs, const auto& rhs) {
+                    return std::tie(rhs.samples, lhs.function) < std::tie(lhs.samples, rhs.function);
+                }
+            );
+        }
+    }
+
+    //
+    // Finds every call from one function to another in the call tree, and how many samples were taken in each.
+    // Like a function's inclusive samples, a call that's on a path more than once (through recursion)
+    // only counts the samples of its outermost appearance.
+    //
+    Analysis::CallGraph get_call_graph(const CallTree& callTree, const NodeFunctions& functions) {
+        std::unordered_map<std::uint64_t, std::size_t> callIndexes;
+        std::vector<Analysis::CallGraph::Call> calls;
+        std::vector<std::uint32_t> callPathCounts;
+
+        // Nodes just below the root have no caller, so aren't a call.
+        constexpr auto no_call = std::numeric_limits<std::size_t>::max();
+        std::vector<std::size_t> nodeCalls(callTree.size(), no_call);
+
+        walk_depth_first(
+            callTree,
+            [&](const CallTree::node_index_t node) {
+                const auto parent = callTree.get(node).parent;
+                if (parent == CallTree::root) {
+                    return;
+                }
+
+                const auto caller = functions.names[functions.nodes[parent]];
+                const auto callee = functions.names[functions.nodes[node]];
+                const auto [callIndex, isNewCall] = callIndexes.try_emplace((std::uint64_t(caller) << 32) | callee, calls.size());
+                if (isNewCall) {
+                    calls.push_back({ caller, callee, 0 });
+                    callPathCounts.push_back(0);
+                }
+
+                nodeCalls[node] = callIndex->second;
+                if (callPathCounts[callIndex->second]++ == 0) {
+                    calls[callIndex->second].samples += callTree.get(node).frequency;
+                }
+            },
+            [&](const CallTree::node_index_t node) {
+                if (nodeCalls[node] != no_call) {
+                    callPathCounts[nodeCalls[node]] -= 1;
+                }
+            }
         );
 
-        return backtraceFrequency;
+        return Analysis::CallGraph(calls);
+    }
+
+    //
+    // Turns a call tree upside down. Every node with self samples has its path added from the node itself
+    // out to the outermost stack frame, and its self samples counted along it.
+    //
+    CallTree get_bottom_up_call_tree(const CallTree& callTree) {
+        const auto selfSamples = get_self_samples(callTree);
+
+        CallTree bottomUpCallTree;
+        for (CallTree::node_index_t node = 1; node < callTree.size(); ++node) {
+            if (selfSamples[node] == 0) {
+                continue;
+            }
+
+            auto bottomUpNode = CallTree::root;
+            for (auto pathNode = node; pathNode != CallTree::root; pathNode = callTree.get(pathNode).parent) {
+                bottomUpNode = bottomUpCallTree.add_child(bottomUpNode, callTree.get(pathNode).stackFrameID);
+            }
+
+            bottomUpCallTree.add_samples(bottomUpNode, selfSamples[node]);
+        }
+
+        return bottomUpCallTree;
     }
 
-    std::vector<Analysis::CallTreeNode> get_call_tree(const Trace& trace) {
-        Analysis::CallTreeNode root({0, 0, {}});
+    //
+    // Builds up an analysis from entries in whatever order they arrive,
+    // keeping only the aggregates rather than the entries themselves.
+    //
+    class Analyser final {
+    public:
+        void add(const Sample& sample) {
+            add_to_thread(sample);
 
-        for(const auto& backtrace : trace.backtraces) {
-            auto* targetNodeChildren = &root.children;
+            const auto backtraceID = sample.backtraceID;
+
+            if (backtraceID < 1 || backtraceID > max_dense_backtrace_id) {
+                m_sparseBacktraceSampleCounts[backtraceID] += 1;
+                return;
+            }
+
+            if (static_cast<std::size_t>(backtraceID) >= m_backtraceSampleCounts.size()) {
+                m_backtraceSampleCounts.resize(backtraceID + 1, 0);
+            }
+
+            m_backtraceSampleCounts[backtraceID] += 1;
+        }
+
+        void add(const Backtrace& backtrace) {
+            auto node = CallTree::root;
 
             for(stack_frame_count_t i = backtrace.stackFrameIDs.size(); i > 0; --i) {
-                const auto stackFrameID = backtrace.stackFrameIDs[i - 1];
+                node = m_callTree.add_child(node, backtrace.stackFrameIDs[i - 1]);
+            }
 
-                const auto existingChild = std::find_if(
-                    targetNodeChildren->begin(),
-                    targetNodeChildren->end(),
-                    [stackFrameID](const auto& child){
-                        return child.stackFrameID == stackFrameID;
-                    }
+            // Samples can come before or after their backtrace, so they're only counted against it at the end.
+            m_backtraceNodes.try_emplace(backtrace.id, node);
+        }
+
+        void add(const StackFrame& stackFrame) {
+            // The first stack frame seen for an ID wins, should there be duplicates.
+            m_symbolTable.stackFrames.try_emplace(stackFrame.id, stackFrame);
+        }
+
+        bool has_backtrace(const backtrace_id_t backtraceID) const {
+            return m_backtraceNodes.contains(backtraceID);
+        }
+
+        //
+        // The string table is only taken at the end, since a v1 trace file's grows as its stack frames are read.
+        //
+        Analysis finish(std::shared_ptr<const StringTable> strings, const std::span<const Thread> threads) {
+            Analysis analysis;
+
+            for (backtrace_id_t backtraceID = 1; static_cast<std::size_t>(backtraceID) < m_backtraceSampleCounts.size(); ++backtraceID) {
+                if (m_backtraceSampleCounts[backtraceID] != 0) {
+                    analysis.backtraceFrequency.emplace_back(m_backtraceSampleCounts[backtraceID], backtraceID);
+                }
+            }
+
+            if (! m_sparseBacktraceSampleCounts.empty()) {
+                for (const auto& [backtraceID, sampleCount] : m_sparseBacktraceSampleCounts) {
+                    analysis.backtraceFrequency.emplace_back(sampleCount, backtraceID);
+                }
+
+                std::sort(
+                    analysis.backtraceFrequency.begin(),
+                    analysis.backtraceFrequency.end(),
+                    [](const auto& lhs, const auto& rhs) { return lhs.second < rhs.second; }
                 );
+            }
+
+            for (const auto& [sampleCount, backtraceID] : analysis.backtraceFrequency) {
+                const auto backtraceNode = m_backtraceNodes.find(backtraceID);
+                if (backtraceNode != m_backtraceNodes.cend()) {
+                    m_callTree.add_samples(backtraceNode->second, sampleCount);
+                }
+            }
+
+            analysis.callTree = std::move(m_callTree);
+            analysis.symbolTable = std::move(m_symbolTable);
+            analysis.symbolTable.strings = std::move(strings);
+
+            const auto nodeFunctions = get_node_functions(analysis.callTree, analysis.symbolTable);
+            analysis.flatProfile = get_flat_profile(analysis.callTree, nodeFunctions);
+            analysis.callGraph = get_call_graph(analysis.callTree, nodeFunctions);
+
+            add_thread_profiles(analysis, threads);
+
+            return analysis;
+        }
+
+    private:
+        //
+        // Samples are only counted by thread once a second thread turns up. Until then,
+        // the first thread's counts are the same as the overall ones, so they're copied from those.
+        //
+        void add_to_thread(const Sample& sample) {
+            if (m_threadSampleCounts.empty()) {
+                if (! m_firstThreadID.has_value()) {
+                    m_firstThreadID = sample.threadID;
+                }
+
+                if (sample.threadID == *m_firstThreadID) {
+                    return;
+                }
 
-                if (existingChild != targetNodeChildren->end()) {
-                    existingChild->frequency += 1;
-                    targetNodeChildren = &existingChild->children;
-                } else {
-                    targetNodeChildren->push_back({1, stackFrameID, {}});
-                    targetNodeChildren = &targetNodeChildren->back().children;
+                auto& firstThreadSampleCounts = m_threadSampleCounts[*m_firstThreadID];
+                for (backtrace_id_t backtraceID = 1; static_cast<std::size_t>(backtraceID) < m_backtraceSampleCounts.size(); ++backtraceID) {
+                    if (m_backtraceSampleCounts[backtraceID] != 0) {
+                        firstThreadSampleCounts.emplace(backtraceID, m_backtraceSampleCounts[backtraceID]);
+                    }
                 }
+
+                firstThreadSampleCounts.insert(m_sparseBacktraceSampleCounts.cbegin(), m_sparseBacktraceSampleCounts.cend());
             }
+
+            m_threadSampleCounts[sample.threadID][sample.backtraceID] += 1;
         }
 
-        return root.children;
+        //
+        // Builds each thread's call tree from the paths its backtraces took through the overall one.
+        //
+        void add_thread_profiles(Analysis& analysis, const std::span<const Thread> threads) const {
+            if (! m_firstThreadID.has_value()) {
+                return;
+            }
+
+            std::unordered_map<thread_id_t, string_id_t> threadNames;
+            for (const auto& thread : threads) {
+                threadNames.try_emplace(thread.id, thread.name < analysis.symbolTable.strings->size() ? thread.name : 0);
+            }
+
+            const auto getThreadName = [&threadNames](const thread_id_t threadID) {
+                const auto threadName = threadNames.find(threadID);
+                return threadName != threadNames.cend() ? threadName->second : 0;
+            };
+
+            if (m_threadSampleCounts.empty()) {
+                analysis.threadProfiles.push_back({ *m_firstThreadID, getThreadName(*m_firstThreadID), analysis.callTree, analysis.flatProfile });
+                return;
+            }
+
+            std::vector<std::pair<backtrace_id_t, sample_count_t>> backtraceSampleCounts;
+            std::vector<stack_frame_id_t> path;
+
+            for (const auto& [threadID, sampleCounts] : m_threadSampleCounts) {
+                // In order of ID, so that each thread's call tree comes out the same every time.
+                backtraceSampleCounts.assign(sampleCounts.cbegin(), sampleCounts.cend());
+                std::sort(backtraceSampleCounts.begin(), backtraceSampleCounts.end());
+
+                Analysis::ThreadProfile threadProfile;
+                threadProfile.threadID = threadID;
+                threadProfile.threadName = getThreadName(threadID);
+
+                for (const auto& [backtraceID, sampleCount] : backtraceSampleCounts) {
+                    const auto backtraceNode = m_backtraceNodes.find(backtraceID);
+                    if (backtraceNode == m_backtraceNodes.cend()) {
+                        continue;
+                    }
+
+                    path.clear();
+                    for (auto node = backtraceNode->second; node != CallTree::root; node = analysis.callTree.get(node).parent) {
+                        path.push_back(analysis.callTree.get(node).stackFrameID);
+                    }
+
+                    auto threadNode = CallTree::root;
+                    for (auto stackFrameID = path.crbegin(); stackFrameID != path.crend(); ++stackFrameID) {
+                        threadNode = threadProfile.callTree.add_child(threadNode, *stackFrameID);
+                    }
+
+                    threadProfile.callTree.add_samples(threadNode, sampleCount);
+                }
+
+                const auto nodeFunctions = get_node_functions(threadProfile.callTree, analysis.symbolTable);
+                threadProfile.flatProfile = get_flat_profile(threadProfile.callTree, nodeFunctions);
+
+                analysis.threadProfiles.push_back(std::move(threadProfile));
+            }
+
+            std::sort(analysis.threadProfiles.begin(), analysis.threadProfiles.end(), [](const auto& lhs, const auto& rhs) {
+                const auto lhsSamples = lhs.callTree.get(CallTree::root).frequency;
+                const auto rhsSamples = rhs.callTree.get(CallTree::root).frequency;
+                return std::tie(rhsSamples, lhs.threadID) < std::tie(lhsSamples, rhs.threadID);
+            });
+        }
+
+        std::vector<sample_count_t> m_backtraceSampleCounts;
+        std::unordered_map<backtrace_id_t, sample_count_t> m_sparseBacktraceSampleCounts;
+        std::unordered_map<backtrace_id_t, CallTree::node_index_t> m_backtraceNodes;
+        std::optional<thread_id_t> m_firstThreadID;
+        std::unordered_map<thread_id_t, std::unordered_map<backtrace_id_t, sample_count_t>> m_threadSampleCounts;
+        CallTree m_callTree;
+        Analysis::SymbolTable m_symbolTable;
+    };
+}
+
+CallTree::CallTree()
+: m_nodes(1),
+  m_lastChildren(1, no_node),
+  m_slots(initial_call_tree_slot_count, no_node) {
+
+}
+
+CallTree::node_index_t CallTree::add_child(const node_index_t parent, const stack_frame_id_t stackFrameID) {
+    swimps_assert(parent < m_nodes.size());
+
+    // Kept at most half full, so probe sequences stay short.
+    if (m_nodes.size() * 2 > m_slots.size()) {
+        grow();
     }
+
+    const auto mask = m_slots.size() - 1;
+
+    for (std::size_t slot = hash_call_tree_child(parent, stackFrameID) & mask; ; slot = (slot + 1) & mask) {
+        const auto node = m_slots[slot];
+
+        if (node == no_node) {
+            swimps_assert(m_nodes.size() < no_node);
+            const auto newNode = static_cast<node_index_t>(m_nodes.size());
+
+            m_nodes.push_back({ stackFrameID, 0, parent, no_node, no_node });
+            m_lastChildren.push_back(no_node);
+
+            if (m_lastChildren[parent] == no_node) {
+                m_nodes[parent].firstChild = newNode;
+            } else {
+                m_nodes[m_lastChildren[parent]].nextSibling = newNode;
+            }
+
+            m_lastChildren[parent] = newNode;
+            m_slots[slot] = newNode;
+            return newNode;
+        }
+
+        if (m_nodes[node].parent == parent && m_nodes[node].stackFrameID == stackFrameID) {
+            return node;
+        }
+    }
+}
+
+CallTree::node_index_t CallTree::find_child(const node_index_t parent, const stack_frame_id_t stackFrameID) const noexcept {
+    const auto mask = m_slots.size() - 1;
+
+    for (std::size_t slot = hash_call_tree_child(parent, stackFrameID) & mask; ; slot = (slot + 1) & mask) {
+        const auto node = m_slots[slot];
+
+        if (node == no_node || (m_nodes[node].parent == parent && m_nodes[node].stackFrameID == stackFrameID)) {
+            return node;
+        }
+    }
+}
+
+void CallTree::add_samples(node_index_t node, const sample_count_t sampleCount) noexcept {
+    swimps_assert(node < m_nodes.size());
+
+    for (; node != no_node; node = m_nodes[node].parent) {
+        m_nodes[node].frequency += sampleCount;
+    }
+}
+
+const CallTree::Node& CallTree::get(const node_index_t node) const noexcept {
+    swimps_assert(node < m_nodes.size());
+    return m_nodes[node];
+}
+
+std::size_t CallTree::size() const noexcept {
+    return m_nodes.size();
+}
+
+void CallTree::grow() {
+    m_slots.assign(m_slots.size() * 2, no_node);
+
+    const auto mask = m_slots.size() - 1;
+
+    // The root is skipped, as it's nobody's child.
+    for (std::size_t node = 1; node < m_nodes.size(); ++node) {
+        auto slot = hash_call_tree_child(m_nodes[node].parent, m_nodes[node].stackFrameID) & mask;
+        while (m_slots[slot] != no_node) {
+            slot = (slot + 1) & mask;
+        }
+
+        m_slots[slot] = static_cast<node_index_t>(node);
+    }
+}
+
+const CallTree& Analysis::get_bottom_up_call_tree() const {
+    if (! m_bottomUpCallTree.has_value()) {
+        m_bottomUpCallTree = ::get_bottom_up_call_tree(callTree);
+    }
+
+    return *m_bottomUpCallTree;
+}
+
+Analysis::CallGraph::CallGraph(const std::span<const Call> calls) {
+    for (const auto& call : calls) {
+        m_functions.push_back(call.caller);
+        m_functions.push_back(call.callee);
+    }
+
+    std::sort(m_functions.begin(), m_functions.end());
+    m_functions.erase(std::unique(m_functions.begin(), m_functions.end()), m_functions.end());
+
+    lay_out_edges(calls, m_functions, &Call::callee, &Call::caller, m_callerOffsets, m_callers);
+    lay_out_edges(calls, m_functions, &Call::caller, &Call::callee, m_calleeOffsets, m_callees);
+}
+
+std::optional<std::size_t> Analysis::CallGraph::find_row(const string_id_t function) const noexcept {
+    const auto row = std::lower_bound(m_functions.cbegin(), m_functions.cend(), function);
+    if (row == m_functions.cend() || *row != function) {
+        return {};
+    }
+
+    return static_cast<std::size_t>(row - m_functions.cbegin());
+}
+
+std::span<const Analysis::CallGraph::Edge> Analysis::CallGraph::get_callers(const string_id_t function) const noexcept {
+    const auto row = find_row(function);
+    if (! row.has_value()) {
+        return {};
+    }
+
+    return { m_callers.data() + m_callerOffsets[*row], m_callers.data() + m_callerOffsets[*row + 1] };
+}
+
+std::span<const Analysis::CallGraph::Edge> Analysis::CallGraph::get_callees(const string_id_t function) const noexcept {
+    const auto row = find_row(function);
+    if (! row.has_value()) {
+        return {};
+    }
+
+    return { m_callees.data() + m_calleeOffsets[*row], m_callees.data() + m_calleeOffsets[*row + 1] };
+}
+
+std::size_t Analysis::CallGraph::size() const noexcept {
+    return m_callees.size();
+}
+
+void TraceIndex::PositionsByID::add(const std::int64_t id, const std::size_t position) {
+    // The first entry seen for an ID wins, should there be duplicates.
+    if (find(id).has_value()) {
+        return;
+    }
+
+    // The same limit as for counting samples by backtrace ID applies, for the same reason.
+    if (id < 1 || id > max_dense_backtrace_id) {
+        m_sparsePositions.emplace(id, position);
+        return;
+    }
+
+    if (static_cast<std::size_t>(id) >= m_densePositions.size()) {
+        m_densePositions.resize(id + 1, std::numeric_limits<std::size_t>::max());
+    }
+
+    m_densePositions[id] = position;
+}
+
+std::optional<std::size_t> TraceIndex::PositionsByID::find(const std::int64_t id) const noexcept {
+    if (id >= 1 && static_cast<std::size_t>(id) < m_densePositions.size()) {
+        const auto position = m_densePositions[id];
+        return position == std::numeric_limits<std::size_t>::max() ? std::optional<std::size_t>() : position;
+    }
+
+    const auto iter = m_sparsePositions.find(id);
+    return iter == m_sparsePositions.cend() ? std::optional<std::size_t>() : iter->second;
+}
+
+TraceIndex::TraceIndex(Trace trace)
+: m_samples(std::move(trace.samples)),
+  m_backtraces(std::move(trace.backtraces)),
+  m_stackFrames(std::move(trace.stackFrames)),
+  m_threads(std::move(trace.threads)),
+  m_strings(std::make_shared<const StringTable>(std::move(trace.strings))) {
+    // Stable, so that samples taken at the same time stay in the order they were recorded.
+    std::stable_sort(m_samples.begin(), m_samples.end(), [](const Sample& lhs, const Sample& rhs) {
+        return is_before(lhs.timestamp, rhs.timestamp);
+    });
+
+    for (std::size_t blockStart = 0; blockStart < m_samples.size(); blockStart += samples_per_block) {
+        const auto blockEnd = std::min(blockStart + samples_per_block, m_samples.size());
+        m_blocks.push_back({ m_samples[blockStart].timestamp, m_samples[blockEnd - 1].timestamp });
+    }
+
+    for (std::size_t i = 0; i < m_backtraces.size(); ++i) {
+        m_backtracePositions.add(m_backtraces[i].id, i);
+    }
+
+    for (std::size_t i = 0; i < m_stackFrames.size(); ++i) {
+        m_stackFramePositions.add(m_stackFrames[i].id, i);
+    }
+}
+
+const std::shared_ptr<const StringTable>& TraceIndex::get_strings() const noexcept {
+    return m_strings;
+}
+
+std::span<const Thread> TraceIndex::get_threads() const noexcept {
+    return m_threads;
+}
+
+std::span<const Sample> TraceIndex::get_samples() const noexcept {
+    return m_samples;
+}
+
+std::span<const Sample> TraceIndex::get_samples(const TimeSpecification start, const TimeSpecification end) const noexcept {
+    if (! is_before(start, end)) {
+        return {};
+    }
+
+    // The first sample at or after a time is in the first block that ends at or after it.
+    const auto findFirstSampleNotBefore = [this](const TimeSpecification& time) {
+        const auto block = std::partition_point(m_blocks.cbegin(), m_blocks.cend(), [&time](const Block& block) {
+            return is_before(block.max, time);
+        });
+
+        if (block == m_blocks.cend()) {
+            return m_samples.size();
+        }
+
+        const auto blockStart = static_cast<std::size_t>(block - m_blocks.cbegin()) * samples_per_block;
+        const auto blockEnd = std::min(blockStart + samples_per_block, m_samples.size());
+
+        const auto sample = std::partition_point(m_samples.cbegin() + blockStart, m_samples.cbegin() + blockEnd, [&time](const Sample& sample) {
+            return is_before(sample.timestamp, time);
+        });
+
+        return static_cast<std::size_t>(sample - m_samples.cbegin());
+    };
+
+    const auto first = findFirstSampleNotBefore(start);
+    const auto last = findFirstSampleNotBefore(end);
+    return std::span<const Sample>(m_samples).subspan(first, last - first);
+}
+
+const Backtrace* TraceIndex::find_backtrace(const backtrace_id_t backtraceID) const noexcept {
+    const auto position = m_backtracePositions.find(backtraceID);
+    return position.has_value() ? &m_backtraces[*position] : nullptr;
+}
+
+const StackFrame* TraceIndex::find_stack_frame(const stack_frame_id_t stackFrameID) const noexcept {
+    const auto position = m_stackFramePositions.find(stackFrameID);
+    return position.has_value() ? &m_stackFrames[*position] : nullptr;
+}
+
+const StackFrame* Analysis::SymbolTable::find(const swimps::trace::stack_frame_id_t stackFrameID) const {
+    const auto iter = stackFrames.find(stackFrameID);
+    return iter != stackFrames.cend() ? &iter->second : nullptr;
 }
 
 Analysis swimps::analysis::analyse(const Trace& trace) {
-    Analysis analysis;
+    Analyser analyser;
 
-    analysis.backtraceFrequency = get_backtrace_frequency(trace);
-    analysis.callTree = get_call_tree(trace);
+    for (const auto& sample : trace.samples) {
+        analyser.add(sample);
+    }
 
-    return analysis;
+    for (const auto& backtrace : trace.backtraces) {
+        analyser.add(backtrace);
+    }
+
+    for (const auto& stackFrame : trace.stackFrames) {
+        analyser.add(stackFrame);
+    }
+
+    return analyser.finish(std::make_shared<const StringTable>(trace.strings), trace.threads);
 }
 
+Analysis swimps::analysis::analyse(TraceFile& traceFile) {
+    Analyser analyser;
+
+    while (true) {
+        const auto entry = traceFile.read_next_entry();
+
+        if (const auto* const errorCode = std::get_if<ErrorCode>(&entry)) {
+            if (*errorCode != ErrorCode::EndOfFile) {
+                format_and_write_to_log<128>(
+                    LogLevel::Fatal,
+                    "Error reading trace file: %",
+                    static_cast<int>(*errorCode)
+                );
+            }
+
+            return analyser.finish(std::make_shared<const StringTable>(traceFile.get_strings()), traceFile.get_threads());
+        }
+
+        std::visit(
+            [&analyser](const auto& entry) {
+                if constexpr (! std::is_same_v<std::decay_t<decltype(entry)>, ErrorCode>) {
+                    analyser.add(entry);
+                }
+            },
+            entry
+        );
+    }
+}
+
+Analysis swimps::analysis::analyse(const TraceIndex& traceIndex, const TimeSpecification start, const TimeSpecification end) {
+    Analyser analyser;
+
+    for (const auto& sample : traceIndex.get_samples(start, end)) {
+        analyser.add(sample);
+
+        // Each backtrace (and its stack frames) is added the first time a sample in it is seen,
+        // so the rest of the trace is never looked at.
+        if (analyser.has_backtrace(sample.backtraceID)) {
+            continue;
+        }
+
+        const auto* const backtrace = traceIndex.find_backtrace(sample.backtraceID);
+        if (backtrace == nullptr) {
+            continue;
+        }
+
+        analyser.add(*backtrace);
+
+        for (const auto stackFrameID : backtrace->stackFrameIDs) {
+            if (const auto* const stackFrame = traceIndex.find_stack_frame(stackFrameID)) {
+                analyser.add(*stackFrame);
+            }
+        }
+    }
+
+    return analyser.finish(traceIndex.get_strings(), traceIndex.get_threads());
+}
+
+Analysis::BacktraceFrequency swimps::analysis::get_heaviest_backtraces(
+    const Analysis::BacktraceFrequency& backtraceFrequency,
+    const std::size_t count
+) {
+    Analysis::BacktraceFrequency heaviestBacktraces(std::min(count, backtraceFrequency.size()));
+
+    std::partial_sort_copy(
+        backtraceFrequency.cbegin(),
+        backtraceFrequency.cend(),
+        heaviestBacktraces.begin(),
+        heaviestBacktraces.end(),
+        std::greater<>{}
+    );
+
+    return heaviestBacktraces;
+}
+
+Diff swimps::analysis::compare(const Analysis& baseline, const Analysis& candidate) {
+    Diff diff;
+    diff.baselineSamples = baseline.callTree.get(CallTree::root).frequency;
+    diff.candidateSamples = candidate.callTree.get(CallTree::root).frequency;
+
+    // Indexed by the function's ID in the diff's strings.
+    std::vector<Diff::FunctionDelta> functionDeltas;
+
+    const auto addAnalysis = [&diff, &functionDeltas](
+        const Analysis& analysis,
+        std::vector<sample_count_t>& nodeSamples,
+        double Diff::FunctionDelta::* const selfShare,
+        double Diff::FunctionDelta::* const inclusiveShare
+    ) {
+        const auto& strings = *analysis.symbolTable.strings;
+
+        // Each of the analysis's function names is put in the diff's strings the first time it's needed.
+        constexpr auto no_function = std::numeric_limits<string_id_t>::max();
+        std::vector<string_id_t> diffFunctions(strings.size(), no_function);
+        const auto getDiffFunction = [&](const string_id_t function) {
+            if (diffFunctions[function] == no_function) {
+                diffFunctions[function] = diff.strings.intern(strings.get(function));
+            }
+
+            return diffFunctions[function];
+        };
+
+        const auto nodeFunctions = get_node_functions(analysis.callTree, analysis.symbolTable);
+        const auto selfSamples = get_self_samples(analysis.callTree);
+
+        // A node's parent always comes before it, so by the time a node is reached its parent has been matched up.
+        std::vector<CallTree::node_index_t> diffNodes(analysis.callTree.size(), CallTree::root);
+        for (CallTree::node_index_t node = 1; node < analysis.callTree.size(); ++node) {
+            const auto& callTreeNode = analysis.callTree.get(node);
+            const auto diffNode = diff.callTree.add_child(diffNodes[callTreeNode.parent], getDiffFunction(nodeFunctions.names[nodeFunctions.nodes[node]]));
+            diffNodes[node] = diffNode;
+
+            diff.callTree.add_samples(diffNode, selfSamples[node]);
+
+            if (nodeSamples.size() < diff.callTree.size()) {
+                nodeSamples.resize(diff.callTree.size(), 0);
+            }
+
+            // Nodes matched to the same one are on different paths, so none of their samples are counted twice.
+            nodeSamples[diffNode] += callTreeNode.frequency;
+        }
+
+        const auto totalSamples = static_cast<double>(std::max<sample_count_t>(analysis.callTree.get(CallTree::root).frequency, 1));
+        for (const auto& functionProfile : analysis.flatProfile) {
+            const auto function = getDiffFunction(functionProfile.functionName);
+            if (function >= functionDeltas.size()) {
+                functionDeltas.resize(function + 1);
+            }
+
+            auto& functionDelta = functionDeltas[function];
+            functionDelta.functionName = function;
+            functionDelta.*selfShare = functionProfile.selfSamples / totalSamples;
+            functionDelta.*inclusiveShare = functionProfile.inclusiveSamples / totalSamples;
+        }
+    };
+
+    addAnalysis(baseline, diff.baselineNodeSamples, &Diff::FunctionDelta::baselineSelf, &Diff::FunctionDelta::baselineInclusive);
+    addAnalysis(candidate, diff.candidateNodeSamples, &Diff::FunctionDelta::candidateSelf, &Diff::FunctionDelta::candidateInclusive);
+
+    diff.baselineNodeSamples.resize(diff.callTree.size(), 0);
+    diff.candidateNodeSamples.resize(diff.callTree.size(), 0);
+    diff.baselineNodeSamples[CallTree::root] = diff.baselineSamples;
+    diff.candidateNodeSamples[CallTree::root] = diff.candidateSamples;
+
+    // Only functions with samples in a flat profile were given a delta.
+    for (const auto& functionDelta : functionDeltas) {
+        if (functionDelta.baselineInclusive != 0 || functionDelta.candidateInclusive != 0) {
+            diff.functionDeltas.push_back(functionDelta);
+        }
+    }
+
+    std::sort(diff.functionDeltas.begin(), diff.functionDeltas.end(), [](const auto& lhs, const auto& rhs) {
+        const auto lhsSelfDelta = lhs.candidateSelf - lhs.baselineSelf;
+        const auto rhsSelfDelta = rhs.candidateSelf - rhs.baselineSelf;
+        const auto lhsInclusiveDelta = lhs.candidateInclusive - lhs.baselineInclusive;
+        const auto rhsInclusiveDelta = rhs.candidateInclusive - rhs.baselineInclusive;
+
+        return std::tie(rhsSelfDelta, rhsInclusiveDelta, lhs.functionName)
+             < std::tie(lhsSelfDelta, lhsInclusiveDelta, rhs.functionName);
+    });
+
+    return diff;
+}
@@ -18,6 +18,9 @@ namespace swimps::error {
         ReadBacktraceFailed,
         ReadStackFrameFailed,
         UnknownEntryKind,
-        EndOfFile
+        EndOfFile,
+        ReadSectionFailed,
+        MergeTraceFilesFailed,
+        ConvertTraceFailed
     };
 }
@@ -20,6 +20,19 @@ namespace swimps::option {
         std::string targetProgram;
         std::vector<std::string> targetProgramArgs;
 
+        bool compressTrace = false;
+        bool flatProfile = false;
+
+        //!
+        //! \brief  The trace file to compare the target trace file against, when diffing two traces.
+        //!
+        std::string diffBaselineTraceFile;
+
+        //!
+        //! \brief  The trace files to merge into the target trace file.
+        //!
+        std::vector<std::string> mergeTraceFiles;
+
         //!
         //! \brief  Turns options into a string.
         //!
@@ -10,9 +10,13 @@ namespace {
     const std::string stringOptionsLogLevelLabel = "log-level ";
     const std::string stringOptionsSamplesPerSecondLabel = "samples-per-second ";
     const std::string stringOptionsTargetTraceFileLabel = "target-trace-file ";
+    const std::string stringOptionsDiffBaselineTraceFileLabel = "diff-baseline-trace-file ";
+    const std::string stringOptionsMergeTraceFilesLabel = "merge-trace-files ";
     const std::string stringOptionsTargetProgramLabel = "target-program ";
     const std::string stringOptionsTargetProgramArgsLabel = "target-program-args ";
     const std::string stringOptionsLoadLabel = "load ";
+    const std::string stringOptionsCompressTraceLabel = "compress-trace ";
+    const std::string stringOptionsFlatProfileLabel = "flat-profile ";
 
     std::string chompPrefix(std::string string, std::string prefix) {
         swimps_assert(string.starts_with(prefix));
@@ -44,6 +48,18 @@ Options swimps::option::Options::fromString(std::string string) {
     result.load = string[0] == '1';
     string = chompPrefix(string.substr(1), "|");
 
+    // compress trace
+    string = chompPrefix(string, stringOptionsCompressTraceLabel);
+    swimps_assert(string.length() >= 1);
+    result.compressTrace = string[0] == '1';
+    string = chompPrefix(string.substr(1), "|");
+
+    // flat profile
+    string = chompPrefix(string, stringOptionsFlatProfileLabel);
+    swimps_assert(string.length() >= 1);
+    result.flatProfile = string[0] == '1';
+    string = chompPrefix(string.substr(1), "|");
+
     // log level
     string = chompPrefix(string, stringOptionsLogLevelLabel);
     swimps_assert(string.length() >= 1);
@@ -75,6 +91,29 @@ Options swimps::option::Options::fromString(std::string string) {
         string = string.substr(end + 1);
     }
 
+    // diff baseline trace file
+    string = chompPrefix(string, stringOptionsDiffBaselineTraceFileLabel);
+    {
+        const auto end = string.find("|");
+        result.diffBaselineTraceFile = string.substr(0, end);
+        string = string.substr(end + 1);
+    }
+
+    // merge trace files
+    string = chompPrefix(string, stringOptionsMergeTraceFilesLabel);
+    {
+        // Unlike the target program's args, these aren't last, so they're preceded by how many there are.
+        auto end = string.find("|");
+        const auto count = std::stoul(string.substr(0, end));
+        string = string.substr(end + 1);
+
+        for (std::size_t i = 0; i < count; ++i) {
+            end = string.find("|");
+            result.mergeTraceFiles.push_back(string.substr(0, end));
+            string = string.substr(end + 1);
+        }
+    }
+
     // target program
     string = chompPrefix(string, stringOptionsTargetProgramLabel);
     {
@@ -110,6 +149,12 @@ std::string swimps::option::Options::toString() const {
     // load
     stringStream << stringOptionsLoadLabel << (load ? "1" : "0") << "|";
 
+    // compress trace
+    stringStream << stringOptionsCompressTraceLabel << (compressTrace ? "1" : "0") << "|";
+
+    // flat profile
+    stringStream << stringOptionsFlatProfileLabel << (flatProfile ? "1" : "0") << "|";
+
     // log level
     stringStream << stringOptionsLogLevelLabel;
 
@@ -131,6 +176,16 @@ std::string swimps::option::Options::toString() const {
     // target trace file
     stringStream << stringOptionsTargetTraceFileLabel << targetTraceFile << "|";
 
+    // diff baseline trace file
+    stringStream << stringOptionsDiffBaselineTraceFileLabel << diffBaselineTraceFile << "|";
+
+    // merge trace files
+    stringStream << stringOptionsMergeTraceFilesLabel << mergeTraceFiles.size() << "|";
+
+    for (auto& mergeTraceFile : mergeTraceFiles) {
+        stringStream << mergeTraceFile << "|";
+    }
+
     // target program
     stringStream << stringOptionsTargetProgramLabel << targetProgram << "|";
 
@@ -33,11 +33,23 @@ std::optional<Options> swimps::option::parse_command_line(
     CLI::App cliApp;
 
     cliApp.add_flag("--load", options.load, "Load the target trace file rather than creating a new one.");
+    cliApp.add_flag("--compress-trace", options.compressTrace, "Compress the trace file's sections with LZ4.");
+    cliApp.add_flag("--flat-profile", options.flatProfile, "Print a flat profile of the trace to stdout.");
     cliApp.add_flag("--tui,!--no-tui", options.tui, "Toggle the TUI.");
     cliApp.add_flag("--ptrace,!--no-ptrace", options.ptrace, "Toggle ptrace."); 
     cliApp.add_option("--target-trace-file", options.targetTraceFile);
     cliApp.add_option("--samples-per-second", options.samplesPerSecond)->check(CLI::Range(0.0, 1'000'000.0));
 
+    auto* const diffCommand = cliApp.add_subcommand("diff", "Compare a candidate trace file against a baseline trace file.");
+    diffCommand->add_option("baseline", options.diffBaselineTraceFile, "The trace file to compare against.")->required();
+    diffCommand->add_option("candidate", options.targetTraceFile, "The trace file to compare.")->required();
+    diffCommand->fallthrough();
+
+    auto* const mergeCommand = cliApp.add_subcommand("merge", "Merge trace files into the target trace file.");
+    mergeCommand->add_option("output", options.targetTraceFile, "The trace file to write.")->required();
+    mergeCommand->add_option("inputs", options.mergeTraceFiles, "The trace files to merge.")->required();
+    mergeCommand->fallthrough();
+
     const auto logLevelMap = std::map<std::string, LogLevel>{
         {"debug",   LogLevel::Debug},
         {"info",    LogLevel::Info},
@@ -62,6 +74,12 @@ std::optional<Options> swimps::option::parse_command_line(
 
     const auto remaining = cliApp.remaining(true);
 
+    // Diffing and merging only ever load existing trace files.
+    if (diffCommand->parsed() || mergeCommand->parsed()) {
+        options.load = true;
+        return options;
+    }
+
     if (options.load) {
         return options;
     }
@@ -2,6 +2,8 @@
 
 #include "swimps-error/swimps-error.h"
 
+#include <string>
+
 #include <unistd.h>
 
 namespace swimps::option {
@@ -34,9 +36,11 @@ namespace swimps::profile {
     //! \brief  Sets up a process in the "parent" to monitor the profiled executable.
     //!
     //! \param[in]  The PID of the child process.
+    //! \param[in]  memoryMapsPath  Where to save the child process's memory maps, for symbolising its trace.
+    //! \param[in]  isTraced        Whether the child process is being traced with ptrace.
     //!
     //! \returns An error code, if there was an error.
     //!
-    swimps::error::ErrorCode parent(const pid_t childPid);
+    swimps::error::ErrorCode parent(const pid_t childPid, const std::string& memoryMapsPath, bool isTraced);
 }
 
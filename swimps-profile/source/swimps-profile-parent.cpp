@@ -1,69 +1,212 @@
 #include "swimps-profile/swimps-profile.h"
 #include "swimps-log/swimps-log.h"
+#include "swimps-symbol/swimps-symbol.h"
 
 #include <cerrno>
+#include <chrono>
+#include <condition_variable>
 #include <cstring>
+#include <ctime>
+#include <mutex>
+#include <thread>
 
 #include <sys/wait.h>
 #include <sys/ptrace.h>
 
-swimps::error::ErrorCode swimps::profile::parent(const pid_t childPid) {
-    while(1) {
-        int status = 0;
-        waitpid(childPid, &status, 0);
+namespace {
+    // How often to look for libraries the child has loaded (or unloaded) since the last look.
+    constexpr std::chrono::milliseconds memory_map_poll_interval(100);
 
-        if (WIFEXITED(status)) {
-            const auto exitCode = WEXITSTATUS(status);
-
-            swimps::log::format_and_write_to_log<256>(
-                swimps::log::LogLevel::Debug,
-                "Child process exited with code %.",
-                exitCode
+    void save_memory_maps(const swimps::symbol::MemoryMapRecorder& memoryMapRecorder, const std::string& memoryMapsPath) {
+        if (! memoryMapRecorder.save(memoryMapsPath)) {
+            swimps::log::format_and_write_to_log<512>(
+                swimps::log::LogLevel::Warning,
+                "Failed to save the child process's memory maps to %; its trace can't be symbolised properly.",
+                memoryMapsPath.c_str()
             );
+        }
+    }
 
-            return exitCode == 0 ? swimps::error::ErrorCode::None
-                                 : swimps::error::ErrorCode::ChildProcessHasNonZeroExitCode;
+    //
+    // Records a process's memory maps every so often on a thread of its own,
+    // so that the process is never held up in a ptrace stop while its maps are read.
+    //
+    class MemoryMapPoller {
+    public:
+        explicit MemoryMapPoller(const pid_t pid)
+            : m_pid(pid),
+              m_thread([this](){ poll(); }) {
         }
 
-        if (WIFSIGNALED(status)) {
-            swimps::log::write_to_log(
-                swimps::log::LogLevel::Debug,
-                "Child process exited due to a signal."
-            );
+        ~MemoryMapPoller() {
+            stop();
+        }
+
+        void record() {
+            std::lock_guard lock(m_mutex);
+            m_memoryMapRecorder.record(m_pid);
+        }
 
-            return swimps::error::ErrorCode::ChildProcessExitedDueToSignal;
+        void stop_and_save(const std::string& memoryMapsPath) {
+            stop();
+            save_memory_maps(m_memoryMapRecorder, memoryMapsPath);
         }
 
-        if (WIFSTOPPED(status)) {
-            const int signalNumber = WSTOPSIG(status);
+        MemoryMapPoller(const MemoryMapPoller&) = delete;
+        MemoryMapPoller& operator=(const MemoryMapPoller&) = delete;
 
-            swimps::log::format_and_write_to_log<128>(
-                swimps::log::LogLevel::Debug,
-                "Child process stopped due to signal % (%).",
-                signalNumber,
-                strsignal(signalNumber)
-            );
+    private:
+        void poll() {
+            std::unique_lock lock(m_mutex);
+            while (! m_stopRequested.wait_for(lock, memory_map_poll_interval, [this](){ return m_stopping; })) {
+                m_memoryMapRecorder.record(m_pid);
+            }
+        }
+
+        void stop() {
+            {
+                std::lock_guard lock(m_mutex);
+                m_stopping = true;
+            }
 
-            int signalToSend = 0;
+            m_stopRequested.notify_one();
 
-            switch(signalNumber) {
-            case SIGTRAP:
-                break;
-            default:
-                signalToSend = signalNumber;
-                break;
+            if (m_thread.joinable()) {
+                m_thread.join();
             }
+        }
+
+        const pid_t m_pid;
+        swimps::symbol::MemoryMapRecorder m_memoryMapRecorder;
+        std::mutex m_mutex;
+        std::condition_variable m_stopRequested;
+        bool m_stopping = false;
+
+        // Started last, once everything it uses is set up.
+        std::thread m_thread;
+    };
+
+    swimps::error::ErrorCode on_exited(const int status) {
+        const auto exitCode = WEXITSTATUS(status);
+
+        swimps::log::format_and_write_to_log<256>(
+            swimps::log::LogLevel::Debug,
+            "Child process exited with code %.",
+            exitCode
+        );
+
+        return exitCode == 0 ? swimps::error::ErrorCode::None
+                             : swimps::error::ErrorCode::ChildProcessHasNonZeroExitCode;
+    }
+
+    swimps::error::ErrorCode on_signaled() {
+        swimps::log::write_to_log(
+            swimps::log::LogLevel::Debug,
+            "Child process exited due to a signal."
+        );
+
+        return swimps::error::ErrorCode::ChildProcessExitedDueToSignal;
+    }
+
+    //
+    // Without ptrace there are no stops to record the memory maps at,
+    // so they're recorded as the child runs; they're gone once it exits.
+    //
+    swimps::error::ErrorCode wait_untraced(const pid_t childPid, const std::string& memoryMapsPath) {
+        swimps::symbol::MemoryMapRecorder memoryMapRecorder;
+
+        const auto pollIntervalNanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(memory_map_poll_interval).count();
+        const timespec pollInterval = { 0, static_cast<long>(pollIntervalNanoseconds) };
+
+        while(1) {
+            int status = 0;
+            if (waitpid(childPid, &status, WNOHANG) == 0) {
+                memoryMapRecorder.record(childPid);
+                nanosleep(&pollInterval, nullptr);
+                continue;
+            }
+
+            if (WIFEXITED(status)) {
+                save_memory_maps(memoryMapRecorder, memoryMapsPath);
+                return on_exited(status);
+            }
+
+            if (WIFSIGNALED(status)) {
+                save_memory_maps(memoryMapRecorder, memoryMapsPath);
+                return on_signaled();
+            }
+        }
+    }
+
+    //
+    // The child is traced, so it stops for every signal it's sent (including the sampler's own),
+    // and has to be sent on its way again as quickly as possible to keep from skewing its profile.
+    // Its memory maps are recorded at its exec and exit stops, and on a separate thread in between.
+    //
+    swimps::error::ErrorCode wait_traced(const pid_t childPid, const std::string& memoryMapsPath) {
+        MemoryMapPoller memoryMapPoller(childPid);
+        bool traceExitRequested = false;
+
+        while(1) {
+            int status = 0;
+            waitpid(childPid, &status, 0);
+
+            if (WIFEXITED(status)) {
+                memoryMapPoller.stop_and_save(memoryMapsPath);
+                return on_exited(status);
+            }
+
+            if (WIFSIGNALED(status)) {
+                memoryMapPoller.stop_and_save(memoryMapsPath);
+                return on_signaled();
+            }
+
+            if (WIFSTOPPED(status)) {
+                const int signalNumber = WSTOPSIG(status);
 
-            if (ptrace(PTRACE_CONT, childPid, 0 /* ignored */, signalToSend) == -1) {
                 swimps::log::format_and_write_to_log<128>(
                     swimps::log::LogLevel::Debug,
-                    "ptrace(PTRACE_CONT) failed, errno % (%).",
-                    errno,
-                    strerror(errno)
+                    "Child process stopped due to signal % (%).",
+                    signalNumber,
+                    strsignal(signalNumber)
                 );
 
-                return swimps::error::ErrorCode::PtraceFailed;
+                // The first stop is the exec, after which the child can be stopped on its way out too,
+                // to record its memory maps with everything it loaded still mapped in.
+                if (! traceExitRequested) {
+                    traceExitRequested = true;
+                    memoryMapPoller.record();
+                    ptrace(PTRACE_SETOPTIONS, childPid, 0 /* ignored */, PTRACE_O_TRACEEXIT);
+                } else if (status >> 8 == (SIGTRAP | (PTRACE_EVENT_EXIT << 8))) {
+                    memoryMapPoller.record();
+                }
+
+                int signalToSend = 0;
+
+                switch(signalNumber) {
+                case SIGTRAP:
+                    break;
+                default:
+                    signalToSend = signalNumber;
+                    break;
+                }
+
+                if (ptrace(PTRACE_CONT, childPid, 0 /* ignored */, signalToSend) == -1) {
+                    swimps::log::format_and_write_to_log<128>(
+                        swimps::log::LogLevel::Debug,
+                        "ptrace(PTRACE_CONT) failed, errno % (%).",
+                        errno,
+                        strerror(errno)
+                    );
+
+                    return swimps::error::ErrorCode::PtraceFailed;
+                }
             }
         }
     }
 }
+
+swimps::error::ErrorCode swimps::profile::parent(const pid_t childPid, const std::string& memoryMapsPath, const bool isTraced) {
+    return isTraced ? wait_traced(childPid, memoryMapsPath)
+                    : wait_untraced(childPid, memoryMapsPath);
+}
@@ -1,5 +1,7 @@
 #include "swimps-profile/swimps-profile.h"
 #include "swimps-log/swimps-log.h"
+#include "swimps-option/swimps-option-options.h"
+#include "swimps-symbol/swimps-symbol.h"
 
 #include <unistd.h>
 #include <errno.h>
@@ -24,7 +26,7 @@ swimps::error::ErrorCode swimps::profile::start(const swimps::option::Options& o
     case 0:
         return swimps::profile::child(options);
     default:
-        return swimps::profile::parent(pid);
+        return swimps::profile::parent(pid, swimps::symbol::get_memory_maps_path(options.targetTraceFile), options.ptrace);
     }
 }
 
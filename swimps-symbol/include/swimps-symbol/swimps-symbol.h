@@ -0,0 +1,342 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include <unistd.h>
+
+#include "swimps-thread/swimps-thread.h"
+#include "swimps-trace/swimps-trace.h"
+
+namespace swimps::symbol {
+    using swimps::trace::address_t;
+    using swimps::trace::line_number_t;
+    using swimps::trace::offset_t;
+
+    //!
+    //! \brief  A file mapped into a process's address space, as listed in /proc/<pid>/maps.
+    //!
+    struct MemoryMap {
+        address_t start = 0;
+        address_t end = 0;
+        offset_t fileOffset = 0;
+        std::string path;
+
+        bool operator==(const MemoryMap&) const = default;
+    };
+
+    //!
+    //! \brief  Parses memory maps in the format of /proc/<pid>/maps.
+    //!
+    //! \param[in]  text  The memory maps to parse.
+    //!
+    //! \returns  The executable, file backed memory maps; the rest can't contain code to symbolise.
+    //!
+    //! \note  Malformed lines are skipped.
+    //!
+    //! \note  This function is *not* async signal safe.
+    //!
+    std::vector<MemoryMap> parse_memory_maps(std::string_view text);
+
+    //!
+    //! \brief  Formats memory maps in the format of /proc/<pid>/maps, so that parse_memory_maps can read them back.
+    //!
+    //! \param[in]  memoryMaps  The memory maps to format.
+    //!
+    //! \returns  The formatted memory maps, one per line.
+    //!
+    //! \note  This function is *not* async signal safe.
+    //!
+    std::string format_memory_maps(std::span<const MemoryMap> memoryMaps);
+
+    //!
+    //! \brief  Gets where the memory maps of a profiled process are kept, alongside its trace file.
+    //!
+    //! \param[in]  traceFilePath  The path of the trace file.
+    //!
+    //! \returns  The path of the memory maps file.
+    //!
+    //! \note  This function is *not* async signal safe.
+    //!
+    std::string get_memory_maps_path(std::string_view traceFilePath);
+
+    //!
+    //! \brief  Gathers up the memory maps of a running process, across as many snapshots as are taken of it.
+    //!
+    //! \note  Libraries can be loaded (e.g. by dlopen) and unloaded while a process runs,
+    //!        so it should be recorded at startup and then every so often until it exits.
+    //!
+    class MemoryMapRecorder {
+    public:
+        //!
+        //! \brief  Takes a snapshot of a process's memory maps, keeping any that haven't been seen before.
+        //!
+        //! \param[in]  pid  The process to take a snapshot of.
+        //!
+        //! \returns  Whether the process's memory maps could be read.
+        //!
+        //! \note  This function is *not* async signal safe.
+        //!
+        bool record(pid_t pid);
+
+        //!
+        //! \brief  Gets every memory map seen so far, in the order they were first seen.
+        //!
+        //! \returns  The recorded memory maps.
+        //!
+        const std::vector<MemoryMap>& get_memory_maps() const noexcept;
+
+        //!
+        //! \brief  Writes the recorded memory maps to a file.
+        //!
+        //! \param[in]  path  Where to write them.
+        //!
+        //! \returns  Whether the file was written.
+        //!
+        //! \note  This function is *not* async signal safe.
+        //!
+        bool save(const std::string& path) const;
+
+    private:
+        std::string m_snapshot;
+        std::vector<MemoryMap> m_memoryMaps;
+    };
+
+    //!
+    //! \brief  A function that was inlined at an address, and the source line within it that the address is on.
+    //!
+    struct InlinedFrame {
+        std::string functionName;
+        std::string sourceFilePath;
+        line_number_t lineNumber = -1;
+    };
+
+    //!
+    //! \brief  What an address was resolved to.
+    //!
+    //! \note  Any part that couldn't be resolved is left empty (or as -1, for the line number).
+    //!
+    struct Symbol {
+        std::string functionName;
+        offset_t offset = 0;
+        std::string sourceFilePath;
+        line_number_t lineNumber = -1;
+
+        //!
+        //! \brief  The functions inlined at the address, innermost first.
+        //!
+        //! \note  When there are any, the source file and line above are where the outermost of them was called.
+        //!
+        std::vector<InlinedFrame> inlinedFrames;
+    };
+
+    //!
+    //! \brief  Gets where symbols are cached between runs: $XDG_CACHE_HOME/swimps, or ~/.cache/swimps.
+    //!
+    //! \returns  The cache directory, or an empty string if neither XDG_CACHE_HOME nor HOME are set.
+    //!
+    //! \note  This function is *not* async signal safe.
+    //!
+    std::string get_symbol_cache_directory();
+
+    //!
+    //! \brief  The function and source line indexes of an ELF file, built once so that each lookup is a binary search.
+    //!
+    //! \note  The indexes are laid out the same way in memory as in the symbol cache,
+    //!        so a cached module is used straight from its mapping without being read in.
+    //!
+    class Module {
+    public:
+        //!
+        //! \brief  Loads an ELF file's symbol tables and DWARF line and inlining information,
+        //!         or their indexes from the symbol cache.
+        //!
+        //! \param[in]  path            The ELF file to load.
+        //! \param[in]  cacheDirectory  Where to look for (and save) the module's indexes, by its build ID.
+        //!                             If empty, or the module has no build ID, the cache isn't used.
+        //!
+        //! \returns  The module, or nothing if the file couldn't be read or isn't a supported ELF file.
+        //!
+        //! \note  If the file has no line tables, a separate debug file is looked for by its build ID.
+        //!
+        //! \note  Cache files are written to a temporary file and renamed into place,
+        //!        so several processes can share a cache directory without seeing each other's partial writes.
+        //!
+        //! \note  This function is *not* async signal safe.
+        //!
+        static std::optional<Module> load(const std::string& path, const std::string& cacheDirectory = {});
+
+        //!
+        //! \brief  Converts an offset into the file to the address it is loaded at, before relocation.
+        //!
+        //! \param[in]  fileOffset  The offset into the file.
+        //!
+        //! \returns  The address, or nothing if the offset isn't within a loadable segment.
+        //!
+        std::optional<address_t> get_address(offset_t fileOffset) const noexcept;
+
+        //!
+        //! \brief  Resolves an address to the function and source line it belongs to, and any functions inlined there.
+        //!
+        //! \param[in]  address  The address, as returned by get_address.
+        //!
+        //! \returns  What the address resolved to.
+        //!
+        //! \note  This function is *not* async signal safe.
+        //!
+        Symbol symbolise(address_t address) const;
+
+        //!
+        //! \brief  Gets the module's build ID, from its GNU build ID note.
+        //!
+        //! \returns  The build ID as lowercase hex, or an empty string if the module hasn't got one.
+        //!
+        const std::string& get_build_id() const noexcept;
+
+        //!
+        //! \brief  Gets whether the module's indexes came from the symbol cache, rather than the ELF file itself.
+        //!
+        //! \returns  Whether the module was loaded from the cache.
+        //!
+        bool is_cached() const noexcept;
+
+        //!
+        //! \brief  A loadable segment: where a range of the file ends up in memory.
+        //!
+        struct Segment {
+            offset_t fileOffset = 0;
+            std::uint64_t fileSize = 0;
+            address_t address = 0;
+        };
+
+        //!
+        //! \brief  A function's address range, and where its (mangled) name is in the module's strings.
+        //!
+        struct Function {
+            address_t start = 0;
+            address_t end = 0;
+            std::uint64_t nameOffset = 0;
+        };
+
+        //!
+        //! \brief  Where a source line's code starts; it runs until the next line starts.
+        //!
+        struct Line {
+            // Marks the end of a run of lines, after which addresses have no line until the next one starts.
+            static constexpr std::uint64_t no_source_file = std::numeric_limits<std::uint64_t>::max();
+
+            address_t start = 0;
+            line_number_t lineNumber = -1;
+            std::uint64_t sourceFilePathOffset = no_source_file;
+        };
+
+        //!
+        //! \brief  An address range where a function was inlined, and where it was called from.
+        //!
+        //! \note  Calls inlined into other inlined calls refer to the range they're within as their parent.
+        //!        Parents always come before their children, which are never outside of them.
+        //!
+        struct InlinedCall {
+            static constexpr std::uint64_t no_parent = std::numeric_limits<std::uint64_t>::max();
+
+            address_t start = 0;
+            address_t end = 0;
+            std::uint64_t nameOffset = 0;
+            std::uint64_t callSourceFilePathOffset = Line::no_source_file;
+            line_number_t callLineNumber = -1;
+            std::uint64_t parent = no_parent;
+        };
+
+    private:
+        //
+        // Points a module's indexes into an index laid out as it is in the symbol cache, if the index is well formed.
+        //
+        static std::optional<Module> from_index(
+            std::shared_ptr<const void> storage,
+            std::span<const std::byte> index,
+            std::string buildID,
+            bool isCached
+        );
+
+        // Owns whatever the indexes point into: a mapped cache file, or the bytes they were built into.
+        std::shared_ptr<const void> m_storage;
+
+        std::span<const Segment> m_segments;
+        std::span<const Function> m_functions;
+        std::span<const Line> m_lines;
+        std::span<const InlinedCall> m_inlinedCalls;
+        std::span<const std::byte> m_strings;
+        std::string m_buildID;
+        bool m_isCached = false;
+    };
+
+    //!
+    //! \brief  Resolves instruction pointers from another process, using the memory maps recorded from it.
+    //!
+    class Symboliser {
+    public:
+        //!
+        //! \brief  Creates a symboliser for a process.
+        //!
+        //! \param[in]  memoryMaps      The process's memory maps.
+        //! \param[in]  cacheDirectory  Where modules' indexes are cached, or empty to not use a cache.
+        //!
+        //! \note  Where memory maps overlap (i.e. something was unloaded and something else loaded in its place),
+        //!        the one starting at the lowest address is used, and any overlapping it are dropped.
+        //!        Of those starting at the same address, the one recorded first is used.
+        //!
+        Symboliser(std::vector<MemoryMap> memoryMaps, std::string cacheDirectory);
+
+        //!
+        //! \brief  Resolves an instruction pointer to the function and source line it belongs to.
+        //!
+        //! \param[in]  instructionPointer  The instruction pointer, as seen by the process.
+        //!
+        //! \returns  What the instruction pointer resolved to,
+        //!           or nothing if it isn't in a memory map with a loadable ELF file behind it.
+        //!
+        //! \note  Each module is loaded the first time an instruction pointer within it is seen.
+        //!
+        //! \note  This function is *not* async signal safe.
+        //!
+        std::optional<Symbol> symbolise(address_t instructionPointer);
+
+    private:
+        // Sorted by start address, and non-overlapping.
+        std::vector<MemoryMap> m_memoryMaps;
+        std::string m_cacheDirectory;
+        std::unordered_map<std::string, std::optional<Module>> m_modules;
+    };
+
+    //!
+    //! \brief  Resolves many instruction pointers from another process at once, spread across a pool of threads.
+    //!
+    //! \param[in]  instructionPointers  The instruction pointers to resolve, as seen by the process.
+    //! \param[in]  memoryMaps           The process's memory maps.
+    //! \param[in]  cacheDirectory       Where modules' indexes are cached, or empty to not use a cache.
+    //! \param[in]  threadCount          The most threads to use.
+    //!
+    //! \returns  What each instruction pointer resolved to (as by Symboliser::symbolise), in the same order.
+    //!
+    //! \note  The instruction pointers are split by address into one contiguous range per thread,
+    //!        each resolved by a symboliser of its own, so that a thread only loads the modules its range covers.
+    //!
+    //! \note  The results don't depend on how many threads are used.
+    //!
+    //! \note  This function is *not* async signal safe.
+    //!
+    std::vector<std::optional<Symbol>> symbolise_in_parallel(
+        std::span<const address_t> instructionPointers,
+        std::span<const MemoryMap> memoryMaps,
+        const std::string& cacheDirectory,
+        std::size_t threadCount = swimps::thread::default_thread_count()
+    );
+}
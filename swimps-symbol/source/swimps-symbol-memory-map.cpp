@@ -0,0 +1,142 @@
+#include "swimps-symbol/swimps-symbol.h"
+
+#include <algorithm>
+#include <charconv>
+#include <cinttypes>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+
+using swimps::symbol::address_t;
+using swimps::symbol::MemoryMap;
+using swimps::symbol::MemoryMapRecorder;
+
+namespace {
+    //
+    // Splits off the text up to the next space (or the end), skipping any spaces that follow it.
+    //
+    std::string_view next_field(std::string_view& line) {
+        const auto fieldEnd = std::min(line.find(' '), line.size());
+        const auto field = line.substr(0, fieldEnd);
+
+        line.remove_prefix(fieldEnd);
+        line.remove_prefix(std::min(line.find_first_not_of(' '), line.size()));
+
+        return field;
+    }
+
+    bool parse_hex(const std::string_view text, std::uint64_t& value) {
+        const auto [end, error] = std::from_chars(text.data(), text.data() + text.size(), value, 16);
+        return error == std::errc() && end == text.data() + text.size();
+    }
+
+    std::optional<MemoryMap> parse_memory_map(std::string_view line) {
+        // e.g. 7f2c4a1d1000-7f2c4a1f3000 r-xp 00025000 fd:01 1835024    /usr/lib/x86_64-linux-gnu/libc.so.6
+        const auto range = next_field(line);
+        const auto permissions = next_field(line);
+        const auto fileOffset = next_field(line);
+        next_field(line); // device
+        next_field(line); // inode
+
+        // What's left is the path, which can contain spaces of its own.
+        const auto path = line;
+
+        const auto rangeSeparator = range.find('-');
+        if (rangeSeparator == std::string_view::npos || permissions.size() < 3) {
+            return {};
+        }
+
+        MemoryMap memoryMap;
+        if (! parse_hex(range.substr(0, rangeSeparator), memoryMap.start)
+         || ! parse_hex(range.substr(rangeSeparator + 1), memoryMap.end)
+         || ! parse_hex(fileOffset, memoryMap.fileOffset)
+         || memoryMap.start >= memoryMap.end) {
+            return {};
+        }
+
+        // Anonymous memory, the stack, [vdso] and the like have no file to read symbols from.
+        if (permissions[2] != 'x' || ! path.starts_with('/')) {
+            return {};
+        }
+
+        memoryMap.path = path;
+        return memoryMap;
+    }
+}
+
+std::vector<MemoryMap> swimps::symbol::parse_memory_maps(const std::string_view text) {
+    std::vector<MemoryMap> memoryMaps;
+
+    std::size_t lineStart = 0;
+    while (lineStart < text.size()) {
+        const auto lineEnd = std::min(text.find('\n', lineStart), text.size());
+
+        if (auto memoryMap = parse_memory_map(text.substr(lineStart, lineEnd - lineStart))) {
+            memoryMaps.push_back(std::move(*memoryMap));
+        }
+
+        lineStart = lineEnd + 1;
+    }
+
+    return memoryMaps;
+}
+
+std::string swimps::symbol::format_memory_maps(const std::span<const MemoryMap> memoryMaps) {
+    std::string text;
+
+    for (const auto& memoryMap : memoryMaps) {
+        char fields[64] = { };
+        snprintf(
+            fields,
+            sizeof fields,
+            "%" PRIx64 "-%" PRIx64 " r-xp %08" PRIx64 " 00:00 0 ",
+            memoryMap.start,
+            memoryMap.end,
+            memoryMap.fileOffset
+        );
+
+        text += fields;
+        text += memoryMap.path;
+        text += '\n';
+    }
+
+    return text;
+}
+
+std::string swimps::symbol::get_memory_maps_path(const std::string_view traceFilePath) {
+    return std::string(traceFilePath) + ".maps";
+}
+
+bool MemoryMapRecorder::record(const pid_t pid) {
+    std::ifstream mapsFile("/proc/" + std::to_string(pid) + "/maps");
+    if (! mapsFile.is_open()) {
+        return false;
+    }
+
+    std::string snapshot(std::istreambuf_iterator<char>(mapsFile), {});
+
+    // Most of the time nothing will have been loaded or unloaded since the last snapshot.
+    if (snapshot == m_snapshot) {
+        return true;
+    }
+
+    for (auto& memoryMap : parse_memory_maps(snapshot)) {
+        if (std::find(m_memoryMaps.cbegin(), m_memoryMaps.cend(), memoryMap) == m_memoryMaps.cend()) {
+            m_memoryMaps.push_back(std::move(memoryMap));
+        }
+    }
+
+    m_snapshot = std::move(snapshot);
+    return true;
+}
+
+const std::vector<MemoryMap>& MemoryMapRecorder::get_memory_maps() const noexcept {
+    return m_memoryMaps;
+}
+
+bool MemoryMapRecorder::save(const std::string& path) const {
+    std::ofstream mapsFile(path, std::ios_base::out | std::ios_base::trunc);
+    mapsFile << format_memory_maps(m_memoryMaps);
+    return mapsFile.good();
+}
@@ -0,0 +1,1993 @@
+#include "swimps-symbol/swimps-symbol.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <numeric>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+#include <elf.h>
+#include <fcntl.h>
+#include <gelf.h>
+#include <libelf.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "swimps-log/swimps-log.h"
+
+using swimps::log::format_and_write_to_log;
+using swimps::log::LogLevel;
+using swimps::symbol::address_t;
+using swimps::symbol::line_number_t;
+using swimps::symbol::Module;
+using swimps::symbol::offset_t;
+using swimps::symbol::Symbol;
+
+namespace {
+    // Separate debug files are installed here, named after the build ID of the file they're for.
+    constexpr std::string_view debug_file_directory = "/usr/lib/debug/.build-id/";
+
+    // The parts of DWARF (see dwarf.h) that reading line tables and inlined calls needs.
+    constexpr std::uint8_t dw_lns_copy = 0x01;
+    constexpr std::uint8_t dw_lns_advance_pc = 0x02;
+    constexpr std::uint8_t dw_lns_advance_line = 0x03;
+    constexpr std::uint8_t dw_lns_set_file = 0x04;
+    constexpr std::uint8_t dw_lns_const_add_pc = 0x08;
+    constexpr std::uint8_t dw_lns_fixed_advance_pc = 0x09;
+    constexpr std::uint8_t dw_lne_end_sequence = 0x01;
+    constexpr std::uint8_t dw_lne_set_address = 0x02;
+    constexpr std::uint64_t dw_lnct_path = 0x1;
+    constexpr std::uint64_t dw_lnct_directory_index = 0x2;
+    constexpr std::uint8_t dw_ut_compile = 0x01;
+    constexpr std::uint8_t dw_ut_partial = 0x03;
+    constexpr std::uint64_t dw_tag_inlined_subroutine = 0x1d;
+    constexpr std::uint64_t dw_tag_subprogram = 0x2e;
+    constexpr std::uint64_t dw_at_name = 0x03;
+    constexpr std::uint64_t dw_at_stmt_list = 0x10;
+    constexpr std::uint64_t dw_at_low_pc = 0x11;
+    constexpr std::uint64_t dw_at_high_pc = 0x12;
+    constexpr std::uint64_t dw_at_abstract_origin = 0x31;
+    constexpr std::uint64_t dw_at_specification = 0x47;
+    constexpr std::uint64_t dw_at_ranges = 0x55;
+    constexpr std::uint64_t dw_at_call_file = 0x58;
+    constexpr std::uint64_t dw_at_call_line = 0x59;
+    constexpr std::uint64_t dw_at_linkage_name = 0x6e;
+    constexpr std::uint64_t dw_at_str_offsets_base = 0x72;
+    constexpr std::uint64_t dw_at_addr_base = 0x73;
+    constexpr std::uint64_t dw_at_rnglists_base = 0x74;
+    constexpr std::uint64_t dw_at_mips_linkage_name = 0x2007;
+    constexpr std::uint64_t dw_form_addr = 0x01;
+    constexpr std::uint64_t dw_form_block2 = 0x03;
+    constexpr std::uint64_t dw_form_block4 = 0x04;
+    constexpr std::uint64_t dw_form_data2 = 0x05;
+    constexpr std::uint64_t dw_form_data4 = 0x06;
+    constexpr std::uint64_t dw_form_data8 = 0x07;
+    constexpr std::uint64_t dw_form_string = 0x08;
+    constexpr std::uint64_t dw_form_block = 0x09;
+    constexpr std::uint64_t dw_form_block1 = 0x0a;
+    constexpr std::uint64_t dw_form_data1 = 0x0b;
+    constexpr std::uint64_t dw_form_flag = 0x0c;
+    constexpr std::uint64_t dw_form_sdata = 0x0d;
+    constexpr std::uint64_t dw_form_strp = 0x0e;
+    constexpr std::uint64_t dw_form_udata = 0x0f;
+    constexpr std::uint64_t dw_form_ref_addr = 0x10;
+    constexpr std::uint64_t dw_form_ref1 = 0x11;
+    constexpr std::uint64_t dw_form_ref2 = 0x12;
+    constexpr std::uint64_t dw_form_ref4 = 0x13;
+    constexpr std::uint64_t dw_form_ref8 = 0x14;
+    constexpr std::uint64_t dw_form_ref_udata = 0x15;
+    constexpr std::uint64_t dw_form_indirect = 0x16;
+    constexpr std::uint64_t dw_form_sec_offset = 0x17;
+    constexpr std::uint64_t dw_form_exprloc = 0x18;
+    constexpr std::uint64_t dw_form_flag_present = 0x19;
+    constexpr std::uint64_t dw_form_strx = 0x1a;
+    constexpr std::uint64_t dw_form_addrx = 0x1b;
+    constexpr std::uint64_t dw_form_ref_sup4 = 0x1c;
+    constexpr std::uint64_t dw_form_strp_sup = 0x1d;
+    constexpr std::uint64_t dw_form_data16 = 0x1e;
+    constexpr std::uint64_t dw_form_line_strp = 0x1f;
+    constexpr std::uint64_t dw_form_ref_sig8 = 0x20;
+    constexpr std::uint64_t dw_form_implicit_const = 0x21;
+    constexpr std::uint64_t dw_form_loclistx = 0x22;
+    constexpr std::uint64_t dw_form_rnglistx = 0x23;
+    constexpr std::uint64_t dw_form_ref_sup8 = 0x24;
+    constexpr std::uint64_t dw_form_strx1 = 0x25;
+    constexpr std::uint64_t dw_form_strx2 = 0x26;
+    constexpr std::uint64_t dw_form_strx3 = 0x27;
+    constexpr std::uint64_t dw_form_strx4 = 0x28;
+    constexpr std::uint64_t dw_form_addrx1 = 0x29;
+    constexpr std::uint64_t dw_form_addrx2 = 0x2a;
+    constexpr std::uint64_t dw_form_addrx3 = 0x2b;
+    constexpr std::uint64_t dw_form_addrx4 = 0x2c;
+    constexpr std::uint64_t dw_form_gnu_addr_index = 0x1f01;
+    constexpr std::uint64_t dw_form_gnu_str_index = 0x1f02;
+    constexpr std::uint64_t dw_form_gnu_ref_alt = 0x1f20;
+    constexpr std::uint64_t dw_form_gnu_strp_alt = 0x1f21;
+    constexpr std::uint8_t dw_rle_end_of_list = 0x00;
+    constexpr std::uint8_t dw_rle_base_addressx = 0x01;
+    constexpr std::uint8_t dw_rle_startx_endx = 0x02;
+    constexpr std::uint8_t dw_rle_startx_length = 0x03;
+    constexpr std::uint8_t dw_rle_offset_pair = 0x04;
+    constexpr std::uint8_t dw_rle_base_address = 0x05;
+    constexpr std::uint8_t dw_rle_start_end = 0x06;
+    constexpr std::uint8_t dw_rle_start_length = 0x07;
+
+    //
+    // Owns a read-only, private mapping of an entire file.
+    //
+    class MappedFile final {
+    public:
+        explicit MappedFile(const std::string& path) noexcept {
+            const int fileDescriptor = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+            if (fileDescriptor == -1) {
+                return;
+            }
+
+            struct stat fileStatus{};
+            if (fstat(fileDescriptor, &fileStatus) == 0 && fileStatus.st_size > 0) {
+                void* const address = mmap(nullptr, fileStatus.st_size, PROT_READ, MAP_PRIVATE, fileDescriptor, 0);
+                if (address != MAP_FAILED) {
+                    m_bytes = { static_cast<const std::byte*>(address), static_cast<std::size_t>(fileStatus.st_size) };
+                }
+            }
+
+            close(fileDescriptor);
+        }
+
+        ~MappedFile() {
+            if (is_mapped()) {
+                munmap(const_cast<std::byte*>(m_bytes.data()), m_bytes.size());
+            }
+        }
+
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+
+        bool is_mapped() const noexcept {
+            return m_bytes.data() != nullptr;
+        }
+
+        std::span<const std::byte> bytes() const noexcept {
+            return m_bytes;
+        }
+
+    private:
+        std::span<const std::byte> m_bytes;
+    };
+
+    //
+    // Reads little endian values out of bytes, failing (rather than reading past the end) if there aren't enough.
+    // Once it has failed, everything it reads is zero or empty.
+    //
+    class ByteReader final {
+    public:
+        ByteReader() = default;
+
+        explicit ByteReader(std::span<const std::byte> bytes) noexcept
+        : m_bytes(bytes) {
+
+        }
+
+        template <typename T>
+        T read() noexcept {
+            static_assert(std::is_trivially_copyable_v<T>);
+
+            T value{};
+            if (! has(sizeof value)) {
+                return value;
+            }
+
+            memcpy(&value, m_bytes.data() + m_offset, sizeof value);
+            m_offset += sizeof value;
+            return value;
+        }
+
+        std::uint64_t read_uleb128() noexcept {
+            std::uint64_t value = 0;
+
+            for (unsigned shift = 0; has(1); shift += 7) {
+                const auto byte = std::to_integer<std::uint8_t>(m_bytes[m_offset++]);
+                if (shift < 64) {
+                    value |= static_cast<std::uint64_t>(byte & 0x7f) << shift;
+                }
+
+                if ((byte & 0x80) == 0) {
+                    break;
+                }
+            }
+
+            return value;
+        }
+
+        std::int64_t read_sleb128() noexcept {
+            std::uint64_t value = 0;
+            unsigned shift = 0;
+            std::uint8_t byte = 0;
+
+            do {
+                if (! has(1)) {
+                    return 0;
+                }
+
+                byte = std::to_integer<std::uint8_t>(m_bytes[m_offset++]);
+                if (shift < 64) {
+                    value |= static_cast<std::uint64_t>(byte & 0x7f) << shift;
+                }
+
+                shift += 7;
+            } while ((byte & 0x80) != 0);
+
+            // Sign extend from the last byte's sign bit.
+            if (shift < 64 && (byte & 0x40) != 0) {
+                value |= ~std::uint64_t(0) << shift;
+            }
+
+            return static_cast<std::int64_t>(value);
+        }
+
+        std::string_view read_string() noexcept {
+            const auto* const start = reinterpret_cast<const char*>(m_bytes.data() + m_offset);
+            const auto length = strnlen(start, m_bytes.size() - m_offset);
+
+            if (! has(length + 1 /* null terminator */)) {
+                return {};
+            }
+
+            m_offset += length + 1;
+            return { start, length };
+        }
+
+        // DWARF offsets are 8 bytes in the 64-bit format, and 4 in the (far more common) 32-bit one.
+        std::uint64_t read_offset(const bool is64Bit) noexcept {
+            return is64Bit ? read<std::uint64_t>() : read<std::uint32_t>();
+        }
+
+        // Reads an unsigned value of up to 8 bytes, such as an address of a unit's address size.
+        std::uint64_t read_sized(const std::uint8_t size) noexcept {
+            std::uint64_t value = 0;
+            for (std::uint8_t i = 0; i < size && i < sizeof value; ++i) {
+                value |= static_cast<std::uint64_t>(read<std::uint8_t>()) << (i * 8);
+            }
+
+            return value;
+        }
+
+        void skip(const std::uint64_t size) noexcept {
+            if (has(size)) {
+                m_offset += size;
+            }
+        }
+
+        ByteReader read_bytes(const std::uint64_t size) noexcept {
+            if (! has(size)) {
+                return {};
+            }
+
+            ByteReader reader(m_bytes.subspan(m_offset, size));
+            m_offset += size;
+            return reader;
+        }
+
+        std::size_t remaining() const noexcept {
+            return m_bytes.size() - m_offset;
+        }
+
+        std::size_t position() const noexcept {
+            return m_offset;
+        }
+
+        bool failed() const noexcept {
+            return m_failed;
+        }
+
+    private:
+        bool has(const std::uint64_t size) noexcept {
+            if (m_failed || size > remaining()) {
+                m_failed = true;
+                m_offset = m_bytes.size();
+                return false;
+            }
+
+            return true;
+        }
+
+        std::span<const std::byte> m_bytes;
+        std::size_t m_offset = 0;
+        bool m_failed = false;
+    };
+
+    std::string_view get_string(const std::span<const std::byte> strings, const std::uint64_t offset) {
+        if (offset >= strings.size()) {
+            return {};
+        }
+
+        const auto* const start = reinterpret_cast<const char*>(strings.data() + offset);
+        return { start, strnlen(start, strings.size() - offset) };
+    }
+
+    ByteReader read_at(const std::span<const std::byte> bytes, const std::uint64_t offset) {
+        return ByteReader(offset <= bytes.size() ? bytes.subspan(offset) : std::span<const std::byte>());
+    }
+
+    //
+    // An ELF file, read through libelf, with its sections found by name.
+    // Compressed sections (e.g. from --compress-debug-sections) are decompressed the first time they're read.
+    //
+    class ElfFile final {
+    public:
+        //
+        // A section's header, and the name it was given in the section header string table.
+        //
+        struct Section {
+            Elf_Scn* scn = nullptr;
+            GElf_Shdr header{};
+            std::string_view name;
+        };
+
+        static std::optional<ElfFile> open(const std::string& path) {
+            // libelf has to be told which version of ELF its caller expects before anything else.
+            static const bool isLibelfReady = elf_version(EV_CURRENT) != EV_NONE;
+
+            ElfFile elfFile;
+            elfFile.m_path = path;
+            elfFile.m_fileDescriptor = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+            if (elfFile.m_fileDescriptor == -1) {
+                format_and_write_to_log<512>(LogLevel::Debug, "Couldn't open % to read its symbols.", path.c_str());
+                return {};
+            }
+
+            // ELF_C_READ_MMAP has libelf copy anything it changes, such as the headers of sections it decompresses.
+            elfFile.m_elf = isLibelfReady ? elf_begin(elfFile.m_fileDescriptor, ELF_C_READ_MMAP, nullptr) : nullptr;
+
+            GElf_Ehdr header{};
+            std::size_t sectionNamesIndex = 0;
+
+            // The DWARF in the file is read directly, and only little endian DWARF is understood.
+            if (elfFile.m_elf == nullptr
+             || elf_kind(elfFile.m_elf) != ELF_K_ELF
+             || gelf_getehdr(elfFile.m_elf, &header) == nullptr
+             || header.e_ident[EI_DATA] != ELFDATA2LSB
+             || elf_getshdrstrndx(elfFile.m_elf, &sectionNamesIndex) != 0) {
+                format_and_write_to_log<512>(LogLevel::Debug, "% isn't a supported ELF file.", path.c_str());
+                return {};
+            }
+
+            for (Elf_Scn* scn = elf_nextscn(elfFile.m_elf, nullptr); scn != nullptr; scn = elf_nextscn(elfFile.m_elf, scn)) {
+                Section section;
+                section.scn = scn;
+                if (gelf_getshdr(scn, &section.header) == nullptr) {
+                    return {};
+                }
+
+                const char* const name = elf_strptr(elfFile.m_elf, sectionNamesIndex, section.header.sh_name);
+                section.name = name != nullptr ? name : "";
+                elfFile.m_sections.push_back(section);
+            }
+
+            std::size_t programHeaderCount = 0;
+            if (elf_getphdrnum(elfFile.m_elf, &programHeaderCount) != 0) {
+                return {};
+            }
+
+            for (std::size_t i = 0; i < programHeaderCount; ++i) {
+                GElf_Phdr programHeader{};
+                if (gelf_getphdr(elfFile.m_elf, static_cast<int>(i), &programHeader) == nullptr) {
+                    return {};
+                }
+
+                elfFile.m_programHeaders.push_back(programHeader);
+            }
+
+            return elfFile;
+        }
+
+        ElfFile(ElfFile&& other) noexcept
+        : m_path(std::move(other.m_path)),
+          m_fileDescriptor(std::exchange(other.m_fileDescriptor, -1)),
+          m_elf(std::exchange(other.m_elf, nullptr)),
+          m_sections(std::move(other.m_sections)),
+          m_programHeaders(std::move(other.m_programHeaders)) {
+
+        }
+
+        ~ElfFile() {
+            if (m_elf != nullptr) {
+                elf_end(m_elf);
+            }
+
+            if (m_fileDescriptor != -1) {
+                close(m_fileDescriptor);
+            }
+        }
+
+        ElfFile(const ElfFile&) = delete;
+        ElfFile& operator=(const ElfFile&) = delete;
+        ElfFile& operator=(ElfFile&&) = delete;
+
+        const std::vector<Section>& sections() const noexcept {
+            return m_sections;
+        }
+
+        const std::vector<GElf_Phdr>& program_headers() const noexcept {
+            return m_programHeaders;
+        }
+
+        std::string_view get_string(const std::size_t sectionIndex, const std::size_t offset) const noexcept {
+            const char* const string = elf_strptr(m_elf, sectionIndex, offset);
+            return string != nullptr ? string : "";
+        }
+
+        Elf_Data* section_data(const Section& section) const noexcept {
+            if (section.header.sh_type == SHT_NOBITS) {
+                return nullptr;
+            }
+
+            // Either the standard (SHF_COMPRESSED) kind of compressed section, or the older GNU kind, named .zdebug_*.
+            const bool isCompressed = (section.header.sh_flags & SHF_COMPRESSED) != 0;
+            const bool isGnuCompressed = section.name.starts_with(".zdebug");
+
+            if ((isCompressed && elf_compress(section.scn, 0 /* decompress */, 0) < 0)
+             || (isGnuCompressed && elf_compress_gnu(section.scn, 0 /* decompress */, 0) < 0)) {
+                format_and_write_to_log<512>(
+                    LogLevel::Warning,
+                    "Skipped % in %, which couldn't be decompressed (%).",
+                    section.name.data(),
+                    m_path.c_str(),
+                    elf_errmsg(-1)
+                );
+
+                return nullptr;
+            }
+
+            return elf_getdata(section.scn, nullptr);
+        }
+
+        std::span<const std::byte> section_bytes(const std::string_view name) const noexcept {
+            for (const auto& section : m_sections) {
+                // .zdebug_* are the GNU compressed forms of .debug_*.
+                const bool isMatch = section.name == name
+                    || (name.starts_with(".debug") && section.name.starts_with(".z") && section.name.substr(2) == name.substr(1));
+
+                if (! isMatch) {
+                    continue;
+                }
+
+                const auto* const data = section_data(section);
+                if (data == nullptr || data->d_buf == nullptr) {
+                    return {};
+                }
+
+                return { static_cast<const std::byte*>(data->d_buf), data->d_size };
+            }
+
+            return {};
+        }
+
+    private:
+        ElfFile() = default;
+
+        std::string m_path;
+        int m_fileDescriptor = -1;
+        Elf* m_elf = nullptr;
+        std::vector<Section> m_sections;
+        std::vector<GElf_Phdr> m_programHeaders;
+    };
+
+    //
+    // The sections that DWARF 5 line table headers can refer to strings in.
+    //
+    struct StringSections {
+        std::span<const std::byte> lineStrings;
+        std::span<const std::byte> strings;
+    };
+
+    //
+    // A function as it is read, with its name as an index into ModuleIndexes::functionNames.
+    //
+    struct FunctionEntry {
+        address_t start = 0;
+        address_t end = 0;
+        std::uint32_t nameIndex = 0;
+    };
+
+    //
+    // A line as it is read, with its source file as an index into ModuleIndexes::sourceFilePaths.
+    //
+    struct LineEntry {
+        // Marks the end of a sequence, after which addresses have no line until the next one starts.
+        static constexpr std::uint32_t no_source_file = std::numeric_limits<std::uint32_t>::max();
+
+        address_t start = 0;
+        std::uint32_t sourceFileIndex = no_source_file;
+        line_number_t lineNumber = -1;
+    };
+
+    //
+    // A range of addresses where a function was inlined, as it is read; its parent is an index into ModuleIndexes::inlinedCalls.
+    //
+    struct InlinedCallEntry {
+        static constexpr std::size_t no_parent = std::numeric_limits<std::size_t>::max();
+
+        address_t start = 0;
+        address_t end = 0;
+        std::uint32_t nameIndex = 0;
+        std::uint32_t callSourceFileIndex = LineEntry::no_source_file;
+        line_number_t callLineNumber = -1;
+        std::uint32_t depth = 0;
+        std::size_t parent = no_parent;
+    };
+
+    //
+    // What a module is built from, before it is sorted into its final indexes.
+    //
+    struct ModuleIndexes {
+        std::vector<Module::Segment> segments;
+        std::vector<FunctionEntry> functions;
+        std::vector<std::string> functionNames;
+        std::vector<LineEntry> lines;
+        std::vector<InlinedCallEntry> inlinedCalls;
+        std::vector<std::string> sourceFilePaths;
+        std::unordered_map<std::string, std::uint32_t> sourceFileIndexes;
+
+        std::uint32_t add_source_file_path(std::string path) {
+            const auto [iter, inserted] = sourceFileIndexes.try_emplace(path, static_cast<std::uint32_t>(sourceFilePaths.size()));
+            if (inserted) {
+                sourceFilePaths.push_back(std::move(path));
+            }
+
+            return iter->second;
+        }
+    };
+
+    //
+    // The start of a module's index, as it is laid out both in memory and in the symbol cache.
+    // The segments, functions, lines and inlined calls follow it, then the null terminated strings they refer to by offset.
+    //
+    struct IndexHeader {
+        char magic[8];
+        std::uint32_t version;
+        std::uint32_t reserved;
+        std::uint64_t segmentCount;
+        std::uint64_t functionCount;
+        std::uint64_t lineCount;
+        std::uint64_t inlinedCallCount;
+        std::uint64_t stringsSize;
+    };
+
+    constexpr char index_magic[8] = { 's', 'w', 'i', 'm', 'p', 's', 'y', 'm' };
+
+    // Bump this whenever the layout of the index changes; cache files of any other version are rebuilt.
+    constexpr std::uint32_t index_version = 2;
+
+    // Records that are a multiple of 8 bytes keep everything in the index 8 byte aligned.
+    static_assert(sizeof(IndexHeader) == 56);
+    static_assert(sizeof(Module::Segment) == 24 && std::is_trivially_copyable_v<Module::Segment>);
+    static_assert(sizeof(Module::Function) == 24 && std::is_trivially_copyable_v<Module::Function>);
+    static_assert(sizeof(Module::Line) == 24 && std::is_trivially_copyable_v<Module::Line>);
+    static_assert(sizeof(Module::InlinedCall) == 48 && std::is_trivially_copyable_v<Module::InlinedCall>);
+
+    template <typename T>
+    void append_bytes(std::vector<std::byte>& bytes, const T* const data, const std::size_t count) {
+        const auto* const start = reinterpret_cast<const std::byte*>(data);
+        bytes.insert(bytes.end(), start, start + count * sizeof(T));
+    }
+
+    std::string read_build_id(const ElfFile& elfFile) {
+        for (const auto& section : elfFile.sections()) {
+            if (section.header.sh_type != SHT_NOTE) {
+                continue;
+            }
+
+            auto* const data = elfFile.section_data(section);
+            if (data == nullptr) {
+                continue;
+            }
+
+            GElf_Nhdr note{};
+            std::size_t nameOffset = 0;
+            std::size_t descriptionOffset = 0;
+
+            for (std::size_t offset = 0; (offset = gelf_getnote(data, offset, &note, &nameOffset, &descriptionOffset)) > 0;) {
+                const auto* const bytes = static_cast<const char*>(data->d_buf);
+                if (note.n_type != NT_GNU_BUILD_ID || note.n_namesz != 4 || memcmp(bytes + nameOffset, "GNU", 4) != 0) {
+                    continue;
+                }
+
+                std::string buildID;
+                for (std::uint32_t i = 0; i < note.n_descsz; ++i) {
+                    constexpr char hexDigits[] = "0123456789abcdef";
+                    const auto byte = static_cast<std::uint8_t>(bytes[descriptionOffset + i]);
+                    buildID += hexDigits[byte >> 4];
+                    buildID += hexDigits[byte & 0xf];
+                }
+
+                return buildID;
+            }
+        }
+
+        return {};
+    }
+
+    void add_functions(ModuleIndexes& indexes, const ElfFile& elfFile) {
+        for (const auto& section : elfFile.sections()) {
+            if ((section.header.sh_type != SHT_SYMTAB && section.header.sh_type != SHT_DYNSYM) || section.header.sh_entsize == 0) {
+                continue;
+            }
+
+            auto* const data = elfFile.section_data(section);
+            if (data == nullptr) {
+                continue;
+            }
+
+            const auto symbolCount = section.header.sh_size / section.header.sh_entsize;
+            for (std::uint64_t i = 0; i < symbolCount; ++i) {
+                GElf_Sym symbol{};
+                if (gelf_getsym(data, static_cast<int>(i), &symbol) == nullptr) {
+                    break;
+                }
+
+                const auto type = GELF_ST_TYPE(symbol.st_info);
+                if ((type != STT_FUNC && type != STT_GNU_IFUNC) || symbol.st_shndx == SHN_UNDEF || symbol.st_value == 0) {
+                    continue;
+                }
+
+                indexes.functions.push_back({ symbol.st_value, symbol.st_value + symbol.st_size, static_cast<std::uint32_t>(indexes.functionNames.size()) });
+                indexes.functionNames.emplace_back(elfFile.get_string(section.header.sh_link, symbol.st_name));
+            }
+        }
+    }
+
+    //
+    // Reads an attribute of a directory or file name entry in a DWARF 5 line table header,
+    // as either a string or a number (whichever the form holds).
+    //
+    bool read_entry_attribute(
+        ByteReader& reader,
+        const std::uint64_t form,
+        const bool is64Bit,
+        const StringSections& stringSections,
+        std::string_view& string,
+        std::uint64_t& number
+    ) {
+        switch (form) {
+        case dw_form_string:    string = reader.read_string();                                                      break;
+        case dw_form_line_strp: string = get_string(stringSections.lineStrings, reader.read_offset(is64Bit));           break;
+        case dw_form_strp:      string = get_string(stringSections.strings, reader.read_offset(is64Bit));               break;
+        case dw_form_udata:     number = reader.read_uleb128();                                                     break;
+        case dw_form_data1:     number = reader.read<std::uint8_t>();                                               break;
+        case dw_form_data2:     number = reader.read<std::uint16_t>();                                              break;
+        case dw_form_data4:     number = reader.read<std::uint32_t>();                                              break;
+        case dw_form_data8:     number = reader.read<std::uint64_t>();                                              break;
+        case dw_form_data16:    reader.skip(16);                                                                    break;
+        case dw_form_block:     reader.skip(reader.read_uleb128());                                                 break;
+        case dw_form_block1:    reader.skip(reader.read<std::uint8_t>());                                           break;
+        default:
+            return false;
+        }
+
+        return ! reader.failed();
+    }
+
+    //
+    // Reads the directory or file name entries of a DWARF 5 line table header,
+    // each of which is described by a list of (content type, form) pairs that comes first.
+    //
+    bool read_entries(
+        ByteReader& reader,
+        const bool is64Bit,
+        const StringSections& stringSections,
+        std::vector<std::pair<std::string_view, std::uint64_t>>& entries
+    ) {
+        std::vector<std::pair<std::uint64_t, std::uint64_t>> formats(reader.read<std::uint8_t>());
+        for (auto& [contentType, form] : formats) {
+            contentType = reader.read_uleb128();
+            form = reader.read_uleb128();
+        }
+
+        const auto entryCount = reader.read_uleb128();
+        for (std::uint64_t i = 0; i < entryCount && ! reader.failed(); ++i) {
+            auto& [path, directoryIndex] = entries.emplace_back();
+
+            for (const auto& [contentType, form] : formats) {
+                std::string_view string;
+                std::uint64_t number = 0;
+                if (! read_entry_attribute(reader, form, is64Bit, stringSections, string, number)) {
+                    return false;
+                }
+
+                if (contentType == dw_lnct_path) {
+                    path = string;
+                } else if (contentType == dw_lnct_directory_index) {
+                    directoryIndex = number;
+                }
+            }
+        }
+
+        return ! reader.failed();
+    }
+
+    std::string join_path(const std::string_view directory, const std::string_view name) {
+        if (directory.empty() || name.starts_with('/')) {
+            return std::string(name);
+        }
+
+        std::string path(directory);
+        if (! path.ends_with('/')) {
+            path += '/';
+        }
+
+        return path + std::string(name);
+    }
+
+    //
+    // The source files that each unit of .debug_line can refer to (as indexes into the module's source file paths),
+    // by the unit's offset, so that inlined calls can be given the files they were called from.
+    //
+    using LineTableSourceFiles = std::unordered_map<std::uint64_t, std::vector<std::uint32_t>>;
+
+    //
+    // Runs the line number program of one unit of .debug_line, adding the lines of every sequence it describes.
+    // See section 6.2 of the DWARF 5 standard; versions 2 to 4 only differ in their headers.
+    //
+    bool add_line_table(
+        ModuleIndexes& indexes,
+        ByteReader unit,
+        const bool is64Bit,
+        const StringSections& stringSections,
+        std::vector<std::uint32_t>& sourceFileIndexes
+    ) {
+        const auto version = unit.read<std::uint16_t>();
+        if (version < 2 || version > 5) {
+            return false;
+        }
+
+        std::uint8_t addressSize = sizeof(address_t);
+        if (version >= 5) {
+            addressSize = unit.read<std::uint8_t>();
+            unit.read<std::uint8_t>(); // segment selector size
+        }
+
+        auto header = unit.read_bytes(unit.read_offset(is64Bit));
+        auto& program = unit;
+
+        const auto minimumInstructionLength = header.read<std::uint8_t>();
+        if (version >= 4) {
+            header.read<std::uint8_t>(); // maximum operations per instruction, which is only for VLIW
+        }
+
+        header.read<std::uint8_t>(); // default is_stmt
+        const auto lineBase = header.read<std::int8_t>();
+        const auto lineRange = header.read<std::uint8_t>();
+        const auto opcodeBase = header.read<std::uint8_t>();
+
+        if (lineRange == 0 || opcodeBase == 0) {
+            return false;
+        }
+
+        std::vector<std::uint8_t> standardOpcodeLengths(opcodeBase - 1);
+        for (auto& length : standardOpcodeLengths) {
+            length = header.read<std::uint8_t>();
+        }
+
+        // Each file the program can refer to, as an index into the module's source file paths.
+        sourceFileIndexes.clear();
+
+        if (version >= 5) {
+            std::vector<std::pair<std::string_view, std::uint64_t>> directories;
+            std::vector<std::pair<std::string_view, std::uint64_t>> files;
+            if (! read_entries(header, is64Bit, stringSections, directories) || ! read_entries(header, is64Bit, stringSections, files)) {
+                return false;
+            }
+
+            for (const auto& [name, directoryIndex] : files) {
+                const auto directory = directoryIndex < directories.size() ? directories[directoryIndex].first : std::string_view();
+                sourceFileIndexes.push_back(indexes.add_source_file_path(join_path(directory, name)));
+            }
+        } else {
+            // Directory 0 is the compilation directory, which isn't recorded in the line table before DWARF 5.
+            std::vector<std::string_view> directories = { {} };
+            for (auto directory = header.read_string(); ! directory.empty(); directory = header.read_string()) {
+                directories.push_back(directory);
+            }
+
+            // Files are numbered from 1 before DWARF 5.
+            sourceFileIndexes.push_back(LineEntry::no_source_file);
+            for (auto name = header.read_string(); ! name.empty(); name = header.read_string()) {
+                const auto directoryIndex = header.read_uleb128();
+                header.read_uleb128(); // modification time
+                header.read_uleb128(); // file size
+
+                const auto directory = directoryIndex < directories.size() ? directories[directoryIndex] : std::string_view();
+                sourceFileIndexes.push_back(indexes.add_source_file_path(join_path(directory, name)));
+            }
+        }
+
+        if (header.failed()) {
+            return false;
+        }
+
+        std::vector<LineEntry> sequence;
+        address_t address = 0;
+        std::uint64_t file = 1;
+        line_number_t line = 1;
+
+        const auto addLine = [&]() {
+            sequence.push_back({
+                address,
+                file < sourceFileIndexes.size() ? sourceFileIndexes[file] : LineEntry::no_source_file,
+                line
+            });
+        };
+
+        while (program.remaining() > 0 && ! program.failed()) {
+            const auto opcode = program.read<std::uint8_t>();
+
+            if (opcode >= opcodeBase) {
+                // Special opcodes advance the address and line together, then add a line.
+                const auto adjustedOpcode = opcode - opcodeBase;
+                address += (adjustedOpcode / lineRange) * minimumInstructionLength;
+                line += lineBase + (adjustedOpcode % lineRange);
+                addLine();
+                continue;
+            }
+
+            switch (opcode) {
+            case 0: {
+                auto extended = program.read_bytes(program.read_uleb128());
+                const auto extendedOpcode = extended.read<std::uint8_t>();
+
+                if (extendedOpcode == dw_lne_end_sequence) {
+                    // Code that the linker threw away is left at address 0; there's nothing there to look up.
+                    if (! sequence.empty() && sequence.front().start != 0) {
+                        indexes.lines.insert(indexes.lines.end(), sequence.cbegin(), sequence.cend());
+                        indexes.lines.push_back({ address, LineEntry::no_source_file, -1 });
+                    }
+
+                    sequence.clear();
+                    address = 0;
+                    file = 1;
+                    line = 1;
+                } else if (extendedOpcode == dw_lne_set_address) {
+                    address = addressSize == 4 ? extended.read<std::uint32_t>() : extended.read<std::uint64_t>();
+                }
+
+                break;
+            }
+            case dw_lns_copy:
+                addLine();
+                break;
+            case dw_lns_advance_pc:
+                address += program.read_uleb128() * minimumInstructionLength;
+                break;
+            case dw_lns_advance_line:
+                line += program.read_sleb128();
+                break;
+            case dw_lns_set_file:
+                file = program.read_uleb128();
+                break;
+            case dw_lns_const_add_pc:
+                address += ((255 - opcodeBase) / lineRange) * minimumInstructionLength;
+                break;
+            case dw_lns_fixed_advance_pc:
+                address += program.read<std::uint16_t>();
+                break;
+            default:
+                // Everything else (columns, statement flags and so on) doesn't matter here; skip its operands.
+                for (std::uint8_t i = 0; i < standardOpcodeLengths[opcode - 1]; ++i) {
+                    program.read_uleb128();
+                }
+
+                break;
+            }
+        }
+
+        return ! program.failed();
+    }
+
+    LineTableSourceFiles add_lines(ModuleIndexes& indexes, const ElfFile& elfFile, const std::string& path) {
+        ByteReader reader(elfFile.section_bytes(".debug_line"));
+        const StringSections stringSections = { elfFile.section_bytes(".debug_line_str"), elfFile.section_bytes(".debug_str") };
+        LineTableSourceFiles lineTableSourceFiles;
+
+        while (reader.remaining() > 0) {
+            const auto unitOffset = reader.position();
+
+            std::uint64_t unitLength = reader.read<std::uint32_t>();
+            const bool is64Bit = unitLength == 0xffffffff;
+            if (is64Bit) {
+                unitLength = reader.read<std::uint64_t>();
+            }
+
+            auto unit = reader.read_bytes(unitLength);
+            if (reader.failed()) {
+                break;
+            }
+
+            if (! add_line_table(indexes, unit, is64Bit, stringSections, lineTableSourceFiles[unitOffset])) {
+                format_and_write_to_log<512>(LogLevel::Debug, "Skipped a line table in % that couldn't be read.", path.c_str());
+            }
+        }
+
+        return lineTableSourceFiles;
+    }
+
+    //
+    // The sections that .debug_info refers into.
+    //
+    struct DebugSections {
+        std::span<const std::byte> info;
+        std::span<const std::byte> abbreviations;
+        std::span<const std::byte> strings;
+        std::span<const std::byte> lineStrings;
+        std::span<const std::byte> stringOffsets;
+        std::span<const std::byte> addresses;
+        std::span<const std::byte> ranges;
+        std::span<const std::byte> rangeLists;
+    };
+
+    //
+    // The attributes a kind of DIE has, and their forms, as declared in .debug_abbrev.
+    //
+    struct Abbreviation {
+        struct Attribute {
+            std::uint64_t name = 0;
+            std::uint64_t form = 0;
+            std::int64_t implicitConstant = 0;
+        };
+
+        std::uint64_t tag = 0;
+        bool hasChildren = false;
+        std::vector<Attribute> attributes;
+    };
+
+    using Abbreviations = std::unordered_map<std::uint64_t, Abbreviation>;
+
+    std::optional<Abbreviations> read_abbreviations(const std::span<const std::byte> abbreviationBytes, const std::uint64_t offset) {
+        auto reader = read_at(abbreviationBytes, offset);
+        Abbreviations abbreviations;
+
+        for (auto code = reader.read_uleb128(); code != 0 && ! reader.failed(); code = reader.read_uleb128()) {
+            auto& abbreviation = abbreviations[code];
+            abbreviation.tag = reader.read_uleb128();
+            abbreviation.hasChildren = reader.read<std::uint8_t>() != 0;
+
+            while (! reader.failed()) {
+                Abbreviation::Attribute attribute;
+                attribute.name = reader.read_uleb128();
+                attribute.form = reader.read_uleb128();
+
+                if (attribute.name == 0 && attribute.form == 0) {
+                    break;
+                }
+
+                if (attribute.form == dw_form_implicit_const) {
+                    attribute.implicitConstant = reader.read_sleb128();
+                }
+
+                abbreviation.attributes.push_back(attribute);
+            }
+        }
+
+        if (reader.failed()) {
+            return {};
+        }
+
+        return abbreviations;
+    }
+
+    //
+    // What's needed to make sense of the attributes of a unit's DIEs, most of which comes from the unit's own DIE.
+    //
+    struct Unit {
+        std::uint64_t offset = 0;
+        std::uint16_t version = 0;
+        bool is64Bit = false;
+        std::uint8_t addressSize = sizeof(address_t);
+        address_t baseAddress = 0;
+        std::uint64_t addressesBase = 0;
+        std::uint64_t stringOffsetsBase = 0;
+        std::uint64_t rangeListsBase = 0;
+        const std::vector<std::uint32_t>* sourceFileIndexes = nullptr;
+    };
+
+    //
+    // An attribute's value as it was read, before whatever it refers to (a string, an address, ...) is looked up.
+    // A form of 0 means the DIE doesn't have the attribute.
+    //
+    struct AttributeValue {
+        std::uint64_t form = 0;
+        std::uint64_t number = 0;
+        std::string_view string;
+    };
+
+    bool read_attribute_value(ByteReader& reader, std::uint64_t form, const std::int64_t implicitConstant, const Unit& unit, AttributeValue& value) {
+        // The form can be given in the DIE itself, rather than in its abbreviation.
+        while (form == dw_form_indirect && ! reader.failed()) {
+            form = reader.read_uleb128();
+        }
+
+        value = { form, 0, {} };
+
+        switch (form) {
+        case dw_form_addr:
+            value.number = reader.read_sized(unit.addressSize);
+            break;
+        case dw_form_data1:
+        case dw_form_flag:
+        case dw_form_ref1:
+        case dw_form_strx1:
+        case dw_form_addrx1:
+            value.number = reader.read<std::uint8_t>();
+            break;
+        case dw_form_data2:
+        case dw_form_ref2:
+        case dw_form_strx2:
+        case dw_form_addrx2:
+            value.number = reader.read<std::uint16_t>();
+            break;
+        case dw_form_strx3:
+        case dw_form_addrx3:
+            value.number = reader.read_sized(3);
+            break;
+        case dw_form_data4:
+        case dw_form_ref4:
+        case dw_form_ref_sup4:
+        case dw_form_strx4:
+        case dw_form_addrx4:
+            value.number = reader.read<std::uint32_t>();
+            break;
+        case dw_form_data8:
+        case dw_form_ref8:
+        case dw_form_ref_sig8:
+        case dw_form_ref_sup8:
+            value.number = reader.read<std::uint64_t>();
+            break;
+        case dw_form_sdata:
+            value.number = static_cast<std::uint64_t>(reader.read_sleb128());
+            break;
+        case dw_form_udata:
+        case dw_form_ref_udata:
+        case dw_form_strx:
+        case dw_form_addrx:
+        case dw_form_loclistx:
+        case dw_form_rnglistx:
+        case dw_form_gnu_addr_index:
+        case dw_form_gnu_str_index:
+            value.number = reader.read_uleb128();
+            break;
+        case dw_form_strp:
+        case dw_form_line_strp:
+        case dw_form_sec_offset:
+        case dw_form_strp_sup:
+        case dw_form_gnu_ref_alt:
+        case dw_form_gnu_strp_alt:
+            value.number = reader.read_offset(unit.is64Bit);
+            break;
+        case dw_form_ref_addr:
+            // DWARF 2 made these address sized, which was changed to offset sized in DWARF 3.
+            value.number = unit.version <= 2 ? reader.read_sized(unit.addressSize) : reader.read_offset(unit.is64Bit);
+            break;
+        case dw_form_string:
+            value.string = reader.read_string();
+            break;
+        case dw_form_flag_present:
+            value.number = 1;
+            break;
+        case dw_form_implicit_const:
+            value.number = static_cast<std::uint64_t>(implicitConstant);
+            break;
+        case dw_form_block1:    reader.skip(reader.read<std::uint8_t>());       break;
+        case dw_form_block2:    reader.skip(reader.read<std::uint16_t>());      break;
+        case dw_form_block4:    reader.skip(reader.read<std::uint32_t>());      break;
+        case dw_form_block:
+        case dw_form_exprloc:   reader.skip(reader.read_uleb128());             break;
+        case dw_form_data16:    reader.skip(16);                                break;
+        default:
+            return false;
+        }
+
+        return ! reader.failed();
+    }
+
+    std::string_view resolve_string(const AttributeValue& value, const DebugSections& sections, const Unit& unit) {
+        switch (value.form) {
+        case dw_form_string:
+            return value.string;
+        case dw_form_strp:
+            return get_string(sections.strings, value.number);
+        case dw_form_line_strp:
+            return get_string(sections.lineStrings, value.number);
+        case dw_form_strx:
+        case dw_form_strx1:
+        case dw_form_strx2:
+        case dw_form_strx3:
+        case dw_form_strx4:
+        case dw_form_gnu_str_index: {
+            const std::uint64_t offsetSize = unit.is64Bit ? 8 : 4;
+            if (value.number > sections.stringOffsets.size() / offsetSize) {
+                return {};
+            }
+
+            auto reader = read_at(sections.stringOffsets, unit.stringOffsetsBase + value.number * offsetSize);
+            const auto offset = reader.read_offset(unit.is64Bit);
+            return reader.failed() ? std::string_view() : get_string(sections.strings, offset);
+        }
+        default:
+            // Strings in a supplementary object file (as made by dwz) aren't read.
+            return {};
+        }
+    }
+
+    std::optional<address_t> read_indexed_address(const std::uint64_t index, const DebugSections& sections, const Unit& unit) {
+        if (index > sections.addresses.size() / unit.addressSize) {
+            return {};
+        }
+
+        auto reader = read_at(sections.addresses, unit.addressesBase + index * unit.addressSize);
+        const auto address = reader.read_sized(unit.addressSize);
+        return reader.failed() ? std::optional<address_t>() : address;
+    }
+
+    bool is_indexed_address(const std::uint64_t form) {
+        switch (form) {
+        case dw_form_addrx:
+        case dw_form_addrx1:
+        case dw_form_addrx2:
+        case dw_form_addrx3:
+        case dw_form_addrx4:
+        case dw_form_gnu_addr_index:
+            return true;
+        default:
+            return false;
+        }
+    }
+
+    std::optional<address_t> resolve_address(const AttributeValue& value, const DebugSections& sections, const Unit& unit) {
+        if (value.form == dw_form_addr) {
+            return value.number;
+        }
+
+        if (is_indexed_address(value.form)) {
+            return read_indexed_address(value.number, sections, unit);
+        }
+
+        return {};
+    }
+
+    // Gets the offset into .debug_info of the DIE an attribute refers to.
+    std::optional<std::uint64_t> resolve_reference(const AttributeValue& value, const Unit& unit) {
+        switch (value.form) {
+        case dw_form_ref1:
+        case dw_form_ref2:
+        case dw_form_ref4:
+        case dw_form_ref8:
+        case dw_form_ref_udata:
+            return unit.offset + value.number;
+        case dw_form_ref_addr:
+            return value.number;
+        default:
+            return {};
+        }
+    }
+
+    //
+    // Reads a range list from .debug_ranges (before DWARF 5) or .debug_rnglists, skipping any empty ranges.
+    //
+    void read_ranges(
+        const AttributeValue& value,
+        const DebugSections& sections,
+        const Unit& unit,
+        std::vector<std::pair<address_t, address_t>>& ranges
+    ) {
+        address_t baseAddress = unit.baseAddress;
+
+        const auto addRange = [&ranges](const address_t start, const address_t end) {
+            if (start < end) {
+                ranges.emplace_back(start, end);
+            }
+        };
+
+        if (unit.version < 5) {
+            const address_t baseAddressSelection = unit.addressSize == 4 ? 0xffffffff : std::numeric_limits<address_t>::max();
+
+            auto reader = read_at(sections.ranges, value.number);
+            while (true) {
+                const auto start = reader.read_sized(unit.addressSize);
+                const auto end = reader.read_sized(unit.addressSize);
+
+                if (reader.failed() || (start == 0 && end == 0)) {
+                    return;
+                }
+
+                if (start == baseAddressSelection) {
+                    baseAddress = end;
+                } else {
+                    addRange(baseAddress + start, baseAddress + end);
+                }
+            }
+        }
+
+        std::uint64_t offset = value.number;
+        if (value.form == dw_form_rnglistx) {
+            // The index is into a table of offsets, which are relative to the table.
+            const std::uint64_t offsetSize = unit.is64Bit ? 8 : 4;
+            if (value.number > sections.rangeLists.size() / offsetSize) {
+                return;
+            }
+
+            auto offsetReader = read_at(sections.rangeLists, unit.rangeListsBase + value.number * offsetSize);
+            offset = unit.rangeListsBase + offsetReader.read_offset(unit.is64Bit);
+        }
+
+        auto reader = read_at(sections.rangeLists, offset);
+        while (! reader.failed()) {
+            switch (reader.read<std::uint8_t>()) {
+            case dw_rle_base_addressx:
+                baseAddress = read_indexed_address(reader.read_uleb128(), sections, unit).value_or(0);
+                break;
+            case dw_rle_startx_endx: {
+                const auto start = read_indexed_address(reader.read_uleb128(), sections, unit);
+                const auto end = read_indexed_address(reader.read_uleb128(), sections, unit);
+                if (start.has_value() && end.has_value()) {
+                    addRange(*start, *end);
+                }
+
+                break;
+            }
+            case dw_rle_startx_length: {
+                const auto start = read_indexed_address(reader.read_uleb128(), sections, unit);
+                const auto length = reader.read_uleb128();
+                if (start.has_value()) {
+                    addRange(*start, *start + length);
+                }
+
+                break;
+            }
+            case dw_rle_offset_pair: {
+                const auto start = reader.read_uleb128();
+                const auto end = reader.read_uleb128();
+                addRange(baseAddress + start, baseAddress + end);
+                break;
+            }
+            case dw_rle_base_address:
+                baseAddress = reader.read_sized(unit.addressSize);
+                break;
+            case dw_rle_start_end: {
+                const auto start = reader.read_sized(unit.addressSize);
+                const auto end = reader.read_sized(unit.addressSize);
+                addRange(start, end);
+                break;
+            }
+            case dw_rle_start_length: {
+                const auto start = reader.read_sized(unit.addressSize);
+                const auto length = reader.read_uleb128();
+                addRange(start, start + length);
+                break;
+            }
+            case dw_rle_end_of_list:
+            default:
+                return;
+            }
+        }
+    }
+
+    //
+    // The attributes of a DIE that finding inlined calls needs; any others are read past.
+    //
+    struct DieAttributes {
+        AttributeValue name;
+        AttributeValue linkageName;
+        AttributeValue lowPC;
+        AttributeValue highPC;
+        AttributeValue ranges;
+        AttributeValue origin;
+        AttributeValue callFile;
+        AttributeValue callLine;
+        AttributeValue statementList;
+        AttributeValue addressesBase;
+        AttributeValue stringOffsetsBase;
+        AttributeValue rangeListsBase;
+
+        AttributeValue* find(const std::uint64_t attribute) noexcept {
+            switch (attribute) {
+            case dw_at_name:                return &name;
+            case dw_at_linkage_name:
+            case dw_at_mips_linkage_name:   return &linkageName;
+            case dw_at_low_pc:              return &lowPC;
+            case dw_at_high_pc:             return &highPC;
+            case dw_at_ranges:              return &ranges;
+            case dw_at_abstract_origin:
+            case dw_at_specification:       return &origin;
+            case dw_at_call_file:           return &callFile;
+            case dw_at_call_line:           return &callLine;
+            case dw_at_stmt_list:           return &statementList;
+            case dw_at_addr_base:           return &addressesBase;
+            case dw_at_str_offsets_base:    return &stringOffsetsBase;
+            case dw_at_rnglists_base:       return &rangeListsBase;
+            default:                        return nullptr;
+            }
+        }
+    };
+
+    //
+    // A function's DIE: its names, and the DIE it takes the rest of its description from, if any.
+    // Inlined calls refer to the (abstract) DIE of the function that was inlined, which might only have a name
+    // through another DIE, e.g. the declaration of a member function in its class.
+    //
+    struct FunctionDie {
+        static constexpr std::uint64_t no_origin = std::numeric_limits<std::uint64_t>::max();
+
+        std::string_view name;
+        std::string_view linkageName;
+        std::uint64_t origin = no_origin;
+    };
+
+    //
+    // What's been read of .debug_info so far: inlined calls can refer to functions in other units,
+    // so their names can only be found once every unit has been read.
+    //
+    struct InlinedCallReader {
+        DebugSections sections;
+        const LineTableSourceFiles& lineTableSourceFiles;
+        std::unordered_map<std::uint64_t, Abbreviations> abbreviationTables;
+        std::unordered_map<std::uint64_t, FunctionDie> functionDies;
+
+        // The DIE of the function each inlined call (in ModuleIndexes::inlinedCalls, from firstInlinedCall on) was of.
+        std::size_t firstInlinedCall = 0;
+        std::vector<std::uint64_t> inlinedCallOrigins;
+    };
+
+    //
+    // An inlined call that DIEs are nested within, and so any inlined calls among them are inlined into.
+    //
+    struct InlinedScope {
+        std::size_t firstInlinedCall = 0;
+        std::size_t inlinedCallCount = 0;
+        std::uint32_t depth = 0;
+    };
+
+    //
+    // Reads the DIEs of one unit of .debug_info, adding every inlined call in it.
+    // See sections 3.3.8 (inlined subroutines) and 7.5 (the format of DIEs) of the DWARF 5 standard.
+    //
+    bool add_unit_inlined_calls(ModuleIndexes& indexes, InlinedCallReader& inlinedCallReader, Unit unit, ByteReader dies, const std::uint64_t diesOffset) {
+        const auto& sections = inlinedCallReader.sections;
+
+        unit.version = dies.read<std::uint16_t>();
+        if (unit.version < 2 || unit.version > 5) {
+            return false;
+        }
+
+        std::uint64_t abbreviationsOffset = 0;
+        if (unit.version >= 5) {
+            const auto unitType = dies.read<std::uint8_t>();
+            unit.addressSize = dies.read<std::uint8_t>();
+            abbreviationsOffset = dies.read_offset(unit.is64Bit);
+
+            // Type units and split units have no code of their own.
+            if (unitType != dw_ut_compile && unitType != dw_ut_partial) {
+                return ! dies.failed();
+            }
+        } else {
+            abbreviationsOffset = dies.read_offset(unit.is64Bit);
+            unit.addressSize = dies.read<std::uint8_t>();
+        }
+
+        if (dies.failed() || (unit.addressSize != 4 && unit.addressSize != 8)) {
+            return false;
+        }
+
+        auto abbreviationsIter = inlinedCallReader.abbreviationTables.find(abbreviationsOffset);
+        if (abbreviationsIter == inlinedCallReader.abbreviationTables.end()) {
+            auto abbreviations = read_abbreviations(sections.abbreviations, abbreviationsOffset);
+            if (! abbreviations.has_value()) {
+                return false;
+            }
+
+            abbreviationsIter = inlinedCallReader.abbreviationTables.emplace(abbreviationsOffset, std::move(*abbreviations)).first;
+        }
+
+        const auto& abbreviations = abbreviationsIter->second;
+
+        // The innermost inlined call that each DIE with children (that is still being read) is within, if any.
+        std::vector<std::optional<InlinedScope>> scopes;
+        std::vector<std::pair<address_t, address_t>> ranges;
+        bool isUnitDie = true;
+
+        while (dies.remaining() > 0) {
+            const auto dieOffset = diesOffset + dies.position();
+            const auto code = dies.read_uleb128();
+
+            // A null entry ends the children of the DIE before.
+            if (code == 0) {
+                if (! scopes.empty()) {
+                    scopes.pop_back();
+                }
+
+                continue;
+            }
+
+            const auto abbreviation = abbreviations.find(code);
+            if (abbreviation == abbreviations.cend()) {
+                return false;
+            }
+
+            DieAttributes attributes;
+            for (const auto& attribute : abbreviation->second.attributes) {
+                AttributeValue value;
+                if (! read_attribute_value(dies, attribute.form, attribute.implicitConstant, unit, value)) {
+                    return false;
+                }
+
+                if (auto* const attributeValue = attributes.find(attribute.name)) {
+                    *attributeValue = value;
+                }
+            }
+
+            // The unit's DIE has what's needed to read the attributes of all the others.
+            if (isUnitDie) {
+                isUnitDie = false;
+
+                unit.addressesBase = attributes.addressesBase.number;
+                unit.stringOffsetsBase = attributes.stringOffsetsBase.number;
+                unit.rangeListsBase = attributes.rangeListsBase.number;
+                unit.baseAddress = resolve_address(attributes.lowPC, sections, unit).value_or(0);
+
+                const auto lineTableSourceFiles = inlinedCallReader.lineTableSourceFiles.find(attributes.statementList.number);
+                if (attributes.statementList.form != 0 && lineTableSourceFiles != inlinedCallReader.lineTableSourceFiles.cend()) {
+                    unit.sourceFileIndexes = &lineTableSourceFiles->second;
+                }
+            }
+
+            auto scope = scopes.empty() ? std::optional<InlinedScope>() : scopes.back();
+
+            if (abbreviation->second.tag == dw_tag_subprogram) {
+                inlinedCallReader.functionDies[dieOffset] = {
+                    resolve_string(attributes.name, sections, unit),
+                    resolve_string(attributes.linkageName, sections, unit),
+                    resolve_reference(attributes.origin, unit).value_or(FunctionDie::no_origin)
+                };
+
+                // Whatever is inside a function isn't part of any call it was inlined into.
+                scope.reset();
+            } else if (abbreviation->second.tag == dw_tag_inlined_subroutine) {
+                ranges.clear();
+
+                if (attributes.ranges.form != 0) {
+                    read_ranges(attributes.ranges, sections, unit, ranges);
+                } else if (const auto lowPC = resolve_address(attributes.lowPC, sections, unit)) {
+                    // A high PC that is a constant, rather than an address, is the size of the range.
+                    const auto highPC = attributes.highPC.form == dw_form_addr || is_indexed_address(attributes.highPC.form)
+                        ? resolve_address(attributes.highPC, sections, unit)
+                        : *lowPC + attributes.highPC.number;
+
+                    if (highPC.has_value() && *lowPC < *highPC) {
+                        ranges.emplace_back(*lowPC, *highPC);
+                    }
+                }
+
+                // Code that the linker threw away is left at address 0; there's nothing there to look up.
+                std::erase_if(ranges, [](const auto& range) { return range.first == 0; });
+
+                const auto origin = resolve_reference(attributes.origin, unit);
+
+                if (origin.has_value() && ! ranges.empty()) {
+                    const auto callFile = attributes.callFile.number;
+                    const auto callSourceFileIndex = unit.sourceFileIndexes != nullptr && callFile < unit.sourceFileIndexes->size()
+                        ? (*unit.sourceFileIndexes)[callFile]
+                        : LineEntry::no_source_file;
+
+                    const InlinedScope inlinedScope = { indexes.inlinedCalls.size(), ranges.size(), scope.has_value() ? scope->depth + 1 : 0 };
+
+                    for (const auto& [start, end] : ranges) {
+                        InlinedCallEntry inlinedCall;
+                        inlinedCall.start = start;
+                        inlinedCall.end = end;
+                        inlinedCall.callSourceFileIndex = callSourceFileIndex;
+                        inlinedCall.callLineNumber = attributes.callLine.form != 0 ? static_cast<line_number_t>(attributes.callLine.number) : -1;
+                        inlinedCall.depth = inlinedScope.depth;
+
+                        // Where the call it's inlined into is split across several ranges, its parent is the one it's within.
+                        if (scope.has_value()) {
+                            inlinedCall.parent = scope->firstInlinedCall;
+                            for (std::size_t i = scope->firstInlinedCall; i < scope->firstInlinedCall + scope->inlinedCallCount; ++i) {
+                                if (start >= indexes.inlinedCalls[i].start && start < indexes.inlinedCalls[i].end) {
+                                    inlinedCall.parent = i;
+                                    break;
+                                }
+                            }
+                        }
+
+                        indexes.inlinedCalls.push_back(inlinedCall);
+                        inlinedCallReader.inlinedCallOrigins.push_back(*origin);
+                    }
+
+                    scope = inlinedScope;
+                }
+            }
+
+            if (abbreviation->second.hasChildren) {
+                scopes.push_back(scope);
+            }
+        }
+
+        return ! dies.failed();
+    }
+
+    //
+    // Gets the name of a function from its DIE, following its origins until one has a name.
+    // Linkage (i.e. mangled) names are preferred, to match the names in the symbol table.
+    //
+    std::string_view get_function_name(const InlinedCallReader& inlinedCallReader, std::uint64_t dieOffset) {
+        std::string_view name;
+
+        // Origins shouldn't go round in circles, but there's no telling what a broken file might hold.
+        for (int hops = 0; hops < 8; ++hops) {
+            const auto functionDie = inlinedCallReader.functionDies.find(dieOffset);
+            if (functionDie == inlinedCallReader.functionDies.cend()) {
+                break;
+            }
+
+            if (! functionDie->second.linkageName.empty()) {
+                return functionDie->second.linkageName;
+            }
+
+            if (name.empty()) {
+                name = functionDie->second.name;
+            }
+
+            dieOffset = functionDie->second.origin;
+        }
+
+        return name;
+    }
+
+    void add_inlined_calls(ModuleIndexes& indexes, const ElfFile& elfFile, const LineTableSourceFiles& lineTableSourceFiles, const std::string& path) {
+        InlinedCallReader inlinedCallReader = {
+            {
+                elfFile.section_bytes(".debug_info"),
+                elfFile.section_bytes(".debug_abbrev"),
+                elfFile.section_bytes(".debug_str"),
+                elfFile.section_bytes(".debug_line_str"),
+                elfFile.section_bytes(".debug_str_offsets"),
+                elfFile.section_bytes(".debug_addr"),
+                elfFile.section_bytes(".debug_ranges"),
+                elfFile.section_bytes(".debug_rnglists")
+            },
+            lineTableSourceFiles,
+            {},
+            {},
+            indexes.inlinedCalls.size(),
+            {}
+        };
+
+        ByteReader reader(inlinedCallReader.sections.info);
+
+        while (reader.remaining() > 0) {
+            Unit unit;
+            unit.offset = reader.position();
+
+            std::uint64_t unitLength = reader.read<std::uint32_t>();
+            unit.is64Bit = unitLength == 0xffffffff;
+            if (unit.is64Bit) {
+                unitLength = reader.read<std::uint64_t>();
+            }
+
+            const auto diesOffset = reader.position();
+            auto dies = reader.read_bytes(unitLength);
+            if (reader.failed()) {
+                break;
+            }
+
+            if (! add_unit_inlined_calls(indexes, inlinedCallReader, unit, dies, diesOffset)) {
+                format_and_write_to_log<512>(LogLevel::Debug, "Skipped a unit of debug info in % that couldn't be read.", path.c_str());
+            }
+        }
+
+        // Many calls are to the same few functions, so each function's name is only added once.
+        std::unordered_map<std::uint64_t, std::uint32_t> nameIndexes;
+
+        for (std::size_t i = 0; i < inlinedCallReader.inlinedCallOrigins.size(); ++i) {
+            const auto origin = inlinedCallReader.inlinedCallOrigins[i];
+
+            const auto [nameIndex, inserted] = nameIndexes.try_emplace(origin, static_cast<std::uint32_t>(indexes.functionNames.size()));
+            if (inserted) {
+                indexes.functionNames.emplace_back(get_function_name(inlinedCallReader, origin));
+            }
+
+            indexes.inlinedCalls[inlinedCallReader.firstInlinedCall + i].nameIndex = nameIndex->second;
+        }
+    }
+
+    void add_symbols(ModuleIndexes& indexes, const ElfFile& elfFile, const std::string& path) {
+        add_functions(indexes, elfFile);
+        const auto lineTableSourceFiles = add_lines(indexes, elfFile, path);
+        add_inlined_calls(indexes, elfFile, lineTableSourceFiles, path);
+    }
+
+    //
+    // Sorts what was read from a module into its final indexes, laid out as they are in the symbol cache.
+    //
+    std::vector<std::byte> build_index(ModuleIndexes& indexes) {
+        // Where several functions start at the same address (aliases, or the same symbol in .symtab and .dynsym),
+        // keep the first that has a size.
+        std::stable_sort(indexes.functions.begin(), indexes.functions.end(), [](const FunctionEntry& lhs, const FunctionEntry& rhs) {
+            return lhs.start != rhs.start ? lhs.start < rhs.start : (lhs.end > lhs.start) > (rhs.end > rhs.start);
+        });
+
+        std::vector<FunctionEntry> functions;
+        for (const auto& function : indexes.functions) {
+            if (! functions.empty() && functions.back().start == function.start) {
+                continue;
+            }
+
+            functions.push_back(function);
+        }
+
+        // Functions without a size are assumed to run up to the next one.
+        for (std::size_t i = 0; i < functions.size(); ++i) {
+            auto& function = functions[i];
+            if (function.end == function.start && i + 1 < functions.size()) {
+                function.end = functions[i + 1].start;
+            }
+        }
+
+        // Where a sequence ends at the same address another starts, the end has to come first so the start wins.
+        // Within a sequence, the last line at an address is the one that applies to it.
+        std::stable_sort(indexes.lines.begin(), indexes.lines.end(), [](const LineEntry& lhs, const LineEntry& rhs) {
+            const bool lhsIsEnd = lhs.sourceFileIndex == LineEntry::no_source_file;
+            const bool rhsIsEnd = rhs.sourceFileIndex == LineEntry::no_source_file;
+            return lhs.start != rhs.start ? lhs.start < rhs.start : lhsIsEnd > rhsIsEnd;
+        });
+
+        // Calls are sorted by where they start, with calls that start together sorted outermost first,
+        // so that a parent always comes before its children. Their parents then have to be found again.
+        std::vector<std::size_t> inlinedCallOrder(indexes.inlinedCalls.size());
+        std::iota(inlinedCallOrder.begin(), inlinedCallOrder.end(), 0);
+        std::sort(inlinedCallOrder.begin(), inlinedCallOrder.end(), [&indexes](const std::size_t lhs, const std::size_t rhs) {
+            const auto& lhsCall = indexes.inlinedCalls[lhs];
+            const auto& rhsCall = indexes.inlinedCalls[rhs];
+            return std::tie(lhsCall.start, lhsCall.depth, lhs) < std::tie(rhsCall.start, rhsCall.depth, rhs);
+        });
+
+        std::vector<std::uint64_t> sortedInlinedCallIndexes(inlinedCallOrder.size());
+        for (std::size_t i = 0; i < inlinedCallOrder.size(); ++i) {
+            sortedInlinedCallIndexes[inlinedCallOrder[i]] = i;
+        }
+
+        // Function names and source file paths share one block of strings, each stored once.
+        std::string strings;
+        std::unordered_map<std::string_view, std::uint64_t> stringOffsets;
+        const auto addString = [&](const std::string_view string) {
+            const auto [iter, inserted] = stringOffsets.try_emplace(string, strings.size());
+            if (inserted) {
+                strings += string;
+                strings += '\0';
+            }
+
+            return iter->second;
+        };
+
+        std::vector<Module::Function> indexFunctions;
+        indexFunctions.reserve(functions.size());
+        for (const auto& function : functions) {
+            indexFunctions.push_back({ function.start, function.end, addString(indexes.functionNames[function.nameIndex]) });
+        }
+
+        std::vector<Module::Line> indexLines;
+        indexLines.reserve(indexes.lines.size());
+        for (const auto& line : indexes.lines) {
+            indexLines.push_back({
+                line.start,
+                line.lineNumber,
+                line.sourceFileIndex == LineEntry::no_source_file
+                    ? Module::Line::no_source_file
+                    : addString(indexes.sourceFilePaths[line.sourceFileIndex])
+            });
+        }
+
+        std::vector<Module::InlinedCall> indexInlinedCalls;
+        indexInlinedCalls.reserve(inlinedCallOrder.size());
+        for (const auto i : inlinedCallOrder) {
+            const auto& inlinedCall = indexes.inlinedCalls[i];
+            indexInlinedCalls.push_back({
+                inlinedCall.start,
+                inlinedCall.end,
+                addString(indexes.functionNames[inlinedCall.nameIndex]),
+                inlinedCall.callSourceFileIndex == LineEntry::no_source_file
+                    ? Module::Line::no_source_file
+                    : addString(indexes.sourceFilePaths[inlinedCall.callSourceFileIndex]),
+                inlinedCall.callLineNumber,
+                inlinedCall.parent == InlinedCallEntry::no_parent
+                    ? Module::InlinedCall::no_parent
+                    : sortedInlinedCallIndexes[inlinedCall.parent]
+            });
+        }
+
+        IndexHeader header{};
+        memcpy(header.magic, index_magic, sizeof header.magic);
+        header.version = index_version;
+        header.segmentCount = indexes.segments.size();
+        header.functionCount = indexFunctions.size();
+        header.lineCount = indexLines.size();
+        header.inlinedCallCount = indexInlinedCalls.size();
+        header.stringsSize = strings.size();
+
+        std::vector<std::byte> index;
+        index.reserve(
+            sizeof header
+            + indexes.segments.size() * sizeof(Module::Segment)
+            + indexFunctions.size() * sizeof(Module::Function)
+            + indexLines.size() * sizeof(Module::Line)
+            + indexInlinedCalls.size() * sizeof(Module::InlinedCall)
+            + strings.size()
+        );
+
+        append_bytes(index, &header, 1);
+        append_bytes(index, indexes.segments.data(), indexes.segments.size());
+        append_bytes(index, indexFunctions.data(), indexFunctions.size());
+        append_bytes(index, indexLines.data(), indexLines.size());
+        append_bytes(index, indexInlinedCalls.data(), indexInlinedCalls.size());
+        append_bytes(index, strings.data(), strings.size());
+
+        return index;
+    }
+
+    //
+    // Takes the next count records off the front of an index, if they're all there.
+    //
+    template <typename T>
+    bool take_records(std::span<const std::byte>& index, const std::uint64_t count, std::span<const T>& records) {
+        // The count is checked against what's left before it's multiplied, so a corrupt one can't overflow.
+        if (count > index.size() / sizeof(T) || reinterpret_cast<std::uintptr_t>(index.data()) % alignof(T) != 0) {
+            return false;
+        }
+
+        records = { reinterpret_cast<const T*>(index.data()), static_cast<std::size_t>(count) };
+        index = index.subspan(count * sizeof(T));
+        return true;
+    }
+
+    //
+    // Writes an index to the symbol cache. It's written to a temporary file in the cache directory, then renamed
+    // into place, so that another process reading the cache only ever sees a whole index.
+    //
+    bool save_index(const std::span<const std::byte> index, const std::string& cacheFilePath) {
+        std::error_code error;
+        std::filesystem::create_directories(std::filesystem::path(cacheFilePath).parent_path(), error);
+        if (error) {
+            return false;
+        }
+
+        std::string temporaryFilePath = cacheFilePath + ".XXXXXX";
+        const int fileDescriptor = mkstemp(temporaryFilePath.data());
+        if (fileDescriptor == -1) {
+            return false;
+        }
+
+        std::size_t bytesWritten = 0;
+        while (bytesWritten < index.size()) {
+            const auto result = write(fileDescriptor, index.data() + bytesWritten, index.size() - bytesWritten);
+            if (result == -1 && errno == EINTR) {
+                continue;
+            }
+
+            if (result <= 0) {
+                break;
+            }
+
+            bytesWritten += static_cast<std::size_t>(result);
+        }
+
+        const bool closed = close(fileDescriptor) == 0;
+        if (bytesWritten != index.size() || ! closed || rename(temporaryFilePath.c_str(), cacheFilePath.c_str()) != 0) {
+            unlink(temporaryFilePath.c_str());
+            return false;
+        }
+
+        return true;
+    }
+}
+
+std::string swimps::symbol::get_symbol_cache_directory() {
+    // See the XDG Base Directory Specification, which says relative paths are to be ignored.
+    const char* const cacheHome = getenv("XDG_CACHE_HOME");
+    if (cacheHome != nullptr && cacheHome[0] == '/') {
+        return join_path(cacheHome, "swimps");
+    }
+
+    const char* const home = getenv("HOME");
+    if (home != nullptr && home[0] == '/') {
+        return join_path(home, ".cache/swimps");
+    }
+
+    return {};
+}
+
+std::optional<Module> Module::load(const std::string& path, const std::string& cacheDirectory) {
+    const auto elfFile = ElfFile::open(path);
+    if (! elfFile.has_value()) {
+        return {};
+    }
+
+    auto buildID = read_build_id(*elfFile);
+
+    // The build ID is all that's needed to find the module in the cache; the rest of the file is left unread.
+    const bool useCache = ! cacheDirectory.empty() && ! buildID.empty();
+    const auto cacheFilePath = useCache ? join_path(cacheDirectory, buildID + ".symbols") : std::string();
+
+    if (useCache) {
+        auto cacheFile = std::make_shared<const MappedFile>(cacheFilePath);
+        if (cacheFile->is_mapped()) {
+            const auto index = cacheFile->bytes();
+            if (auto module = from_index(std::move(cacheFile), index, buildID, true)) {
+                return module;
+            }
+
+            format_and_write_to_log<512>(LogLevel::Debug, "Ignoring the unreadable symbol cache file %.", cacheFilePath.c_str());
+        }
+    }
+
+    ModuleIndexes indexes;
+    for (const auto& programHeader : elfFile->program_headers()) {
+        if (programHeader.p_type == PT_LOAD) {
+            indexes.segments.push_back({ programHeader.p_offset, programHeader.p_filesz, programHeader.p_vaddr });
+        }
+    }
+
+    add_symbols(indexes, *elfFile, path);
+
+    // Distributions strip their binaries, and install the debug info separately.
+    if (indexes.lines.empty() && buildID.size() > 2) {
+        const auto debugFilePath = std::string(debug_file_directory) + buildID.substr(0, 2) + "/" + buildID.substr(2) + ".debug";
+
+        if (std::filesystem::exists(debugFilePath)) {
+            if (const auto debugElfFile = ElfFile::open(debugFilePath)) {
+                add_symbols(indexes, *debugElfFile, debugFilePath);
+            }
+        }
+    }
+
+    if (indexes.lines.empty()) {
+        format_and_write_to_log<512>(LogLevel::Debug, "No line tables were found for %; its source files and lines are unknown.", path.c_str());
+    }
+
+    auto index = std::make_shared<const std::vector<std::byte>>(build_index(indexes));
+
+    if (useCache && ! save_index(*index, cacheFilePath)) {
+        format_and_write_to_log<512>(LogLevel::Debug, "Couldn't save the symbols of % to %.", path.c_str(), cacheFilePath.c_str());
+    }
+
+    const std::span<const std::byte> indexBytes = *index;
+    return from_index(std::move(index), indexBytes, std::move(buildID), false);
+}
+
+std::optional<Module> Module::from_index(
+    std::shared_ptr<const void> storage,
+    std::span<const std::byte> index,
+    std::string buildID,
+    const bool isCached
+) {
+    ByteReader reader(index);
+    const auto header = reader.read<IndexHeader>();
+    if (reader.failed() || memcmp(header.magic, index_magic, sizeof index_magic) != 0 || header.version != index_version) {
+        return {};
+    }
+
+    Module module;
+    index = index.subspan(sizeof header);
+
+    if (! take_records(index, header.segmentCount, module.m_segments)
+     || ! take_records(index, header.functionCount, module.m_functions)
+     || ! take_records(index, header.lineCount, module.m_lines)
+     || ! take_records(index, header.inlinedCallCount, module.m_inlinedCalls)) {
+        return {};
+    }
+
+    // Every string is null terminated, so none of them can run off the end.
+    if (index.size() != header.stringsSize || (! index.empty() && index.back() != std::byte(0))) {
+        return {};
+    }
+
+    module.m_strings = index;
+    module.m_storage = std::move(storage);
+    module.m_buildID = std::move(buildID);
+    module.m_isCached = isCached;
+
+    return module;
+}
+
+std::optional<address_t> Module::get_address(const offset_t fileOffset) const noexcept {
+    for (const auto& segment : m_segments) {
+        if (fileOffset >= segment.fileOffset && fileOffset - segment.fileOffset < segment.fileSize) {
+            return segment.address + (fileOffset - segment.fileOffset);
+        }
+    }
+
+    return {};
+}
+
+Symbol Module::symbolise(const address_t address) const {
+    Symbol symbol;
+
+    const auto nextFunction = std::upper_bound(m_functions.begin(), m_functions.end(), address, [](const address_t lhs, const Function& rhs) {
+        return lhs < rhs.start;
+    });
+
+    if (nextFunction != m_functions.begin()) {
+        const auto& function = *std::prev(nextFunction);
+        if (address < function.end) {
+            symbol.functionName = get_string(m_strings, function.nameOffset);
+            symbol.offset = address - function.start;
+        }
+    }
+
+    const auto nextLine = std::upper_bound(m_lines.begin(), m_lines.end(), address, [](const address_t lhs, const Line& rhs) {
+        return lhs < rhs.start;
+    });
+
+    if (nextLine != m_lines.begin()) {
+        const auto& line = *std::prev(nextLine);
+        if (line.sourceFilePathOffset != Line::no_source_file) {
+            symbol.sourceFilePath = get_string(m_strings, line.sourceFilePathOffset);
+            symbol.lineNumber = line.lineNumber;
+        }
+    }
+
+    const auto nextInlinedCall = std::upper_bound(m_inlinedCalls.begin(), m_inlinedCalls.end(), address, [](const address_t lhs, const InlinedCall& rhs) {
+        return lhs < rhs.start;
+    });
+
+    if (nextInlinedCall == m_inlinedCalls.begin()) {
+        return symbol;
+    }
+
+    // Calls nest, so the innermost call the address is in is the last to start before it, or one of its parents.
+    // Parents always come before their children, which (even in a broken cache file) stops this going round in circles.
+    std::uint64_t inlinedCallIndex = std::distance(m_inlinedCalls.begin(), nextInlinedCall) - 1;
+    while (address >= m_inlinedCalls[inlinedCallIndex].end) {
+        const auto parent = m_inlinedCalls[inlinedCallIndex].parent;
+        if (parent >= inlinedCallIndex) {
+            return symbol;
+        }
+
+        inlinedCallIndex = parent;
+    }
+
+    // The line the address is on is in the innermost call's function. Each call then happened on a line in the
+    // function it was inlined into, out to the line in the function that everything was inlined into.
+    while (true) {
+        const auto& inlinedCall = m_inlinedCalls[inlinedCallIndex];
+
+        symbol.inlinedFrames.push_back({
+            std::string(get_string(m_strings, inlinedCall.nameOffset)),
+            std::move(symbol.sourceFilePath),
+            symbol.lineNumber
+        });
+
+        symbol.sourceFilePath = inlinedCall.callSourceFilePathOffset == Line::no_source_file
+            ? std::string()
+            : std::string(get_string(m_strings, inlinedCall.callSourceFilePathOffset));
+        symbol.lineNumber = inlinedCall.callLineNumber;
+
+        if (inlinedCall.parent >= inlinedCallIndex) {
+            break;
+        }
+
+        inlinedCallIndex = inlinedCall.parent;
+    }
+
+    return symbol;
+}
+
+const std::string& Module::get_build_id() const noexcept {
+    return m_buildID;
+}
+
+bool Module::is_cached() const noexcept {
+    return m_isCached;
+}
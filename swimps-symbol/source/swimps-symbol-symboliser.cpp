@@ -0,0 +1,127 @@
+#include "swimps-symbol/swimps-symbol.h"
+
+#include <algorithm>
+#include <future>
+#include <numeric>
+
+using swimps::symbol::address_t;
+using swimps::symbol::MemoryMap;
+using swimps::symbol::Symbol;
+using swimps::symbol::Symboliser;
+using swimps::thread::ThreadPool;
+
+namespace {
+    // Below this many instruction pointers per thread, starting the threads (and loading the same modules
+    // in each of them) costs more than it saves.
+    constexpr std::size_t min_instruction_pointers_per_thread = 1024;
+}
+
+Symboliser::Symboliser(std::vector<MemoryMap> memoryMaps, std::string cacheDirectory)
+: m_cacheDirectory(std::move(cacheDirectory)) {
+    // Of overlapping memory maps, the one starting lowest is kept, and the rest dropped.
+    // Stable, so that of those starting at the same address, the first recorded is kept.
+    std::stable_sort(memoryMaps.begin(), memoryMaps.end(), [](const MemoryMap& lhs, const MemoryMap& rhs) {
+        return lhs.start < rhs.start;
+    });
+
+    for (auto& memoryMap : memoryMaps) {
+        if (! m_memoryMaps.empty() && memoryMap.start < m_memoryMaps.back().end) {
+            continue;
+        }
+
+        m_memoryMaps.push_back(std::move(memoryMap));
+    }
+}
+
+std::optional<Symbol> Symboliser::symbolise(const address_t instructionPointer) {
+    const auto nextMemoryMap = std::upper_bound(
+        m_memoryMaps.cbegin(),
+        m_memoryMaps.cend(),
+        instructionPointer,
+        [](const address_t address, const MemoryMap& memoryMap) {
+            return address < memoryMap.start;
+        }
+    );
+
+    if (nextMemoryMap == m_memoryMaps.cbegin()) {
+        return {};
+    }
+
+    const auto& memoryMap = *std::prev(nextMemoryMap);
+    if (instructionPointer >= memoryMap.end) {
+        return {};
+    }
+
+    auto moduleIter = m_modules.find(memoryMap.path);
+    if (moduleIter == m_modules.end()) {
+        moduleIter = m_modules.emplace(memoryMap.path, Module::load(memoryMap.path, m_cacheDirectory)).first;
+    }
+
+    const auto& module = moduleIter->second;
+    if (! module.has_value()) {
+        return {};
+    }
+
+    const auto address = module->get_address(instructionPointer - memoryMap.start + memoryMap.fileOffset);
+    if (! address.has_value()) {
+        return {};
+    }
+
+    return module->symbolise(*address);
+}
+
+std::vector<std::optional<Symbol>> swimps::symbol::symbolise_in_parallel(
+    const std::span<const address_t> instructionPointers,
+    const std::span<const MemoryMap> memoryMaps,
+    const std::string& cacheDirectory,
+    const std::size_t threadCount
+) {
+    std::vector<std::optional<Symbol>> symbols(instructionPointers.size());
+
+    // Sorted by address, so that each thread's range covers as few modules as possible.
+    std::vector<std::size_t> order(instructionPointers.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::sort(order.begin(), order.end(), [instructionPointers](const std::size_t lhs, const std::size_t rhs) {
+        return instructionPointers[lhs] < instructionPointers[rhs];
+    });
+
+    const auto rangeCount = std::clamp<std::size_t>(order.size() / min_instruction_pointers_per_thread, 1, std::max<std::size_t>(threadCount, 1));
+    const auto rangeSize = (order.size() + rangeCount - 1) / rangeCount;
+
+    const auto symboliseRange = [&](const std::size_t rangeStart, const std::size_t rangeEnd) {
+        // Each range has its own symboliser, and so its own modules; none of them are shared between threads.
+        Symboliser symboliser(std::vector<MemoryMap>(memoryMaps.begin(), memoryMaps.end()), cacheDirectory);
+
+        // Each result goes back where its instruction pointer came from, which no other range writes to.
+        for (std::size_t i = rangeStart; i < rangeEnd; ++i) {
+            symbols[order[i]] = symboliser.symbolise(instructionPointers[order[i]]);
+        }
+    };
+
+    if (rangeCount == 1) {
+        symboliseRange(0, order.size());
+        return symbols;
+    }
+
+    ThreadPool threadPool(rangeCount);
+    std::vector<std::future<void>> rangesSymbolised;
+    rangesSymbolised.reserve(rangeCount);
+
+    for (std::size_t rangeStart = 0; rangeStart < order.size(); rangeStart += rangeSize) {
+        const auto rangeEnd = std::min(rangeStart + rangeSize, order.size());
+        rangesSymbolised.push_back(threadPool.submit([&symboliseRange, rangeStart, rangeEnd](){
+            symboliseRange(rangeStart, rangeEnd);
+        }));
+    }
+
+    // Every range has to finish before the results can be returned, even if one has already thrown.
+    for (auto& rangeSymbolised : rangesSymbolised) {
+        rangeSymbolised.wait();
+    }
+
+    for (auto& rangeSymbolised : rangesSymbolised) {
+        rangeSymbolised.get();
+    }
+
+    return symbols;
+}
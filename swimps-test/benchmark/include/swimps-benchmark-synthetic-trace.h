@@ -0,0 +1,47 @@
+#pragma once
+
+#include <string>
+
+#include "swimps-trace-file/swimps-trace-file.h"
+
+namespace swimps::benchmark {
+    // Roughly a minute of sampling at 10kHz, with a realistic spread of stacks.
+    constexpr swimps::trace::sample_count_t synthetic_sample_count = 600'000;
+    constexpr swimps::trace::backtrace_id_t synthetic_backtrace_count = 2'000;
+    constexpr swimps::trace::stack_frame_id_t synthetic_stack_frame_count = 4'000;
+    constexpr swimps::trace::stack_frame_count_t synthetic_backtrace_depth = 30;
+
+    //!
+    //! \brief  Fills a trace file with deterministic, made-up entries.
+    //!
+    //! \param[in]  traceFile  Where to add the entries.
+    //!
+    inline void write_synthetic_trace(swimps::trace::TraceFile& traceFile) {
+        using namespace swimps::trace;
+
+        for (sample_count_t i = 0; i < synthetic_sample_count; ++i) {
+            Sample sample;
+            sample.backtraceID = 1 + (i * 7919) % synthetic_backtrace_count;
+            sample.timestamp.seconds = i / 10'000;
+            sample.timestamp.nanoseconds = (i % 10'000) * 100'000;
+            traceFile.add_sample(sample);
+        }
+
+        for (backtrace_id_t id = 1; id <= synthetic_backtrace_count; ++id) {
+            Backtrace backtrace;
+            backtrace.id = id;
+            for (stack_frame_count_t depth = 0; depth < synthetic_backtrace_depth; ++depth) {
+                backtrace.stackFrameIDs.push_back(1 + (id * synthetic_backtrace_depth + depth) % synthetic_stack_frame_count);
+            }
+
+            traceFile.add_backtrace(backtrace);
+        }
+
+        StringTable strings;
+        for (stack_frame_id_t id = 1; id <= synthetic_stack_frame_count; ++id) {
+            StackFrame stackFrame(id, 0x400000 + id * 16);
+            stackFrame.functionName = strings.intern("function_" + std::to_string(id));
+            traceFile.add_stack_frame(stackFrame, strings);
+        }
+    }
+}
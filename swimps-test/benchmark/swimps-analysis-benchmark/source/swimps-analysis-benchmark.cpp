@@ -0,0 +1,54 @@
+#include "swimps-benchmark.h"
+
+#include <string>
+
+#include "swimps-analysis/swimps-analysis.h"
+
+using namespace swimps::trace;
+
+namespace {
+    //
+    // A trace the size of a long capture: a million samples spread over 50,000 backtraces,
+    // each 20 stack frames deep and sharing their outer frames with their neighbours.
+    //
+    Trace make_trace() {
+        constexpr backtrace_id_t backtrace_count = 50'000;
+
+        Trace trace;
+
+        for (backtrace_id_t id = 1; id <= backtrace_count; ++id) {
+            Backtrace backtrace;
+            backtrace.id = id;
+
+            for (stack_frame_id_t depth = 20; depth > 0; --depth) {
+                backtrace.stackFrameIDs.push_back(1 + (id * 7919) % (depth * 100));
+            }
+
+            trace.backtraces.push_back(std::move(backtrace));
+        }
+
+        for (std::uint64_t i = 0; i < 1'000'000; ++i) {
+            Sample sample;
+            sample.backtraceID = 1 + static_cast<backtrace_id_t>((i * 48271) % backtrace_count);
+            trace.samples.push_back(sample);
+        }
+
+        return trace;
+    }
+}
+
+TEST_CASE("swimps::analysis::analyse", "[swimps-analysis]") {
+    const auto trace = make_trace();
+
+    BENCHMARK("Analyse " + std::to_string(trace.samples.size()) + " samples over " + std::to_string(trace.backtraces.size()) + " backtraces") {
+        return swimps::analysis::analyse(trace).callTree.size();
+    };
+
+    const auto analysis = swimps::analysis::analyse(trace);
+
+    for (const std::size_t count : { std::size_t(20), analysis.backtraceFrequency.size() }) {
+        BENCHMARK("Pick the heaviest " + std::to_string(count) + " backtraces") {
+            return swimps::analysis::get_heaviest_backtraces(analysis.backtraceFrequency, count).size();
+        };
+    }
+}
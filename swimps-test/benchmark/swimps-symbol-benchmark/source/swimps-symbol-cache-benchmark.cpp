@@ -0,0 +1,28 @@
+#include "swimps-benchmark.h"
+
+#include <filesystem>
+#include <string>
+
+#include "swimps-symbol/swimps-symbol.h"
+
+using swimps::symbol::Module;
+
+// Loading a module from the symbol cache should cost next to nothing next to reading its ELF and DWARF.
+TEST_CASE("swimps::symbol::Module::load", "[swimps-symbol]") {
+    const auto path = std::filesystem::read_symlink("/proc/self/exe").string();
+    const auto cacheDirectory = (std::filesystem::temp_directory_path() / "swimps-symbol-cache-benchmark").string();
+    std::filesystem::remove_all(cacheDirectory);
+
+    BENCHMARK("Without the cache") {
+        return Module::load(path).has_value();
+    };
+
+    // Prime the cache, so that every load below is a hit.
+    Module::load(path, cacheDirectory);
+
+    BENCHMARK("From the cache") {
+        return Module::load(path, cacheDirectory).has_value();
+    };
+
+    std::filesystem::remove_all(cacheDirectory);
+}
@@ -0,0 +1,39 @@
+#include "swimps-benchmark.h"
+
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+#include "swimps-symbol/swimps-symbol.h"
+
+using swimps::symbol::address_t;
+using swimps::symbol::MemoryMapRecorder;
+
+// Given enough cores, the time should fall as threads are added, until the modules each thread loads dominate.
+TEST_CASE("swimps::symbol::symbolise_in_parallel", "[swimps-symbol]") {
+    MemoryMapRecorder recorder;
+    recorder.record(getpid());
+
+    // As many unique instruction pointers as a large trace has, spread across every module in this process.
+    std::vector<address_t> instructionPointers;
+    for (const auto& memoryMap : recorder.get_memory_maps()) {
+        for (auto address = memoryMap.start; address < memoryMap.end && instructionPointers.size() < 50'000; address += 97) {
+            instructionPointers.push_back(address);
+        }
+    }
+
+    // Warm the symbol cache, so it's the symbolising that's measured rather than reading DWARF.
+    const auto cacheDirectory = (std::filesystem::temp_directory_path() / "swimps-symbol-parallel-benchmark").string();
+    std::filesystem::remove_all(cacheDirectory);
+    swimps::symbol::symbolise_in_parallel(instructionPointers, recorder.get_memory_maps(), cacheDirectory, 1);
+
+    for (const std::size_t threadCount : { 1, 2, 4, 8 }) {
+        BENCHMARK(std::to_string(instructionPointers.size()) + " instruction pointers on " + std::to_string(threadCount) + " threads") {
+            return swimps::symbol::symbolise_in_parallel(instructionPointers, recorder.get_memory_maps(), cacheDirectory, threadCount).size();
+        };
+    }
+
+    std::filesystem::remove_all(cacheDirectory);
+}
@@ -0,0 +1,47 @@
+#include "swimps-benchmark.h"
+
+#include <string>
+#include <vector>
+
+#include "swimps-trace/swimps-trace.h"
+
+using swimps::trace::BacktraceTable;
+using swimps::trace::stack_frame_count_t;
+using swimps::trace::stack_frame_id_t;
+
+namespace {
+    // Deep stacks sharing most of their frames, as real ones do, so the backtraces differ only near the top.
+    constexpr stack_frame_count_t backtrace_depth = 30;
+
+    std::vector<std::vector<stack_frame_id_t>> make_unique_backtraces(const std::size_t count) {
+        std::vector<std::vector<stack_frame_id_t>> backtraces(count);
+
+        for (std::size_t i = 0; i < count; ++i) {
+            backtraces[i].push_back(static_cast<stack_frame_id_t>(i));
+            for (stack_frame_count_t depth = 1; depth < backtrace_depth; ++depth) {
+                backtraces[i].push_back(depth);
+            }
+        }
+
+        return backtraces;
+    }
+}
+
+// The time per backtrace should stay flat as the number of unique backtraces grows.
+TEST_CASE("swimps::trace::BacktraceTable::intern", "[swimps-trace]") {
+    for (const std::size_t uniqueCount : { 25'000, 50'000, 100'000, 200'000 }) {
+        const auto uniqueBacktraces = make_unique_backtraces(uniqueCount);
+
+        BENCHMARK(std::to_string(uniqueCount) + " unique backtraces, each seen twice") {
+            BacktraceTable backtraces;
+
+            for (int pass = 0; pass < 2; ++pass) {
+                for (const auto& stackFrameIDs : uniqueBacktraces) {
+                    backtraces.intern(stackFrameIDs);
+                }
+            }
+
+            return backtraces.size();
+        };
+    }
+}
@@ -0,0 +1,98 @@
+#include "swimps-benchmark.h"
+#include "swimps-benchmark-synthetic-trace.h"
+
+#include <filesystem>
+#include <iostream>
+#include <string>
+
+using swimps::trace::Trace;
+using swimps::trace::TraceFile;
+
+namespace {
+    void write_trace(TraceFile& traceFile, const Trace& trace) {
+        for (const auto& sample : trace.samples) {
+            traceFile.add_sample(sample);
+        }
+
+        for (const auto& backtrace : trace.backtraces) {
+            traceFile.add_backtrace(backtrace);
+        }
+
+        for (const auto& stackFrame : trace.stackFrames) {
+            traceFile.add_stack_frame(stackFrame, trace.strings);
+        }
+    }
+
+    void benchmark_compression(const std::string& name, const Trace& trace) {
+        const auto uncompressedPath = (std::filesystem::temp_directory_path() / "swimps-trace-file-compression-benchmark-none").string();
+        const auto compressedPath = (std::filesystem::temp_directory_path() / "swimps-trace-file-compression-benchmark-lz4").string();
+
+        for (const auto compression : { TraceFile::Compression::None, TraceFile::Compression::LZ4 }) {
+            auto traceFile = TraceFile::create_and_open(
+                compression == TraceFile::Compression::None ? uncompressedPath : compressedPath,
+                TraceFile::Permissions::ReadWrite,
+                TraceFile::Format::V2,
+                compression
+            );
+
+            write_trace(traceFile, trace);
+            traceFile.finalise();
+        }
+
+        const auto uncompressedSize = std::filesystem::file_size(uncompressedPath);
+        const auto compressedSize = std::filesystem::file_size(compressedPath);
+
+        std::cout << name << ": " << uncompressedSize << " bytes uncompressed, "
+                  << compressedSize << " bytes with LZ4 (ratio "
+                  << static_cast<double>(uncompressedSize) / static_cast<double>(compressedSize) << ")\n";
+
+        auto uncompressedFile = TraceFile::open_existing(uncompressedPath, TraceFile::Permissions::ReadOnly);
+        auto compressedFile = TraceFile::open_existing(compressedPath, TraceFile::Permissions::ReadOnly);
+
+        BENCHMARK("Write " + name + ", uncompressed") {
+            auto traceFile = TraceFile::create_and_open(uncompressedPath + ".write", TraceFile::Permissions::ReadWrite, TraceFile::Format::V2);
+            write_trace(traceFile, trace);
+            return traceFile.finalise();
+        };
+
+        BENCHMARK("Write " + name + ", LZ4") {
+            auto traceFile = TraceFile::create_and_open(compressedPath + ".write", TraceFile::Permissions::ReadWrite, TraceFile::Format::V2, TraceFile::Compression::LZ4);
+            write_trace(traceFile, trace);
+            return traceFile.finalise();
+        };
+
+        BENCHMARK("Read " + name + ", uncompressed") {
+            return uncompressedFile.read_trace();
+        };
+
+        BENCHMARK("Read " + name + ", LZ4") {
+            return compressedFile.read_trace();
+        };
+
+        std::filesystem::remove(uncompressedPath);
+        std::filesystem::remove(compressedPath);
+        std::filesystem::remove(uncompressedPath + ".write");
+        std::filesystem::remove(compressedPath + ".write");
+    }
+}
+
+TEST_CASE("swimps::trace::TraceFile::Compression", "[swimps-trace-file]") {
+    Trace syntheticTrace;
+
+    {
+        auto traceFile = TraceFile::create_temporary(TraceFile::Format::V2);
+        swimps::benchmark::write_synthetic_trace(traceFile);
+        traceFile.finalise();
+        syntheticTrace = *traceFile.read_trace();
+    }
+
+    benchmark_compression("synthetic trace", syntheticTrace);
+
+    // A real trace compresses differently to a synthetic one, so the checked in swimps-dummy trace is measured too.
+    auto dummyTraceFile = TraceFile::open_existing(SWIMPS_BENCHMARK_DUMMY_TRACE, TraceFile::Permissions::ReadOnly);
+    const auto dummyTrace = dummyTraceFile.read_trace();
+    REQUIRE(dummyTrace.has_value());
+    REQUIRE(! dummyTrace->samples.empty());
+
+    benchmark_compression("swimps-dummy trace", *dummyTrace);
+}
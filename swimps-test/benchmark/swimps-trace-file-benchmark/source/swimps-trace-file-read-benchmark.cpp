@@ -0,0 +1,50 @@
+#include "swimps-benchmark.h"
+#include "swimps-benchmark-synthetic-trace.h"
+
+#include <filesystem>
+
+using swimps::trace::TraceFile;
+
+TEST_CASE("swimps::trace::TraceFile::read_trace", "[swimps-trace-file]") {
+    const auto path = (std::filesystem::temp_directory_path() / "swimps-trace-file-read-benchmark").string();
+
+    {
+        auto traceFile = TraceFile::create_and_open(path, TraceFile::Permissions::ReadWrite);
+        traceFile.enable_write_buffering();
+        swimps::benchmark::write_synthetic_trace(traceFile);
+    }
+
+    auto traceFile = TraceFile::open_existing(path, TraceFile::Permissions::ReadOnly);
+
+    BENCHMARK("Sequential") {
+        return traceFile.read_trace(TraceFile::ReadMode::Sequential);
+    };
+
+    BENCHMARK("Mapped") {
+        return traceFile.read_trace(TraceFile::ReadMode::Mapped);
+    };
+
+    std::filesystem::remove(path);
+}
+
+TEST_CASE("swimps::trace::TraceFile::read_trace (v2)", "[swimps-trace-file]") {
+    const auto path = (std::filesystem::temp_directory_path() / "swimps-trace-file-read-v2-benchmark").string();
+
+    {
+        auto traceFile = TraceFile::create_and_open(path, TraceFile::Permissions::ReadWrite, TraceFile::Format::V2);
+        swimps::benchmark::write_synthetic_trace(traceFile);
+        traceFile.finalise();
+    }
+
+    auto traceFile = TraceFile::open_existing(path, TraceFile::Permissions::ReadOnly);
+
+    BENCHMARK("Mapped") {
+        return traceFile.read_trace(TraceFile::ReadMode::Mapped);
+    };
+
+    BENCHMARK("Parallel") {
+        return traceFile.read_trace(TraceFile::ReadMode::Parallel);
+    };
+
+    std::filesystem::remove(path);
+}
@@ -0,0 +1,27 @@
+#include "swimps-benchmark.h"
+#include "swimps-benchmark-synthetic-trace.h"
+
+#include <filesystem>
+
+using swimps::trace::TraceFile;
+
+TEST_CASE("swimps::trace::TraceFile::add_sample, "
+          "swimps::trace::TraceFile::add_backtrace, "
+          "swimps::trace::TraceFile::add_stack_frame", "[swimps-trace-file]") {
+    const auto path = (std::filesystem::temp_directory_path() / "swimps-trace-file-write-benchmark").string();
+
+    BENCHMARK("Unbuffered") {
+        auto traceFile = TraceFile::create_and_open(path, TraceFile::Permissions::ReadWrite);
+        swimps::benchmark::write_synthetic_trace(traceFile);
+        return traceFile.finalise();
+    };
+
+    BENCHMARK("Buffered") {
+        auto traceFile = TraceFile::create_and_open(path, TraceFile::Permissions::ReadWrite);
+        traceFile.enable_write_buffering();
+        swimps::benchmark::write_synthetic_trace(traceFile);
+        return traceFile.finalise();
+    };
+
+    std::filesystem::remove(path);
+}
@@ -0,0 +1,73 @@
+#include "swimps-intergration-test.h"
+
+#include "swimps-analysis/swimps-analysis.h"
+
+using swimps::analysis::Analysis;
+using CallTree = Analysis::CallTree;
+using namespace swimps::trace;
+
+SCENARIO("swimps::analysis::Analysis::get_bottom_up_call_tree", "[swimps-analysis]") {
+    GIVEN("A trace in which main calls memcpy through two different functions, and has samples of its own.") {
+        constexpr stack_frame_id_t main_id = 1;
+        constexpr stack_frame_id_t first_caller_id = 2;
+        constexpr stack_frame_id_t memcpy_id = 3;
+        constexpr stack_frame_id_t second_caller_id = 4;
+
+        Trace trace;
+        for (stack_frame_id_t id = 1; id <= 4; ++id) {
+            trace.stackFrames.emplace_back(id, 0x100 * id);
+        }
+
+        Backtrace throughFirstCaller;
+        throughFirstCaller.id = 1;
+        throughFirstCaller.stackFrameIDs = { memcpy_id, first_caller_id, main_id };
+        Backtrace throughSecondCaller;
+        throughSecondCaller.id = 2;
+        throughSecondCaller.stackFrameIDs = { memcpy_id, second_caller_id, main_id };
+        Backtrace justMain;
+        justMain.id = 3;
+        justMain.stackFrameIDs = { main_id };
+        trace.backtraces = { throughFirstCaller, throughSecondCaller, justMain };
+
+        for (const auto& [backtraceID, sampleCount] : { std::pair{ 1, 6 }, std::pair{ 2, 4 }, std::pair{ 3, 2 } }) {
+            for (int i = 0; i < sampleCount; ++i) {
+                Sample sample;
+                sample.backtraceID = backtraceID;
+                trace.samples.push_back(sample);
+            }
+        }
+
+        WHEN("It is analysed, and its bottom up call tree asked for.") {
+            const auto analysis = swimps::analysis::analyse(trace);
+            const auto& bottomUpCallTree = analysis.get_bottom_up_call_tree();
+
+            THEN("The innermost stack frames are at the top, and their callers below them, weighted by samples.") {
+                REQUIRE(bottomUpCallTree.get(CallTree::root).frequency == 12);
+
+                const auto memcpyNode = bottomUpCallTree.find_child(CallTree::root, memcpy_id);
+                REQUIRE(memcpyNode != CallTree::no_node);
+                REQUIRE(bottomUpCallTree.get(memcpyNode).frequency == 10);
+
+                const auto firstCallerNode = bottomUpCallTree.find_child(memcpyNode, first_caller_id);
+                REQUIRE(firstCallerNode != CallTree::no_node);
+                REQUIRE(bottomUpCallTree.get(firstCallerNode).frequency == 6);
+                REQUIRE(bottomUpCallTree.get(bottomUpCallTree.find_child(firstCallerNode, main_id)).frequency == 6);
+
+                const auto secondCallerNode = bottomUpCallTree.find_child(memcpyNode, second_caller_id);
+                REQUIRE(secondCallerNode != CallTree::no_node);
+                REQUIRE(bottomUpCallTree.get(secondCallerNode).frequency == 4);
+
+                const auto mainNode = bottomUpCallTree.find_child(CallTree::root, main_id);
+                REQUIRE(mainNode != CallTree::no_node);
+                REQUIRE(bottomUpCallTree.get(mainNode).frequency == 2);
+                REQUIRE(bottomUpCallTree.get(mainNode).firstChild == CallTree::no_node);
+
+                REQUIRE(bottomUpCallTree.size() == 7);
+            }
+
+            THEN("It's only built once.") {
+                REQUIRE(&analysis.get_bottom_up_call_tree() == &bottomUpCallTree);
+            }
+        }
+    }
+}
@@ -0,0 +1,93 @@
+#include "swimps-intergration-test.h"
+
+#include <vector>
+
+#include "swimps-analysis/swimps-analysis.h"
+
+using swimps::analysis::Analysis;
+using CallGraph = Analysis::CallGraph;
+using namespace swimps::trace;
+
+namespace {
+    std::vector<CallGraph::Edge> to_vector(const std::span<const CallGraph::Edge> edges) {
+        return { edges.begin(), edges.end() };
+    }
+}
+
+SCENARIO("swimps::analysis::Analysis::CallGraph", "[swimps-analysis]") {
+    GIVEN("Calls between functions, given in no particular order.") {
+        const std::vector<CallGraph::Call> calls = {
+            { 1, 2, 5 },
+            { 3, 2, 7 },
+            { 1, 3, 9 },
+            { 2, 2, 1 }
+        };
+
+        WHEN("A call graph is made from them.") {
+            const CallGraph callGraph(calls);
+
+            THEN("Each function's callers and callees can be looked up, heaviest first.") {
+                REQUIRE(callGraph.size() == 4);
+
+                REQUIRE(to_vector(callGraph.get_callees(1)) == std::vector<CallGraph::Edge>{ { 3, 9 }, { 2, 5 } });
+                REQUIRE(to_vector(callGraph.get_callers(1)).empty());
+
+                REQUIRE(to_vector(callGraph.get_callees(2)) == std::vector<CallGraph::Edge>{ { 2, 1 } });
+                REQUIRE(to_vector(callGraph.get_callers(2)) == std::vector<CallGraph::Edge>{ { 3, 7 }, { 1, 5 }, { 2, 1 } });
+
+                REQUIRE(to_vector(callGraph.get_callees(3)) == std::vector<CallGraph::Edge>{ { 2, 7 } });
+                REQUIRE(to_vector(callGraph.get_callers(3)) == std::vector<CallGraph::Edge>{ { 1, 9 } });
+
+                REQUIRE(callGraph.get_callees(4).empty());
+                REQUIRE(callGraph.get_callers(4).empty());
+            }
+
+            THEN("Functions it doesn't know about have no callers or callees.") {
+                REQUIRE(callGraph.get_callees(5).empty());
+                REQUIRE(callGraph.get_callers(1000).empty());
+            }
+        }
+    }
+
+    GIVEN("A trace in which main calls a recursive function both directly and through a helper.") {
+        Trace trace;
+        const auto mainName = trace.strings.intern("main");
+        const auto helperName = trace.strings.intern("helper");
+        const auto recurseName = trace.strings.intern("recurse");
+
+        for (const auto& [id, name] : { std::pair{ 1, mainName }, std::pair{ 2, helperName }, std::pair{ 3, recurseName } }) {
+            StackFrame stackFrame(id, 0x100 * id);
+            stackFrame.functionName = name;
+            trace.stackFrames.push_back(stackFrame);
+        }
+
+        Backtrace direct;
+        direct.id = 1;
+        direct.stackFrameIDs = { 3, 3, 3, 1 };
+        Backtrace throughHelper;
+        throughHelper.id = 2;
+        throughHelper.stackFrameIDs = { 3, 2, 1 };
+        trace.backtraces = { direct, throughHelper };
+
+        for (const auto& [backtraceID, sampleCount] : { std::pair{ 1, 6 }, std::pair{ 2, 4 } }) {
+            for (int i = 0; i < sampleCount; ++i) {
+                Sample sample;
+                sample.backtraceID = backtraceID;
+                trace.samples.push_back(sample);
+            }
+        }
+
+        WHEN("It is analysed.") {
+            const auto analysis = swimps::analysis::analyse(trace);
+            const auto& callGraph = analysis.callGraph;
+
+            THEN("Each call is weighted by its samples, with recursive calls counted once per sample.") {
+                REQUIRE(callGraph.size() == 4);
+                REQUIRE(to_vector(callGraph.get_callees(mainName)) == std::vector<CallGraph::Edge>{ { recurseName, 6 }, { helperName, 4 } });
+                REQUIRE(to_vector(callGraph.get_callers(recurseName)) == std::vector<CallGraph::Edge>{ { mainName, 6 }, { recurseName, 6 }, { helperName, 4 } });
+                REQUIRE(to_vector(callGraph.get_callees(helperName)) == std::vector<CallGraph::Edge>{ { recurseName, 4 } });
+                REQUIRE(callGraph.get_callers(mainName).empty());
+            }
+        }
+    }
+}
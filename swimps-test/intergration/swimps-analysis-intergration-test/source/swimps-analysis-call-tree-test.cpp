@@ -0,0 +1,91 @@
+#include "swimps-intergration-test.h"
+
+#include <vector>
+
+#include "swimps-analysis/swimps-analysis.h"
+
+using CallTree = swimps::analysis::Analysis::CallTree;
+using swimps::trace::stack_frame_id_t;
+
+namespace {
+    std::vector<stack_frame_id_t> get_children(const CallTree& callTree, const CallTree::node_index_t parent) {
+        std::vector<stack_frame_id_t> children;
+
+        for (auto child = callTree.get(parent).firstChild; child != CallTree::no_node; child = callTree.get(child).nextSibling) {
+            REQUIRE(callTree.get(child).parent == parent);
+            children.push_back(callTree.get(child).stackFrameID);
+        }
+
+        return children;
+    }
+}
+
+SCENARIO("swimps::analysis::Analysis::CallTree", "[swimps-analysis]") {
+    GIVEN("An empty call tree.") {
+        CallTree callTree;
+
+        THEN("It holds just the root, which has no children.") {
+            REQUIRE(callTree.size() == 1);
+            REQUIRE(callTree.get(CallTree::root).firstChild == CallTree::no_node);
+            REQUIRE(callTree.find_child(CallTree::root, 1) == CallTree::no_node);
+        }
+
+        WHEN("A recursive path is added twice.") {
+            std::vector<CallTree::node_index_t> nodes;
+
+            for (int i = 0; i < 2; ++i) {
+                auto node = CallTree::root;
+                nodes.clear();
+
+                for (const stack_frame_id_t stackFrameID : { 1, 2, 1, 2 }) {
+                    node = callTree.add_child(node, stackFrameID);
+                    nodes.push_back(node);
+                }
+            }
+
+            THEN("Each recursive call has a node of its own, and the second time adds none.") {
+                REQUIRE(callTree.size() == 5);
+                REQUIRE(nodes[0] != nodes[2]);
+                REQUIRE(nodes[1] != nodes[3]);
+                REQUIRE(callTree.find_child(nodes[1], 1) == nodes[2]);
+            }
+
+            AND_WHEN("Samples are added at the innermost node.") {
+                callTree.add_samples(nodes[3], 5);
+                callTree.add_samples(nodes[1], 2);
+
+                THEN("They're counted against it and every node above it.") {
+                    REQUIRE(callTree.get(CallTree::root).frequency == 7);
+                    REQUIRE(callTree.get(nodes[0]).frequency == 7);
+                    REQUIRE(callTree.get(nodes[1]).frequency == 7);
+                    REQUIRE(callTree.get(nodes[2]).frequency == 5);
+                    REQUIRE(callTree.get(nodes[3]).frequency == 5);
+                }
+            }
+        }
+
+        WHEN("More children are added to one node than the tree started with room for.") {
+            const auto parent = callTree.add_child(CallTree::root, 1000);
+
+            std::vector<stack_frame_id_t> expectedChildren;
+            for (stack_frame_id_t stackFrameID = 500; stackFrameID > 0; --stackFrameID) {
+                callTree.add_child(parent, stackFrameID);
+                expectedChildren.push_back(stackFrameID);
+            }
+
+            THEN("They can all still be found, in the order they were added.") {
+                REQUIRE(callTree.size() == 502);
+                REQUIRE(get_children(callTree, parent) == expectedChildren);
+
+                for (const auto stackFrameID : expectedChildren) {
+                    const auto child = callTree.find_child(parent, stackFrameID);
+                    REQUIRE(child != CallTree::no_node);
+                    REQUIRE(callTree.get(child).stackFrameID == stackFrameID);
+                    REQUIRE(callTree.add_child(parent, stackFrameID) == child);
+                }
+
+                REQUIRE(callTree.find_child(CallTree::root, 1) == CallTree::no_node);
+            }
+        }
+    }
+}
@@ -0,0 +1,136 @@
+#include "swimps-intergration-test.h"
+
+#include "swimps-analysis/swimps-analysis.h"
+
+using swimps::analysis::Analysis;
+using swimps::analysis::Diff;
+using namespace swimps::trace;
+
+namespace {
+    //
+    // Adds a number of samples in a backtrace to a trace.
+    //
+    void add_samples(Trace& trace, const backtrace_id_t backtraceID, const int sampleCount) {
+        for (int i = 0; i < sampleCount; ++i) {
+            Sample sample;
+            sample.backtraceID = backtraceID;
+            trace.samples.push_back(sample);
+        }
+    }
+}
+
+SCENARIO("swimps::analysis::compare", "[swimps-analysis]") {
+    GIVEN("A baseline trace with samples in main and a function it calls, and a candidate trace twice as long, "
+          "with its strings and stack frames in a different order and a function the baseline doesn't have.") {
+        Trace baselineTrace;
+        {
+            StackFrame mainStackFrame(1, 0x100);
+            mainStackFrame.functionName = baselineTrace.strings.intern("main");
+            StackFrame workStackFrame(2, 0x200);
+            workStackFrame.functionName = baselineTrace.strings.intern("work");
+            baselineTrace.stackFrames = { mainStackFrame, workStackFrame };
+
+            Backtrace justMain;
+            justMain.id = 1;
+            justMain.stackFrameIDs = { 1 };
+            Backtrace work;
+            work.id = 2;
+            work.stackFrameIDs = { 2, 1 };
+            baselineTrace.backtraces = { justMain, work };
+
+            add_samples(baselineTrace, 1, 4);
+            add_samples(baselineTrace, 2, 6);
+        }
+
+        Trace candidateTrace;
+        {
+            StackFrame workStackFrame(1, 0x1200);
+            workStackFrame.functionName = candidateTrace.strings.intern("work");
+            StackFrame mainStackFrame(2, 0x1100);
+            mainStackFrame.functionName = candidateTrace.strings.intern("main");
+            StackFrame extraStackFrame(3, 0x1300);
+            extraStackFrame.functionName = candidateTrace.strings.intern("extra");
+            candidateTrace.stackFrames = { workStackFrame, mainStackFrame, extraStackFrame };
+
+            Backtrace work;
+            work.id = 1;
+            work.stackFrameIDs = { 1, 2 };
+            Backtrace extra;
+            extra.id = 2;
+            extra.stackFrameIDs = { 3, 2 };
+            candidateTrace.backtraces = { work, extra };
+
+            add_samples(candidateTrace, 1, 15);
+            add_samples(candidateTrace, 2, 5);
+        }
+
+        WHEN("Their analyses are compared.") {
+            const auto diff = swimps::analysis::compare(
+                swimps::analysis::analyse(baselineTrace),
+                swimps::analysis::analyse(candidateTrace)
+            );
+
+            const auto getName = [&diff](const string_id_t function) {
+                return std::string(diff.strings.get(function));
+            };
+
+            THEN("Each run's total samples are kept.") {
+                REQUIRE(diff.baselineSamples == 10);
+                REQUIRE(diff.candidateSamples == 20);
+            }
+
+            THEN("Each function's shares are matched up by name, and ranked by how much its self share grew.") {
+                REQUIRE(diff.functionDeltas.size() == 3);
+
+                REQUIRE(getName(diff.functionDeltas[0].functionName) == "extra");
+                REQUIRE(diff.functionDeltas[0].baselineSelf == 0);
+                REQUIRE(diff.functionDeltas[0].candidateSelf == Approx(0.25));
+                REQUIRE(diff.functionDeltas[0].baselineInclusive == 0);
+                REQUIRE(diff.functionDeltas[0].candidateInclusive == Approx(0.25));
+
+                REQUIRE(getName(diff.functionDeltas[1].functionName) == "work");
+                REQUIRE(diff.functionDeltas[1].baselineSelf == Approx(0.6));
+                REQUIRE(diff.functionDeltas[1].candidateSelf == Approx(0.75));
+                REQUIRE(diff.functionDeltas[1].baselineInclusive == Approx(0.6));
+                REQUIRE(diff.functionDeltas[1].candidateInclusive == Approx(0.75));
+
+                REQUIRE(getName(diff.functionDeltas[2].functionName) == "main");
+                REQUIRE(diff.functionDeltas[2].baselineSelf == Approx(0.4));
+                REQUIRE(diff.functionDeltas[2].candidateSelf == 0);
+                REQUIRE(diff.functionDeltas[2].baselineInclusive == Approx(1));
+                REQUIRE(diff.functionDeltas[2].candidateInclusive == Approx(1));
+            }
+
+            THEN("The call trees are laid over each other by function, with each node's samples from each run.") {
+                const auto& callTree = diff.callTree;
+                REQUIRE(callTree.size() == 4);
+                REQUIRE(diff.baselineNodeSamples.size() == callTree.size());
+                REQUIRE(diff.candidateNodeSamples.size() == callTree.size());
+
+                REQUIRE(callTree.get(Analysis::CallTree::root).frequency == 30);
+                REQUIRE(diff.baselineNodeSamples[Analysis::CallTree::root] == 10);
+                REQUIRE(diff.candidateNodeSamples[Analysis::CallTree::root] == 20);
+
+                const auto main = callTree.get(Analysis::CallTree::root).firstChild;
+                REQUIRE(main != Analysis::CallTree::no_node);
+                REQUIRE(getName(callTree.get(main).stackFrameID) == "main");
+                REQUIRE(callTree.get(main).nextSibling == Analysis::CallTree::no_node);
+                REQUIRE(callTree.get(main).frequency == 30);
+                REQUIRE(diff.baselineNodeSamples[main] == 10);
+                REQUIRE(diff.candidateNodeSamples[main] == 20);
+
+                const auto work = callTree.get(main).firstChild;
+                REQUIRE(getName(callTree.get(work).stackFrameID) == "work");
+                REQUIRE(callTree.get(work).frequency == 21);
+                REQUIRE(diff.baselineNodeSamples[work] == 6);
+                REQUIRE(diff.candidateNodeSamples[work] == 15);
+
+                const auto extra = callTree.get(work).nextSibling;
+                REQUIRE(getName(callTree.get(extra).stackFrameID) == "extra");
+                REQUIRE(callTree.get(extra).frequency == 5);
+                REQUIRE(diff.baselineNodeSamples[extra] == 0);
+                REQUIRE(diff.candidateNodeSamples[extra] == 5);
+            }
+        }
+    }
+}
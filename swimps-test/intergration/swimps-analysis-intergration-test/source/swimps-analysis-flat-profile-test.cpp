@@ -0,0 +1,54 @@
+#include "swimps-intergration-test.h"
+
+#include "swimps-analysis/swimps-analysis.h"
+
+using swimps::analysis::Analysis;
+using namespace swimps::trace;
+
+SCENARIO("swimps::analysis::Analysis::flatProfile", "[swimps-analysis]") {
+    GIVEN("A trace with samples in main, a recursive function called from main, and an unsymbolised stack frame.") {
+        Trace trace;
+        const auto mainName = trace.strings.intern("main");
+        const auto recurseName = trace.strings.intern("recurse");
+
+        // The recursive function calls itself from two different lines, so has two stack frames.
+        StackFrame mainStackFrame(1, 0x100);
+        mainStackFrame.functionName = mainName;
+        StackFrame recurseStackFrame(2, 0x200);
+        recurseStackFrame.functionName = recurseName;
+        StackFrame otherRecurseStackFrame(3, 0x210);
+        otherRecurseStackFrame.functionName = recurseName;
+        trace.stackFrames = { mainStackFrame, recurseStackFrame, otherRecurseStackFrame, StackFrame(4, 0x300) };
+
+        Backtrace deepRecursion;
+        deepRecursion.id = 1;
+        deepRecursion.stackFrameIDs = { 2, 3, 2, 1 };
+        Backtrace justMain;
+        justMain.id = 2;
+        justMain.stackFrameIDs = { 1 };
+        Backtrace unsymbolised;
+        unsymbolised.id = 3;
+        unsymbolised.stackFrameIDs = { 4, 2, 1 };
+        trace.backtraces = { deepRecursion, justMain, unsymbolised };
+
+        for (const auto& [backtraceID, sampleCount] : { std::pair{ 1, 10 }, std::pair{ 2, 5 }, std::pair{ 3, 1 } }) {
+            for (int i = 0; i < sampleCount; ++i) {
+                Sample sample;
+                sample.backtraceID = backtraceID;
+                trace.samples.push_back(sample);
+            }
+        }
+
+        WHEN("It is analysed.") {
+            const auto analysis = swimps::analysis::analyse(trace);
+
+            THEN("Each function's self samples are those it was innermost for, and its inclusive samples count each sample once however deep the recursion.") {
+                REQUIRE(analysis.flatProfile == Analysis::FlatProfile{
+                    { recurseName, 10, 11 },
+                    { mainName, 5, 16 },
+                    { 0, 1, 1 }
+                });
+            }
+        }
+    }
+}
@@ -0,0 +1,152 @@
+#include "swimps-intergration-test.h"
+
+#include <filesystem>
+#include <string>
+
+#include "swimps-analysis/swimps-analysis.h"
+#include "swimps-trace-file/swimps-trace-file.h"
+
+using swimps::analysis::Analysis;
+using namespace swimps::trace;
+
+namespace {
+    void require_same_call_tree(const Analysis::CallTree& lhs, const Analysis::CallTree& rhs) {
+        REQUIRE(lhs.size() == rhs.size());
+
+        for (Analysis::CallTree::node_index_t i = 0; i < lhs.size(); ++i) {
+            REQUIRE(lhs.get(i).frequency == rhs.get(i).frequency);
+            REQUIRE(lhs.get(i).stackFrameID == rhs.get(i).stackFrameID);
+            REQUIRE(lhs.get(i).parent == rhs.get(i).parent);
+            REQUIRE(lhs.get(i).firstChild == rhs.get(i).firstChild);
+            REQUIRE(lhs.get(i).nextSibling == rhs.get(i).nextSibling);
+        }
+    }
+}
+
+SCENARIO("swimps::analysis::analyse(TraceFile&)", "[swimps-analysis]") {
+    for (const auto format : { TraceFile::Format::V1, TraceFile::Format::V2 }) {
+        GIVEN("A format " + std::to_string(static_cast<int>(format)) + " trace file with repeated samples and function names.") {
+            const auto path = (std::filesystem::temp_directory_path() / "swimps-analysis-streaming-test").string();
+
+            {
+                auto traceFile = TraceFile::create_and_open(path, TraceFile::Permissions::ReadWrite, format);
+
+                for (int i = 0; i < 1000; ++i) {
+                    Sample sample;
+                    sample.backtraceID = 1 + (i % 3);
+                    sample.timestamp.seconds = i;
+                    traceFile.add_sample(sample);
+                }
+
+                for (backtrace_id_t id = 1; id <= 3; ++id) {
+                    Backtrace backtrace;
+                    backtrace.id = id;
+                    backtrace.stackFrameIDs = { id + 10, 10 };
+                    traceFile.add_backtrace(backtrace);
+                }
+
+                StringTable strings;
+                for (stack_frame_id_t id = 10; id <= 13; ++id) {
+                    StackFrame stackFrame(id, 0x100 + id);
+                    stackFrame.functionName = strings.intern(id == 10 ? "main" : "worker");
+                    traceFile.add_stack_frame(stackFrame, strings);
+                }
+
+                REQUIRE(traceFile.finalise());
+            }
+
+            WHEN("It is analysed entry by entry, and also read in full then analysed.") {
+                auto traceFile = TraceFile::open_existing(path, TraceFile::Permissions::ReadOnly);
+                const auto streamedAnalysis = swimps::analysis::analyse(traceFile);
+
+                auto fullTraceFile = TraceFile::open_existing(path, TraceFile::Permissions::ReadOnly);
+                const auto trace = fullTraceFile.read_trace();
+                REQUIRE(trace.has_value());
+                const auto fullAnalysis = swimps::analysis::analyse(*trace);
+
+                THEN("The results are the same.") {
+                    REQUIRE(streamedAnalysis.backtraceFrequency == fullAnalysis.backtraceFrequency);
+                    require_same_call_tree(streamedAnalysis.callTree, fullAnalysis.callTree);
+                }
+
+                THEN("The samples are counted per backtrace, in order of backtrace ID.") {
+                    REQUIRE(streamedAnalysis.backtraceFrequency == Analysis::BacktraceFrequency{ { 334, 1 }, { 333, 2 }, { 333, 3 } });
+                }
+
+                THEN("The heaviest backtraces can be picked out, heaviest first.") {
+                    const auto& backtraceFrequency = streamedAnalysis.backtraceFrequency;
+                    REQUIRE(swimps::analysis::get_heaviest_backtraces(backtraceFrequency) == Analysis::BacktraceFrequency{ { 334, 1 }, { 333, 3 }, { 333, 2 } });
+                    REQUIRE(swimps::analysis::get_heaviest_backtraces(backtraceFrequency, 2) == Analysis::BacktraceFrequency{ { 334, 1 }, { 333, 3 } });
+                    REQUIRE(swimps::analysis::get_heaviest_backtraces(backtraceFrequency, 0).empty());
+                }
+
+                THEN("The call tree is weighted by how many samples were taken along each path.") {
+                    const auto& callTree = streamedAnalysis.callTree;
+                    REQUIRE(callTree.get(Analysis::CallTree::root).frequency == 1000);
+
+                    const auto mainNode = callTree.find_child(Analysis::CallTree::root, 10);
+                    REQUIRE(mainNode != Analysis::CallTree::no_node);
+                    REQUIRE(callTree.get(mainNode).frequency == 1000);
+
+                    REQUIRE(callTree.get(callTree.find_child(mainNode, 11)).frequency == 334);
+                    REQUIRE(callTree.get(callTree.find_child(mainNode, 12)).frequency == 333);
+                    REQUIRE(callTree.get(callTree.find_child(mainNode, 13)).frequency == 333);
+                }
+
+                THEN("The flat profile is the same, and puts every sample in worker, called from main.") {
+                    REQUIRE(streamedAnalysis.flatProfile == fullAnalysis.flatProfile);
+                    REQUIRE(streamedAnalysis.flatProfile.size() == 2);
+
+                    const auto& strings = *streamedAnalysis.symbolTable.strings;
+                    REQUIRE(strings.get(streamedAnalysis.flatProfile[0].functionName) == "worker");
+                    REQUIRE(streamedAnalysis.flatProfile[0].selfSamples == 1000);
+                    REQUIRE(streamedAnalysis.flatProfile[0].inclusiveSamples == 1000);
+                    REQUIRE(strings.get(streamedAnalysis.flatProfile[1].functionName) == "main");
+                    REQUIRE(streamedAnalysis.flatProfile[1].selfSamples == 0);
+                    REQUIRE(streamedAnalysis.flatProfile[1].inclusiveSamples == 1000);
+                }
+
+                THEN("Each function name is stored once, and every stack frame can be looked up.") {
+                    REQUIRE(streamedAnalysis.symbolTable.strings->size() == 3); // "main", "worker" and the empty string
+                    REQUIRE(streamedAnalysis.symbolTable.stackFrames.size() == 4);
+
+                    const auto* const mainStackFrame = streamedAnalysis.symbolTable.find(10);
+                    REQUIRE(mainStackFrame != nullptr);
+                    REQUIRE(streamedAnalysis.symbolTable.strings->get(mainStackFrame->functionName) == "main");
+                    REQUIRE(streamedAnalysis.symbolTable.find(99) == nullptr);
+                }
+            }
+
+            std::filesystem::remove(path);
+        }
+    }
+}
+
+SCENARIO("swimps::analysis::analyse(const Trace&), with backtrace IDs too big to count in an array", "[swimps-analysis]") {
+    GIVEN("A trace with samples in a backtrace with a small ID, and a backtrace with a huge one.") {
+        constexpr backtrace_id_t huge_backtrace_id = backtrace_id_t(1) << 40;
+
+        Trace trace;
+        for (const auto backtraceID : { huge_backtrace_id, backtrace_id_t(2), huge_backtrace_id }) {
+            Sample sample;
+            sample.backtraceID = backtraceID;
+            trace.samples.push_back(sample);
+        }
+
+        for (const auto backtraceID : { backtrace_id_t(2), huge_backtrace_id }) {
+            Backtrace backtrace;
+            backtrace.id = backtraceID;
+            backtrace.stackFrameIDs = { 1 };
+            trace.backtraces.push_back(backtrace);
+        }
+
+        WHEN("It is analysed.") {
+            const auto analysis = swimps::analysis::analyse(trace);
+
+            THEN("Both backtraces are counted, in order of ID.") {
+                REQUIRE(analysis.backtraceFrequency == Analysis::BacktraceFrequency{ { 1, 2 }, { 2, huge_backtrace_id } });
+                REQUIRE(analysis.callTree.get(Analysis::CallTree::root).frequency == 3);
+            }
+        }
+    }
+}
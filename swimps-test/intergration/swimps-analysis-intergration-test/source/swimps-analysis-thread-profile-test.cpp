@@ -0,0 +1,112 @@
+#include "swimps-intergration-test.h"
+
+#include "swimps-analysis/swimps-analysis.h"
+
+using swimps::analysis::Analysis;
+using CallTree = swimps::analysis::Analysis::CallTree;
+using namespace swimps::trace;
+
+SCENARIO("swimps::analysis::Analysis::threadProfiles", "[swimps-analysis]") {
+    GIVEN("A trace with samples in main calling two functions, taken on a named main thread and a named worker thread.") {
+        Trace trace;
+        const auto mainName = trace.strings.intern("main");
+        const auto parseName = trace.strings.intern("parse");
+        const auto workName = trace.strings.intern("work");
+        const auto workerThreadName = trace.strings.intern("worker");
+
+        StackFrame mainStackFrame(1, 0x100);
+        mainStackFrame.functionName = mainName;
+        StackFrame parseStackFrame(2, 0x200);
+        parseStackFrame.functionName = parseName;
+        StackFrame workStackFrame(3, 0x300);
+        workStackFrame.functionName = workName;
+        trace.stackFrames = { mainStackFrame, parseStackFrame, workStackFrame };
+
+        Backtrace parsing;
+        parsing.id = 1;
+        parsing.stackFrameIDs = { 2, 1 };
+        Backtrace working;
+        working.id = 2;
+        working.stackFrameIDs = { 3, 1 };
+        trace.backtraces = { parsing, working };
+
+        trace.threads = { { 100, mainName }, { 200, workerThreadName } };
+
+        // The main thread's samples come first, so the worker's turn up part way through.
+        for (const auto& [threadID, backtraceID] : {
+            std::pair{ 100, 1 }, std::pair{ 100, 1 }, std::pair{ 100, 2 },
+            std::pair{ 200, 2 }, std::pair{ 100, 1 }, std::pair{ 200, 2 },
+            std::pair{ 200, 2 }, std::pair{ 200, 2 }, std::pair{ 200, 2 }, std::pair{ 200, 2 }
+        }) {
+            Sample sample;
+            sample.backtraceID = backtraceID;
+            sample.threadID = threadID;
+            trace.samples.push_back(sample);
+        }
+
+        WHEN("It is analysed.") {
+            const auto analysis = swimps::analysis::analyse(trace);
+
+            THEN("There is a profile per thread, busiest first, with the thread's name.") {
+                REQUIRE(analysis.threadProfiles.size() == 2);
+                REQUIRE(analysis.threadProfiles[0].threadID == 200);
+                REQUIRE(analysis.threadProfiles[0].threadName == workerThreadName);
+                REQUIRE(analysis.threadProfiles[1].threadID == 100);
+                REQUIRE(analysis.threadProfiles[1].threadName == mainName);
+            }
+
+            THEN("Each thread's call tree only counts its own samples.") {
+                const auto& workerCallTree = analysis.threadProfiles[0].callTree;
+                REQUIRE(workerCallTree.get(CallTree::root).frequency == 6);
+
+                const auto workerMainNode = workerCallTree.find_child(CallTree::root, 1);
+                REQUIRE(workerCallTree.get(workerCallTree.find_child(workerMainNode, 3)).frequency == 6);
+                REQUIRE(workerCallTree.find_child(workerMainNode, 2) == CallTree::no_node);
+
+                const auto& mainCallTree = analysis.threadProfiles[1].callTree;
+                REQUIRE(mainCallTree.get(CallTree::root).frequency == 4);
+
+                const auto mainMainNode = mainCallTree.find_child(CallTree::root, 1);
+                REQUIRE(mainCallTree.get(mainCallTree.find_child(mainMainNode, 2)).frequency == 3);
+                REQUIRE(mainCallTree.get(mainCallTree.find_child(mainMainNode, 3)).frequency == 1);
+            }
+
+            THEN("Each thread's flat profile only counts its own samples.") {
+                REQUIRE(analysis.threadProfiles[0].flatProfile == Analysis::FlatProfile{
+                    { workName, 6, 6 },
+                    { mainName, 0, 6 }
+                });
+
+                REQUIRE(analysis.threadProfiles[1].flatProfile == Analysis::FlatProfile{
+                    { parseName, 3, 3 },
+                    { workName, 1, 1 },
+                    { mainName, 0, 4 }
+                });
+            }
+
+            THEN("The whole trace's flat profile still counts every thread's samples.") {
+                REQUIRE(analysis.flatProfile == Analysis::FlatProfile{
+                    { workName, 7, 7 },
+                    { parseName, 3, 3 },
+                    { mainName, 0, 10 }
+                });
+            }
+        }
+
+        WHEN("Its samples are all put down to the unknown thread, then it is analysed.") {
+            for (auto& sample : trace.samples) {
+                sample.threadID = 0;
+            }
+
+            const auto analysis = swimps::analysis::analyse(trace);
+
+            THEN("There is one thread profile, the same as the whole trace's.") {
+                REQUIRE(analysis.threadProfiles.size() == 1);
+                REQUIRE(analysis.threadProfiles[0].threadID == 0);
+                REQUIRE(analysis.threadProfiles[0].threadName == 0);
+                REQUIRE(analysis.threadProfiles[0].callTree.size() == analysis.callTree.size());
+                REQUIRE(analysis.threadProfiles[0].flatProfile == analysis.flatProfile);
+            }
+        }
+    }
+}
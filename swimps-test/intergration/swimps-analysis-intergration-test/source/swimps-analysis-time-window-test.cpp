@@ -0,0 +1,137 @@
+#include "swimps-intergration-test.h"
+
+#include "swimps-analysis/swimps-analysis.h"
+
+using signalsafe::time::TimeSpecification;
+using swimps::analysis::Analysis;
+using swimps::analysis::TraceIndex;
+using namespace swimps::trace;
+
+namespace {
+    //
+    // Gets the time a number of milliseconds after a minute in.
+    //
+    TimeSpecification at_millisecond(const int millisecond) {
+        TimeSpecification time{};
+        time.seconds = 60 + millisecond / 1000;
+        time.nanoseconds = (millisecond % 1000) * 1'000'000;
+        return time;
+    }
+}
+
+SCENARIO("swimps::analysis::TraceIndex", "[swimps-analysis]") {
+    GIVEN("A trace with a sample every millisecond for ten seconds, written out of order, in one backtrace for the first half and another for the second.") {
+        constexpr int sample_count = 10'000;
+
+        Trace trace;
+        const auto mainName = trace.strings.intern("main");
+        const auto firstName = trace.strings.intern("first");
+        const auto secondName = trace.strings.intern("second");
+
+        for (const auto& [id, name] : { std::pair{ 1, mainName }, std::pair{ 2, firstName }, std::pair{ 3, secondName } }) {
+            StackFrame stackFrame(id, 0x100 * id);
+            stackFrame.functionName = name;
+            trace.stackFrames.push_back(stackFrame);
+        }
+
+        Backtrace firstHalf;
+        firstHalf.id = 1;
+        firstHalf.stackFrameIDs = { 2, 1 };
+        Backtrace secondHalf;
+        secondHalf.id = 2;
+        secondHalf.stackFrameIDs = { 3, 1 };
+        trace.backtraces = { firstHalf, secondHalf };
+
+        for (int millisecond = sample_count - 1; millisecond >= 0; --millisecond) {
+            Sample sample;
+            sample.backtraceID = millisecond < sample_count / 2 ? 1 : 2;
+            sample.timestamp = at_millisecond(millisecond);
+            trace.samples.push_back(sample);
+        }
+
+        const TraceIndex traceIndex(trace);
+
+        WHEN("Its samples are got.") {
+            const auto samples = traceIndex.get_samples();
+
+            THEN("They are all there, in order of when they were taken.") {
+                REQUIRE(samples.size() == sample_count);
+                REQUIRE(samples.front().timestamp.seconds == 60);
+                REQUIRE(samples.front().timestamp.nanoseconds == 0);
+                REQUIRE(samples.back().timestamp.seconds == 69);
+                REQUIRE(samples.back().timestamp.nanoseconds == 999'000'000);
+            }
+        }
+
+        WHEN("The samples in a window spanning several blocks are got.") {
+            const auto samples = traceIndex.get_samples(at_millisecond(2000), at_millisecond(7500));
+
+            THEN("The window includes its start but not its end.") {
+                REQUIRE(samples.size() == 5500);
+                REQUIRE(samples.front().timestamp.seconds == 62);
+                REQUIRE(samples.front().timestamp.nanoseconds == 0);
+                REQUIRE(samples.back().timestamp.seconds == 67);
+                REQUIRE(samples.back().timestamp.nanoseconds == 499'000'000);
+            }
+        }
+
+        WHEN("The samples in an empty window, a backwards window, and a window after the trace are got.") {
+            THEN("There are none.") {
+                REQUIRE(traceIndex.get_samples(at_millisecond(3000), at_millisecond(3000)).empty());
+                REQUIRE(traceIndex.get_samples(at_millisecond(4000), at_millisecond(3000)).empty());
+                REQUIRE(traceIndex.get_samples(at_millisecond(20'000), at_millisecond(30'000)).empty());
+            }
+        }
+
+        WHEN("Its backtraces and stack frames are looked up.") {
+            THEN("Those in the trace are found, and those that aren't are not.") {
+                REQUIRE(traceIndex.find_backtrace(2)->stackFrameIDs == std::vector<stack_frame_id_t>{ 3, 1 });
+                REQUIRE(traceIndex.find_backtrace(3) == nullptr);
+                REQUIRE(traceIndex.find_stack_frame(3)->instructionPointer == 0x300);
+                REQUIRE(traceIndex.find_stack_frame(0) == nullptr);
+            }
+        }
+
+        WHEN("A window within the first half is analysed.") {
+            const auto analysis = swimps::analysis::analyse(traceIndex, at_millisecond(1000), at_millisecond(3500));
+
+            THEN("Only the window's samples are counted, and the second half's backtrace isn't in the call tree.") {
+                REQUIRE(analysis.backtraceFrequency == Analysis::BacktraceFrequency{ { 2500, 1 } });
+
+                const auto& callTree = analysis.callTree;
+                REQUIRE(callTree.get(Analysis::CallTree::root).frequency == 2500);
+
+                const auto mainNode = callTree.find_child(Analysis::CallTree::root, 1);
+                REQUIRE(mainNode != Analysis::CallTree::no_node);
+                REQUIRE(callTree.get(callTree.find_child(mainNode, 2)).frequency == 2500);
+                REQUIRE(callTree.find_child(mainNode, 3) == Analysis::CallTree::no_node);
+            }
+
+            THEN("Only the functions the window reaches are in its flat profile and call graph.") {
+                REQUIRE(analysis.flatProfile == Analysis::FlatProfile{ { firstName, 2500, 2500 }, { mainName, 0, 2500 } });
+
+                REQUIRE(analysis.callGraph.size() == 1);
+                REQUIRE(analysis.callGraph.get_callees(mainName).size() == 1);
+                REQUIRE(analysis.callGraph.get_callees(mainName)[0] == Analysis::CallGraph::Edge{ firstName, 2500 });
+                REQUIRE(analysis.callGraph.get_callers(secondName).empty());
+            }
+
+            THEN("It shares the trace's strings rather than copying them.") {
+                REQUIRE(analysis.symbolTable.strings == traceIndex.get_strings());
+                REQUIRE(analysis.symbolTable.strings->get(firstName) == "first");
+            }
+        }
+
+        WHEN("A window covering the whole trace is analysed.") {
+            const auto windowAnalysis = swimps::analysis::analyse(traceIndex, at_millisecond(0), at_millisecond(sample_count));
+            const auto analysis = swimps::analysis::analyse(trace);
+
+            THEN("It is the same as analysing the trace.") {
+                REQUIRE(windowAnalysis.backtraceFrequency == analysis.backtraceFrequency);
+                REQUIRE(windowAnalysis.callTree.size() == analysis.callTree.size());
+                REQUIRE(windowAnalysis.callTree.get(Analysis::CallTree::root).frequency == sample_count);
+                REQUIRE(windowAnalysis.flatProfile == analysis.flatProfile);
+            }
+        }
+    }
+}
@@ -27,7 +27,11 @@ SCENARIO("swimps::option::Options::toString, swimps::option::Options::fromString
             42,
             "amazing-swimps-trace-name",
             "programName",
-            { "arg1", "arg2", "arg3" }
+            { "arg1", "arg2", "arg3" },
+            true,
+            true,
+            "baseline-swimps-trace-name",
+            { "merge1", "merge2" }
         };
 
         WHEN("They are converted to a string and back again.") {
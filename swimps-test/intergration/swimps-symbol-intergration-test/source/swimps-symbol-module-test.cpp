@@ -0,0 +1,132 @@
+#include "swimps-intergration-test.h"
+
+#include <cstdlib>
+#include <filesystem>
+#include <string>
+
+#include "swimps-symbol/swimps-symbol.h"
+
+using swimps::symbol::Module;
+
+namespace {
+    //
+    // Checks that two loads of a module symbolise every part of it the same way.
+    //
+    void require_same_symbols(const Module& lhs, const Module& rhs, const std::uintmax_t fileSize) {
+        for (std::uintmax_t fileOffset = 0; fileOffset < fileSize; fileOffset += 256) {
+            const auto lhsAddress = lhs.get_address(fileOffset);
+            const auto rhsAddress = rhs.get_address(fileOffset);
+            REQUIRE(lhsAddress == rhsAddress);
+
+            if (! lhsAddress.has_value()) {
+                continue;
+            }
+
+            const auto lhsSymbol = lhs.symbolise(*lhsAddress);
+            const auto rhsSymbol = rhs.symbolise(*rhsAddress);
+            REQUIRE(lhsSymbol.functionName == rhsSymbol.functionName);
+            REQUIRE(lhsSymbol.offset == rhsSymbol.offset);
+            REQUIRE(lhsSymbol.sourceFilePath == rhsSymbol.sourceFilePath);
+            REQUIRE(lhsSymbol.lineNumber == rhsSymbol.lineNumber);
+            REQUIRE(lhsSymbol.inlinedFrames.size() == rhsSymbol.inlinedFrames.size());
+        }
+    }
+}
+
+SCENARIO("swimps::symbol::Module", "[swimps-symbol]") {
+    GIVEN("This test's executable and an empty symbol cache directory.") {
+        const auto path = std::filesystem::read_symlink("/proc/self/exe").string();
+        const auto fileSize = std::filesystem::file_size(path);
+        const auto cacheDirectory = (std::filesystem::temp_directory_path() / "swimps-symbol-module-test-cache").string();
+        std::filesystem::remove_all(cacheDirectory);
+
+        const auto uncachedModule = Module::load(path);
+        REQUIRE(uncachedModule.has_value());
+        REQUIRE(! uncachedModule->get_build_id().empty());
+        REQUIRE(! uncachedModule->is_cached());
+
+        const auto cacheFilePath = std::filesystem::path(cacheDirectory) / (uncachedModule->get_build_id() + ".symbols");
+
+        WHEN("It is loaded with the cache directory.") {
+            const auto module = Module::load(path, cacheDirectory);
+
+            THEN("Its symbols are read from the executable, and saved to the cache by build ID.") {
+                REQUIRE(module.has_value());
+                REQUIRE(! module->is_cached());
+                REQUIRE(std::filesystem::is_regular_file(cacheFilePath));
+                REQUIRE(std::distance(std::filesystem::directory_iterator(cacheDirectory), {}) == 1);
+            }
+
+            AND_WHEN("It is loaded again.") {
+                const auto cachedModule = Module::load(path, cacheDirectory);
+
+                THEN("Its symbols come from the cache, and are the same as those read from the executable.") {
+                    REQUIRE(cachedModule.has_value());
+                    REQUIRE(cachedModule->is_cached());
+                    REQUIRE(cachedModule->get_build_id() == uncachedModule->get_build_id());
+                    require_same_symbols(*uncachedModule, *cachedModule, fileSize);
+                }
+            }
+
+            AND_WHEN("The cache file is truncated, then it is loaded again.") {
+                const auto cacheFileSize = std::filesystem::file_size(cacheFilePath);
+                std::filesystem::resize_file(cacheFilePath, cacheFileSize / 2);
+
+                const auto reloadedModule = Module::load(path, cacheDirectory);
+
+                THEN("The cache file is ignored and rebuilt.") {
+                    REQUIRE(reloadedModule.has_value());
+                    REQUIRE(! reloadedModule->is_cached());
+                    REQUIRE(std::filesystem::file_size(cacheFilePath) == cacheFileSize);
+                    require_same_symbols(*uncachedModule, *reloadedModule, fileSize);
+                }
+            }
+
+            AND_WHEN("The cache file is overwritten with something else, then it is loaded again.") {
+                std::filesystem::resize_file(cacheFilePath, 0);
+                std::filesystem::resize_file(cacheFilePath, 4096);
+
+                const auto reloadedModule = Module::load(path, cacheDirectory);
+
+                THEN("The cache file is ignored and rebuilt.") {
+                    REQUIRE(reloadedModule.has_value());
+                    REQUIRE(! reloadedModule->is_cached());
+                    REQUIRE(Module::load(path, cacheDirectory)->is_cached());
+                }
+            }
+        }
+
+        std::filesystem::remove_all(cacheDirectory);
+    }
+
+    GIVEN("A copy of this test's executable with its debug sections compressed.") {
+        const auto path = std::filesystem::read_symlink("/proc/self/exe").string();
+        const auto fileSize = std::filesystem::file_size(path);
+        const auto compressedPath = (std::filesystem::temp_directory_path() / "swimps-symbol-module-test-compressed").string();
+        std::filesystem::remove(compressedPath);
+
+        const auto command = "objcopy --compress-debug-sections=zlib '" + path + "' '" + compressedPath + "'";
+        REQUIRE(std::system(command.c_str()) == 0);
+
+        WHEN("Both are loaded.") {
+            const auto module = Module::load(path);
+            const auto compressedModule = Module::load(compressedPath);
+
+            THEN("The compressed debug sections are read, and symbolise everything the same way.") {
+                REQUIRE(module.has_value());
+                REQUIRE(compressedModule.has_value());
+                require_same_symbols(*module, *compressedModule, fileSize);
+
+                bool hasLines = false;
+                for (std::uintmax_t fileOffset = 0; fileOffset < fileSize && ! hasLines; fileOffset += 256) {
+                    const auto address = compressedModule->get_address(fileOffset);
+                    hasLines = address.has_value() && compressedModule->symbolise(*address).lineNumber != -1;
+                }
+
+                REQUIRE(hasLines);
+            }
+        }
+
+        std::filesystem::remove(compressedPath);
+    }
+}
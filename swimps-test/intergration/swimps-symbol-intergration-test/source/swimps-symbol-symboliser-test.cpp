@@ -0,0 +1,164 @@
+#include "swimps-intergration-test.h"
+
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+#include "swimps-symbol/swimps-symbol.h"
+
+using swimps::symbol::MemoryMapRecorder;
+using swimps::symbol::Symboliser;
+
+namespace swimps::symbol::test {
+    constexpr swimps::trace::line_number_t function_to_symbolise_line = __LINE__ + 2;
+
+    [[gnu::noinline]] int function_to_symbolise(int value) {
+        return value * 3;
+    }
+
+    [[gnu::noinline]] std::uintptr_t get_return_address() {
+        return reinterpret_cast<std::uintptr_t>(__builtin_return_address(0));
+    }
+
+    constexpr swimps::trace::line_number_t inlined_call_line = __LINE__ + 3;
+
+    [[gnu::always_inline]] inline std::uintptr_t inlined_function() {
+        const auto returnAddress = get_return_address();
+
+        // Keeps the call from becoming a jump, which would return straight past this function.
+        asm volatile("");
+        return returnAddress;
+    }
+
+    constexpr swimps::trace::line_number_t inlining_call_line = __LINE__ + 3;
+
+    [[gnu::noinline]] std::uintptr_t function_with_inlined_call() {
+        const auto returnAddress = inlined_function();
+        asm volatile("");
+        return returnAddress;
+    }
+}
+
+SCENARIO("swimps::symbol::Symboliser", "[swimps-symbol]") {
+    GIVEN("The memory maps of this process.") {
+        MemoryMapRecorder recorder;
+        REQUIRE(recorder.record(getpid()));
+        REQUIRE(! recorder.get_memory_maps().empty());
+
+        // No cache, so that the symbols are read from the modules themselves.
+        Symboliser symboliser(recorder.get_memory_maps(), {});
+
+        WHEN("The address of a function in this process is symbolised.") {
+            const auto address = reinterpret_cast<std::uintptr_t>(&swimps::symbol::test::function_to_symbolise);
+            const auto symbol = symboliser.symbolise(address);
+
+            THEN("It resolves to the function's name, source file and line.") {
+                REQUIRE(symbol.has_value());
+                REQUIRE(symbol->functionName.find("function_to_symbolise") != std::string::npos);
+                REQUIRE(symbol->offset == 0);
+                REQUIRE(std::filesystem::path(symbol->sourceFilePath).filename() == "swimps-symbol-symboliser-test.cpp");
+                REQUIRE(symbol->lineNumber == swimps::symbol::test::function_to_symbolise_line);
+            }
+        }
+
+        WHEN("An address in a function that was inlined into another is symbolised.") {
+            // The return address is just past the call; the call itself is the instruction before it.
+            const auto address = swimps::symbol::test::function_with_inlined_call() - 1;
+            const auto symbol = symboliser.symbolise(address);
+
+            THEN("It resolves to the inlined function, then the line it was called from in the function it was inlined into.") {
+                REQUIRE(symbol.has_value());
+                REQUIRE(symbol->inlinedFrames.size() == 1);
+
+                const auto& inlinedFrame = symbol->inlinedFrames.front();
+                REQUIRE(inlinedFrame.functionName.find("inlined_function") != std::string::npos);
+                REQUIRE(std::filesystem::path(inlinedFrame.sourceFilePath).filename() == "swimps-symbol-symboliser-test.cpp");
+                REQUIRE(inlinedFrame.lineNumber == swimps::symbol::test::inlined_call_line);
+
+                REQUIRE(symbol->functionName.find("function_with_inlined_call") != std::string::npos);
+                REQUIRE(std::filesystem::path(symbol->sourceFilePath).filename() == "swimps-symbol-symboliser-test.cpp");
+                REQUIRE(symbol->lineNumber == swimps::symbol::test::inlining_call_line);
+            }
+        }
+
+        WHEN("An address that isn't in any memory map is symbolised.") {
+            const auto symbol = symboliser.symbolise(0x10);
+
+            THEN("Nothing is found.") {
+                REQUIRE(! symbol.has_value());
+            }
+        }
+    }
+
+    GIVEN("The memory maps of this process, and many addresses within this test's executable.") {
+        MemoryMapRecorder recorder;
+        REQUIRE(recorder.record(getpid()));
+
+        const auto executablePath = std::filesystem::read_symlink("/proc/self/exe").string();
+        std::vector<swimps::symbol::address_t> instructionPointers;
+
+        for (const auto& memoryMap : recorder.get_memory_maps()) {
+            if (memoryMap.path != executablePath) {
+                continue;
+            }
+
+            // Stepping backwards, so that they aren't already sorted.
+            for (auto address = memoryMap.end - 1; address >= memoryMap.start && instructionPointers.size() < 8192; address -= 61) {
+                instructionPointers.push_back(address);
+            }
+        }
+
+        REQUIRE(instructionPointers.size() == 8192);
+
+        WHEN("They are symbolised in parallel.") {
+            const auto symbols = swimps::symbol::symbolise_in_parallel(instructionPointers, recorder.get_memory_maps(), {}, 4);
+
+            THEN("Each resolves the same as it does by itself, in the order they were given.") {
+                Symboliser symboliser(recorder.get_memory_maps(), {});
+
+                REQUIRE(symbols.size() == instructionPointers.size());
+                for (std::size_t i = 0; i < instructionPointers.size(); ++i) {
+                    const auto symbol = symboliser.symbolise(instructionPointers[i]);
+                    REQUIRE(symbols[i].has_value() == symbol.has_value());
+
+                    if (symbol.has_value()) {
+                        REQUIRE(symbols[i]->functionName == symbol->functionName);
+                        REQUIRE(symbols[i]->offset == symbol->offset);
+                        REQUIRE(symbols[i]->sourceFilePath == symbol->sourceFilePath);
+                        REQUIRE(symbols[i]->lineNumber == symbol->lineNumber);
+                    }
+                }
+            }
+        }
+    }
+
+    GIVEN("The memory maps of this process, recorded twice and saved.") {
+        const auto path = (std::filesystem::temp_directory_path() / "swimps-symbol-symboliser-test.maps").string();
+
+        MemoryMapRecorder recorder;
+        REQUIRE(recorder.record(getpid()));
+        const auto memoryMapCount = recorder.get_memory_maps().size();
+        REQUIRE(recorder.record(getpid()));
+        REQUIRE(recorder.save(path));
+
+        THEN("The second recording adds nothing new.") {
+            REQUIRE(recorder.get_memory_maps().size() == memoryMapCount);
+        }
+
+        WHEN("The saved file is read back.") {
+            std::ifstream mapsFile(path);
+            const std::string maps(std::istreambuf_iterator<char>(mapsFile), {});
+
+            THEN("It holds the recorded memory maps.") {
+                REQUIRE(swimps::symbol::parse_memory_maps(maps) == recorder.get_memory_maps());
+            }
+        }
+
+        std::filesystem::remove(path);
+    }
+}
@@ -0,0 +1,215 @@
+#include "swimps-intergration-test.h"
+
+#include <algorithm>
+#include <csignal>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <set>
+#include <string>
+#include <vector>
+
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <samplerpreload/trace.hpp>
+
+#include "swimps-trace-file/swimps-trace-file.h"
+
+using namespace swimps::trace;
+using signalsampler::instruction_pointer_t;
+
+namespace {
+    // More than one chunk's worth, so the raw trace isn't read in one go.
+    constexpr std::size_t raw_sample_count = 10000;
+
+    // The instruction pointers of each of the raw trace's backtraces, innermost first.
+    const std::vector<std::vector<instruction_pointer_t>> raw_backtraces = {
+        { 0x1010, 0x1020, 0x1030 },
+        { 0x1040, 0x1030 },
+        { 0x1010, 0x1020, 0x1030 },
+        { 0x1050, 0x1040, 0x1030 },
+    };
+
+    //
+    // Writes a raw trace the way the sampler does: one fixed size sample after another.
+    //
+    void write_raw_trace(const std::string& path) {
+        std::ofstream rawFile(path, std::ios_base::out | std::ios_base::binary | std::ios_base::trunc);
+        REQUIRE(rawFile.is_open());
+
+        for (std::size_t i = 0; i < raw_sample_count; ++i) {
+            samplerpreload::Sample rawSample{};
+            rawSample.timestamp.seconds = static_cast<decltype(rawSample.timestamp.seconds)>(i / 1000);
+            rawSample.timestamp.nanoseconds = static_cast<decltype(rawSample.timestamp.nanoseconds)>(i % 1000);
+
+            const auto& instructionPointers = raw_backtraces[i % raw_backtraces.size()];
+            for (std::size_t frame = 0; frame < instructionPointers.size(); ++frame) {
+                rawSample.backtrace[frame] = instructionPointers[frame];
+            }
+
+            rawFile.write(reinterpret_cast<const char*>(&rawSample), sizeof rawSample);
+        }
+
+        REQUIRE(rawFile.good());
+    }
+
+    std::vector<char> read_bytes(const std::string& path) {
+        std::ifstream file(path, std::ios_base::in | std::ios_base::binary);
+        return { std::istreambuf_iterator<char>(file), {} };
+    }
+
+    //
+    // Converts the raw trace in a child process that can't grow a file past a few KiB, so writing the
+    // converted trace fails part way through. If the child is to crash instead, it can't write to a file
+    // at all, and is left to be killed by SIGXFSZ as soon as it tries. Returns the child's ID and how it ended.
+    //
+    std::pair<pid_t, int> convert_in_cramped_child(const std::string& path, const bool crash) {
+        const auto childID = fork();
+        REQUIRE(childID != -1);
+
+        if (childID == 0) {
+            const rlimit noCore{ 0, 0 };
+            setrlimit(RLIMIT_CORE, &noCore);
+
+            const rlim_t fileSizeLimit = crash ? 0 : 4096;
+            const rlimit smallFiles{ fileSizeLimit, fileSizeLimit };
+            setrlimit(RLIMIT_FSIZE, &smallFiles);
+
+            signal(SIGXFSZ, crash ? SIG_DFL : SIG_IGN);
+
+            const auto converted = TraceFile::from_raw(path);
+            _exit(converted.has_value() ? 0 : 1);
+        }
+
+        int status = 0;
+        REQUIRE(waitpid(childID, &status, 0) == childID);
+        return { childID, status };
+    }
+}
+
+SCENARIO("swimps::trace::TraceFile::from_raw", "[swimps-trace-file]") {
+    GIVEN("A raw trace, in a directory of its own, whose samples share backtraces and instruction pointers.") {
+        const auto directory = std::filesystem::temp_directory_path() / "swimps-trace-file-from-raw-test";
+        std::filesystem::remove_all(directory);
+        std::filesystem::create_directories(directory);
+
+        const auto path = (directory / "trace").string();
+        write_raw_trace(path);
+        const auto rawBytes = read_bytes(path);
+
+        WHEN("It is converted.") {
+            auto traceFile = TraceFile::from_raw(path);
+
+            THEN("It is replaced by a v2 trace file, and nothing else is left in the directory.") {
+                REQUIRE(traceFile.has_value());
+                REQUIRE(traceFile->get_format() == TraceFile::Format::V2);
+                REQUIRE(std::distance(std::filesystem::directory_iterator(directory), {}) == 1);
+            }
+
+            THEN("Each backtrace and each instruction pointer's stack frame is stored once, in sections of their own.") {
+                REQUIRE(traceFile.has_value());
+
+                std::set<TraceFile::SectionKind> kinds;
+                for (const auto& section : traceFile->get_sections()) {
+                    kinds.insert(section.kind);
+
+                    switch (section.kind) {
+                    case TraceFile::SectionKind::Samples:
+                        REQUIRE(section.entryCount == raw_sample_count);
+                        break;
+                    case TraceFile::SectionKind::Backtraces:
+                        REQUIRE(section.entryCount == 3);
+                        break;
+                    case TraceFile::SectionKind::StackFrames:
+                        REQUIRE(section.entryCount == 5);
+                        break;
+                    case TraceFile::SectionKind::Strings:
+                    case TraceFile::SectionKind::Threads:
+                        break;
+                    }
+                }
+
+                REQUIRE(kinds.count(TraceFile::SectionKind::Samples) == 1);
+                REQUIRE(kinds.count(TraceFile::SectionKind::Backtraces) == 1);
+                REQUIRE(kinds.count(TraceFile::SectionKind::StackFrames) == 1);
+            }
+
+            THEN("Every sample keeps its timestamp and the instruction pointers of its backtrace.") {
+                REQUIRE(traceFile.has_value());
+
+                const auto trace = traceFile->read_trace();
+                REQUIRE(trace.has_value());
+                REQUIRE(trace->samples.size() == raw_sample_count);
+
+                for (std::size_t i = 0; i < trace->samples.size(); ++i) {
+                    const auto& sample = trace->samples[i];
+                    REQUIRE(sample.timestamp.seconds == static_cast<decltype(sample.timestamp.seconds)>(i / 1000));
+                    REQUIRE(sample.timestamp.nanoseconds == static_cast<decltype(sample.timestamp.nanoseconds)>(i % 1000));
+
+                    const auto backtrace = std::find_if(trace->backtraces.cbegin(), trace->backtraces.cend(), [&sample](const Backtrace& backtrace) {
+                        return backtrace.id == sample.backtraceID;
+                    });
+
+                    REQUIRE(backtrace != trace->backtraces.cend());
+
+                    std::vector<instruction_pointer_t> instructionPointers;
+                    for (const auto stackFrameID : backtrace->stackFrameIDs) {
+                        const auto stackFrame = std::find_if(trace->stackFrames.cbegin(), trace->stackFrames.cend(), [stackFrameID](const StackFrame& stackFrame) {
+                            return stackFrame.id == stackFrameID;
+                        });
+
+                        REQUIRE(stackFrame != trace->stackFrames.cend());
+                        instructionPointers.push_back(stackFrame->instructionPointer);
+                    }
+
+                    REQUIRE(instructionPointers == raw_backtraces[i % raw_backtraces.size()]);
+                }
+            }
+        }
+
+        WHEN("Converting it crashes as soon as it starts writing the converted trace.") {
+            const auto [childID, status] = convert_in_cramped_child(path, true);
+
+            THEN("The raw trace is untouched, and the converted one was being written alongside it.") {
+                REQUIRE(WIFSIGNALED(status));
+                REQUIRE(WTERMSIG(status) == SIGXFSZ);
+                REQUIRE(read_bytes(path) == rawBytes);
+                REQUIRE(std::filesystem::is_regular_file(path + "." + std::to_string(childID) + ".tmp"));
+            }
+        }
+
+        WHEN("Converting it fails part way through writing the converted trace.") {
+            const auto [childID, status] = convert_in_cramped_child(path, false);
+
+            THEN("The conversion reports failure, the raw trace is untouched, and the partly converted one is removed.") {
+                REQUIRE(WIFEXITED(status));
+                REQUIRE(WEXITSTATUS(status) == 1);
+                REQUIRE(read_bytes(path) == rawBytes);
+                REQUIRE(std::distance(std::filesystem::directory_iterator(directory), {}) == 1);
+            }
+        }
+
+        WHEN("Something is in the way of the file it would convert it into.") {
+            std::filesystem::create_directory(path + "." + std::to_string(getpid()) + ".tmp");
+
+            const auto traceFile = TraceFile::from_raw(path);
+
+            THEN("The conversion reports failure, and the raw trace is untouched.") {
+                REQUIRE(! traceFile.has_value());
+                REQUIRE(read_bytes(path) == rawBytes);
+            }
+        }
+
+        WHEN("The raw trace is missing.") {
+            std::filesystem::remove(path);
+
+            THEN("The conversion reports failure.") {
+                REQUIRE(! TraceFile::from_raw(path).has_value());
+            }
+        }
+
+        std::filesystem::remove_all(directory);
+    }
+}
@@ -0,0 +1,263 @@
+#include "swimps-intergration-test.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "swimps-trace-file/swimps-trace-file.h"
+
+using namespace swimps::trace;
+
+namespace {
+    //
+    // Gets the names of the functions a sample's backtrace went through, innermost first.
+    // Stack frames that weren't symbolised are named by their instruction pointer.
+    //
+    std::vector<std::string> get_function_names(const Trace& trace, const Sample& sample) {
+        const auto backtrace = std::find_if(trace.backtraces.cbegin(), trace.backtraces.cend(), [&sample](const Backtrace& backtrace) {
+            return backtrace.id == sample.backtraceID;
+        });
+
+        REQUIRE(backtrace != trace.backtraces.cend());
+
+        std::vector<std::string> functionNames;
+        for (const auto stackFrameID : backtrace->stackFrameIDs) {
+            const auto stackFrame = std::find_if(trace.stackFrames.cbegin(), trace.stackFrames.cend(), [stackFrameID](const StackFrame& stackFrame) {
+                return stackFrame.id == stackFrameID;
+            });
+
+            REQUIRE(stackFrame != trace.stackFrames.cend());
+
+            const auto functionName = trace.strings.get(stackFrame->functionName);
+            functionNames.push_back(functionName.empty() ? std::to_string(stackFrame->instructionPointer) : std::string(functionName));
+        }
+
+        return functionNames;
+    }
+
+    //
+    // Writes a trace file from one of the runs of a program. Each run loads it at a different address,
+    // hands out its IDs in a different order, and (on odd runs) calls a function the others don't.
+    //
+    Trace write_run(const std::string& path, const int run) {
+        Trace trace;
+
+        // The runs' strings are interned in different orders, so their IDs differ.
+        if (run % 2 == 0) {
+            trace.strings.intern("main.cpp");
+        }
+
+        const auto mainName = trace.strings.intern("main");
+        const auto workName = trace.strings.intern("work");
+        const auto sourceFilePath = trace.strings.intern("main.cpp");
+        const auto runName = trace.strings.intern("run" + std::to_string(run));
+        const auto threadName = trace.strings.intern("worker");
+
+        const address_t loadAddress = 0x100000 * (run + 1);
+        const stack_frame_id_t firstID = run + 1;
+
+        StackFrame mainStackFrame(firstID, loadAddress + 0x10);
+        mainStackFrame.functionName = mainName;
+        mainStackFrame.sourceFilePath = sourceFilePath;
+        mainStackFrame.offset = 0x10;
+        mainStackFrame.lineNumber = 3;
+
+        StackFrame workStackFrame(firstID + 1, loadAddress + 0x24);
+        workStackFrame.functionName = workName;
+        workStackFrame.sourceFilePath = sourceFilePath;
+        workStackFrame.offset = 0x4;
+        workStackFrame.lineNumber = 9;
+
+        // Even runs have the same unsymbolised stack frame; odd runs have a function of their own instead.
+        StackFrame otherStackFrame(firstID + 2, run % 2 == 0 ? 0x9000 : loadAddress + 0x40);
+        if (run % 2 != 0) {
+            otherStackFrame.functionName = runName;
+        }
+
+        trace.stackFrames = { workStackFrame, mainStackFrame, otherStackFrame };
+
+        Backtrace work;
+        work.id = 1;
+        work.stackFrameIDs = { firstID + 1, firstID };
+        Backtrace justMain;
+        justMain.id = 2;
+        justMain.stackFrameIDs = { firstID };
+        Backtrace other;
+        other.id = 3;
+        other.stackFrameIDs = { firstID + 2, firstID };
+        trace.backtraces = { other, work, justMain };
+
+        for (int i = 0; i < 10 + run; ++i) {
+            Sample sample;
+            sample.backtraceID = 1 + (i + run) % 3;
+            sample.timestamp.seconds = run;
+            sample.timestamp.nanoseconds = i;
+            sample.threadID = 100 + i % 2;
+            trace.samples.push_back(sample);
+        }
+
+        trace.threads = { Thread{ 101, threadName } };
+
+        auto traceFile = TraceFile::create_and_open(path, TraceFile::Permissions::ReadWrite, TraceFile::Format::V2);
+
+        for (const auto& sample : trace.samples) {
+            traceFile.add_sample(sample);
+        }
+
+        for (const auto& backtrace : trace.backtraces) {
+            traceFile.add_backtrace(backtrace);
+        }
+
+        for (const auto& stackFrame : trace.stackFrames) {
+            traceFile.add_stack_frame(stackFrame, trace.strings);
+        }
+
+        for (const auto& thread : trace.threads) {
+            traceFile.add_thread(thread, trace.strings);
+        }
+
+        REQUIRE(traceFile.finalise());
+
+        return trace;
+    }
+}
+
+SCENARIO("swimps::trace::merge_trace_files", "[swimps-trace-file]") {
+    GIVEN("Four trace files from different runs of a program.") {
+        const auto directory = std::filesystem::temp_directory_path() / "swimps-trace-file-merge-test";
+        std::filesystem::remove_all(directory);
+        std::filesystem::create_directories(directory);
+
+        std::vector<std::string> inputPaths;
+        std::vector<Trace> runs;
+        for (int run = 0; run < 4; ++run) {
+            inputPaths.push_back((directory / ("run" + std::to_string(run))).string());
+            runs.push_back(write_run(inputPaths.back(), run));
+        }
+
+        const auto outputPath = (directory / "merged").string();
+
+        WHEN("They are merged on one thread.") {
+            REQUIRE(merge_trace_files(inputPaths, outputPath, TraceFile::Compression::None, 1));
+
+            auto mergedFile = TraceFile::open_existing(outputPath, TraceFile::Permissions::ReadOnly);
+            const auto merged = mergedFile.read_trace();
+            REQUIRE(merged.has_value());
+
+            THEN("Every sample is kept, in order, in the same functions it was taken in.") {
+                std::size_t mergedSample = 0;
+
+                for (const auto& run : runs) {
+                    for (const auto& sample : run.samples) {
+                        REQUIRE(mergedSample < merged->samples.size());
+                        REQUIRE(get_function_names(*merged, merged->samples[mergedSample]) == get_function_names(run, sample));
+                        REQUIRE(merged->samples[mergedSample].timestamp.seconds == sample.timestamp.seconds);
+                        REQUIRE(merged->samples[mergedSample].timestamp.nanoseconds == sample.timestamp.nanoseconds);
+                        mergedSample += 1;
+                    }
+                }
+
+                REQUIRE(mergedSample == merged->samples.size());
+            }
+
+            THEN("Stack frames are matched up by their symbols, and backtraces by their stack frames.") {
+                // main, work, the even runs' unsymbolised stack frame, and each odd run's function.
+                REQUIRE(merged->stackFrames.size() == 5);
+
+                // Through work, just main, through the unsymbolised stack frame, and through each odd run's function.
+                REQUIRE(merged->backtraces.size() == 5);
+            }
+
+            THEN("Each file's threads are kept apart, with their names, and its samples stay on the same threads.") {
+                // Each run's named worker thread, in the order of the runs.
+                REQUIRE(merged->threads.size() == runs.size());
+                for (const auto& thread : merged->threads) {
+                    REQUIRE(merged->strings.get(thread.name) == "worker");
+                }
+
+                std::size_t mergedSample = 0;
+                std::set<thread_id_t> unnamedThreadIDs;
+
+                for (std::size_t run = 0; run < runs.size(); ++run) {
+                    for (const auto& sample : runs[run].samples) {
+                        const auto mergedThreadID = merged->samples[mergedSample++].threadID;
+
+                        if (sample.threadID == 101) {
+                            REQUIRE(mergedThreadID == merged->threads[run].id);
+                        } else {
+                            REQUIRE(mergedThreadID != 0);
+                            REQUIRE(std::none_of(merged->threads.cbegin(), merged->threads.cend(), [mergedThreadID](const Thread& thread) {
+                                return thread.id == mergedThreadID;
+                            }));
+
+                            unnamedThreadIDs.insert(mergedThreadID);
+                        }
+                    }
+                }
+
+                // Thread 100 of each run is a thread of its own.
+                REQUIRE(unnamedThreadIDs.size() == runs.size());
+            }
+
+            for (const std::size_t threadCount : { 2, 3, 4, 8 }) {
+                AND_WHEN("They are merged again on " + std::to_string(threadCount) + " threads.") {
+                    const auto otherOutputPath = (directory / "merged-again").string();
+                    REQUIRE(merge_trace_files(inputPaths, otherOutputPath, TraceFile::Compression::LZ4, threadCount));
+
+                    auto otherMergedFile = TraceFile::open_existing(otherOutputPath, TraceFile::Permissions::ReadOnly);
+                    const auto otherMerged = otherMergedFile.read_trace();
+                    REQUIRE(otherMerged.has_value());
+
+                    THEN("The merged trace is the same.") {
+                        REQUIRE(otherMerged->samples.size() == merged->samples.size());
+                        for (std::size_t i = 0; i < merged->samples.size(); ++i) {
+                            REQUIRE(otherMerged->samples[i].backtraceID == merged->samples[i].backtraceID);
+                            REQUIRE(otherMerged->samples[i].threadID == merged->samples[i].threadID);
+                        }
+
+                        REQUIRE(otherMerged->backtraces.size() == merged->backtraces.size());
+                        for (std::size_t i = 0; i < merged->backtraces.size(); ++i) {
+                            REQUIRE(otherMerged->backtraces[i].id == merged->backtraces[i].id);
+                            REQUIRE(otherMerged->backtraces[i].stackFrameIDs == merged->backtraces[i].stackFrameIDs);
+                        }
+
+                        REQUIRE(otherMerged->stackFrames.size() == merged->stackFrames.size());
+                        for (std::size_t i = 0; i < merged->stackFrames.size(); ++i) {
+                            REQUIRE(otherMerged->stackFrames[i].id == merged->stackFrames[i].id);
+                            REQUIRE(otherMerged->stackFrames[i].instructionPointer == merged->stackFrames[i].instructionPointer);
+                            REQUIRE(otherMerged->strings.get(otherMerged->stackFrames[i].functionName) == merged->strings.get(merged->stackFrames[i].functionName));
+                        }
+                    }
+                }
+            }
+        }
+
+        WHEN("One of them is cut short, and they are merged.") {
+            std::filesystem::resize_file(inputPaths[1], 64);
+
+            const bool merged = merge_trace_files(inputPaths, outputPath, TraceFile::Compression::None, 2);
+
+            THEN("The merge fails, without leaving a merged file (or a half written one) behind.") {
+                REQUIRE(! merged);
+                REQUIRE(! std::filesystem::exists(outputPath));
+                REQUIRE(std::distance(std::filesystem::directory_iterator(directory), {}) == static_cast<std::ptrdiff_t>(inputPaths.size()));
+            }
+        }
+
+        WHEN("Something is in the way of the merged file, and they are merged.") {
+            std::filesystem::create_directories(std::filesystem::path(outputPath) / "in-the-way");
+
+            const bool merged = merge_trace_files(inputPaths, outputPath, TraceFile::Compression::None, 2);
+
+            THEN("The merge fails, and the temporary file is cleaned up.") {
+                REQUIRE(! merged);
+                REQUIRE(std::filesystem::is_directory(outputPath));
+                REQUIRE(std::distance(std::filesystem::directory_iterator(directory), {}) == static_cast<std::ptrdiff_t>(inputPaths.size() + 1));
+            }
+        }
+
+        std::filesystem::remove_all(directory);
+    }
+}
@@ -0,0 +1,119 @@
+#include "swimps-intergration-test.h"
+
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <vector>
+
+#include "swimps-trace-file/swimps-trace-file.h"
+
+using namespace swimps::trace;
+
+SCENARIO("swimps::trace::TraceFile::read_trace", "[swimps-trace-file]") {
+    GIVEN("A trace file containing a sample, a backtrace and a stack frame.") {
+        const auto path = (std::filesystem::temp_directory_path() / "swimps-trace-file-read-trace-test").string();
+
+        Sample writtenSample;
+        writtenSample.backtraceID = 3;
+        writtenSample.timestamp.seconds = 12;
+        writtenSample.timestamp.nanoseconds = 345;
+
+        Backtrace writtenBacktrace;
+        writtenBacktrace.id = 3;
+        writtenBacktrace.stackFrameIDs = { 4, 5, 6 };
+
+        StringTable writtenStrings;
+        StackFrame writtenStackFrame(4, 0x1234);
+        writtenStackFrame.functionName = writtenStrings.intern("main");
+        writtenStackFrame.sourceFilePath = writtenStrings.intern("main.cpp");
+        writtenStackFrame.lineNumber = 7;
+        writtenStackFrame.offset = 16;
+
+        {
+            auto traceFile = TraceFile::create_and_open(path, TraceFile::Permissions::ReadWrite);
+            traceFile.add_sample(writtenSample);
+            traceFile.add_backtrace(writtenBacktrace);
+            traceFile.add_stack_frame(writtenStackFrame, writtenStrings);
+        }
+
+        auto traceFile = TraceFile::open_existing(path, TraceFile::Permissions::ReadOnly);
+
+        for (const auto readMode : { TraceFile::ReadMode::Sequential, TraceFile::ReadMode::Mapped, TraceFile::ReadMode::Parallel }) {
+            WHEN("It is read in mode " + std::to_string(static_cast<int>(readMode)) + ".") {
+                const auto trace = traceFile.read_trace(readMode);
+
+                THEN("The written entries are read back.") {
+                    REQUIRE(trace.has_value());
+
+                    REQUIRE(trace->samples.size() == 1);
+                    REQUIRE(trace->samples[0].backtraceID == writtenSample.backtraceID);
+                    REQUIRE(trace->samples[0].timestamp.seconds == writtenSample.timestamp.seconds);
+                    REQUIRE(trace->samples[0].timestamp.nanoseconds == writtenSample.timestamp.nanoseconds);
+
+                    REQUIRE(trace->backtraces.size() == 1);
+                    REQUIRE(trace->backtraces[0].id == writtenBacktrace.id);
+                    REQUIRE(trace->backtraces[0].stackFrameIDs == writtenBacktrace.stackFrameIDs);
+
+                    REQUIRE(trace->stackFrames.size() == 1);
+                    REQUIRE(trace->stackFrames[0].id == writtenStackFrame.id);
+                    REQUIRE(trace->stackFrames[0].instructionPointer == writtenStackFrame.instructionPointer);
+                    REQUIRE(trace->stackFrames[0].offset == writtenStackFrame.offset);
+                    REQUIRE(trace->stackFrames[0].lineNumber == writtenStackFrame.lineNumber);
+                    REQUIRE(trace->strings.get(trace->stackFrames[0].functionName) == "main");
+                    REQUIRE(trace->strings.get(trace->stackFrames[0].sourceFilePath) == "main.cpp");
+                }
+            }
+        }
+
+        std::filesystem::remove(path);
+    }
+
+    GIVEN("An older v1 trace file, with the profiled process' memory maps before its entries.") {
+        const auto path = (std::filesystem::temp_directory_path() / "swimps-trace-file-read-trace-memory-maps-test").string();
+
+        Sample writtenSample;
+        writtenSample.backtraceID = 3;
+        writtenSample.timestamp.seconds = 12;
+        writtenSample.timestamp.nanoseconds = 345;
+
+        {
+            auto traceFile = TraceFile::create_and_open(path, TraceFile::Permissions::ReadWrite);
+            traceFile.add_sample(writtenSample);
+        }
+
+        // The memory maps go straight after the file marker: a count, then each map's start and end address.
+        {
+            std::ifstream writtenFile(path, std::ios_base::in | std::ios_base::binary);
+            std::vector<char> bytes{ std::istreambuf_iterator<char>(writtenFile), {} };
+            writtenFile.close();
+
+            constexpr char memoryMapsMarker[] = "\npm!\n";
+            const std::uint64_t memoryMaps[] = { 2, 0x1000, 0x2000, 0x3000, 0x4000 };
+
+            std::vector<char> memoryMapsEntry(memoryMapsMarker, memoryMapsMarker + sizeof memoryMapsMarker);
+            memoryMapsEntry.insert(memoryMapsEntry.end(), reinterpret_cast<const char*>(memoryMaps), reinterpret_cast<const char*>(memoryMaps) + sizeof memoryMaps);
+            bytes.insert(bytes.begin() + sizeof memoryMapsMarker, memoryMapsEntry.cbegin(), memoryMapsEntry.cend());
+
+            std::ofstream rewrittenFile(path, std::ios_base::out | std::ios_base::binary | std::ios_base::trunc);
+            rewrittenFile.write(bytes.data(), static_cast<std::streamsize>(bytes.size()));
+        }
+
+        auto traceFile = TraceFile::open_existing(path, TraceFile::Permissions::ReadOnly);
+
+        for (const auto readMode : { TraceFile::ReadMode::Sequential, TraceFile::ReadMode::Mapped, TraceFile::ReadMode::Parallel }) {
+            WHEN("It is read in mode " + std::to_string(static_cast<int>(readMode)) + ".") {
+                const auto trace = traceFile.read_trace(readMode);
+
+                THEN("The memory maps are skipped, and the entries after them are read.") {
+                    REQUIRE(trace.has_value());
+                    REQUIRE(trace->samples.size() == 1);
+                    REQUIRE(trace->samples[0].backtraceID == writtenSample.backtraceID);
+                    REQUIRE(trace->samples[0].timestamp.seconds == writtenSample.timestamp.seconds);
+                }
+            }
+        }
+
+        std::filesystem::remove(path);
+    }
+}
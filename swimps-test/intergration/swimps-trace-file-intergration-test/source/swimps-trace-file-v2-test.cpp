@@ -0,0 +1,495 @@
+#include "swimps-intergration-test.h"
+
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+
+#include "swimps-trace-file/swimps-trace-file.h"
+
+using namespace swimps::trace;
+
+SCENARIO("swimps::trace::TraceFile::Format::V2", "[swimps-trace-file]") {
+    GIVEN("A finalised v2 trace file containing samples, backtraces, stack frames and threads.") {
+        const auto path = (std::filesystem::temp_directory_path() / "swimps-trace-file-v2-test").string();
+
+        {
+            auto traceFile = TraceFile::create_and_open(path, TraceFile::Permissions::ReadWrite, TraceFile::Format::V2);
+
+            for (backtrace_id_t backtraceID = 1; backtraceID <= 4; ++backtraceID) {
+                Sample sample;
+                sample.backtraceID = backtraceID;
+                sample.timestamp.seconds = backtraceID * 10;
+                sample.threadID = static_cast<thread_id_t>(1000 + backtraceID % 2);
+                traceFile.add_sample(sample);
+
+                Backtrace backtrace;
+                backtrace.id = backtraceID;
+                backtrace.stackFrameIDs = { backtraceID, backtraceID + 1 };
+                traceFile.add_backtrace(backtrace);
+            }
+
+            StringTable strings;
+            for (stack_frame_id_t stackFrameID = 1; stackFrameID <= 5; ++stackFrameID) {
+                StackFrame stackFrame(stackFrameID, 0x1000 + stackFrameID);
+                stackFrame.functionName = strings.intern("function");
+                stackFrame.sourceFilePath = strings.intern("function.cpp");
+                traceFile.add_stack_frame(stackFrame, strings);
+            }
+
+            traceFile.add_thread({ 1000, strings.intern("main") }, strings);
+            traceFile.add_thread({ 1001, strings.intern("worker") }, strings);
+
+            REQUIRE(traceFile.finalise());
+        }
+
+        WHEN("It is opened.") {
+            auto traceFile = TraceFile::open_existing(path, TraceFile::Permissions::ReadOnly);
+
+            THEN("It is detected as v2, with a section per kind of entry.") {
+                REQUIRE(traceFile.get_format() == TraceFile::Format::V2);
+
+                const auto& sections = traceFile.get_sections();
+                REQUIRE(sections.size() == TraceFile::section_kind_count);
+                REQUIRE(sections[0].kind == TraceFile::SectionKind::Samples);
+                REQUIRE(sections[0].entryCount == 4);
+                REQUIRE(sections[1].kind == TraceFile::SectionKind::Backtraces);
+                REQUIRE(sections[1].entryCount == 4);
+                REQUIRE(sections[2].kind == TraceFile::SectionKind::StackFrames);
+                REQUIRE(sections[2].entryCount == 5);
+                REQUIRE(sections[3].kind == TraceFile::SectionKind::Strings);
+                REQUIRE(sections[3].entryCount == 5); // the empty string, "function", "function.cpp", "main" and "worker"
+                REQUIRE(sections[4].kind == TraceFile::SectionKind::Threads);
+                REQUIRE(sections[4].entryCount == 2);
+            }
+
+            THEN("Its threads are loaded, with their names.") {
+                const auto& threads = traceFile.get_threads();
+                REQUIRE(threads.size() == 2);
+                REQUIRE(threads[1].id == 1001);
+                REQUIRE(traceFile.get_strings().get(threads[1].name) == "worker");
+            }
+
+            for (const auto readMode : { TraceFile::ReadMode::Sequential, TraceFile::ReadMode::Mapped, TraceFile::ReadMode::Parallel }) {
+                AND_WHEN("The whole trace is read in mode " + std::to_string(static_cast<int>(readMode)) + ".") {
+                    const auto trace = traceFile.read_trace(readMode);
+
+                    THEN("Every entry is read back.") {
+                        REQUIRE(trace.has_value());
+                        REQUIRE(trace->samples.size() == 4);
+                        REQUIRE(trace->samples[3].backtraceID == 4);
+                        REQUIRE(trace->samples[3].timestamp.seconds == 40);
+                        REQUIRE(trace->samples[3].threadID == 1000);
+                        REQUIRE(trace->samples[2].threadID == 1001);
+                        REQUIRE(trace->backtraces.size() == 4);
+                        REQUIRE(trace->backtraces[2].stackFrameIDs == std::vector<stack_frame_id_t>{ 3, 4 });
+                        REQUIRE(trace->stackFrames.size() == 5);
+                        REQUIRE(trace->stackFrames[4].instructionPointer == 0x1005);
+                        REQUIRE(trace->strings.get(trace->stackFrames[4].functionName) == "function");
+                        REQUIRE(trace->strings.get(trace->stackFrames[4].sourceFilePath) == "function.cpp");
+                        REQUIRE(trace->threads.size() == 2);
+                        REQUIRE(trace->strings.get(trace->threads[0].name) == "main");
+                    }
+                }
+
+                AND_WHEN("Only the stack frames are read in mode " + std::to_string(static_cast<int>(readMode)) + ".") {
+                    TraceSelection selection;
+                    selection.samples = false;
+                    selection.backtraces = false;
+
+                    const auto trace = traceFile.read_trace(readMode, selection);
+
+                    THEN("Only the stack frames are present.") {
+                        REQUIRE(trace.has_value());
+                        REQUIRE(trace->samples.empty());
+                        REQUIRE(trace->backtraces.empty());
+                        REQUIRE(trace->stackFrames.size() == 5);
+                    }
+                }
+            }
+
+            AND_WHEN("It is read entry by entry.") {
+                std::size_t sampleCount = 0;
+                std::size_t backtraceCount = 0;
+                std::size_t stackFrameCount = 0;
+                std::vector<thread_id_t> threadIDs;
+
+                for (auto entry = traceFile.read_next_entry();
+                     ! std::holds_alternative<swimps::error::ErrorCode>(entry);
+                     entry = traceFile.read_next_entry()) {
+                    if (const auto* const sample = std::get_if<Sample>(&entry)) {
+                        threadIDs.push_back(sample->threadID);
+                    }
+
+                    sampleCount += std::holds_alternative<Sample>(entry);
+                    backtraceCount += std::holds_alternative<Backtrace>(entry);
+                    stackFrameCount += std::holds_alternative<StackFrame>(entry);
+                }
+
+                THEN("Every entry is visited, followed by the end of the file.") {
+                    REQUIRE(sampleCount == 4);
+                    REQUIRE(threadIDs == std::vector<thread_id_t>{ 1001, 1000, 1001, 1000 });
+                    REQUIRE(backtraceCount == 4);
+                    REQUIRE(stackFrameCount == 5);
+                    REQUIRE(std::get<swimps::error::ErrorCode>(traceFile.read_next_entry()) == swimps::error::ErrorCode::EndOfFile);
+                }
+            }
+        }
+
+        std::filesystem::remove(path);
+    }
+}
+
+SCENARIO("swimps::trace::TraceFile::SectionEncoding::Compact", "[swimps-trace-file]") {
+    GIVEN("A v2 trace file holding a second of 10kHz samples across eight threads, some of which go back in time.") {
+        const auto path = (std::filesystem::temp_directory_path() / "swimps-trace-file-v2-compact-test").string();
+
+        constexpr std::int64_t sampleCount = 10'000;
+        std::vector<Sample> writtenSamples;
+
+        {
+            auto traceFile = TraceFile::create_and_open(path, TraceFile::Permissions::ReadWrite, TraceFile::Format::V2);
+
+            for (std::int64_t i = 0; i < sampleCount; ++i) {
+                Sample sample;
+                sample.backtraceID = 1 + (i % 300);
+                sample.timestamp.seconds = 1'000'000 + (i / 10'000);
+                sample.timestamp.nanoseconds = (i % 10'000) * 100'000 - (i % 7 == 0 ? 50'000 : 0);
+                sample.threadID = static_cast<thread_id_t>(4'000'000 + (i % 8));
+                traceFile.add_sample(sample);
+                writtenSamples.push_back(sample);
+            }
+
+            Backtrace backtrace;
+            backtrace.id = 300;
+            backtrace.stackFrameIDs = { 1, 200, 40'000, 3 };
+            traceFile.add_backtrace(backtrace);
+
+            REQUIRE(traceFile.finalise());
+        }
+
+        WHEN("It is read back.") {
+            auto traceFile = TraceFile::open_existing(path, TraceFile::Permissions::ReadOnly);
+            const auto trace = traceFile.read_trace();
+
+            THEN("The samples and backtraces sections are compact.") {
+                const auto& samplesSection = traceFile.get_sections()[0];
+                REQUIRE(samplesSection.encoding == TraceFile::SectionEncoding::CompactWithThreads);
+                REQUIRE(traceFile.get_sections()[1].encoding == TraceFile::SectionEncoding::Compact);
+
+                AND_THEN("Each sample takes at most a fifth of its 34 bytes of fixed width fields (its 30 byte v1 size, and its thread ID).") {
+                    REQUIRE(samplesSection.size * 5 <= samplesSection.entryCount * 34);
+                }
+            }
+
+            THEN("Every sample and backtrace round trips exactly.") {
+                REQUIRE(trace.has_value());
+                REQUIRE(trace->samples.size() == writtenSamples.size());
+
+                for (std::size_t i = 0; i < writtenSamples.size(); ++i) {
+                    REQUIRE(trace->samples[i].backtraceID == writtenSamples[i].backtraceID);
+                    REQUIRE(trace->samples[i].timestamp.seconds == writtenSamples[i].timestamp.seconds);
+                    REQUIRE(trace->samples[i].timestamp.nanoseconds == writtenSamples[i].timestamp.nanoseconds);
+                    REQUIRE(trace->samples[i].threadID == writtenSamples[i].threadID);
+                }
+
+                REQUIRE(trace->backtraces.size() == 1);
+                REQUIRE(trace->backtraces[0].id == 300);
+                REQUIRE(trace->backtraces[0].stackFrameIDs == std::vector<stack_frame_id_t>{ 1, 200, 40'000, 3 });
+            }
+        }
+
+        std::filesystem::remove(path);
+    }
+}
+
+SCENARIO("swimps::trace::TraceFile::Compression::LZ4", "[swimps-trace-file]") {
+    GIVEN("The same entries written to an uncompressed and an LZ4 compressed v2 trace file, spanning several blocks.") {
+        const auto uncompressedPath = (std::filesystem::temp_directory_path() / "swimps-trace-file-v2-uncompressed-test").string();
+        const auto compressedPath = (std::filesystem::temp_directory_path() / "swimps-trace-file-v2-lz4-test").string();
+
+        for (const auto compression : { TraceFile::Compression::None, TraceFile::Compression::LZ4 }) {
+            const auto& path = compression == TraceFile::Compression::None ? uncompressedPath : compressedPath;
+            auto traceFile = TraceFile::create_and_open(path, TraceFile::Permissions::ReadWrite, TraceFile::Format::V2, compression);
+
+            for (std::int64_t i = 0; i < 300'000; ++i) {
+                Sample sample;
+                sample.backtraceID = 1 + (i % 50);
+                sample.timestamp.seconds = i / 10'000;
+                sample.timestamp.nanoseconds = (i % 10'000) * 100'000;
+                traceFile.add_sample(sample);
+            }
+
+            for (backtrace_id_t id = 1; id <= 50; ++id) {
+                Backtrace backtrace;
+                backtrace.id = id;
+                backtrace.stackFrameIDs = { id, id + 1, id + 2 };
+                traceFile.add_backtrace(backtrace);
+            }
+
+            StringTable strings;
+            for (stack_frame_id_t id = 1; id <= 30'000; ++id) {
+                StackFrame stackFrame(id, 0x1000 + id);
+                stackFrame.functionName = strings.intern("swimps::some_namespace::some_function_" + std::to_string(id));
+                traceFile.add_stack_frame(stackFrame, strings);
+            }
+
+            REQUIRE(traceFile.finalise());
+        }
+
+        auto uncompressedFile = TraceFile::open_existing(uncompressedPath, TraceFile::Permissions::ReadOnly);
+        auto compressedFile = TraceFile::open_existing(compressedPath, TraceFile::Permissions::ReadOnly);
+
+        THEN("The compression is recorded in the files.") {
+            REQUIRE(uncompressedFile.get_compression() == TraceFile::Compression::None);
+            REQUIRE(compressedFile.get_compression() == TraceFile::Compression::LZ4);
+        }
+
+        THEN("The sections are split into the same blocks, and the large compressed ones are smaller.") {
+            const auto& uncompressedSections = uncompressedFile.get_sections();
+            const auto& compressedSections = compressedFile.get_sections();
+            REQUIRE(uncompressedSections.size() == compressedSections.size());
+
+            for (std::size_t i = 0; i < uncompressedSections.size(); ++i) {
+                REQUIRE(uncompressedSections[i].blocks.size() == compressedSections[i].blocks.size());
+                REQUIRE(compressedSections[i].size <= uncompressedSections[i].size);
+            }
+
+            REQUIRE(compressedSections[0].blocks.size() > 1);
+            REQUIRE(compressedSections[0].size < uncompressedSections[0].size);
+            REQUIRE(compressedSections[3].blocks.size() > 1);
+            REQUIRE(compressedSections[3].size < uncompressedSections[3].size);
+        }
+
+        for (const auto readMode : { TraceFile::ReadMode::Sequential, TraceFile::ReadMode::Mapped, TraceFile::ReadMode::Parallel }) {
+            WHEN("Both are read in mode " + std::to_string(static_cast<int>(readMode)) + ".") {
+                const auto uncompressedTrace = uncompressedFile.read_trace(readMode);
+                const auto compressedTrace = compressedFile.read_trace(readMode);
+
+                THEN("They hold the same entries.") {
+                    REQUIRE(uncompressedTrace.has_value());
+                    REQUIRE(compressedTrace.has_value());
+
+                    REQUIRE(uncompressedTrace->samples.size() == 300'000);
+                    REQUIRE(compressedTrace->samples.size() == uncompressedTrace->samples.size());
+                    for (std::size_t i = 0; i < uncompressedTrace->samples.size(); ++i) {
+                        REQUIRE(compressedTrace->samples[i].backtraceID == uncompressedTrace->samples[i].backtraceID);
+                        REQUIRE(compressedTrace->samples[i].timestamp.seconds == uncompressedTrace->samples[i].timestamp.seconds);
+                        REQUIRE(compressedTrace->samples[i].timestamp.nanoseconds == uncompressedTrace->samples[i].timestamp.nanoseconds);
+                    }
+
+                    REQUIRE(compressedTrace->backtraces.size() == 50);
+                    for (std::size_t i = 0; i < compressedTrace->backtraces.size(); ++i) {
+                        REQUIRE(compressedTrace->backtraces[i].id == uncompressedTrace->backtraces[i].id);
+                        REQUIRE(compressedTrace->backtraces[i].stackFrameIDs == uncompressedTrace->backtraces[i].stackFrameIDs);
+                    }
+
+                    REQUIRE(compressedTrace->stackFrames.size() == 30'000);
+                    for (std::size_t i = 0; i < compressedTrace->stackFrames.size(); ++i) {
+                        REQUIRE(compressedTrace->stackFrames[i].isSameAs(uncompressedTrace->stackFrames[i]));
+                    }
+                }
+            }
+        }
+
+        WHEN("The compressed file is walked entry by entry.") {
+            std::size_t entryCount = 0;
+            auto entry = compressedFile.read_next_entry();
+            for (; ! std::holds_alternative<swimps::error::ErrorCode>(entry); entry = compressedFile.read_next_entry()) {
+                ++entryCount;
+            }
+
+            THEN("Every entry is visited, followed by the end of the file.") {
+                REQUIRE(entryCount == 300'000 + 50 + 30'000);
+                REQUIRE(std::get<swimps::error::ErrorCode>(entry) == swimps::error::ErrorCode::EndOfFile);
+            }
+        }
+
+        std::filesystem::remove(uncompressedPath);
+        std::filesystem::remove(compressedPath);
+    }
+}
+
+SCENARIO("swimps::trace::TraceFile::Block", "[swimps-trace-file]") {
+    GIVEN("A v2 trace file being written with its samples and stack frames added in turn, enough to fill several blocks of each.") {
+        const auto path = (std::filesystem::temp_directory_path() / "swimps-trace-file-v2-block-test").string();
+
+        constexpr std::int64_t stackFrameCount = 200'000;
+        StringTable strings;
+
+        auto traceFile = TraceFile::create_and_open(path, TraceFile::Permissions::ReadWrite, TraceFile::Format::V2, TraceFile::Compression::LZ4);
+
+        for (std::int64_t i = 0; i < stackFrameCount; ++i) {
+            for (std::int64_t j = 0; j < 2; ++j) {
+                Sample sample;
+                sample.backtraceID = 1 + ((i + j) % 50);
+                sample.timestamp.seconds = i / 5'000;
+                sample.timestamp.nanoseconds = (i % 5'000) * 200'000 + j;
+                sample.threadID = static_cast<thread_id_t>(100 + j);
+                traceFile.add_sample(sample);
+            }
+
+            StackFrame stackFrame(i + 1, 0x400000 + i * 16);
+            stackFrame.lineNumber = static_cast<line_number_t>(i % 1000);
+            traceFile.add_stack_frame(stackFrame, strings);
+        }
+
+        THEN("Blocks are written out as they fill, before the file is finalised.") {
+            REQUIRE(std::filesystem::file_size(path) >= 1024 * 1024);
+        }
+
+        WHEN("It is finalised and opened.") {
+            REQUIRE(traceFile.finalise());
+
+            auto openedFile = TraceFile::open_existing(path, TraceFile::Permissions::ReadOnly);
+            const auto& sections = openedFile.get_sections();
+
+            THEN("The samples' and stack frames' blocks are interleaved, each where the section table says it is.") {
+                REQUIRE(sections[0].blocks.size() > 1);
+                REQUIRE(sections[2].blocks.size() > 1);
+                REQUIRE(sections[2].blocks.front().offset < sections[0].blocks.back().offset);
+                REQUIRE(sections[0].blocks.front().offset < sections[2].blocks.back().offset);
+            }
+
+            THEN("Every entry is read back.") {
+                const auto trace = openedFile.read_trace();
+                REQUIRE(trace.has_value());
+                REQUIRE(trace->samples.size() == stackFrameCount * 2);
+                REQUIRE(trace->samples.back().timestamp.nanoseconds == ((stackFrameCount - 1) % 5'000) * 200'000 + 1);
+                REQUIRE(trace->samples.back().threadID == 101);
+                REQUIRE(trace->stackFrames.size() == stackFrameCount);
+
+                for (std::int64_t i = 0; i < stackFrameCount; ++i) {
+                    REQUIRE(trace->stackFrames[i].id == i + 1);
+                    REQUIRE(trace->stackFrames[i].instructionPointer == static_cast<address_t>(0x400000 + i * 16));
+                }
+            }
+        }
+
+        std::filesystem::remove(path);
+    }
+}
+
+SCENARIO("swimps::trace::TraceFile::read_trace, given a damaged v2 trace file", "[swimps-trace-file]") {
+    GIVEN("A v2 trace file, opened and then cut short so that its blocks are missing.") {
+        const auto path = (std::filesystem::temp_directory_path() / "swimps-trace-file-v2-truncated-test").string();
+
+        {
+            auto traceFile = TraceFile::create_and_open(path, TraceFile::Permissions::ReadWrite, TraceFile::Format::V2);
+
+            for (std::int64_t i = 0; i < 100'000; ++i) {
+                Sample sample;
+                sample.backtraceID = 1 + (i % 10);
+                sample.timestamp.nanoseconds = i;
+                traceFile.add_sample(sample);
+            }
+
+            REQUIRE(traceFile.finalise());
+        }
+
+        auto traceFile = TraceFile::open_existing(path, TraceFile::Permissions::ReadOnly);
+        std::filesystem::resize_file(path, 64);
+
+        for (const auto readMode : { TraceFile::ReadMode::Sequential, TraceFile::ReadMode::Mapped, TraceFile::ReadMode::Parallel }) {
+            WHEN("It is read in mode " + std::to_string(static_cast<int>(readMode)) + ".") {
+                const auto trace = traceFile.read_trace(readMode);
+
+                THEN("Reading it fails, rather than reading beyond the end of the file.") {
+                    REQUIRE(! trace.has_value());
+                }
+            }
+        }
+
+        std::filesystem::remove(path);
+    }
+}
+
+namespace {
+    //
+    // Overwrites part of a file in place.
+    //
+    template <typename T>
+    void overwrite(const std::string& path, const std::streamoff offset, const T& value) {
+        std::fstream file(path, std::ios_base::in | std::ios_base::out | std::ios_base::binary);
+        REQUIRE(file.is_open());
+        file.seekp(offset);
+        file.write(reinterpret_cast<const char*>(&value), sizeof value);
+        REQUIRE(file.good());
+    }
+
+    std::uint64_t read_section_table_offset(const std::string& path) {
+        // The footer is the section table's offset, the number of sections, and a marker.
+        std::ifstream file(path, std::ios_base::in | std::ios_base::binary);
+        file.seekg(-static_cast<std::streamoff>(sizeof(std::uint64_t) + sizeof(std::uint32_t) + 6), std::ios_base::end);
+
+        std::uint64_t sectionTableOffset = 0;
+        file.read(reinterpret_cast<char*>(&sectionTableOffset), sizeof sectionTableOffset);
+        REQUIRE(file.good());
+        return sectionTableOffset;
+    }
+}
+
+SCENARIO("swimps::trace::TraceFile::try_open_existing, given a damaged v2 trace file", "[swimps-trace-file]") {
+    GIVEN("A finalised v2 trace file.") {
+        const auto path = (std::filesystem::temp_directory_path() / "swimps-trace-file-v2-damaged-test").string();
+
+        {
+            auto traceFile = TraceFile::create_and_open(path, TraceFile::Permissions::ReadWrite, TraceFile::Format::V2);
+
+            for (std::int64_t i = 0; i < 1000; ++i) {
+                Sample sample;
+                sample.backtraceID = 1 + (i % 10);
+                sample.timestamp.nanoseconds = i;
+                traceFile.add_sample(sample);
+            }
+
+            REQUIRE(traceFile.finalise());
+        }
+
+        THEN("It opens.") {
+            REQUIRE(TraceFile::try_open_existing(path, TraceFile::Permissions::ReadOnly).has_value());
+        }
+
+        WHEN("It is cut short.") {
+            std::filesystem::resize_file(path, 64);
+
+            THEN("It doesn't open, since its footer is missing.") {
+                REQUIRE(! TraceFile::try_open_existing(path, TraceFile::Permissions::ReadOnly).has_value());
+            }
+        }
+
+        WHEN("Its compression is overwritten with one that doesn't exist.") {
+            overwrite(path, 6, std::uint32_t{ 7 });
+
+            THEN("It doesn't open.") {
+                REQUIRE(! TraceFile::try_open_existing(path, TraceFile::Permissions::ReadOnly).has_value());
+            }
+        }
+
+        WHEN("Its first section claims far more entries than its blocks could hold.") {
+            // Each section starts with its kind and encoding, then its entry count.
+            overwrite(path, static_cast<std::streamoff>(read_section_table_offset(path) + 2 * sizeof(std::uint32_t)), std::uint64_t{ 1 } << 40);
+
+            THEN("It doesn't open.") {
+                REQUIRE(! TraceFile::try_open_existing(path, TraceFile::Permissions::ReadOnly).has_value());
+            }
+        }
+
+        WHEN("Its marker is overwritten.") {
+            overwrite(path, 0, std::uint32_t{ 0 });
+
+            THEN("It doesn't open.") {
+                REQUIRE(! TraceFile::try_open_existing(path, TraceFile::Permissions::ReadOnly).has_value());
+            }
+        }
+
+        WHEN("It is removed.") {
+            std::filesystem::remove(path);
+
+            THEN("It doesn't open.") {
+                REQUIRE(! TraceFile::try_open_existing(path, TraceFile::Permissions::ReadOnly).has_value());
+            }
+        }
+
+        std::filesystem::remove(path);
+    }
+}
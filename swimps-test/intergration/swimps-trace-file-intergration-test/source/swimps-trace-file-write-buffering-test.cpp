@@ -0,0 +1,47 @@
+#include "swimps-intergration-test.h"
+
+#include <filesystem>
+
+#include "swimps-trace-file/swimps-trace-file.h"
+
+using namespace swimps::trace;
+
+SCENARIO("swimps::trace::TraceFile::enable_write_buffering, "
+         "swimps::trace::TraceFile::flush", "[swimps-trace-file]") {
+    GIVEN("A trace file with write buffering enabled.") {
+        const auto path = (std::filesystem::temp_directory_path() / "swimps-trace-file-write-buffering-test").string();
+
+        auto traceFile = TraceFile::create_and_open(path, TraceFile::Permissions::ReadWrite);
+        traceFile.enable_write_buffering();
+
+        const auto sizeBeforeAdding = std::filesystem::file_size(path);
+
+        WHEN("Samples are added to it.") {
+            for (backtrace_id_t backtraceID = 1; backtraceID <= 3; ++backtraceID) {
+                Sample sample;
+                sample.backtraceID = backtraceID;
+                traceFile.add_sample(sample);
+            }
+
+            THEN("Nothing reaches the file until it is flushed.") {
+                REQUIRE(std::filesystem::file_size(path) == sizeBeforeAdding);
+                REQUIRE(traceFile.flush());
+                REQUIRE(std::filesystem::file_size(path) > sizeBeforeAdding);
+            }
+
+            AND_WHEN("The trace is read back.") {
+                const auto trace = traceFile.read_trace();
+
+                THEN("All of the samples are present, in order.") {
+                    REQUIRE(trace.has_value());
+                    REQUIRE(trace->samples.size() == 3);
+                    for (std::size_t i = 0; i < trace->samples.size(); ++i) {
+                        REQUIRE(trace->samples[i].backtraceID == static_cast<backtrace_id_t>(i + 1));
+                    }
+                }
+            }
+        }
+
+        std::filesystem::remove(path);
+    }
+}
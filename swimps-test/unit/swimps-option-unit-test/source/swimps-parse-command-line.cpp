@@ -222,6 +222,86 @@ SCENARIO("swimps::option::parse_command_line", "[swimps-option]") {
         }
     }
 
+    GIVEN("A flat profile option.") {
+        MockArguments<3> args({
+            "/fake/path/swimps",
+            "--flat-profile",
+            "dummy"
+        });
+
+        WHEN("It is parsed.") {
+            const auto maybeOptions = option::parse_command_line(
+                args.argc(),
+                args.argv()
+            );
+
+            THEN("parsing succeeds.") {
+                REQUIRE(maybeOptions.has_value());
+
+                AND_THEN("The flat profile option is set accordingly.") {
+                    REQUIRE(maybeOptions->flatProfile);
+                }
+            }
+        }
+    }
+
+    GIVEN("A diff of two trace files.") {
+        MockArguments<5> args({
+            "/fake/path/swimps",
+            "--no-tui",
+            "diff",
+            "baseline-trace",
+            "candidate-trace"
+        });
+
+        WHEN("It is parsed.") {
+            const auto maybeOptions = option::parse_command_line(
+                args.argc(),
+                args.argv()
+            );
+
+            THEN("parsing succeeds.") {
+                REQUIRE(maybeOptions.has_value());
+
+                AND_THEN("The trace files are loaded rather than a program profiled.") {
+                    REQUIRE(maybeOptions->load);
+                    REQUIRE(! maybeOptions->tui);
+                    REQUIRE(maybeOptions->diffBaselineTraceFile == "baseline-trace");
+                    REQUIRE(maybeOptions->targetTraceFile == "candidate-trace");
+                    REQUIRE(maybeOptions->targetProgram.empty());
+                }
+            }
+        }
+    }
+
+    GIVEN("A merge of trace files.") {
+        MockArguments<5> args({
+            "/fake/path/swimps",
+            "merge",
+            "merged-trace",
+            "first-trace",
+            "second-trace"
+        });
+
+        WHEN("It is parsed.") {
+            const auto maybeOptions = option::parse_command_line(
+                args.argc(),
+                args.argv()
+            );
+
+            THEN("parsing succeeds.") {
+                REQUIRE(maybeOptions.has_value());
+
+                AND_THEN("The trace files are merged into the target trace file, which is then loaded.") {
+                    REQUIRE(maybeOptions->load);
+                    REQUIRE(maybeOptions->targetTraceFile == "merged-trace");
+                    REQUIRE(maybeOptions->mergeTraceFiles == std::vector<std::string>{ "first-trace", "second-trace" });
+                    REQUIRE(maybeOptions->targetProgram.empty());
+                }
+            }
+        }
+    }
+
     GIVEN("An invalid option value." ) {
         MockArguments<3> args({
             "/fake/path/swimps",
@@ -0,0 +1,41 @@
+#include "swimps-unit-test.h"
+#include "swimps-symbol/swimps-symbol.h"
+
+using swimps::symbol::MemoryMap;
+
+SCENARIO("swimps::symbol::parse_memory_maps", "[swimps-symbol]") {
+    GIVEN("The contents of a /proc/<pid>/maps file.") {
+        constexpr std::string_view maps =
+            "55d4c3a00000-55d4c3a02000 r--p 00000000 fd:01 1835024                    /usr/bin/swimps-dummy\n"
+            "55d4c3a02000-55d4c3a05000 r-xp 00002000 fd:01 1835024                    /usr/bin/swimps-dummy\n"
+            "55d4c4e3c000-55d4c4e5d000 rw-p 00000000 00:00 0                          [heap]\n"
+            "7f2c4a1d1000-7f2c4a366000 r-xp 00028000 fd:01 1844371                    /usr/lib/x86_64-linux-gnu/libc.so.6\n"
+            "7f2c4a400000-7f2c4a401000 r-xp 00001000 fd:01 1844372                    /opt/my app/libplugin.so\n"
+            "7ffd5e7b1000-7ffd5e7b3000 r-xp 00000000 00:00 0                          [vdso]\n"
+            "this line is not a memory map\n";
+
+        WHEN("It is parsed.") {
+            const auto memoryMaps = swimps::symbol::parse_memory_maps(maps);
+
+            THEN("Only the executable, file backed memory maps are kept.") {
+                REQUIRE(memoryMaps.size() == 3);
+
+                REQUIRE(memoryMaps[0].start == 0x55d4c3a02000);
+                REQUIRE(memoryMaps[0].end == 0x55d4c3a05000);
+                REQUIRE(memoryMaps[0].fileOffset == 0x2000);
+                REQUIRE(memoryMaps[0].path == "/usr/bin/swimps-dummy");
+
+                REQUIRE(memoryMaps[1].path == "/usr/lib/x86_64-linux-gnu/libc.so.6");
+                REQUIRE(memoryMaps[2].path == "/opt/my app/libplugin.so");
+            }
+
+            AND_WHEN("The memory maps are formatted, then parsed again.") {
+                const auto reparsedMemoryMaps = swimps::symbol::parse_memory_maps(swimps::symbol::format_memory_maps(memoryMaps));
+
+                THEN("They are unchanged.") {
+                    REQUIRE(reparsedMemoryMaps == memoryMaps);
+                }
+            }
+        }
+    }
+}
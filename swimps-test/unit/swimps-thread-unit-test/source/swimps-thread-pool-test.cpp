@@ -0,0 +1,52 @@
+#include "swimps-unit-test.h"
+#include "swimps-thread/swimps-thread.h"
+
+#include <atomic>
+#include <future>
+#include <vector>
+
+using swimps::thread::ThreadPool;
+
+SCENARIO("swimps::thread::ThreadPool", "[swimps-thread]") {
+    GIVEN("A thread pool with four threads.") {
+        ThreadPool pool(4);
+
+        REQUIRE(pool.get_thread_count() == 4);
+
+        WHEN("Many tasks are submitted.") {
+            std::vector<std::future<int>> futures;
+            for (int i = 0; i < 1000; ++i) {
+                futures.push_back(pool.submit([i](){ return i * 2; }));
+            }
+
+            THEN("Each future holds its own task's result.") {
+                for (int i = 0; i < 1000; ++i) {
+                    REQUIRE(futures[i].get() == i * 2);
+                }
+            }
+        }
+
+        WHEN("A task throws.") {
+            auto future = pool.submit([]() -> int { throw 42; });
+
+            THEN("The exception comes out of its future.") {
+                REQUIRE_THROWS_AS(future.get(), int);
+            }
+        }
+    }
+
+    GIVEN("Tasks queued on a single threaded pool that's about to be destroyed.") {
+        std::atomic<int> tasksRun = 0;
+
+        {
+            ThreadPool pool(1);
+            for (int i = 0; i < 100; ++i) {
+                pool.submit([&tasksRun](){ tasksRun += 1; });
+            }
+        }
+
+        THEN("All of them were run before it was destroyed.") {
+            REQUIRE(tasksRun == 100);
+        }
+    }
+}
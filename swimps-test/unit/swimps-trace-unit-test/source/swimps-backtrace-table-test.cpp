@@ -0,0 +1,74 @@
+#include "swimps-unit-test.h"
+#include "swimps-trace/swimps-trace.h"
+
+#include <vector>
+
+using swimps::trace::backtrace_id_t;
+using swimps::trace::BacktraceTable;
+using swimps::trace::stack_frame_id_t;
+
+SCENARIO("swimps::trace::BacktraceTable", "[swimps-trace]") {
+    GIVEN("An empty backtrace table.") {
+        BacktraceTable backtraces;
+
+        REQUIRE(backtraces.size() == 0);
+
+        WHEN("Backtraces that differ only in order, length or a single frame are added.") {
+            const std::vector<std::vector<stack_frame_id_t>> distinctBacktraces = {
+                { 1, 2, 3 },
+                { 3, 2, 1 },
+                { 1, 2 },
+                { 1, 2, 3, 4 },
+                { 1, 2, 5 },
+                { }
+            };
+
+            std::vector<backtrace_id_t> ids;
+            for (const auto& stackFrameIDs : distinctBacktraces) {
+                ids.push_back(backtraces.intern(stackFrameIDs));
+            }
+
+            THEN("Each gets the next ID, starting from 1.") {
+                REQUIRE(ids == std::vector<backtrace_id_t>{ 1, 2, 3, 4, 5, 6 });
+                REQUIRE(backtraces.size() == distinctBacktraces.size());
+            }
+
+            THEN("Their stack frames can be got back by ID.") {
+                for (std::size_t i = 0; i < ids.size(); ++i) {
+                    const auto stackFrameIDs = backtraces.get(ids[i]);
+                    REQUIRE(std::vector<stack_frame_id_t>(stackFrameIDs.begin(), stackFrameIDs.end()) == distinctBacktraces[i]);
+                }
+            }
+
+            AND_WHEN("They are added again.") {
+                for (std::size_t i = 0; i < distinctBacktraces.size(); ++i) {
+                    REQUIRE(backtraces.intern(distinctBacktraces[i]) == ids[i]);
+                }
+
+                THEN("No new backtraces are stored.") {
+                    REQUIRE(backtraces.size() == distinctBacktraces.size());
+                }
+            }
+        }
+
+        WHEN("Enough backtraces are added for the table to grow many times.") {
+            constexpr stack_frame_id_t count = 100'000;
+
+            for (stack_frame_id_t i = 0; i < count; ++i) {
+                const std::vector<stack_frame_id_t> stackFrameIDs = { i % 7, i, i / 3 };
+                REQUIRE(backtraces.intern(stackFrameIDs) == i + 1);
+            }
+
+            THEN("Every backtrace is still found under its original ID.") {
+                REQUIRE(backtraces.size() == count);
+
+                for (stack_frame_id_t i = 0; i < count; ++i) {
+                    const std::vector<stack_frame_id_t> stackFrameIDs = { i % 7, i, i / 3 };
+                    REQUIRE(backtraces.intern(stackFrameIDs) == i + 1);
+                }
+
+                REQUIRE(backtraces.size() == count);
+            }
+        }
+    }
+}
@@ -0,0 +1,46 @@
+#include "swimps-unit-test.h"
+#include "swimps-trace/swimps-trace.h"
+
+#include <string>
+
+using swimps::trace::StringTable;
+
+SCENARIO("swimps::trace::StringTable", "[swimps-trace]") {
+    GIVEN("An empty string table.") {
+        StringTable strings;
+
+        THEN("It holds just the empty string, with ID 0.") {
+            REQUIRE(strings.size() == 1);
+            REQUIRE(strings.get(0).empty());
+            REQUIRE(strings.intern("") == 0);
+        }
+
+        WHEN("The same strings are interned many times.") {
+            for (int i = 0; i < 1000; ++i) {
+                strings.intern("function_" + std::to_string(i % 10));
+            }
+
+            THEN("Each distinct string is stored once.") {
+                REQUIRE(strings.size() == 11);
+                REQUIRE(strings.intern("function_3") == 4);
+                REQUIRE(strings.get(4) == "function_3");
+            }
+
+            AND_WHEN("It is copied.") {
+                const StringTable copy = strings;
+                StringTable copyAssigned;
+                copyAssigned = strings;
+
+                THEN("The copies hand out the same IDs.") {
+                    REQUIRE(copy.size() == strings.size());
+                    REQUIRE(copy.get(4) == "function_3");
+                    REQUIRE(copyAssigned.size() == strings.size());
+                    REQUIRE(copyAssigned.get(4) == "function_3");
+
+                    REQUIRE(copyAssigned.intern("function_9") == strings.intern("function_9"));
+                    REQUIRE(copyAssigned.size() == strings.size());
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace swimps::thread {
+    //!
+    //! \brief  Gets how many threads a pool should have by default.
+    //!
+    //! \returns  The number of hardware threads, or 1 if that isn't known.
+    //!
+    //! \note  This function is *not* async signal safe.
+    //!
+    std::size_t default_thread_count() noexcept;
+
+    //!
+    //! \brief  A fixed set of worker threads that run submitted tasks in the order they were submitted.
+    //!
+    class ThreadPool {
+    public:
+        //!
+        //! \brief  Starts a thread pool.
+        //!
+        //! \param[in]  threadCount  How many worker threads to start; must be at least one.
+        //!
+        //! \note  This function is *not* async signal safe.
+        //!
+        explicit ThreadPool(std::size_t threadCount = default_thread_count());
+
+        //!
+        //! \brief  Runs any tasks that are still queued, then stops the worker threads.
+        //!
+        //! \note  This function is *not* async signal safe.
+        //!
+        ~ThreadPool();
+
+        //!
+        //! \brief  Queues a task to be run on one of the pool's threads.
+        //!
+        //! \param[in]  task  What to run; it's called with no arguments.
+        //!
+        //! \returns  A future for the task's result (or the exception it threw).
+        //!
+        //! \note  This function is *not* async signal safe.
+        //!
+        template <typename Task>
+        std::future<std::invoke_result_t<Task>> submit(Task task) {
+            // std::function has to be copyable, so the packaged_task is shared rather than moved in.
+            auto packagedTask = std::make_shared<std::packaged_task<std::invoke_result_t<Task>()>>(std::move(task));
+            auto future = packagedTask->get_future();
+            enqueue([packagedTask](){ (*packagedTask)(); });
+            return future;
+        }
+
+        //!
+        //! \brief  Gets how many worker threads the pool has.
+        //!
+        //! \returns  The pool's thread count.
+        //!
+        std::size_t get_thread_count() const noexcept;
+
+        ThreadPool(const ThreadPool&) = delete;
+        ThreadPool& operator=(const ThreadPool&) = delete;
+
+    private:
+        void enqueue(std::function<void()> task);
+        void run_tasks();
+
+        std::mutex m_mutex;
+        std::condition_variable m_taskQueued;
+        std::deque<std::function<void()>> m_tasks;
+        bool m_stopping = false;
+
+        std::vector<std::thread> m_threads;
+    };
+}
@@ -0,0 +1,68 @@
+#include "swimps-thread/swimps-thread.h"
+
+#include "swimps-assert/swimps-assert.h"
+
+#include <algorithm>
+
+using swimps::thread::ThreadPool;
+
+std::size_t swimps::thread::default_thread_count() noexcept {
+    return std::max(1u, std::thread::hardware_concurrency());
+}
+
+ThreadPool::ThreadPool(const std::size_t threadCount) {
+    swimps_assert(threadCount > 0);
+
+    m_threads.reserve(threadCount);
+    for (std::size_t i = 0; i < threadCount; ++i) {
+        m_threads.emplace_back([this](){ run_tasks(); });
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard lock(m_mutex);
+        m_stopping = true;
+    }
+
+    m_taskQueued.notify_all();
+
+    for (auto& thread : m_threads) {
+        thread.join();
+    }
+}
+
+std::size_t ThreadPool::get_thread_count() const noexcept {
+    return m_threads.size();
+}
+
+void ThreadPool::enqueue(std::function<void()> task) {
+    {
+        std::lock_guard lock(m_mutex);
+        swimps_assert(! m_stopping);
+        m_tasks.push_back(std::move(task));
+    }
+
+    m_taskQueued.notify_one();
+}
+
+void ThreadPool::run_tasks() {
+    while (true) {
+        std::function<void()> task;
+
+        {
+            std::unique_lock lock(m_mutex);
+            m_taskQueued.wait(lock, [this](){ return m_stopping || ! m_tasks.empty(); });
+
+            // Only stop once the queue has drained, so that no submitted task's future is left hanging.
+            if (m_tasks.empty()) {
+                return;
+            }
+
+            task = std::move(m_tasks.front());
+            m_tasks.pop_front();
+        }
+
+        task();
+    }
+}
@@ -1,45 +1,161 @@
 #pragma once
 
+#include <array>
 #include <cstddef>
+#include <cstdint>
 #include <optional>
+#include <span>
+#include <string>
 #include <variant>
+#include <vector>
 
 #include <unistd.h>
 
 #include <signalsafe/file.hpp>
 
 #include "swimps-error/swimps-error.h"
+#include "swimps-thread/swimps-thread.h"
 #include "swimps-trace/swimps-trace.h"
 
 namespace swimps::trace {
+    //!
+    //! \brief  Which parts of a trace to read from a trace file.
+    //!
+    struct TraceSelection {
+        bool samples = true;
+        bool backtraces = true;
+        bool stackFrames = true;
+    };
+
     //!
     //! \brief  Represents a swimps trace file.
     //!
     class TraceFile : public signalsafe::File {
     public:
+        //!
+        //! \brief  The layouts a trace file can have on disk.
+        //!
+        enum class Format : int {
+            V1, //! entries interleaved in the order they were added, each preceded by a marker
+            V2  //! samples, backtraces and stack frames each in their own section, indexed by a footer
+        };
+
+        //!
+        //! \brief  The kinds of section in a v2 trace file, in the order they are written.
+        //!
+        enum class SectionKind : std::uint32_t {
+            Samples,
+            Backtraces,
+            StackFrames,
+            Strings,     //! the function names and source file paths that stack frames refer to, by ID
+            Threads      //! the names of the threads that samples were taken on
+        };
+
+        static constexpr std::size_t section_kind_count = 5;
+
+        //!
+        //! \brief  How the entries in a v2 section are encoded.
+        //!
+        enum class SectionEncoding : std::uint32_t {
+            Raw,    //! fixed width fields, as in v1 entries (without the markers)
+            Compact,           //! LEB128 integers, with backtrace IDs delta encoded against the previous entry,
+                               //! and stack frames' strings referred to by their ID in the strings section (not used for samples)
+            CompactWithThreads //! how samples are encoded: as Compact, with timestamps delta encoded against the previous sample,
+                               //! and each sample followed by its thread ID, delta encoded in the same way
+        };
+
+        //!
+        //! \brief  How the blocks of a v2 file are stored, as recorded in the file's header.
+        //!
+        enum class Compression : std::uint32_t {
+            None, //! blocks are stored as they are
+            LZ4   //! each block is compressed on its own with LZ4, unless that wouldn't make it any smaller
+        };
+
+        //!
+        //! \brief  Describes a block of entries within a v2 section.
+        //!
+        //! \note  Each block starts its delta encoding afresh and is compressed on its own,
+        //!        so blocks can be decoded independently of one another.
+        //!
+        struct Block {
+            std::uint64_t offset = 0;
+            std::uint32_t storedSize = 0;
+            std::uint32_t size = 0;
+            std::uint32_t entryCount = 0;
+        };
+
+        //!
+        //! \brief  Describes where a v2 section's blocks are, and what they contain.
+        //!
+        //! \note  Each block is written out as soon as it fills, so different sections' blocks can be interleaved.
+        //!        size is how many bytes the section's blocks take up in the file, all together.
+        //!
+        struct Section {
+            SectionKind kind = SectionKind::Samples;
+            SectionEncoding encoding = SectionEncoding::Raw;
+            std::uint64_t size = 0;
+            std::uint64_t entryCount = 0;
+            std::vector<Block> blocks;
+        };
+
+        //!
+        //! \brief  The default size of the buffer used by enable_write_buffering, in bytes.
+        //!
+        static constexpr std::size_t default_write_buffer_size = 4 * 1024 * 1024;
+
         //!
         //! \brief  Creates an empty trace file instance.
         //!
         TraceFile() = default;
 
+        //!
+        //! \brief  Flushes any buffered entries and closes the trace file.
+        //!
+        ~TraceFile();
+
         //!
         //! \brief  Creates a trace file at the given path.
         //!
         //! \param[in]  path         Where to create the file.
         //! \param[in]  permissions  The permissions to create the file with.
+        //! \param[in]  format       The layout to write the file in.
+        //! \param[in]  compression  How to store the file's blocks; only V2 files can be compressed.
+        //!
+        //! \note  V2 files hold on to one block of each section's entries, writing each block out as it fills.
+        //!
+        //! \note  This function is only async signal safe for Format::V1 with Compression::None;
+        //!        V2 files allocate their block buffers, and LZ4 its compression buffer.
+        //!
+        static TraceFile create_and_open(std::string_view path, Permissions permissions, Format format = Format::V1, Compression compression = Compression::None) noexcept;
+
+        //!
+        //! \brief  Creates a trace file at the given path, if it can be created.
+        //!
+        //! \param[in]  path         Where to create the file.
+        //! \param[in]  permissions  The permissions to create the file with.
+        //! \param[in]  format       The layout to write the file in.
+        //! \param[in]  compression  How to store the file's blocks; only V2 files can be compressed.
+        //!
+        //! \returns  The created trace file, or nothing if it couldn't be created or its marker couldn't be written.
         //!
-        //! \note  This function is async signal safe.
+        //! \note  Unlike create_and_open, this doesn't assert; why it failed is logged.
+        //!
+        //! \note  This function is *not* async signal safe.
         //!
-        static TraceFile create_and_open(std::string_view path, Permissions permissions) noexcept;
+        static std::optional<TraceFile> try_create_and_open(std::string_view path, Permissions permissions, Format format = Format::V1, Compression compression = Compression::None) noexcept;
 
         //!
         //! \brief  Creates a temporary trace file.
         //!
+        //! \param[in]  format       The layout to write the file in.
+        //! \param[in]  compression  How to store the file's blocks; only V2 files can be compressed.
+        //!
         //! \returns  The temporary trace file.
         //!
-        //! \note  This function is async signal safe.
+        //! \note  This function is only async signal safe for Format::V1 with Compression::None.
         //!
-        static TraceFile create_temporary() noexcept;
+        static TraceFile create_temporary(Format format = Format::V1, Compression compression = Compression::None) noexcept;
 
         //!
         //!  \brief  Opens a trace file.
@@ -49,20 +165,51 @@ namespace swimps::trace {
         //!
         //!  \returns  The requested trace file.
         //!
-        //!  \note  This function is async signal safe.
+        //!  \note  The format is detected from the file's marker. Asserts if the file can't be opened or is damaged;
+        //!         use try_open_existing to handle that instead.
+        //!
+        //!  \note  This function is *not* async signal safe.
         //!
         static TraceFile open_existing(std::string_view path, Permissions permissions) noexcept;
 
-        static TraceFile from_raw(std::string_view pathView) noexcept;
+        //!
+        //!  \brief  Opens a trace file, if it can be opened and is intact.
+        //!
+        //!  \param[in]  path         Where the trace file to be opened is.
+        //!  \param[in]  permissions  The permissions to open the trace file with.
+        //!
+        //!  \returns  The requested trace file, or nothing if it couldn't be opened,
+        //!            has no marker, or its v2 tables are damaged.
+        //!
+        //!  \note  Unlike open_existing, this doesn't assert; why it failed is logged.
+        //!
+        //!  \note  This function is *not* async signal safe.
+        //!
+        static std::optional<TraceFile> try_open_existing(std::string_view path, Permissions permissions) noexcept;
+
+        //!
+        //!  \brief  Converts the raw trace the sampler wrote into a symbolised V2 trace file, in place.
+        //!
+        //!  \param[in]  pathView     Where the raw trace is.
+        //!  \param[in]  compression  How to store the converted file's blocks.
+        //!
+        //!  \returns  The converted trace file, or nothing if it couldn't be converted.
+        //!
+        //!  \note  The converted trace is written to a temporary file next to the raw one, synced,
+        //!         and then renamed over it. If conversion fails, the raw trace is left as it was.
+        //!
+        //!  \note  This function is *not* async signal safe.
+        //!
+        static std::optional<TraceFile> from_raw(std::string_view pathView, Compression compression = Compression::None) noexcept;
 
         //!
         //! \brief  Adds a sample to the trace file.
         //!
         //! \param[in]  sample  The sample to add.
         //!
-        //! \returns  The number of bytes written to the file.
+        //! \returns  The number of bytes written to the file (or its write buffer).
         //!
-        //! \note  This function is async signal safe.
+        //! \note  This function is *not* async signal safe.
         //!
         std::size_t add_sample(const swimps::trace::Sample& sample);
 
@@ -71,7 +218,7 @@ namespace swimps::trace {
         //!
         //! \param[in]  backtrace  The backtrace to add.
         //!
-        //! \returns  The number of bytes written to the file.
+        //! \returns  The number of bytes written to the file (or its write buffer).
         //!
         //! \note  This function is *not* async signal safe.
         //!
@@ -81,20 +228,112 @@ namespace swimps::trace {
         //! \brief  Adds a stack frame to the trace file.
         //!
         //! \param[in]  stackFrame  The stack frame to add.
+        //! \param[in]  strings     The string table the stack frame's strings are in.
+        //!
+        //! \returns  The number of bytes written to the file (or its write buffer).
+        //!
+        //! \note  V2 files keep their own string table, which the stack frame's strings are added to;
+        //!        v1 files store the strings inline.
+        //!
+        //! \note  This function is *not* async signal safe.
+        //!
+        std::size_t add_stack_frame(const StackFrame& stackFrame, const StringTable& strings);
+
+        //!
+        //! \brief  Adds a thread's name to the trace file.
+        //!
+        //! \param[in]  thread   The thread to add.
+        //! \param[in]  strings  The string table the thread's name is in.
         //!
-        //! \returns  The number of bytes written to the file.
+        //! \returns  The number of bytes written to the file (or its write buffer).
         //!
-        //! \note  This function is async signal safe.
+        //! \note  Only v2 files record threads, and which thread each sample was taken on;
+        //!        v1 files ignore them.
+        //!
+        //! \note  This function is *not* async signal safe.
         //!
-        std::size_t add_stack_frame(const StackFrame& stackFrame);
+        std::size_t add_thread(const Thread& thread, const StringTable& strings);
+
+        //!
+        //! \brief  Makes the add functions gather entries in memory and write them out in large batches,
+        //!         rather than issuing a write for every field of every entry.
+        //!
+        //! \param[in]  bufferSize  How many bytes to gather before writing them to the file.
+        //!
+        //! \note  Buffered entries are written when the buffer fills, or by flush(), finalise() or the destructor.
+        //!         Flush before seeking, as buffered entries are written wherever the file offset is at the time.
+        //!
+        //! \note  This function is *not* async signal safe.
+        //!
+        void enable_write_buffering(std::size_t bufferSize = default_write_buffer_size);
+
+        //!
+        //! \brief  Writes out any entries gathered by write buffering.
+        //!
+        //! \returns  Whether all of the buffered bytes were written.
+        //!
+        //! \note  This function is *not* async signal safe.
+        //!
+        bool flush() noexcept;
 
         using Entry = std::variant<Backtrace, Sample, StackFrame, swimps::error::ErrorCode>;
 
+        //!
+        //! \brief  How read_trace should pull entries out of the file.
+        //!
+        enum class ReadMode : int {
+            Sequential, //! entry by entry, via read_next_entry
+            Mapped,     //! decoded in place from a read-only memory mapping of the file
+            Parallel    //! as Mapped, but with v2 blocks decoded concurrently on a thread pool
+        };
+
+        //!
+        //! \brief  Gets the layout of the trace file.
+        //!
+        //! \returns  The trace file's format.
+        //!
+        Format get_format() const noexcept;
+
+        //!
+        //! \brief  Gets how the trace file's blocks are stored.
+        //!
+        //! \returns  The trace file's compression, which is always None for v1 trace files.
+        //!
+        Compression get_compression() const noexcept;
+
+        //!
+        //! \brief  Gets the sections of a v2 trace file.
+        //!
+        //! \returns  The sections described by the footer, or nothing for a v1 trace file.
+        //!
+        const std::vector<Section>& get_sections() const noexcept;
+
+        //!
+        //! \brief  Gets the strings that the stack frames read from (or added to) the trace file refer to.
+        //!
+        //! \returns  The trace file's string table.
+        //!
+        //! \note  V2 files load theirs when opened; v1 files build theirs up as stack frames are read.
+        //!
+        const StringTable& get_strings() const noexcept;
+
+        //!
+        //! \brief  Gets the threads whose names were recorded in the trace file.
+        //!
+        //! \returns  The threads, whose names are in the trace file's string table.
+        //!
+        //! \note  V2 files load theirs when opened, so read_next_entry never returns them; v1 files have none.
+        //!
+        const std::vector<Thread>& get_threads() const noexcept;
+
         //!
         //! \brief  Reads the next entry in the trace file.
         //!
         //! \returns  The next entry, or an error code if something went wrong (such as EndOfFile).
         //!
+        //! \note  V2 files are walked section by section, starting from the first one.
+        //!        Only one block is held in memory (decompressed, if need be) at a time.
+        //!
         //! \note  This function is *not* async signal safe.
         //!
         Entry read_next_entry() noexcept;
@@ -102,17 +341,29 @@ namespace swimps::trace {
         //!
         //! \brief  Reads the entire trace from the trace file.
         //!
+        //! \param[in]  readMode   How to read the entries.
+        //! \param[in]  selection  Which kinds of entry to read.
+        //!
         //! \returns  The trace contained in the file, if successful.
         //!
+        //! \note  If the file cannot be mapped, the sequential reader is used instead.
+        //!
+        //! \note  V1 files have no index to split them up by, so they are read as Mapped even when Parallel is asked for.
+        //!
+        //! \note  V2 files skip the sections that weren't selected; v1 files still have to scan past them.
+        //!
         //! \note  This function is *not* async signal safe.
         //!
-        std::optional<Trace> read_trace() noexcept;
+        std::optional<Trace> read_trace(ReadMode readMode = ReadMode::Parallel, TraceSelection selection = {}) noexcept;
 
         //!
         //! \brief  Finalises the trace file.
         //!
         //! \returns  Whether finalising was successful or not.
         //!
+        //! \note  For v2 files, this is what writes the last of each section's blocks, the string table,
+        //!        and the section table and footer out.
+        //!
         //! \note  You should not modify the file after finalising it.
         //!
         //! \note  This function is *not* async signal safe.
@@ -124,5 +375,142 @@ namespace swimps::trace {
 
         TraceFile(const TraceFile&) = delete;
         TraceFile& operator=(const TraceFile&) = delete;
+
+    private:
+        struct PendingSection {
+            std::uint64_t entryCount = 0;
+
+            // Blocks that have been written out; bytes holds the entries of the one being added to.
+            std::vector<Block> blocks;
+            std::vector<char> bytes;
+            std::uint32_t blockEntryCount = 0;
+        };
+
+        //
+        // Gets the buffer an entry of the given kind should be encoded into:
+        // the section it belongs to for v2 files, or a scratch buffer holding the entry marker for v1.
+        //
+        std::vector<char>& begin_entry(SectionKind kind);
+
+        //
+        // Hands an encoded entry over to its section (v2) or the file (v1).
+        // Returns the number of bytes the entry took up.
+        //
+        std::size_t end_entry(SectionKind kind);
+
+        //
+        // Writes straight through to the file, or into the write buffer if buffering is enabled.
+        //
+        std::size_t write_entry_data(std::span<const char> data) noexcept;
+
+        //
+        // Writes out the block a pending section is adding to, if there's anything in it,
+        // compressing it first if the file is compressed.
+        //
+        bool write_block(SectionKind kind) noexcept;
+
+        //
+        // Reads (and if need be decompresses) the next block of a v2 file, for read_next_entry.
+        //
+        std::optional<swimps::error::ErrorCode> read_next_block() noexcept;
+
+        bool write_sections() noexcept;
+        bool read_section_table() noexcept;
+        bool read_string_table() noexcept;
+        bool read_thread_table() noexcept;
+
+        //
+        // Reads (and if need be decompresses) each block of every section of the given kind,
+        // handing each one's bytes and entry count to readBlock, until it returns false.
+        //
+        template <typename ReadBlock>
+        bool read_blocks(SectionKind kind, ReadBlock&& readBlock) noexcept;
+
+        Format m_format = Format::V1;
+        Compression m_compression = Compression::None;
+
+        std::vector<char> m_writeBuffer;
+        std::size_t m_writeBufferSize = 0;
+
+        std::vector<char> m_entryBuffer;
+        std::size_t m_entryStart = 0;
+        std::array<PendingSection, section_kind_count> m_pendingSections;
+        std::vector<char> m_compressedBlock;
+
+        // Where the next v2 block goes; blocks are appended to the file, straight after the header.
+        std::uint64_t m_nextBlockOffset = 0;
+        bool m_writeFailed = false;
+
+        std::vector<Section> m_sections;
+        StringTable m_strings;
+        std::vector<Thread> m_threads;
+        std::size_t m_nextSection = 0;
+        std::size_t m_nextBlock = 0;
+        std::uint32_t m_entriesLeftInBlock = 0;
+        std::vector<char> m_storedBlock;
+        std::vector<char> m_block;
+        std::span<const std::byte> m_blockBytes; // points into m_storedBlock, or m_block once decompressed
+        std::size_t m_blockReadOffset = 0;
+        SectionKind m_currentSectionKind = SectionKind::Samples;
+        SectionEncoding m_currentSectionEncoding = SectionEncoding::Raw;
+
+        // Compact entries are stored relative to the previous entry of the same kind.
+        Sample m_previousWrittenSample{};
+        backtrace_id_t m_previousWrittenBacktraceID = 0;
+        Sample m_previousReadSample{};
+        backtrace_id_t m_previousReadBacktraceID = 0;
     };
+
+    //!
+    //! \brief  Moves a finished (and closed) trace file over another path, so that a crash leaves one or the other whole.
+    //!
+    //! \param[in]  tempFilePath  The finished trace file, which must be in the same directory as targetPath.
+    //! \param[in]  targetPath    Where the trace file is to end up.
+    //!
+    //! \returns  Whether the trace file was moved into place. If it wasn't, it's removed, and targetPath is left as it was.
+    //!
+    //! \note  The trace file is synced to disk before it's renamed, and its directory after.
+    //!
+    //! \note  This function is *not* async signal safe.
+    //!
+    bool move_into_place(std::string_view tempFilePath, std::string_view targetPath) noexcept;
+
+    //!
+    //! \brief  Combines several trace files into one, as if all of their samples had been taken in a single run.
+    //!
+    //! \param[in]  inputPaths   The trace files to combine.
+    //! \param[in]  outputPath   Where to write the combined trace file, which is always v2.
+    //! \param[in]  compression  How to store the combined trace file's blocks.
+    //! \param[in]  threadCount  The most threads to use.
+    //!
+    //! \returns  Whether every trace file was read, and the combined one written.
+    //!
+    //! \note  Each file's backtrace and stack frame IDs only mean something within that file, so stack frames are
+    //!        matched up by what they were symbolised to (or by instruction pointer, if they weren't), and backtraces
+    //!        by their stack frames. Every sample is kept, with its backtrace's ID in the combined file.
+    //!
+    //! \note  Threads in different files are different threads, even where their IDs are the same, so each file's
+    //!        threads are given new IDs in the combined file, numbered from 1 in the order of the files (the unknown
+    //!        thread, 0, stays as it is). Each file's named threads are numbered first, then any other threads its
+    //!        samples were taken on.
+    //!
+    //! \note  The files are split into one contiguous range per thread, each folded into a table of backtraces and
+    //!        stack frames one file at a time; the tables are then combined pairwise until one is left. So however many
+    //!        files there are, only one table per thread (and one file's backtraces and stack frames) is held at once.
+    //!        Samples are then copied into the combined file an entry at a time, so only a block of them is held
+    //!        at once, however many there are.
+    //!
+    //! \note  The combined file doesn't depend on how many threads are used.
+    //!
+    //! \note  The combined file is written next to outputPath and moved into place with move_into_place, so it's never
+    //!        seen half written. If any file can't be read (a damaged one, say), the merge fails and outputPath is left as it was.
+    //!
+    //! \note  This function is *not* async signal safe.
+    //!
+    bool merge_trace_files(
+        std::span<const std::string> inputPaths,
+        std::string_view outputPath,
+        TraceFile::Compression compression = TraceFile::Compression::None,
+        std::size_t threadCount = swimps::thread::default_thread_count()
+    );
 }
@@ -0,0 +1,434 @@
+#include "swimps-trace-file/swimps-trace-file.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <future>
+#include <optional>
+#include <string>
+#include <system_error>
+#include <unordered_map>
+#include <vector>
+
+#include <unistd.h>
+
+#include "swimps-log/swimps-log.h"
+
+using swimps::error::ErrorCode;
+using swimps::log::format_and_write_to_log;
+using swimps::log::LogLevel;
+using swimps::thread::ThreadPool;
+using swimps::trace::Backtrace;
+using swimps::trace::backtrace_id_t;
+using swimps::trace::BacktraceTable;
+using swimps::trace::Sample;
+using swimps::trace::StackFrame;
+using swimps::trace::stack_frame_id_t;
+using swimps::trace::string_id_t;
+using swimps::trace::StringTable;
+using swimps::trace::Thread;
+using swimps::trace::thread_id_t;
+using swimps::trace::TraceFile;
+using swimps::trace::TraceSelection;
+
+namespace {
+    //
+    // What a stack frame was symbolised to, with its strings in the merged string table.
+    // Stack frames that weren't symbolised can only be told apart by their instruction pointers.
+    //
+    struct StackFrameKey {
+        string_id_t functionName = 0;
+        string_id_t sourceFilePath = 0;
+        swimps::trace::offset_t offset = 0;
+        swimps::trace::line_number_t lineNumber = -1;
+        swimps::trace::address_t instructionPointer = 0;
+
+        bool operator==(const StackFrameKey&) const = default;
+    };
+
+    struct StackFrameKeyHash {
+        std::size_t operator()(const StackFrameKey& key) const noexcept {
+            std::size_t hash = 0;
+
+            for (const auto value : {
+                static_cast<std::uint64_t>(key.functionName),
+                static_cast<std::uint64_t>(key.sourceFilePath),
+                static_cast<std::uint64_t>(key.offset),
+                static_cast<std::uint64_t>(key.lineNumber),
+                static_cast<std::uint64_t>(key.instructionPointer)
+            }) {
+                hash ^= std::hash<std::uint64_t>{}(value) + 0x9e3779b97f4a7c15 + (hash << 6) + (hash >> 2);
+            }
+
+            return hash;
+        }
+    };
+
+    using BacktraceIDs = std::unordered_map<backtrace_id_t, backtrace_id_t>;
+
+    //
+    // The backtraces and stack frames of a contiguous range of the files being merged, each stored once,
+    // and what each of those files' backtrace IDs became.
+    //
+    struct MergedSymbols {
+        StringTable strings;
+
+        // Merged stack frame N is stackFrames[N - 1].
+        std::vector<StackFrame> stackFrames;
+        std::unordered_map<StackFrameKey, stack_frame_id_t, StackFrameKeyHash> stackFrameIDs;
+
+        BacktraceTable backtraces;
+
+        // In the order of the files.
+        std::vector<BacktraceIDs> fileBacktraceIDs;
+
+        // In the order of the files, with their IDs as they were in their file and their names in the merged strings.
+        std::vector<std::vector<Thread>> fileThreads;
+    };
+
+    //
+    // Adds stack frames and backtraces to the merged ones, and returns what the backtraces' IDs became.
+    // forEachBacktrace calls the function it's given with each backtrace's ID and stack frame IDs.
+    //
+    template <typename ForEachBacktrace>
+    BacktraceIDs add_symbols(
+        MergedSymbols& merged,
+        const std::span<const StackFrame> stackFrames,
+        const StringTable& strings,
+        ForEachBacktrace&& forEachBacktrace
+    ) {
+        const auto addStackFrame = [&merged, &strings](const StackFrame& stackFrame) {
+            const auto functionName = strings.get(stackFrame.functionName);
+
+            StackFrameKey key;
+            key.functionName = merged.strings.intern(functionName);
+            key.sourceFilePath = merged.strings.intern(strings.get(stackFrame.sourceFilePath));
+            key.offset = stackFrame.offset;
+            key.lineNumber = stackFrame.lineNumber;
+            key.instructionPointer = functionName.empty() ? stackFrame.instructionPointer : 0;
+
+            // New stack frames are numbered in the order they're first seen, as they would be in a single run.
+            const auto [stackFrameIDIter, isNewStackFrame] = merged.stackFrameIDs.try_emplace(key, merged.stackFrames.size() + 1);
+            if (isNewStackFrame) {
+                StackFrame mergedStackFrame = stackFrame;
+                mergedStackFrame.id = stackFrameIDIter->second;
+                mergedStackFrame.functionName = key.functionName;
+                mergedStackFrame.sourceFilePath = key.sourceFilePath;
+                merged.stackFrames.push_back(mergedStackFrame);
+            }
+
+            return stackFrameIDIter->second;
+        };
+
+        std::unordered_map<stack_frame_id_t, stack_frame_id_t> stackFrameIDs;
+        for (const auto& stackFrame : stackFrames) {
+            stackFrameIDs.try_emplace(stackFrame.id, addStackFrame(stackFrame));
+        }
+
+        BacktraceIDs backtraceIDs;
+        std::vector<stack_frame_id_t> mergedStackFrameIDs;
+
+        forEachBacktrace([&](const backtrace_id_t backtraceID, const std::span<const stack_frame_id_t> backtraceStackFrameIDs) {
+            mergedStackFrameIDs.clear();
+
+            for (const auto stackFrameID : backtraceStackFrameIDs) {
+                auto stackFrameIDIter = stackFrameIDs.find(stackFrameID);
+
+                // Only a corrupt file would be missing one of its stack frames. It's kept as an unsymbolised one,
+                // so the backtrace is still as deep as it was.
+                if (stackFrameIDIter == stackFrameIDs.end()) {
+                    stackFrameIDIter = stackFrameIDs.try_emplace(stackFrameID, addStackFrame(StackFrame(stackFrameID, 0))).first;
+                }
+
+                mergedStackFrameIDs.push_back(stackFrameIDIter->second);
+            }
+
+            backtraceIDs.try_emplace(backtraceID, merged.backtraces.intern(mergedStackFrameIDs));
+        });
+
+        return backtraceIDs;
+    }
+
+    //
+    // Adds a file's backtraces, stack frames and threads (but not its samples) to the merged ones.
+    //
+    bool add_file(MergedSymbols& merged, const std::string& path) {
+        // One damaged file among many shouldn't bring the whole process down, just this merge.
+        auto traceFile = TraceFile::try_open_existing(path, TraceFile::Permissions::ReadOnly);
+        if (! traceFile.has_value()) {
+            format_and_write_to_log<512>(LogLevel::Fatal, "Failed to open trace file % to merge it.", path.c_str());
+            return false;
+        }
+
+        TraceSelection selection;
+        selection.samples = false;
+
+        // Each range of files already has a thread of its own, so the file's blocks aren't read in parallel too.
+        const auto trace = traceFile->read_trace(TraceFile::ReadMode::Mapped, selection);
+        if (! trace.has_value()) {
+            format_and_write_to_log<512>(LogLevel::Fatal, "Failed to read trace file % to merge it.", path.c_str());
+            return false;
+        }
+
+        merged.fileBacktraceIDs.push_back(add_symbols(merged, trace->stackFrames, trace->strings, [&trace](auto&& addBacktrace) {
+            for (const auto& backtrace : trace->backtraces) {
+                addBacktrace(backtrace.id, backtrace.stackFrameIDs);
+            }
+        }));
+
+        auto& threads = merged.fileThreads.emplace_back(trace->threads);
+        for (auto& thread : threads) {
+            thread.name = merged.strings.intern(trace->strings.get(thread.name));
+        }
+
+        return true;
+    }
+
+    //
+    // Adds the merged symbols of the range of files just after the merged ones' to them. New backtraces and
+    // stack frames are added in the order they were first seen in the later range, so the result is the same
+    // as if each of its files had been added one by one.
+    //
+    void add_merged_symbols(MergedSymbols& merged, MergedSymbols&& later) {
+        const auto backtraceIDs = add_symbols(merged, later.stackFrames, later.strings, [&later](auto&& addBacktrace) {
+            for (backtrace_id_t backtraceID = 1; static_cast<std::size_t>(backtraceID) <= later.backtraces.size(); ++backtraceID) {
+                addBacktrace(backtraceID, later.backtraces.get(backtraceID));
+            }
+        });
+
+        for (auto& fileBacktraceIDs : later.fileBacktraceIDs) {
+            for (auto& [fileBacktraceID, mergedBacktraceID] : fileBacktraceIDs) {
+                mergedBacktraceID = backtraceIDs.at(mergedBacktraceID);
+            }
+
+            merged.fileBacktraceIDs.push_back(std::move(fileBacktraceIDs));
+        }
+
+        for (auto& fileThreads : later.fileThreads) {
+            for (auto& thread : fileThreads) {
+                thread.name = merged.strings.intern(later.strings.get(thread.name));
+            }
+
+            merged.fileThreads.push_back(std::move(fileThreads));
+        }
+    }
+
+    //
+    // Gives each of a file's threads an ID of its own in the merged trace, the first time it's seen.
+    // The unknown thread, 0, is the same in every file.
+    //
+    class ThreadIDs {
+    public:
+        explicit ThreadIDs(thread_id_t& nextThreadID) noexcept
+        : m_nextThreadID(nextThreadID) {
+
+        }
+
+        thread_id_t get(const thread_id_t fileThreadID) {
+            if (fileThreadID == 0) {
+                return 0;
+            }
+
+            const auto [threadIDIter, isNewThread] = m_threadIDs.try_emplace(fileThreadID, m_nextThreadID);
+            if (isNewThread) {
+                m_nextThreadID += 1;
+            }
+
+            return threadIDIter->second;
+        }
+
+        bool has(const thread_id_t fileThreadID) const {
+            return fileThreadID == 0 || m_threadIDs.contains(fileThreadID);
+        }
+
+    private:
+        thread_id_t& m_nextThreadID;
+        std::unordered_map<thread_id_t, thread_id_t> m_threadIDs;
+    };
+
+    //
+    // Writes the merged trace: each file's samples (with their backtraces' and threads' merged IDs),
+    // then the merged symbols and threads.
+    //
+    bool write_merged_trace(TraceFile& outputFile, const std::span<const std::string> inputPaths, const MergedSymbols& merged) {
+        // Threads in different files are different threads, even where their IDs happen to be the same,
+        // so they're numbered afresh: each file's named threads, then any others its samples were taken on.
+        thread_id_t nextThreadID = 1;
+        std::vector<Thread> mergedThreads;
+
+        // Samples are copied over an entry at a time, so only a block of them is held at once, on either side.
+        for (std::size_t file = 0; file < inputPaths.size(); ++file) {
+            auto maybeInputFile = TraceFile::try_open_existing(inputPaths[file], TraceFile::Permissions::ReadOnly);
+            if (! maybeInputFile.has_value()) {
+                format_and_write_to_log<512>(LogLevel::Fatal, "Failed to open trace file % to merge its samples.", inputPaths[file].c_str());
+                return false;
+            }
+
+            auto& inputFile = *maybeInputFile;
+
+            // v2 files say how many samples they have, so there's no need to read on past the last one.
+            // v1 files' samples are mixed in with everything else, so they're read to the end.
+            std::optional<std::uint64_t> samplesLeft;
+            if (inputFile.get_format() == TraceFile::Format::V2) {
+                samplesLeft = 0;
+
+                for (const auto& section : inputFile.get_sections()) {
+                    if (section.kind == TraceFile::SectionKind::Samples) {
+                        *samplesLeft += section.entryCount;
+                    }
+                }
+            }
+
+            const auto& backtraceIDs = merged.fileBacktraceIDs[file];
+
+            ThreadIDs threadIDs(nextThreadID);
+            for (const auto& thread : merged.fileThreads[file]) {
+                // Only a corrupt file would name a thread twice, or name the unknown thread.
+                if (! threadIDs.has(thread.id)) {
+                    mergedThreads.push_back({ threadIDs.get(thread.id), thread.name });
+                }
+            }
+
+            while (! samplesLeft.has_value() || *samplesLeft > 0) {
+                const auto entry = inputFile.read_next_entry();
+
+                if (const auto* const errorCode = std::get_if<ErrorCode>(&entry)) {
+                    if (*errorCode == ErrorCode::EndOfFile && ! samplesLeft.has_value()) {
+                        break;
+                    }
+
+                    format_and_write_to_log<512>(LogLevel::Fatal, "Failed to read the samples of trace file % to merge them.", inputPaths[file].c_str());
+                    return false;
+                }
+
+                const auto* const sample = std::get_if<Sample>(&entry);
+                if (sample == nullptr) {
+                    continue;
+                }
+
+                if (samplesLeft.has_value()) {
+                    *samplesLeft -= 1;
+                }
+
+                Sample mergedSample = *sample;
+
+                // A sample in a backtrace its file hasn't got is kept, but still can't be put down to any backtrace.
+                const auto backtraceIDIter = backtraceIDs.find(sample->backtraceID);
+                mergedSample.backtraceID = backtraceIDIter == backtraceIDs.cend() ? 0 : backtraceIDIter->second;
+                mergedSample.threadID = threadIDs.get(sample->threadID);
+
+                outputFile.add_sample(mergedSample);
+            }
+        }
+
+        for (backtrace_id_t backtraceID = 1; static_cast<std::size_t>(backtraceID) <= merged.backtraces.size(); ++backtraceID) {
+            const auto stackFrameIDs = merged.backtraces.get(backtraceID);
+
+            // Trace files can't hold empty backtraces; only a v1 file could have had one to begin with.
+            if (stackFrameIDs.empty()) {
+                continue;
+            }
+
+            Backtrace backtrace;
+            backtrace.id = backtraceID;
+            backtrace.stackFrameIDs.assign(stackFrameIDs.begin(), stackFrameIDs.end());
+            outputFile.add_backtrace(backtrace);
+        }
+
+        for (const auto& stackFrame : merged.stackFrames) {
+            outputFile.add_stack_frame(stackFrame, merged.strings);
+        }
+
+        for (const auto& thread : mergedThreads) {
+            outputFile.add_thread(thread, merged.strings);
+        }
+
+        return outputFile.finalise();
+    }
+}
+
+bool swimps::trace::merge_trace_files(
+    const std::span<const std::string> inputPaths,
+    const std::string_view outputPath,
+    const TraceFile::Compression compression,
+    const std::size_t threadCount
+) {
+    // Each range of files is folded into merged symbols of its own, on a thread of its own.
+    const auto rangeCount = std::clamp<std::size_t>(inputPaths.size(), 1, std::max<std::size_t>(threadCount, 1));
+    const auto rangeSize = (inputPaths.size() + rangeCount - 1) / rangeCount;
+
+    std::vector<MergedSymbols> mergedSymbols(rangeCount);
+
+    ThreadPool threadPool(rangeCount);
+    std::vector<std::future<bool>> rangesMerged;
+    rangesMerged.reserve(rangeCount);
+
+    for (std::size_t range = 0; range < rangeCount; ++range) {
+        const auto rangeStart = std::min(range * rangeSize, inputPaths.size());
+        const auto rangeEnd = std::min(rangeStart + rangeSize, inputPaths.size());
+
+        rangesMerged.push_back(threadPool.submit([&rangeSymbols = mergedSymbols[range], inputPaths, rangeStart, rangeEnd](){
+            for (auto file = rangeStart; file < rangeEnd; ++file) {
+                if (! add_file(rangeSymbols, inputPaths[file])) {
+                    return false;
+                }
+            }
+
+            return true;
+        }));
+    }
+
+    // Every range has to finish before the merged symbols can be combined (or destroyed), even if one has already failed.
+    bool succeeded = true;
+    for (auto& rangeMerged : rangesMerged) {
+        succeeded = rangeMerged.get() && succeeded;
+    }
+
+    if (! succeeded) {
+        return false;
+    }
+
+    // Neighbouring ranges are combined pairwise, level by level, so the files stay in order until there's one range left.
+    for (std::size_t stride = 1; stride < rangeCount; stride *= 2) {
+        std::vector<std::future<void>> pairsCombined;
+
+        for (std::size_t range = 0; range + stride < rangeCount; range += stride * 2) {
+            pairsCombined.push_back(threadPool.submit([&mergedSymbols, range, stride](){
+                add_merged_symbols(mergedSymbols[range], std::move(mergedSymbols[range + stride]));
+
+                // The later range's symbols aren't needed any more, so there's no need to hold on to them.
+                mergedSymbols[range + stride] = {};
+            }));
+        }
+
+        for (auto& pairCombined : pairsCombined) {
+            pairCombined.wait();
+        }
+
+        for (auto& pairCombined : pairsCombined) {
+            pairCombined.get();
+        }
+    }
+
+    // The merged trace is written next to where it's going, so that it can be renamed into place once it's whole.
+    const std::string outputFilePath(outputPath);
+    const auto tempFilePath = outputFilePath + "." + std::to_string(getpid()) + ".tmp";
+
+    auto outputFile = TraceFile::try_create_and_open(tempFilePath, TraceFile::Permissions::ReadWrite, TraceFile::Format::V2, compression);
+    if (! outputFile.has_value()) {
+        format_and_write_to_log<512>(LogLevel::Fatal, "Could not create merged trace file %.", tempFilePath.c_str());
+        return false;
+    }
+
+    const bool written = write_merged_trace(*outputFile, inputPaths, mergedSymbols.front());
+    if (! outputFile->close() || ! written) {
+        format_and_write_to_log<512>(LogLevel::Fatal, "Could not write merged trace file %.", tempFilePath.c_str());
+
+        std::error_code errorCode;
+        std::filesystem::remove(tempFilePath, errorCode);
+        return false;
+    }
+
+    return swimps::trace::move_into_place(tempFilePath, outputFilePath);
+}
@@ -1,5 +1,6 @@
 #include "swimps-trace-file/swimps-trace-file.h"
 
+#include <algorithm>
 #include <cstring>
 #include <cerrno>
 #include <cinttypes>
@@ -8,20 +9,32 @@
 #include <unordered_set>
 #include <functional>
 #include <string>
+#include <system_error>
 #include <filesystem>
 #include <fstream>
+#include <future>
+#include <iterator>
+#include <span>
+#include <type_traits>
 
 #include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 #define UNW_LOCAL_ONLY
 #include <libunwind.h>
 
+#include <lz4.h>
+
 #include <samplerpreload/trace-file.hpp>
 
 #include <signalsafe/memory.hpp>
 
 #include "swimps-assert/swimps-assert.h"
 #include "swimps-log/swimps-log.h"
+#include "swimps-symbol/swimps-symbol.h"
+#include "swimps-thread/swimps-thread.h"
 
 using signalsafe::memory::copy_no_overlap;
 using signalsafe::time::TimeSpecification;
@@ -32,15 +45,25 @@ using swimps::error::ErrorCode;
 using swimps::log::format_and_write_to_log;
 using swimps::log::LogLevel;
 using swimps::log::write_to_log;
+using swimps::symbol::MemoryMap;
+using swimps::thread::ThreadPool;
 using swimps::trace::Backtrace;
 using swimps::trace::backtrace_id_t;
+using swimps::trace::BacktraceTable;
+using swimps::trace::file_path_length_t;
 using swimps::trace::function_name_length_t;
 using swimps::trace::Sample;
 using swimps::trace::StackFrame;
+using swimps::trace::stack_frame_count_max;
 using swimps::trace::stack_frame_count_t;
 using swimps::trace::stack_frame_id_t;
+using swimps::trace::string_id_t;
+using swimps::trace::StringTable;
+using swimps::trace::Thread;
+using swimps::trace::thread_id_t;
 using swimps::trace::Trace;
 using swimps::trace::TraceFile;
+using swimps::trace::TraceSelection;
 
 namespace {
     constexpr size_t swimps_v1_trace_entry_marker_size = 6;
@@ -49,6 +72,25 @@ namespace {
     constexpr char swimps_v1_trace_sample_marker[swimps_v1_trace_entry_marker_size] = "\nsp!\n";
     constexpr char swimps_v1_trace_stack_frame_marker[swimps_v1_trace_entry_marker_size] = "\nsf!\n";
 
+    // Older v1 files have the profiled process' memory maps after the file marker: a count, then each map's start
+    // and end address. The maps are now recorded in a file alongside the trace instead (see get_memory_maps_path),
+    // so these are skipped over, just so that those older files can still be read.
+    constexpr char swimps_v1_trace_memory_maps_marker[swimps_v1_trace_entry_marker_size] = "\npm!\n";
+
+    // v2 files start with their own marker and the compression their blocks use, followed by the sections' blocks
+    // in the order they filled up. The footer at the very end says where the section table is and how many entries it has.
+    constexpr char swimps_v2_trace_file_marker[swimps_v1_trace_entry_marker_size] = "s_v2\n";
+    constexpr char swimps_v2_trace_footer_marker[swimps_v1_trace_entry_marker_size] = "\nsi!\n";
+    constexpr std::size_t swimps_v2_trace_header_size = sizeof swimps_v2_trace_file_marker + sizeof(std::uint32_t);
+    constexpr std::size_t swimps_v2_trace_footer_size = sizeof(std::uint64_t) + sizeof(std::uint32_t) + sizeof swimps_v2_trace_footer_marker;
+
+    // Sections are cut into blocks of roughly this many uncompressed bytes (a block is only closed between entries).
+    // That's plenty for LZ4 to find repetition in, while keeping what read_next_entry holds in memory small.
+    constexpr std::size_t swimps_v2_block_size = 1024 * 1024;
+
+    // Function names and source file paths longer than this are assumed to be corrupt data.
+    constexpr std::size_t max_string_length = 64 * 1024;
+
     struct Visitor {
         using BacktraceHandler = std::function<void(Backtrace&)>;
         using SampleHandler = std::function<void(Sample&)>;
@@ -101,13 +143,21 @@ namespace {
         StackFrame,
     };
 
-    int read_trace_file_marker(TraceFile& traceFile) {
-        std::array<std::byte, sizeof swimps_v1_trace_file_marker> buffer;
-        if (! traceFile.read(buffer)) {
-            return -1;
+    std::optional<TraceFile::Format> read_trace_file_marker(TraceFile& traceFile) {
+        char buffer[swimps_v1_trace_entry_marker_size] = { };
+        if (traceFile.read(buffer) != sizeof buffer) {
+            return {};
+        }
+
+        if (memcmp(buffer, swimps_v1_trace_file_marker, sizeof swimps_v1_trace_file_marker) == 0) {
+            return TraceFile::Format::V1;
+        }
+
+        if (memcmp(buffer, swimps_v2_trace_file_marker, sizeof swimps_v2_trace_file_marker) == 0) {
+            return TraceFile::Format::V2;
         }
 
-        return memcmp(buffer.data(), swimps_v1_trace_file_marker, sizeof swimps_v1_trace_file_marker) == 0 ? 0 : -1;
+        return {};
     }
 
     bool goToStartOfFile(TraceFile& file) {
@@ -125,31 +175,134 @@ namespace {
         return true;
     }
 
-    bool isSwimpsTraceFile(TraceFile& traceFile) {
-        if (read_trace_file_marker(traceFile) != 0) {
-            write_to_log(
-                LogLevel::Fatal,
-                "Missing swimps trace file marker."
-            );
+    //
+    // Reads from trace file bytes that are already in memory (e.g. mapped, or a whole v2 section).
+    // This mirrors the parts of TraceFile's interface that the entry readers below use,
+    // so that the same decoding code works whether the bytes come from read() or memory.
+    //
+    class MemoryReader final {
+    public:
+        explicit MemoryReader(std::span<const std::byte> bytes) noexcept
+        : m_bytes(bytes) {
+
+        }
+
+        std::size_t read(std::span<char> target) noexcept {
+            const auto bytesToRead = std::min(target.size(), m_bytes.size() - m_offset);
+            memcpy(target.data(), m_bytes.data() + m_offset, bytesToRead);
+            m_offset += bytesToRead;
+            return bytesToRead;
+        }
+
+        template <typename T>
+        std::size_t read(T& target) noexcept {
+            static_assert(std::is_trivially_copyable_v<T>);
+            return read({ reinterpret_cast<char*>(&target), sizeof target });
+        }
+
+        std::size_t remaining() const noexcept {
+            return m_bytes.size() - m_offset;
+        }
+
+    private:
+        std::span<const std::byte> m_bytes;
+        std::size_t m_offset = 0;
+    };
+
+    //
+    // Appends encoded fields to a buffer, for building up entries in memory before they're written.
+    //
+    class MemoryWriter final {
+    public:
+        explicit MemoryWriter(std::vector<char>& target) noexcept
+        : m_target(target) {
+
+        }
+
+        std::size_t write(std::span<const char> data) {
+            m_target.insert(m_target.end(), data.begin(), data.end());
+            return data.size();
+        }
+
+        template <typename T>
+        std::size_t write(const T& data) {
+            static_assert(std::is_trivially_copyable_v<T>);
+            return write({ reinterpret_cast<const char*>(&data), sizeof data });
+        }
+
+    private:
+        std::vector<char>& m_target;
+    };
+
+    //
+    // Owns a read-only, private mapping of an entire file.
+    //
+    class MappedFile final {
+    public:
+        explicit MappedFile(const std::string& path) noexcept {
+            const int fileDescriptor = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+            if (fileDescriptor == -1) {
+                return;
+            }
+
+            struct stat fileStatus{};
+            if (fstat(fileDescriptor, &fileStatus) == 0 && fileStatus.st_size > 0) {
+                void* const address = mmap(nullptr, fileStatus.st_size, PROT_READ, MAP_PRIVATE, fileDescriptor, 0);
+                if (address != MAP_FAILED) {
+                    // Entries are decoded front to back, so let the kernel read ahead aggressively.
+                    madvise(address, fileStatus.st_size, MADV_SEQUENTIAL);
+                    m_bytes = { static_cast<const std::byte*>(address), static_cast<std::size_t>(fileStatus.st_size) };
+                }
+            }
+
+            close(fileDescriptor);
+        }
+
+        ~MappedFile() {
+            if (is_mapped()) {
+                munmap(const_cast<std::byte*>(m_bytes.data()), m_bytes.size());
+            }
+        }
+
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+
+        bool is_mapped() const noexcept {
+            return m_bytes.data() != nullptr;
+        }
+
+        std::span<const std::byte> bytes() const noexcept {
+            return m_bytes;
+        }
+
+    private:
+        std::span<const std::byte> m_bytes;
+    };
 
+    template <typename Source>
+    bool skip_v1_memory_maps(Source& source) {
+        std::uint64_t memoryMapCount = 0;
+        if (source.read(memoryMapCount) != sizeof memoryMapCount) {
             return false;
         }
 
+        // The count isn't trusted to size anything; a bad one just runs into the end of the file.
+        for (std::uint64_t i = 0; i < memoryMapCount; ++i) {
+            std::uint64_t addresses[2] = { };
+            if (source.read(addresses) != sizeof addresses) {
+                return false;
+            }
+        }
+
         return true;
     }
 
-
-    EntryKind read_next_entry_kind(TraceFile& traceFile) {
+    template <typename Source>
+    EntryKind read_next_entry_kind(Source& source) {
         char buffer[swimps_v1_trace_entry_marker_size];
         memset(buffer, 0, sizeof buffer);
 
-        const auto readReturnCode = traceFile.read(buffer);
-
-        format_and_write_to_log<64>(
-            LogLevel::Debug,
-            "Entry marker: %.",
-            buffer
-        );
+        const auto readReturnCode = source.read(buffer);
 
         if (readReturnCode == 0) {
             return EntryKind::EndOfFile;
@@ -161,7 +314,15 @@ namespace {
 
         if (memcmp(buffer, swimps_v1_trace_file_marker, sizeof swimps_v1_trace_file_marker) == 0) {
             // Ignore this and grab the next one.
-            return read_next_entry_kind(traceFile);
+            return read_next_entry_kind(source);
+        }
+
+        if (memcmp(buffer, swimps_v1_trace_memory_maps_marker, sizeof swimps_v1_trace_memory_maps_marker) == 0) {
+            if (! skip_v1_memory_maps(source)) {
+                return EntryKind::Unknown;
+            }
+
+            return read_next_entry_kind(source);
         }
 
         if (memcmp(buffer, swimps_v1_trace_sample_marker, sizeof swimps_v1_trace_sample_marker) == 0) {
@@ -179,405 +340,2027 @@ namespace {
         return EntryKind::Unknown;
     }
 
-    std::optional<Sample> read_sample(TraceFile& traceFile) {
+    template <typename Source>
+    std::optional<Sample> read_sample(Source& source) {
         backtrace_id_t backtraceID;
 
-        if (! traceFile.read(backtraceID)) {
+        if (! source.read(backtraceID)) {
             return {};
         }
 
         TimeSpecification timestamp;
 
-        if (! traceFile.read(timestamp.seconds)) {
+        if (! source.read(timestamp.seconds)) {
             return {};
         }
 
-        if (! traceFile.read(timestamp.nanoseconds)) {
+        if (! source.read(timestamp.nanoseconds)) {
             return {};
         }
 
         return {{ backtraceID, timestamp }};
     }
 
-    int write_trace_file_marker(TraceFile& targetFile) {
-        const auto bytesWritten = targetFile.write(swimps_v1_trace_file_marker);
+    // Zigzag encoding maps small negative numbers to small unsigned ones (0, -1, 1, -2 ... => 0, 1, 2, 3 ...),
+    // so that deltas which occasionally go backwards still encode as short varints.
+    constexpr std::uint64_t zigzag_encode(const std::int64_t value) {
+        return (static_cast<std::uint64_t>(value) << 1) ^ static_cast<std::uint64_t>(value >> 63);
+    }
 
-        if (bytesWritten != sizeof swimps_v1_trace_file_marker) {
-            targetFile.remove();
-            return -1;
-        }
+    constexpr std::int64_t zigzag_decode(const std::uint64_t value) {
+        return static_cast<std::int64_t>(value >> 1) ^ -static_cast<std::int64_t>(value & 1);
+    }
 
-        return 0;
+    // Deltas are calculated with unsigned wrap-around so that any pair of values round trips exactly.
+    constexpr std::int64_t delta(const std::int64_t value, const std::int64_t previous) {
+        return static_cast<std::int64_t>(static_cast<std::uint64_t>(value) - static_cast<std::uint64_t>(previous));
     }
 
-    std::optional<Backtrace> read_backtrace(TraceFile& traceFile) {
-        Backtrace backtrace;
+    constexpr std::int64_t undelta(const std::int64_t delta, const std::int64_t previous) {
+        return static_cast<std::int64_t>(static_cast<std::uint64_t>(previous) + static_cast<std::uint64_t>(delta));
+    }
 
-        if (! traceFile.read(backtrace.id)) {
-            return {};
-        }
+    template <typename Source>
+    bool read_varint(Source& source, std::uint64_t& value) {
+        value = 0;
 
-        stack_frame_count_t stackFrameIDCount = 0;
-        if (! traceFile.read(stackFrameIDCount)) {
-            return {};
-        }
+        for (unsigned int shift = 0; shift < 64; shift += 7) {
+            std::uint8_t byte = 0;
+            if (! source.read(byte)) {
+                return false;
+            }
 
-        swimps_assert(stackFrameIDCount > 0);
-        backtrace.stackFrameIDs.resize(stackFrameIDCount);
+            value |= static_cast<std::uint64_t>(byte & 0x7F) << shift;
 
-        for (stack_frame_count_t i = 0; i < stackFrameIDCount; ++i) {
-            if (! traceFile.read(backtrace.stackFrameIDs[i])) {
-                return {};
+            if ((byte & 0x80) == 0) {
+                return true;
             }
         }
 
-        return backtrace;
+        // More than 10 bytes can't be a valid 64-bit varint.
+        return false;
     }
 
-    std::optional<StackFrame> read_stack_frame(TraceFile& traceFile) {
-        StackFrame stackFrame;
-
-        if (! traceFile.read(stackFrame.id)) {
+    template <typename Source>
+    std::optional<Sample> read_compact_sample(Source& source, Sample& previousSample) {
+        std::uint64_t backtraceID = 0;
+        std::uint64_t secondsDelta = 0;
+        std::uint64_t nanosecondsDelta = 0;
+        std::uint64_t threadIDDelta = 0;
+
+        if (! read_varint(source, backtraceID)
+            || ! read_varint(source, secondsDelta)
+            || ! read_varint(source, nanosecondsDelta)
+            || ! read_varint(source, threadIDDelta)) {
             return {};
         }
 
-        if (! traceFile.read(stackFrame.functionNameLength)) {
-            return {};
-        }
-
-        {
-            const auto bytesToWrite = std::min(
-                static_cast<size_t>(stackFrame.functionNameLength),
-                sizeof StackFrame::functionName
-            );
+        previousSample.backtraceID = static_cast<backtrace_id_t>(backtraceID);
+        previousSample.timestamp.seconds = undelta(zigzag_decode(secondsDelta), previousSample.timestamp.seconds);
+        previousSample.timestamp.nanoseconds = undelta(zigzag_decode(nanosecondsDelta), previousSample.timestamp.nanoseconds);
+        previousSample.threadID = static_cast<thread_id_t>(undelta(zigzag_decode(threadIDDelta), previousSample.threadID));
 
-            if (traceFile.read({
-                    stackFrame.functionName,
-                    bytesToWrite
-                }) != bytesToWrite) {
-                return {};
-            }
-        }
+        return previousSample;
+    }
 
-        if (traceFile.read(stackFrame.offset) != sizeof(stackFrame.offset)) {
-            return {};
+    //
+    // Compact samples always carry their thread ID, so only CompactWithThreads (and Raw) sample sections are read.
+    //
+    template <typename Source>
+    std::optional<Sample> read_encoded_sample(Source& source, const TraceFile::SectionEncoding encoding, Sample& previousSample) {
+        switch (encoding) {
+        case TraceFile::SectionEncoding::Raw:                return read_sample(source);
+        case TraceFile::SectionEncoding::CompactWithThreads: return read_compact_sample(source, previousSample);
+        default:                                             return {};
         }
+    }
 
-        if (traceFile.read(stackFrame.instructionPointer) != sizeof(stackFrame.instructionPointer)) {
-            return {};
-        }
+    template <typename Source>
+    std::optional<Backtrace> read_compact_backtrace(Source& source, backtrace_id_t& previousBacktraceID) {
+        Backtrace backtrace;
 
-        if (traceFile.read(stackFrame.lineNumber) != sizeof(stackFrame.lineNumber)) {
-            return {};
-        }
+        std::uint64_t idDelta = 0;
+        std::uint64_t stackFrameIDCount = 0;
 
-        if (traceFile.read(stackFrame.sourceFilePathLength) != sizeof(stackFrame.sourceFilePathLength)) {
+        if (! read_varint(source, idDelta)
+            || ! read_varint(source, stackFrameIDCount)) {
             return {};
         }
 
-        if (traceFile.read({ stackFrame.sourceFilePath,
-                             stackFrame.sourceFilePathLength }) != stackFrame.sourceFilePathLength) {
+        if (stackFrameIDCount == 0 || stackFrameIDCount > static_cast<std::uint64_t>(stack_frame_count_max)) {
             return {};
         }
 
-        return stackFrame;
-    }
-}
-
-TraceFile TraceFile::create_and_open(std::string_view path, const Permissions permissions) noexcept {
-    format_and_write_to_log<128>(
-        LogLevel::Debug,
-        "%: creating %",
-        __func__,
-        path.data()
-    );
-
-    TraceFile traceFile;
-    traceFile.create_and_open_internal(
-        path,
-        permissions
-    );
-
-    // Write out the swimps marker to make such files easily recognisable
-    const auto writeMarkerReturnValue = write_trace_file_marker(traceFile);
-    swimps_assert(writeMarkerReturnValue != -1);
-
-    return traceFile;
-}
+        backtrace.id = undelta(zigzag_decode(idDelta), previousBacktraceID);
+        previousBacktraceID = backtrace.id;
 
-TraceFile TraceFile::create_temporary() noexcept {
-    TraceFile traceFile;
-    traceFile.create_and_open_temporary_internal();
+        // The count hasn't been checked against how many bytes are left, so the IDs are added as they're read,
+        // rather than sized up front; a corrupt count just runs out of bytes.
+        for (std::uint64_t i = 0; i < stackFrameIDCount; ++i) {
+            std::uint64_t encodedStackFrameID = 0;
+            if (! read_varint(source, encodedStackFrameID)) {
+                return {};
+            }
 
-    // Write out the swimps marker to make such files easily recognisable
-    const auto writeMarkerReturnValue = write_trace_file_marker(traceFile);
-    swimps_assert(writeMarkerReturnValue != -1);
+            backtrace.stackFrameIDs.push_back(static_cast<stack_frame_id_t>(encodedStackFrameID));
+        }
 
-    return traceFile;
-}
+        return backtrace;
+    }
 
-TraceFile TraceFile::open_existing(std::string_view path, const Permissions permissions) noexcept {
-    format_and_write_to_log<128>(
-        LogLevel::Debug,
-        "%: opening %",
-        __func__,
-        path.data()
-    );
+    int write_trace_file_marker(TraceFile& targetFile, const TraceFile::Format format, const TraceFile::Compression compression) {
+        const auto& marker = format == TraceFile::Format::V2 ? swimps_v2_trace_file_marker
+                                                             : swimps_v1_trace_file_marker;
 
-    TraceFile traceFile;
-    traceFile.open_existing_internal(path, permissions);
+        const auto bytesWritten = targetFile.write(marker);
 
-    swimps_assert(isSwimpsTraceFile(traceFile));
+        if (bytesWritten != sizeof marker) {
+            targetFile.remove();
+            return -1;
+        }
 
-    return traceFile;
-}
+        if (format == TraceFile::Format::V2
+            && targetFile.write(static_cast<std::uint32_t>(compression)) != sizeof(std::uint32_t)) {
+            targetFile.remove();
+            return -1;
+        }
 
-TraceFile TraceFile::from_raw(std::string_view pathView) noexcept {
-    // TODO: now TraceFile doesn't need to be signal-safe anymore, why not pass in std::filesystem::paths directly?
+        return 0;
+    }
 
-    std::filesystem::path path(pathView);
-    swimps_assert(std::filesystem::exists(path));
+    template <typename Source>
+    std::optional<Backtrace> read_backtrace(Source& source) {
+        Backtrace backtrace;
 
-    std::ifstream rawFile(path.native(), std::ios_base::in | std::ios_base::binary);
-    swimps_assert(rawFile.is_open());
+        if (! source.read(backtrace.id)) {
+            return {};
+        }
 
-    std::noskipws(rawFile);
+        stack_frame_count_t stackFrameIDCount = 0;
+        if (! source.read(stackFrameIDCount) || stackFrameIDCount <= 0) {
+            return {};
+        }
 
-    std::vector<unsigned char> rawData(std::filesystem::file_size(path));
+        // As with compact backtraces, a corrupt count just runs out of bytes.
+        for (stack_frame_count_t i = 0; i < stackFrameIDCount; ++i) {
+            stack_frame_id_t stackFrameID = 0;
+            if (source.read(stackFrameID) != sizeof stackFrameID) {
+                return {};
+            }
 
-    rawFile.read(reinterpret_cast<char*>(rawData.data()), rawData.size());
-    rawFile.close();
+            backtrace.stackFrameIDs.push_back(stackFrameID);
+        }
 
-    const auto rawTrace = samplerpreload::Trace::from(rawData);
-    std::filesystem::remove(path);
+        return backtrace;
+    }
 
-    auto traceFile = create_and_open(path.string(), Permissions::ReadWrite);
+    template <typename Source>
+    bool read_string(Source& source, std::string& string, const std::size_t length) {
+        if (length > max_string_length) {
+            return false;
+        }
 
-    stack_frame_id_t nextStackFrameID = 1;
-    std::unordered_map<instruction_pointer_t, stack_frame_id_t> stackFrameIDMap;
+        string.resize(length);
+        return source.read({ string.data(), string.size() }) == string.size();
+    }
 
-    struct BacktraceHash final {
-        std::size_t operator()(const Backtrace& backtrace) const {
-            return backtrace.id;
+    //
+    // v1 stack frames hold their strings inline, so these are added to the given string table as they're read.
+    // Stack frames are decoded straight into their destination, so that the caller can reuse or place them.
+    //
+    template <typename Source>
+    bool read_stack_frame(Source& source, StackFrame& stackFrame, StringTable& strings) {
+        if (! source.read(stackFrame.id)) {
+            return false;
         }
-    };
 
-    struct BacktraceCompare final {
-        bool operator()(const Backtrace& lhs, const Backtrace& rhs) const {
-            return lhs.stackFrameIDs == rhs.stackFrameIDs;
+        function_name_length_t functionNameLength = 0;
+        if (! source.read(functionNameLength) || functionNameLength < 0) {
+            return false;
         }
-    };
-
-    backtrace_id_t nextBacktraceID = 1;
-    std::unordered_map<Backtrace, backtrace_id_t, BacktraceHash, BacktraceCompare> backtraces;
-    std::vector<StackFrame> stackFrames;
-    std::vector<Sample> samples;
 
-    // Grab a 0.5GB of RAM for each.
-    constexpr std::size_t halfAGigInBytes = 500'000'000;
-    samples.reserve(halfAGigInBytes / sizeof(Sample));
-    stackFrames.reserve(halfAGigInBytes / sizeof(StackFrame));
-
-    for (const auto& rawSample : rawTrace.get_samples()) {
-        Backtrace backtrace;
-
-        for (std::size_t i = 0; i < rawSample.backtrace.size() && rawSample.backtrace[i] != 0; ++i) {
+        std::string functionName;
+        if (! read_string(source, functionName, static_cast<std::size_t>(functionNameLength))) {
+            return false;
+        }
 
-            const auto instructionPointer = rawSample.backtrace[i];
+        if (source.read(stackFrame.offset) != sizeof(stackFrame.offset)) {
+            return false;
+        }
 
-            if (stackFrameIDMap.find(instructionPointer) == stackFrameIDMap.cend()) {
-                stackFrameIDMap[instructionPointer] = nextStackFrameID++;
-            }
+        if (source.read(stackFrame.instructionPointer) != sizeof(stackFrame.instructionPointer)) {
+            return false;
+        }
 
-            const auto stackFrameID = stackFrameIDMap.at(instructionPointer);
+        if (source.read(stackFrame.lineNumber) != sizeof(stackFrame.lineNumber)) {
+            return false;
+        }
 
-            backtrace.stackFrameIDs.push_back(stackFrameIDMap.at(instructionPointer));
+        file_path_length_t sourceFilePathLength = 0;
+        if (source.read(sourceFilePathLength) != sizeof(sourceFilePathLength)) {
+            return false;
+        }
 
-            stackFrames.emplace_back(stackFrameID, instructionPointer);
+        if (sourceFilePathLength > PATH_MAX) {
+            return false;
         }
 
-        auto backtraceIter = backtraces.find(backtrace);
-        if (backtraceIter == backtraces.cend()) {
-            backtraceIter = backtraces.insert({backtrace, nextBacktraceID++}).first;
+        std::string sourceFilePath;
+        if (! read_string(source, sourceFilePath, sourceFilePathLength)) {
+            return false;
         }
 
-        samples.push_back({backtraceIter->second, rawSample.timestamp});
+        stackFrame.functionName = strings.intern(functionName);
+        stackFrame.sourceFilePath = strings.intern(sourceFilePath);
+
+        return true;
     }
 
-    format_and_write_to_log<1024>(
-        LogLevel::Debug,
-        "Finalising...\n"
-        "Samples: %\n"
-        "Backtraces: %\n"
-        "Stack Frames: %\n",
-        samples.size(),
-        backtraces.size(),
-        stackFrames.size()
-    );
+    //
+    // Compact stack frames refer to their strings by ID, which must be in the given string table.
+    //
+    template <typename Source>
+    bool read_compact_stack_frame(Source& source, StackFrame& stackFrame, const StringTable& strings) {
+        std::uint64_t id = 0;
+        std::uint64_t instructionPointer = 0;
+        std::uint64_t offset = 0;
+        std::uint64_t lineNumber = 0;
+        std::uint64_t functionName = 0;
+        std::uint64_t sourceFilePath = 0;
+
+        if (! read_varint(source, id)
+            || ! read_varint(source, instructionPointer)
+            || ! read_varint(source, offset)
+            || ! read_varint(source, lineNumber)
+            || ! read_varint(source, functionName)
+            || ! read_varint(source, sourceFilePath)) {
+            return false;
+        }
 
-    const auto traceFilePath = traceFile.get_path();
-    const auto tempFilePath = std::string("/tmp/") + std::filesystem::path(traceFilePath).filename().string() + ".tmp";
+        if (functionName >= strings.size() || sourceFilePath >= strings.size()) {
+            return false;
+        }
 
-    auto tempFile = TraceFile::create_and_open({ tempFilePath.data(), tempFilePath.length() }, TraceFile::Permissions::ReadWrite);
+        stackFrame.id = zigzag_decode(id);
+        stackFrame.instructionPointer = instructionPointer;
+        stackFrame.offset = offset;
+        stackFrame.lineNumber = zigzag_decode(lineNumber);
+        stackFrame.functionName = static_cast<string_id_t>(functionName);
+        stackFrame.sourceFilePath = static_cast<string_id_t>(sourceFilePath);
 
-    for(const auto& sample : samples) {
-        tempFile.add_sample(sample);
+        return true;
     }
 
-    for(const auto& backtraceKeyValue : backtraces) {
-        tempFile.add_backtrace(backtraceKeyValue.first);
+    template <typename Source>
+    bool read_compact_string(Source& source, std::string& string) {
+        std::uint64_t length = 0;
+        return read_varint(source, length) && read_string(source, string, length);
     }
 
-    for(auto& stackFrame : stackFrames) {
-        const auto instructionPointer = stackFrame.instructionPointer;
+    void write_sample(MemoryWriter& writer, const Sample& sample) {
+        writer.write(sample.backtraceID);
+        writer.write(sample.timestamp.seconds);
+        writer.write(sample.timestamp.nanoseconds);
+    }
 
-        unw_context_t unwindContext{};
+    void write_backtrace(MemoryWriter& writer, const Backtrace& backtrace) {
+        swimps_assert(backtrace.stackFrameIDs.size() > 0);
 
-        #ifdef __clang__
-        #pragma clang diagnostic push
-        #pragma clang diagnostic ignored "-Wgnu-statement-expression"
-        #endif
-        unw_getcontext(&unwindContext);
-        #ifdef __clang__
-        #pragma clang diagnostic pop
-        #endif
-        unw_cursor_t unwindCursor{};
-        unw_init_local(&unwindCursor, &unwindContext);
-        unw_set_reg(&unwindCursor, UNW_REG_IP, instructionPointer);
-        unw_get_proc_name(&unwindCursor, &stackFrame.functionName[0], std::size(stackFrame.functionName), &stackFrame.offset);
+        writer.write(backtrace.id);
+        writer.write(static_cast<stack_frame_count_t>(backtrace.stackFrameIDs.size()));
 
-        tempFile.add_stack_frame(stackFrame);
+        for(const auto& stackFrameID : backtrace.stackFrameIDs) {
+            writer.write(stackFrameID);
+        }
     }
 
-    std::filesystem::copy(tempFilePath, traceFilePath, std::filesystem::copy_options::overwrite_existing);
-
-    return traceFile;
-}
-
-std::size_t TraceFile::add_backtrace(const Backtrace& backtrace) {
-    std::size_t bytesWritten = 0;
+    void write_varint(MemoryWriter& writer, std::uint64_t value) {
+        std::array<std::uint8_t, 10> bytes;
+        std::size_t byteCount = 0;
 
-    swimps_assert(backtrace.stackFrameIDs.size() > 0);
+        while (value >= 0x80) {
+            bytes[byteCount++] = static_cast<std::uint8_t>(value | 0x80);
+            value >>= 7;
+        }
 
-    bytesWritten += write(swimps_v1_trace_symbolic_backtrace_marker);
-    bytesWritten += write(backtrace.id);
-    bytesWritten += write(static_cast<stack_frame_count_t>(backtrace.stackFrameIDs.size()));
+        bytes[byteCount++] = static_cast<std::uint8_t>(value);
 
-    for(const auto& stackFrameID : backtrace.stackFrameIDs) {
-        bytesWritten += write(stackFrameID);
+        writer.write({ reinterpret_cast<const char*>(bytes.data()), byteCount });
     }
 
-    return bytesWritten;
-}
-
-std::size_t TraceFile::add_stack_frame(const StackFrame& stackFrame) {
-    std::size_t bytesWritten = 0;
-
-    bytesWritten += write(swimps_v1_trace_stack_frame_marker);
+    void write_compact_sample(MemoryWriter& writer, const Sample& sample, Sample& previousSample) {
+        write_varint(writer, static_cast<std::uint64_t>(sample.backtraceID));
+        write_varint(writer, zigzag_encode(delta(sample.timestamp.seconds, previousSample.timestamp.seconds)));
+        write_varint(writer, zigzag_encode(delta(sample.timestamp.nanoseconds, previousSample.timestamp.nanoseconds)));
+        write_varint(writer, zigzag_encode(delta(sample.threadID, previousSample.threadID)));
 
-    const auto  id = stackFrame.id;
-    const auto& functionName = stackFrame.functionName;
-    const auto  functionNameLength = static_cast<function_name_length_t>(strnlen(&functionName[0], sizeof functionName));
+        previousSample = sample;
+    }
 
-    const auto& offset = stackFrame.offset;
-    const auto& instructionPointer = stackFrame.instructionPointer;
+    void write_compact_backtrace(MemoryWriter& writer, const Backtrace& backtrace, backtrace_id_t& previousBacktraceID) {
+        swimps_assert(backtrace.stackFrameIDs.size() > 0);
 
-    const auto& lineNumber = stackFrame.lineNumber;
-    const auto& sourceFilePath = stackFrame.sourceFilePath;
-    const auto  sourceFilePathLength = stackFrame.sourceFilePathLength;
+        write_varint(writer, zigzag_encode(delta(backtrace.id, previousBacktraceID)));
+        write_varint(writer, backtrace.stackFrameIDs.size());
 
-    swimps_assert(functionNameLength >= 0);
+        for(const auto& stackFrameID : backtrace.stackFrameIDs) {
+            write_varint(writer, static_cast<std::uint64_t>(stackFrameID));
+        }
 
-    bytesWritten += write(id);
-    bytesWritten += write(functionNameLength);
-    bytesWritten += write({ &functionName[0], static_cast<size_t>(functionNameLength) });
-    bytesWritten += write(offset);
-    bytesWritten += write(instructionPointer);
-    bytesWritten += write(lineNumber);
-    bytesWritten += write(sourceFilePathLength);
-    bytesWritten += write({ sourceFilePath, static_cast<size_t>(sourceFilePathLength) });
+        previousBacktraceID = backtrace.id;
+    }
 
-    return bytesWritten;
-}
+    void write_stack_frame(MemoryWriter& writer, const StackFrame& stackFrame, const StringTable& strings) {
+        const auto functionName = strings.get(stackFrame.functionName);
+        const auto sourceFilePath = strings.get(stackFrame.sourceFilePath);
+
+        swimps_assert(functionName.size() <= max_string_length);
+        swimps_assert(sourceFilePath.size() <= PATH_MAX);
+
+        writer.write(stackFrame.id);
+        writer.write(static_cast<function_name_length_t>(functionName.size()));
+        writer.write({ functionName.data(), functionName.size() });
+        writer.write(stackFrame.offset);
+        writer.write(stackFrame.instructionPointer);
+        writer.write(stackFrame.lineNumber);
+        writer.write(static_cast<file_path_length_t>(sourceFilePath.size()));
+        writer.write({ sourceFilePath.data(), sourceFilePath.size() });
+    }
 
-std::size_t TraceFile::add_sample(const Sample& sample) {
-    std::size_t bytesWritten = 0;
+    void write_compact_stack_frame(MemoryWriter& writer, const StackFrame& stackFrame) {
+        write_varint(writer, zigzag_encode(stackFrame.id));
+        write_varint(writer, stackFrame.instructionPointer);
+        write_varint(writer, stackFrame.offset);
+        write_varint(writer, zigzag_encode(stackFrame.lineNumber));
+        write_varint(writer, stackFrame.functionName);
+        write_varint(writer, stackFrame.sourceFilePath);
+    }
 
-    bytesWritten += write(swimps_v1_trace_sample_marker);
-    bytesWritten += write(sample.backtraceID);
-    bytesWritten += write(sample.timestamp.seconds);
-    bytesWritten += write(sample.timestamp.nanoseconds);
+    void write_compact_thread(MemoryWriter& writer, const Thread& thread) {
+        write_varint(writer, zigzag_encode(thread.id));
+        write_varint(writer, thread.name);
+    }
 
-    return bytesWritten;
-}
+    void write_compact_string(MemoryWriter& writer, const std::string_view string) {
+        swimps_assert(string.size() <= max_string_length);
 
-TraceFile::Entry TraceFile::read_next_entry() noexcept {
-    const auto entryKind = read_next_entry_kind(*this);
+        write_varint(writer, string.size());
+        writer.write({ string.data(), string.size() });
+    }
 
-    format_and_write_to_log<128>(
-        LogLevel::Debug,
-        "Trace file entry kind: %.",
-        static_cast<int>(entryKind)
-    );
+    bool is_selected(const TraceFile::SectionKind kind, const TraceSelection& selection) {
+        switch (kind) {
+        case TraceFile::SectionKind::Samples:     return selection.samples;
+        case TraceFile::SectionKind::Backtraces:  return selection.backtraces;
+        case TraceFile::SectionKind::StackFrames: return selection.stackFrames;
+        default:                                  return false;
+        }
+    }
 
-    switch(entryKind) {
-    case EntryKind::Sample:
-        {
-            const auto sample = read_sample(*this);
-            if (!sample) {
+    EntryKind to_entry_kind(const TraceFile::SectionKind kind) {
+        switch (kind) {
+        case TraceFile::SectionKind::Samples:     return EntryKind::Sample;
+        case TraceFile::SectionKind::Backtraces:  return EntryKind::SymbolicBacktrace;
+        case TraceFile::SectionKind::StackFrames: return EntryKind::StackFrame;
+        default:                                  return EntryKind::Unknown;
+        }
+    }
 
-                write_to_log(
+    std::optional<Trace> read_v1_trace_from_memory(std::span<const std::byte> bytes, const TraceSelection& selection) {
+        MemoryReader reader(bytes);
+        Trace trace;
+
+        while (true) {
+            switch (read_next_entry_kind(reader)) {
+            case EntryKind::Sample:
+                {
+                    const auto sample = read_sample(reader);
+                    if (! sample) {
+                        write_to_log(LogLevel::Fatal, "Reading sample failed.");
+                        return trace;
+                    }
+
+                    if (selection.samples) {
+                        trace.samples.push_back(*sample);
+                    }
+                }
+                break;
+            case EntryKind::SymbolicBacktrace:
+                {
+                    auto backtrace = read_backtrace(reader);
+                    if (! backtrace) {
+                        write_to_log(LogLevel::Fatal, "Reading backtrace failed.");
+                        return trace;
+                    }
+
+                    if (selection.backtraces) {
+                        trace.backtraces.push_back(std::move(*backtrace));
+                    }
+                }
+                break;
+            case EntryKind::StackFrame:
+                if (! read_stack_frame(reader, trace.stackFrames.emplace_back(), trace.strings)) {
+                    trace.stackFrames.pop_back();
+                    write_to_log(LogLevel::Fatal, "Reading stack frame failed.");
+                    return trace;
+                }
+
+                if (! selection.stackFrames) {
+                    trace.stackFrames.pop_back();
+                }
+                break;
+            case EntryKind::EndOfFile:
+                return trace;
+            case EntryKind::Unknown:
+            default:
+                format_and_write_to_log<128>(
                     LogLevel::Fatal,
-                    "Reading sample failed."
+                    "Error reading trace file: %",
+                    static_cast<int>(ErrorCode::UnknownEntryKind)
                 );
 
-                return ErrorCode::ReadSampleFailed;
+                return trace;
             }
-
-            return *sample;
         }
-    case EntryKind::SymbolicBacktrace:
-        {
-            const auto backtrace = read_backtrace(*this);
-            if (!backtrace) {
-                write_to_log(
-                    LogLevel::Fatal,
-                    "Reading backtrace failed."
-                );
+    }
 
-                return ErrorCode::ReadBacktraceFailed;
+    //
+    // Gets the fewest bytes an entry of a v2 section could be encoded in, so that the entry counts
+    // in a section table can be checked against the bytes there are before anything is sized by them.
+    //
+    std::size_t get_min_entry_size(const TraceFile::SectionKind kind, const TraceFile::SectionEncoding encoding) {
+        if (encoding == TraceFile::SectionEncoding::Raw) {
+            switch (kind) {
+            case TraceFile::SectionKind::Samples:    return sizeof(backtrace_id_t) + sizeof(TimeSpecification::seconds) + sizeof(TimeSpecification::nanoseconds);
+            case TraceFile::SectionKind::Backtraces: return sizeof(backtrace_id_t) + sizeof(stack_frame_count_t) + sizeof(stack_frame_id_t);
+            default:                                 return 1;
             }
+        }
 
-            return *backtrace;
+        // Compact entries are made up of varints, each at least a byte long.
+        switch (kind) {
+        case TraceFile::SectionKind::Samples:     return 4; // backtrace ID, seconds, nanoseconds and thread ID
+        case TraceFile::SectionKind::Backtraces:  return 3; // ID, stack frame count, and at least one stack frame ID
+        case TraceFile::SectionKind::StackFrames: return 6;
+        case TraceFile::SectionKind::Strings:     return 1; // an empty string is just its length
+        case TraceFile::SectionKind::Threads:     return 2;
+        default:                                  return 1;
         }
-    case EntryKind::StackFrame:
-        {
-            const auto stackFrame = read_stack_frame(*this);
-            if (!stackFrame) {
-                write_to_log(
-                    LogLevel::Fatal,
-                    "Reading stack frame failed."
+    }
+
+    //
+    // Gets a block's stored bytes out of a mapping of the whole file,
+    // or nothing if the file has shrunk since its section table was read.
+    //
+    std::optional<std::span<const std::byte>> get_stored_bytes(std::span<const std::byte> fileBytes, const TraceFile::Block& block) {
+        if (block.offset > fileBytes.size() || block.storedSize > fileBytes.size() - block.offset) {
+            format_and_write_to_log<128>(
+                LogLevel::Fatal,
+                "v2 trace file block at offset % is beyond the end of the file.",
+                block.offset
+            );
+
+            return {};
+        }
+
+        return fileBytes.subspan(block.offset, block.storedSize);
+    }
+
+    //
+    // Makes room in the trace for all of a v2 section's entries, returning the index of the first one.
+    // The section's entry count is known up front, so the target is sized exactly
+    // and each block can be decoded straight into its own part of it.
+    // Entry counts were checked against the bytes their blocks could hold when the section table was read.
+    //
+    std::size_t resize_for_v2_section(const TraceFile::Section& section, Trace& trace) {
+        const auto grow = [&section](auto& entries) {
+            const auto firstIndex = entries.size();
+            entries.resize(firstIndex + section.entryCount);
+            return firstIndex;
+        };
+
+        switch (section.kind) {
+        case TraceFile::SectionKind::Samples:     return grow(trace.samples);
+        case TraceFile::SectionKind::Backtraces:  return grow(trace.backtraces);
+        case TraceFile::SectionKind::StackFrames: return grow(trace.stackFrames);
+        default:                                  return 0;
+        }
+    }
+
+    //
+    // Decodes all of a v2 block's entries into the trace, starting at the given index.
+    // The bytes must already be decompressed, and the trace already sized by resize_for_v2_section.
+    // Different blocks write to different entries, so they can be decoded concurrently.
+    //
+    bool read_v2_block(
+        const TraceFile::Section& section,
+        const TraceFile::Block& block,
+        std::span<const std::byte> bytes,
+        const StringTable& strings,
+        Trace& trace,
+        const std::size_t firstIndex) {
+
+        MemoryReader reader(bytes);
+
+        const bool isCompact = section.encoding == TraceFile::SectionEncoding::Compact;
+        Sample previousSample{};
+        backtrace_id_t previousBacktraceID = 0;
+
+        switch (section.kind) {
+        case TraceFile::SectionKind::Samples:
+            for (std::uint32_t i = 0; i < block.entryCount; ++i) {
+                const auto sample = read_encoded_sample(reader, section.encoding, previousSample);
+                if (! sample) {
+                    write_to_log(LogLevel::Fatal, "Reading sample failed.");
+                    return false;
+                }
+
+                trace.samples[firstIndex + i] = *sample;
+            }
+            break;
+        case TraceFile::SectionKind::Backtraces:
+            for (std::uint32_t i = 0; i < block.entryCount; ++i) {
+                auto backtrace = isCompact ? read_compact_backtrace(reader, previousBacktraceID)
+                                           : read_backtrace(reader);
+                if (! backtrace) {
+                    write_to_log(LogLevel::Fatal, "Reading backtrace failed.");
+                    return false;
+                }
+
+                trace.backtraces[firstIndex + i] = std::move(*backtrace);
+            }
+            break;
+        case TraceFile::SectionKind::StackFrames:
+            // v2 stack frames are always compact, as they only have a string table to refer to.
+            if (! isCompact) {
+                return false;
+            }
+
+            for (std::uint32_t i = 0; i < block.entryCount; ++i) {
+                if (! read_compact_stack_frame(reader, trace.stackFrames[firstIndex + i], strings)) {
+                    write_to_log(LogLevel::Fatal, "Reading stack frame failed.");
+                    return false;
+                }
+            }
+            break;
+        default:
+            return false;
+        }
+
+        if (reader.remaining() != 0) {
+            format_and_write_to_log<128>(
+                LogLevel::Fatal,
+                "Block in section of kind % has % unexpected trailing bytes.",
+                static_cast<std::uint32_t>(section.kind),
+                reader.remaining()
+            );
+
+            return false;
+        }
+
+        return true;
+    }
+
+    //
+    // Gets a v2 block's bytes as they were before being stored,
+    // decompressing them into the scratch buffer if need be.
+    // Blocks that compression wouldn't have made any smaller are stored as they are, even in compressed files.
+    //
+    std::optional<std::span<const std::byte>> unpack_v2_block(
+        const TraceFile::Compression compression,
+        const TraceFile::Block& block,
+        std::span<const std::byte> storedBytes,
+        std::vector<char>& scratch) {
+
+        if (compression == TraceFile::Compression::None || block.storedSize == block.size) {
+            return storedBytes;
+        }
+
+        scratch.resize(block.size);
+
+        const int decompressedSize = LZ4_decompress_safe(
+            reinterpret_cast<const char*>(storedBytes.data()),
+            scratch.data(),
+            static_cast<int>(storedBytes.size()),
+            static_cast<int>(scratch.size())
+        );
+
+        if (decompressedSize < 0 || static_cast<std::uint32_t>(decompressedSize) != block.size) {
+            format_and_write_to_log<128>(
+                LogLevel::Fatal,
+                "Could not decompress block at offset % (LZ4 returned %).",
+                block.offset,
+                decompressedSize
+            );
+
+            return {};
+        }
+
+        return std::as_bytes(std::span(scratch));
+    }
+
+    //
+    // Decodes an entry, once its kind is known.
+    // v1 entries are always raw; v2 entries are encoded however their section says.
+    //
+    template <typename Source>
+    TraceFile::Entry read_entry(
+        Source& source,
+        const EntryKind entryKind,
+        const TraceFile::SectionEncoding encoding,
+        StringTable& strings,
+        Sample& previousSample,
+        backtrace_id_t& previousBacktraceID) {
+
+        format_and_write_to_log<128>(
+            LogLevel::Debug,
+            "Trace file entry kind: %.",
+            static_cast<int>(entryKind)
+        );
+
+        switch(entryKind) {
+        case EntryKind::Sample:
+            {
+                const auto sample = read_encoded_sample(source, encoding, previousSample);
+
+                if (!sample) {
+
+                    write_to_log(
+                        LogLevel::Fatal,
+                        "Reading sample failed."
+                    );
+
+                    return ErrorCode::ReadSampleFailed;
+                }
+
+                return *sample;
+            }
+        case EntryKind::SymbolicBacktrace:
+            {
+                const auto backtrace = encoding == TraceFile::SectionEncoding::Compact
+                    ? read_compact_backtrace(source, previousBacktraceID)
+                    : read_backtrace(source);
+
+                if (!backtrace) {
+                    write_to_log(
+                        LogLevel::Fatal,
+                        "Reading backtrace failed."
+                    );
+
+                    return ErrorCode::ReadBacktraceFailed;
+                }
+
+                return *backtrace;
+            }
+        case EntryKind::StackFrame:
+            {
+                StackFrame stackFrame;
+                const bool readStackFrameSucceeded = encoding == TraceFile::SectionEncoding::Compact
+                    ? read_compact_stack_frame(source, stackFrame, strings)
+                    : read_stack_frame(source, stackFrame, strings);
+
+                if (! readStackFrameSucceeded) {
+                    write_to_log(
+                        LogLevel::Fatal,
+                        "Reading stack frame failed."
+                    );
+
+                    return ErrorCode::ReadStackFrameFailed;
+                }
+
+                return stackFrame;
+            }
+        case EntryKind::EndOfFile:
+            return ErrorCode::EndOfFile;
+        case EntryKind::Unknown:
+        default:
+            write_to_log(
+                LogLevel::Debug,
+                "Unknown entry kind detected, bailing."
+            );
+
+            return ErrorCode::UnknownEntryKind;
+        }
+    }
+
+    //
+    // Decodes the selected sections of a mapped v2 file, a block per task.
+    //
+    std::optional<Trace> read_v2_trace_in_parallel(
+        const std::vector<TraceFile::Section>& sections,
+        const StringTable& strings,
+        const TraceFile::Compression compression,
+        std::span<const std::byte> fileBytes,
+        const TraceSelection& selection) {
+
+        struct BlockToRead {
+            const TraceFile::Section& section;
+            const TraceFile::Block& block;
+            std::size_t firstIndex = 0;
+        };
+
+        // All of the trace is sized before any decoding starts,
+        // so no task can reallocate a vector that another task is writing into.
+        Trace trace;
+        std::vector<BlockToRead> blocksToRead;
+
+        for (const auto& section : sections) {
+            if (! is_selected(section.kind, selection)) {
+                continue;
+            }
+
+            auto nextIndex = resize_for_v2_section(section, trace);
+
+            for (const auto& block : section.blocks) {
+                blocksToRead.push_back({ section, block, nextIndex });
+                nextIndex += block.entryCount;
+            }
+        }
+
+        ThreadPool threadPool(std::min(swimps::thread::default_thread_count(), std::max<std::size_t>(blocksToRead.size(), 1)));
+        std::vector<std::future<bool>> blocksRead;
+        blocksRead.reserve(blocksToRead.size());
+
+        for (const auto& blockToRead : blocksToRead) {
+            blocksRead.push_back(threadPool.submit([&trace, &strings, compression, fileBytes, blockToRead](){
+                std::vector<char> scratch;
+                const auto& block = blockToRead.block;
+
+                const auto storedBytes = get_stored_bytes(fileBytes, block);
+                if (! storedBytes) {
+                    return false;
+                }
+
+                const auto blockBytes = unpack_v2_block(compression, block, *storedBytes, scratch);
+
+                return blockBytes.has_value()
+                    && read_v2_block(blockToRead.section, block, *blockBytes, strings, trace, blockToRead.firstIndex);
+            }));
+        }
+
+        // Every task has to finish before the trace can be returned (or destroyed), even if one has already failed.
+        bool succeeded = true;
+        for (auto& blockRead : blocksRead) {
+            succeeded = blockRead.get() && succeeded;
+        }
+
+        if (! succeeded) {
+            return {};
+        }
+
+        trace.strings = strings;
+        return trace;
+    }
+
+    bool read_exactly(TraceFile& traceFile, std::span<char> target) {
+        while (! target.empty()) {
+            const auto bytesRead = traceFile.read(target);
+            if (bytesRead == 0) {
+                return false;
+            }
+
+            target = target.subspan(bytesRead);
+        }
+
+        return true;
+    }
+
+    // Raw traces are parsed this many samples at a time, so only that many are ever held at once.
+    constexpr std::size_t raw_samples_per_chunk = 4096;
+
+    //
+    // Checks that a path can be opened with the given flags, without keeping it open.
+    //
+    bool can_open(const std::string& path, const int flags) {
+        const int fileDescriptor = open(path.c_str(), flags | O_CLOEXEC, 0644);
+        if (fileDescriptor == -1) {
+            return false;
+        }
+
+        close(fileDescriptor);
+        return true;
+    }
+
+    //
+    // Flushes a file's data (or a directory's entries) to disk. The path is opened with the given flags.
+    //
+    bool sync_to_disk(const std::string& path, const int flags) {
+        const int fileDescriptor = open(path.c_str(), flags | O_CLOEXEC);
+        if (fileDescriptor == -1) {
+            return false;
+        }
+
+        const bool synced = fsync(fileDescriptor) == 0;
+        close(fileDescriptor);
+        return synced;
+    }
+
+    //
+    // Loads the memory maps the profiler recorded from the profiled process, if it left any.
+    //
+    std::optional<std::vector<MemoryMap>> load_memory_maps(const std::string_view traceFilePath) {
+        std::ifstream memoryMapsFile(swimps::symbol::get_memory_maps_path(traceFilePath));
+        if (! memoryMapsFile.is_open()) {
+            return {};
+        }
+
+        const std::string memoryMaps(std::istreambuf_iterator<char>(memoryMapsFile), {});
+        return swimps::symbol::parse_memory_maps(memoryMaps);
+    }
+
+    //
+    // Resolves a stack frame against swimps' own address space.
+    // Only right for addresses that are the same in both processes, such as those in a non-PIE executable.
+    //
+    void symbolise_in_process(StackFrame& stackFrame, StringTable& strings) {
+        unw_context_t unwindContext{};
+
+        #ifdef __clang__
+        #pragma clang diagnostic push
+        #pragma clang diagnostic ignored "-Wgnu-statement-expression"
+        #endif
+        unw_getcontext(&unwindContext);
+        #ifdef __clang__
+        #pragma clang diagnostic pop
+        #endif
+        unw_cursor_t unwindCursor{};
+        unw_init_local(&unwindCursor, &unwindContext);
+        unw_set_reg(&unwindCursor, UNW_REG_IP, stackFrame.instructionPointer);
+        char functionName[256] = { };
+        unw_get_proc_name(&unwindCursor, &functionName[0], std::size(functionName), &stackFrame.offset);
+        stackFrame.functionName = strings.intern({ functionName, strnlen(functionName, sizeof functionName) });
+    }
+
+    //
+    // The stack frames that each instruction pointer's stack frame becomes once it is symbolised:
+    // one for each function inlined at the instruction pointer, innermost first,
+    // then one for the function they were all inlined into (or just that one, if nothing was inlined there).
+    //
+    struct SymbolisedStackFrames {
+        // Numbered from 1, in the order of the stack frames they came from.
+        std::vector<StackFrame> stackFrames;
+
+        // The stack frame with ID n becomes those from starts[n - 1] up to starts[n].
+        std::vector<std::size_t> starts = { 0 };
+
+        void add(StackFrame stackFrame) {
+            stackFrame.id = static_cast<stack_frame_id_t>(stackFrames.size() + 1);
+            stackFrames.push_back(stackFrame);
+        }
+
+        void end_expansion() {
+            starts.push_back(stackFrames.size());
+        }
+    };
+
+    //
+    // Resolves every stack frame against the profiled process's memory maps, symbolising them in parallel.
+    // The results are interned in stack frame order, so the string table comes out the same however it was split up.
+    //
+    SymbolisedStackFrames symbolise(std::span<const StackFrame> stackFrames, StringTable& strings, const std::vector<MemoryMap>& memoryMaps) {
+        std::vector<swimps::symbol::address_t> instructionPointers;
+        instructionPointers.reserve(stackFrames.size());
+        for (const auto& stackFrame : stackFrames) {
+            instructionPointers.push_back(stackFrame.instructionPointer);
+        }
+
+        const auto symbols = swimps::symbol::symbolise_in_parallel(
+            instructionPointers,
+            memoryMaps,
+            swimps::symbol::get_symbol_cache_directory()
+        );
+
+        SymbolisedStackFrames symbolisedStackFrames;
+        symbolisedStackFrames.stackFrames.reserve(stackFrames.size());
+        symbolisedStackFrames.starts.reserve(stackFrames.size() + 1);
+
+        for (std::size_t i = 0; i < stackFrames.size(); ++i) {
+            auto stackFrame = stackFrames[i];
+            const auto& symbol = symbols[i];
+
+            if (symbol.has_value()) {
+                for (const auto& inlinedFrame : symbol->inlinedFrames) {
+                    StackFrame inlinedStackFrame(0, stackFrame.instructionPointer);
+                    inlinedStackFrame.functionName = strings.intern(inlinedFrame.functionName);
+                    inlinedStackFrame.sourceFilePath = strings.intern(inlinedFrame.sourceFilePath);
+                    inlinedStackFrame.lineNumber = inlinedFrame.lineNumber;
+                    symbolisedStackFrames.add(inlinedStackFrame);
+                }
+
+                stackFrame.functionName = strings.intern(symbol->functionName);
+                stackFrame.offset = symbol->offset;
+                stackFrame.sourceFilePath = strings.intern(symbol->sourceFilePath);
+                stackFrame.lineNumber = symbol->lineNumber;
+            }
+
+            symbolisedStackFrames.add(stackFrame);
+            symbolisedStackFrames.end_expansion();
+        }
+
+        return symbolisedStackFrames;
+    }
+}
+
+TraceFile TraceFile::create_and_open(std::string_view path, const Permissions permissions, const Format format, const Compression compression) noexcept {
+    format_and_write_to_log<128>(
+        LogLevel::Debug,
+        "%: creating %",
+        __func__,
+        path.data()
+    );
+
+    TraceFile traceFile;
+    traceFile.create_and_open_internal(
+        path,
+        permissions
+    );
+
+    swimps_assert(format == Format::V2 || compression == Compression::None);
+
+    traceFile.m_format = format;
+    traceFile.m_compression = compression;
+
+    // Write out the swimps marker to make such files easily recognisable
+    const auto writeMarkerReturnValue = write_trace_file_marker(traceFile, format, compression);
+    swimps_assert(writeMarkerReturnValue != -1);
+
+    traceFile.m_nextBlockOffset = swimps_v2_trace_header_size;
+
+    return traceFile;
+}
+
+std::optional<TraceFile> TraceFile::try_create_and_open(std::string_view path, const Permissions permissions, const Format format, const Compression compression) noexcept {
+    format_and_write_to_log<128>(
+        LogLevel::Debug,
+        "%: creating %",
+        __func__,
+        path.data()
+    );
+
+    if (format != Format::V2 && compression != Compression::None) {
+        write_to_log(LogLevel::Fatal, "Only v2 trace files can be compressed.");
+        return {};
+    }
+
+    // File doesn't say whether it managed to create the path, so that's checked first.
+    const std::string pathString(path);
+    if (! can_open(pathString, O_WRONLY | O_CREAT)) {
+        format_and_write_to_log<512>(
+            LogLevel::Fatal,
+            "Could not create trace file %, errno %.",
+            pathString.c_str(),
+            errno
+        );
+
+        return {};
+    }
+
+    TraceFile traceFile;
+    traceFile.create_and_open_internal(
+        path,
+        permissions
+    );
+
+    traceFile.m_format = format;
+    traceFile.m_compression = compression;
+
+    if (write_trace_file_marker(traceFile, format, compression) == -1) {
+        format_and_write_to_log<512>(
+            LogLevel::Fatal,
+            "Could not write the marker of trace file %.",
+            pathString.c_str()
+        );
+
+        traceFile.close();
+        return {};
+    }
+
+    traceFile.m_nextBlockOffset = swimps_v2_trace_header_size;
+
+    return traceFile;
+}
+
+TraceFile TraceFile::create_temporary(const Format format, const Compression compression) noexcept {
+    TraceFile traceFile;
+    traceFile.create_and_open_temporary_internal();
+
+    swimps_assert(format == Format::V2 || compression == Compression::None);
+
+    traceFile.m_format = format;
+    traceFile.m_compression = compression;
+
+    // Write out the swimps marker to make such files easily recognisable
+    const auto writeMarkerReturnValue = write_trace_file_marker(traceFile, format, compression);
+    swimps_assert(writeMarkerReturnValue != -1);
+
+    traceFile.m_nextBlockOffset = swimps_v2_trace_header_size;
+
+    return traceFile;
+}
+
+TraceFile TraceFile::open_existing(std::string_view path, const Permissions permissions) noexcept {
+    auto traceFile = try_open_existing(path, permissions);
+    swimps_assert(traceFile.has_value());
+
+    return std::move(*traceFile);
+}
+
+std::optional<TraceFile> TraceFile::try_open_existing(std::string_view path, const Permissions permissions) noexcept {
+    format_and_write_to_log<128>(
+        LogLevel::Debug,
+        "%: opening %",
+        __func__,
+        path.data()
+    );
+
+    // File doesn't say whether it managed to open the path, so that's checked first.
+    const std::string pathString(path);
+    if (! can_open(pathString, permissions == Permissions::ReadOnly ? O_RDONLY : O_RDWR)) {
+        format_and_write_to_log<512>(
+            LogLevel::Fatal,
+            "Could not open trace file %, errno %.",
+            pathString.c_str(),
+            errno
+        );
+
+        return {};
+    }
+
+    TraceFile traceFile;
+    traceFile.open_existing_internal(path, permissions);
+
+    const auto format = read_trace_file_marker(traceFile);
+    if (! format) {
+        write_to_log(
+            LogLevel::Fatal,
+            "Missing swimps trace file marker."
+        );
+
+        return {};
+    }
+
+    traceFile.m_format = *format;
+
+    if (traceFile.m_format == Format::V2) {
+        std::uint32_t compression = 0;
+        if (traceFile.read(compression) != sizeof compression
+            || compression > static_cast<std::uint32_t>(Compression::LZ4)) {
+            format_and_write_to_log<128>(
+                LogLevel::Fatal,
+                "Unknown v2 trace file compression %.",
+                compression
+            );
+
+            return {};
+        }
+
+        traceFile.m_compression = static_cast<Compression>(compression);
+
+        // Each of these logs why it failed.
+        if (! traceFile.read_section_table() || ! traceFile.read_string_table() || ! traceFile.read_thread_table()) {
+            return {};
+        }
+    }
+
+    return traceFile;
+}
+
+std::optional<TraceFile> TraceFile::from_raw(std::string_view pathView, const Compression compression) noexcept {
+    // TODO: now TraceFile doesn't need to be signal-safe anymore, why not pass in std::filesystem::paths directly?
+
+    std::filesystem::path path(pathView);
+
+    // The raw trace stays where it is until the converted one replaces it, so a conversion that dies part way
+    // through can just be run again. The converted trace is written next to it, so that it can be renamed into place.
+    const auto traceFilePath = path.string();
+    const auto tempFilePath = traceFilePath + "." + std::to_string(getpid()) + ".tmp";
+
+    std::ifstream rawFile(path.native(), std::ios_base::in | std::ios_base::binary);
+    if (! rawFile.is_open()) {
+        format_and_write_to_log<512>(LogLevel::Fatal, "Could not open raw trace file % to convert it.", traceFilePath.c_str());
+        return {};
+    }
+
+    auto maybeTempFile = TraceFile::try_create_and_open(tempFilePath, TraceFile::Permissions::ReadWrite, Format::V2, compression);
+    if (! maybeTempFile.has_value()) {
+        format_and_write_to_log<512>(LogLevel::Fatal, "Could not create converted trace file %.", tempFilePath.c_str());
+        return {};
+    }
+
+    auto& tempFile = *maybeTempFile;
+
+    // Whatever goes wrong, the raw trace is left as it was, and the half-written converted one is cleaned up.
+    const auto abandon = [&tempFile, &tempFilePath]() {
+        tempFile.close();
+
+        std::error_code errorCode;
+        std::filesystem::remove(tempFilePath, errorCode);
+    };
+
+    stack_frame_id_t nextStackFrameID = 1;
+    std::unordered_map<instruction_pointer_t, stack_frame_id_t> stackFrameIDMap;
+
+    BacktraceTable backtraces;
+    std::vector<stack_frame_id_t> stackFrameIDs;
+    std::vector<StackFrame> stackFrames;
+    StringTable strings;
+
+    // The raw trace is a run of fixed size samples, so it's parsed a chunk of whole samples at a time.
+    // Samples only need their backtrace's ID, which is known as soon as the backtrace is seen,
+    // so they go straight into the trace file rather than being held on to.
+    std::vector<unsigned char> rawData;
+    std::size_t sampleCount = 0;
+
+    while (rawFile) {
+        rawData.resize(raw_samples_per_chunk * sizeof(samplerpreload::Sample));
+        rawFile.read(reinterpret_cast<char*>(rawData.data()), static_cast<std::streamsize>(rawData.size()));
+        rawData.resize(static_cast<std::size_t>(rawFile.gcount()));
+
+        const auto rawTrace = samplerpreload::Trace::from(rawData);
+        sampleCount += rawTrace.get_samples().size();
+
+        for (const auto& rawSample : rawTrace.get_samples()) {
+            stackFrameIDs.clear();
+
+            for (std::size_t i = 0; i < rawSample.backtrace.size() && rawSample.backtrace[i] != 0; ++i) {
+
+                const auto instructionPointer = rawSample.backtrace[i];
+
+                // Each instruction pointer gets one stack frame, made (and later symbolised) the first time it's seen.
+                const auto [stackFrameIDIter, isNewStackFrame] = stackFrameIDMap.try_emplace(instructionPointer, nextStackFrameID);
+                if (isNewStackFrame) {
+                    stackFrames.emplace_back(nextStackFrameID++, instructionPointer);
+                }
+
+                stackFrameIDs.push_back(stackFrameIDIter->second);
+            }
+
+            // The sampler doesn't record which thread each sample was taken on, so they're all put down to the unknown one.
+            tempFile.add_sample({backtraces.intern(stackFrameIDs), rawSample.timestamp});
+        }
+    }
+
+    if (rawFile.bad()) {
+        format_and_write_to_log<512>(LogLevel::Fatal, "Could not read raw trace file %.", traceFilePath.c_str());
+        abandon();
+        return {};
+    }
+
+    format_and_write_to_log<1024>(
+        LogLevel::Debug,
+        "Finalising...\n"
+        "Samples: %\n"
+        "Backtraces: %\n"
+        "Stack Frames: %\n",
+        sampleCount,
+        backtraces.size(),
+        stackFrames.size()
+    );
+
+    // The profiler records the target's memory maps, so its instruction pointers can be resolved against the right files.
+    // Without them, the best that can be done is to assume it was laid out the same as swimps.
+    SymbolisedStackFrames symbolisedStackFrames;
+
+    if (const auto memoryMaps = load_memory_maps(pathView)) {
+        symbolisedStackFrames = symbolise(stackFrames, strings, *memoryMaps);
+    } else {
+        write_to_log(LogLevel::Warning, "No memory maps were recorded for the trace, so it is being symbolised in-process.");
+
+        for (auto& stackFrame : stackFrames) {
+            symbolise_in_process(stackFrame, strings);
+            symbolisedStackFrames.add(stackFrame);
+            symbolisedStackFrames.end_expansion();
+        }
+    }
+
+    // Each instruction pointer was only symbolised once, however many backtraces it's in;
+    // its stack frames are just copied into each of them.
+    for (backtrace_id_t backtraceID = 1; static_cast<std::size_t>(backtraceID) <= backtraces.size(); ++backtraceID) {
+        Backtrace backtrace;
+        backtrace.id = backtraceID;
+
+        for (const auto stackFrameID : backtraces.get(backtraceID)) {
+            const auto start = symbolisedStackFrames.starts[stackFrameID - 1];
+            const auto end = symbolisedStackFrames.starts[stackFrameID];
+
+            for (auto i = start; i < end; ++i) {
+                backtrace.stackFrameIDs.push_back(symbolisedStackFrames.stackFrames[i].id);
+            }
+        }
+
+        tempFile.add_backtrace(backtrace);
+    }
+
+    for (const auto& stackFrame : symbolisedStackFrames.stackFrames) {
+        tempFile.add_stack_frame(stackFrame, strings);
+    }
+
+    if (! tempFile.finalise()) {
+        format_and_write_to_log<512>(LogLevel::Fatal, "Could not write converted trace file %.", tempFilePath.c_str());
+        abandon();
+        return {};
+    }
+
+    if (! tempFile.close()) {
+        format_and_write_to_log<512>(LogLevel::Fatal, "Could not close converted trace file %.", tempFilePath.c_str());
+        abandon();
+        return {};
+    }
+
+    // The path holds either the whole raw trace or the whole converted one, whatever happens.
+    // If the converted one is lost to a crash, the raw one can just be converted again.
+    if (! move_into_place(tempFilePath, traceFilePath)) {
+        return {};
+    }
+
+    std::error_code errorCode;
+    std::filesystem::remove(swimps::symbol::get_memory_maps_path(traceFilePath), errorCode);
+
+    return try_open_existing(traceFilePath, Permissions::ReadWrite);
+}
+
+bool swimps::trace::move_into_place(const std::string_view tempFilePathView, const std::string_view targetPathView) noexcept {
+    const std::string tempFilePath(tempFilePathView);
+    const std::string targetPath(targetPathView);
+
+    const auto abandon = [&tempFilePath]() {
+        std::error_code errorCode;
+        std::filesystem::remove(tempFilePath, errorCode);
+        return false;
+    };
+
+    // Renaming is atomic, but that only holds across a crash if the file's data reaches the disk before the rename does.
+    if (! sync_to_disk(tempFilePath, O_RDONLY)) {
+        format_and_write_to_log<512>(LogLevel::Fatal, "Could not sync trace file % to disk, errno %.", tempFilePath.c_str(), errno);
+        return abandon();
+    }
+
+    std::error_code errorCode;
+    std::filesystem::rename(tempFilePath, targetPath, errorCode);
+    if (errorCode) {
+        format_and_write_to_log<1024>(
+            LogLevel::Fatal,
+            "Could not rename trace file % to %: %.",
+            tempFilePath.c_str(),
+            targetPath.c_str(),
+            errorCode.message().c_str()
+        );
+
+        return abandon();
+    }
+
+    // The rename itself is only on disk once the directory is. If it isn't, the file is still there to be read now;
+    // a crash could just bring back whatever was at the target path before.
+    const std::filesystem::path path(targetPath);
+    const auto directoryPath = path.has_parent_path() ? path.parent_path().string() : std::string(".");
+    if (! sync_to_disk(directoryPath, O_RDONLY | O_DIRECTORY)) {
+        format_and_write_to_log<512>(LogLevel::Warning, "Could not sync directory % to disk, errno %.", directoryPath.c_str(), errno);
+    }
+
+    return true;
+}
+
+std::size_t TraceFile::add_backtrace(const Backtrace& backtrace) {
+    MemoryWriter writer(begin_entry(SectionKind::Backtraces));
+
+    if (m_format == Format::V2) {
+        write_compact_backtrace(writer, backtrace, m_previousWrittenBacktraceID);
+    } else {
+        write_backtrace(writer, backtrace);
+    }
+
+    return end_entry(SectionKind::Backtraces);
+}
+
+std::size_t TraceFile::add_stack_frame(const StackFrame& stackFrame, const StringTable& strings) {
+    MemoryWriter writer(begin_entry(SectionKind::StackFrames));
+
+    if (m_format == Format::V2) {
+        StackFrame fileStackFrame = stackFrame;
+        fileStackFrame.functionName = m_strings.intern(strings.get(stackFrame.functionName));
+        fileStackFrame.sourceFilePath = m_strings.intern(strings.get(stackFrame.sourceFilePath));
+        write_compact_stack_frame(writer, fileStackFrame);
+    } else {
+        write_stack_frame(writer, stackFrame, strings);
+    }
+
+    return end_entry(SectionKind::StackFrames);
+}
+
+std::size_t TraceFile::add_thread(const Thread& thread, const StringTable& strings) {
+    if (m_format != Format::V2) {
+        return 0;
+    }
+
+    MemoryWriter writer(begin_entry(SectionKind::Threads));
+
+    Thread fileThread = thread;
+    fileThread.name = m_strings.intern(strings.get(thread.name));
+    write_compact_thread(writer, fileThread);
+
+    return end_entry(SectionKind::Threads);
+}
+
+std::size_t TraceFile::add_sample(const Sample& sample) {
+    MemoryWriter writer(begin_entry(SectionKind::Samples));
+
+    if (m_format == Format::V2) {
+        write_compact_sample(writer, sample, m_previousWrittenSample);
+    } else {
+        write_sample(writer, sample);
+    }
+
+    return end_entry(SectionKind::Samples);
+}
+
+std::vector<char>& TraceFile::begin_entry(const SectionKind kind) {
+    if (m_format == Format::V2) {
+        auto& pendingSection = m_pendingSections[static_cast<std::size_t>(kind)];
+
+        if (pendingSection.bytes.size() >= swimps_v2_block_size) {
+            write_block(kind);
+
+            // Blocks are decoded independently, so each one's deltas start from scratch.
+            switch (kind) {
+            case SectionKind::Samples:     m_previousWrittenSample = {};      break;
+            case SectionKind::Backtraces:  m_previousWrittenBacktraceID = 0;  break;
+            case SectionKind::StackFrames:                                    break;
+            case SectionKind::Strings:                                        break;
+            case SectionKind::Threads:                                        break;
+            }
+        }
+
+        m_entryStart = pendingSection.bytes.size();
+        return pendingSection.bytes;
+    }
+
+    const char* marker = nullptr;
+    switch (kind) {
+    case SectionKind::Samples:     marker = swimps_v1_trace_sample_marker;             break;
+    case SectionKind::Backtraces:  marker = swimps_v1_trace_symbolic_backtrace_marker; break;
+    case SectionKind::StackFrames: marker = swimps_v1_trace_stack_frame_marker;        break;
+    case SectionKind::Strings:                                                         break;
+    case SectionKind::Threads:                                                         break;
+    }
+
+    swimps_assert(marker != nullptr);
+
+    m_entryBuffer.assign(marker, marker + swimps_v1_trace_entry_marker_size);
+    return m_entryBuffer;
+}
+
+std::size_t TraceFile::end_entry(const SectionKind kind) {
+    if (m_format == Format::V2) {
+        auto& pendingSection = m_pendingSections[static_cast<std::size_t>(kind)];
+        pendingSection.entryCount += 1;
+        pendingSection.blockEntryCount += 1;
+        return pendingSection.bytes.size() - m_entryStart;
+    }
+
+    return write_entry_data(m_entryBuffer);
+}
+
+bool TraceFile::write_block(const SectionKind kind) noexcept {
+    auto& pendingSection = m_pendingSections[static_cast<std::size_t>(kind)];
+    if (pendingSection.blockEntryCount == 0) {
+        return true;
+    }
+
+    Block block;
+    block.offset = m_nextBlockOffset;
+    block.size = static_cast<std::uint32_t>(pendingSection.bytes.size());
+    block.entryCount = pendingSection.blockEntryCount;
+
+    std::span<const char> storedBytes(pendingSection.bytes);
+
+    if (m_compression == Compression::LZ4) {
+        m_compressedBlock.resize(static_cast<std::size_t>(LZ4_compressBound(static_cast<int>(block.size))));
+
+        const int compressedSize = LZ4_compress_default(
+            storedBytes.data(),
+            m_compressedBlock.data(),
+            static_cast<int>(storedBytes.size()),
+            static_cast<int>(m_compressedBlock.size())
+        );
+
+        if (compressedSize <= 0) {
+            format_and_write_to_log<128>(
+                LogLevel::Fatal,
+                "Could not compress a block of trace file section %.",
+                static_cast<std::uint32_t>(kind)
+            );
+
+            m_writeFailed = true;
+        } else if (static_cast<std::uint32_t>(compressedSize) < block.size) {
+            storedBytes = { m_compressedBlock.data(), static_cast<std::size_t>(compressedSize) };
+        }
+    }
+
+    // Once a block is missing, the file can't be finalised, so there's no point writing any more.
+    if (! m_writeFailed && write(storedBytes) != storedBytes.size()) {
+        format_and_write_to_log<256>(
+            LogLevel::Fatal,
+            "Could not write trace file section %, errno % (%).",
+            static_cast<std::uint32_t>(kind),
+            errno,
+            strerror(errno)
+        );
+
+        m_writeFailed = true;
+    }
+
+    block.storedSize = static_cast<std::uint32_t>(storedBytes.size());
+    pendingSection.blocks.push_back(block);
+    m_nextBlockOffset += block.storedSize;
+
+    // The block is on disk now, so its bytes can make way for the next one's.
+    pendingSection.bytes.clear();
+    pendingSection.blockEntryCount = 0;
+
+    return ! m_writeFailed;
+}
+
+void TraceFile::enable_write_buffering(const std::size_t bufferSize) {
+    swimps_assert(bufferSize > 0);
+
+    flush();
+
+    m_writeBufferSize = bufferSize;
+    m_writeBuffer.reserve(bufferSize);
+}
+
+bool TraceFile::flush() noexcept {
+    if (m_writeBuffer.empty()) {
+        return true;
+    }
+
+    const auto bytesWritten = write({ m_writeBuffer.data(), m_writeBuffer.size() });
+    const bool success = bytesWritten == m_writeBuffer.size();
+
+    if (! success) {
+        format_and_write_to_log<256>(
+            LogLevel::Fatal,
+            "Could only flush % of % buffered trace file bytes, errno % (%).",
+            bytesWritten,
+            m_writeBuffer.size(),
+            errno,
+            strerror(errno)
+        );
+    }
+
+    m_writeBuffer.clear();
+    return success;
+}
+
+bool TraceFile::finalise() noexcept {
+    if (! flush()) {
+        return false;
+    }
+
+    // v2 sections are only written once; a non-empty section table means that's already happened.
+    if (m_format == Format::V1 || ! m_sections.empty()) {
+        return true;
+    }
+
+    return write_sections();
+}
+
+TraceFile::Format TraceFile::get_format() const noexcept {
+    return m_format;
+}
+
+TraceFile::Compression TraceFile::get_compression() const noexcept {
+    return m_compression;
+}
+
+const std::vector<TraceFile::Section>& TraceFile::get_sections() const noexcept {
+    return m_sections;
+}
+
+const StringTable& TraceFile::get_strings() const noexcept {
+    return m_strings;
+}
+
+const std::vector<Thread>& TraceFile::get_threads() const noexcept {
+    return m_threads;
+}
+
+bool TraceFile::write_sections() noexcept {
+    // The string table is only complete now, so its section comes last.
+    for (std::size_t id = 0; id < m_strings.size(); ++id) {
+        MemoryWriter writer(begin_entry(SectionKind::Strings));
+        write_compact_string(writer, m_strings.get(static_cast<string_id_t>(id)));
+        end_entry(SectionKind::Strings);
+    }
+
+    for (std::size_t i = 0; i < m_pendingSections.size(); ++i) {
+        write_block(static_cast<SectionKind>(i));
+    }
+
+    if (m_writeFailed) {
+        return false;
+    }
+
+    for (std::size_t i = 0; i < m_pendingSections.size(); ++i) {
+        auto& pendingSection = m_pendingSections[i];
+
+        Section section;
+        section.kind = static_cast<SectionKind>(i);
+        section.encoding = section.kind == SectionKind::Samples ? SectionEncoding::CompactWithThreads : SectionEncoding::Compact;
+        section.entryCount = pendingSection.entryCount;
+        section.blocks = std::move(pendingSection.blocks);
+
+        for (const auto& block : section.blocks) {
+            section.size += block.storedSize;
+        }
+
+        m_sections.push_back(std::move(section));
+        pendingSection = {};
+    }
+
+    std::vector<char> sectionTable;
+    MemoryWriter writer(sectionTable);
+
+    for (const auto& section : m_sections) {
+        writer.write(static_cast<std::uint32_t>(section.kind));
+        writer.write(static_cast<std::uint32_t>(section.encoding));
+        writer.write(section.entryCount);
+        writer.write(static_cast<std::uint32_t>(section.blocks.size()));
+
+        for (const auto& block : section.blocks) {
+            writer.write(block.offset);
+            writer.write(block.storedSize);
+            writer.write(block.size);
+            writer.write(block.entryCount);
+        }
+    }
+
+    // The section table goes after the last block.
+    writer.write(m_nextBlockOffset);
+    writer.write(static_cast<std::uint32_t>(m_sections.size()));
+    writer.write(swimps_v2_trace_footer_marker);
+
+    if (write({ sectionTable.data(), sectionTable.size() }) != sectionTable.size()) {
+        format_and_write_to_log<256>(
+            LogLevel::Fatal,
+            "Could not write trace file section table, errno % (%).",
+            errno,
+            strerror(errno)
+        );
+
+        return false;
+    }
+
+    return true;
+}
+
+bool TraceFile::read_section_table() noexcept {
+    std::error_code errorCode;
+    const auto fileSize = std::filesystem::file_size(std::string(get_path()), errorCode);
+    if (errorCode || fileSize < swimps_v2_trace_header_size + swimps_v2_trace_footer_size) {
+        write_to_log(
+            LogLevel::Fatal,
+            "v2 trace file is too small to have a footer."
+        );
+
+        return false;
+    }
+
+    std::array<char, swimps_v2_trace_footer_size> footer;
+    const auto footerOffset = static_cast<off_t>(fileSize - swimps_v2_trace_footer_size);
+    if (seek(footerOffset, OffsetInterpretation::Absolute) != footerOffset
+        || ! read_exactly(*this, footer)) {
+        write_to_log(
+            LogLevel::Fatal,
+            "Could not read v2 trace file footer."
+        );
+
+        return false;
+    }
+
+    MemoryReader footerReader(std::as_bytes(std::span(footer)));
+
+    std::uint64_t sectionTableOffset = 0;
+    std::uint32_t sectionCount = 0;
+    char footerMarker[sizeof swimps_v2_trace_footer_marker] = { };
+
+    footerReader.read(sectionTableOffset);
+    footerReader.read(sectionCount);
+    footerReader.read(footerMarker);
+
+    if (memcmp(footerMarker, swimps_v2_trace_footer_marker, sizeof footerMarker) != 0) {
+        write_to_log(
+            LogLevel::Fatal,
+            "Missing v2 trace file footer marker."
+        );
+
+        return false;
+    }
+
+    // Nothing in the footer or section table is trusted until it's been checked against the file.
+    if (sectionTableOffset < swimps_v2_trace_header_size || sectionTableOffset > static_cast<std::uint64_t>(footerOffset)) {
+        format_and_write_to_log<128>(
+            LogLevel::Fatal,
+            "v2 trace file section table offset % is out of bounds.",
+            sectionTableOffset
+        );
+
+        return false;
+    }
+
+    // The whole table is read in one go, so that however many sections and blocks it claims to have,
+    // reading it stops at its end.
+    std::vector<char> sectionTable(static_cast<std::size_t>(static_cast<std::uint64_t>(footerOffset) - sectionTableOffset));
+    if (seek(static_cast<off_t>(sectionTableOffset), OffsetInterpretation::Absolute) != static_cast<off_t>(sectionTableOffset)
+        || ! read_exactly(*this, sectionTable)) {
+        write_to_log(
+            LogLevel::Fatal,
+            "Could not read v2 trace file section table."
+        );
+
+        return false;
+    }
+
+    MemoryReader reader(std::as_bytes(std::span(sectionTable)));
+    const auto readField = [&reader](auto& field) {
+        return reader.read(field) == sizeof field;
+    };
+
+    m_sections.clear();
+
+    for (std::uint32_t i = 0; i < sectionCount; ++i) {
+        std::uint32_t kind = 0;
+        std::uint32_t encoding = 0;
+        Section section;
+
+        std::uint32_t blockCount = 0;
+
+        if (! readField(kind)
+            || ! readField(encoding)
+            || ! readField(section.entryCount)
+            || ! readField(blockCount)) {
+            write_to_log(LogLevel::Fatal, "v2 trace file section table is truncated.");
+            return false;
+        }
+
+        if (kind >= section_kind_count
+            || encoding > static_cast<std::uint32_t>(SectionEncoding::CompactWithThreads)
+            || (kind == static_cast<std::uint32_t>(SectionKind::Samples) && encoding == static_cast<std::uint32_t>(SectionEncoding::Compact))
+            || (kind != static_cast<std::uint32_t>(SectionKind::Samples) && encoding == static_cast<std::uint32_t>(SectionEncoding::CompactWithThreads))
+            || (kind >= static_cast<std::uint32_t>(SectionKind::StackFrames) && encoding != static_cast<std::uint32_t>(SectionEncoding::Compact))) {
+            format_and_write_to_log<128>(
+                LogLevel::Fatal,
+                "Invalid v2 trace file section % (kind %, encoding %).",
+                i,
+                kind,
+                encoding
+            );
+
+            return false;
+        }
+
+        section.kind = static_cast<SectionKind>(kind);
+        section.encoding = static_cast<SectionEncoding>(encoding);
+
+        const auto minEntrySize = get_min_entry_size(section.kind, section.encoding);
+        std::uint64_t blockEntryCount = 0;
+
+        for (std::uint32_t j = 0; j < blockCount; ++j) {
+            Block block;
+            if (! readField(block.offset)
+                || ! readField(block.storedSize)
+                || ! readField(block.size)
+                || ! readField(block.entryCount)) {
+                write_to_log(LogLevel::Fatal, "v2 trace file section table is truncated.");
+                return false;
+            }
+
+            // Blocks are all between the header and the section table, and can't hold more entries than their bytes could encode.
+            // Uncompressed blocks are stored as they are; LZ4 can't turn a byte into more than 255.
+            const bool isBlockValid = block.offset >= swimps_v2_trace_header_size
+                && block.offset <= sectionTableOffset
+                && block.storedSize <= sectionTableOffset - block.offset
+                && (m_compression == Compression::None ? block.storedSize == block.size
+                                                       : block.size <= static_cast<std::uint64_t>(block.storedSize) * 255)
+                && block.entryCount <= block.size / minEntrySize;
+
+            if (! isBlockValid) {
+                format_and_write_to_log<256>(
+                    LogLevel::Fatal,
+                    "Invalid v2 trace file block % of section % (offset %, stored size %, size %, entry count %).",
+                    j,
+                    i,
+                    block.offset,
+                    block.storedSize,
+                    block.size,
+                    block.entryCount
+                );
+
+                return false;
+            }
+
+            section.size += block.storedSize;
+            blockEntryCount += block.entryCount;
+            section.blocks.push_back(block);
+        }
+
+        if (blockEntryCount != section.entryCount) {
+            format_and_write_to_log<128>(
+                LogLevel::Fatal,
+                "v2 trace file section % has % entries, but its blocks have %.",
+                i,
+                section.entryCount,
+                blockEntryCount
+            );
+
+            return false;
+        }
+
+        m_sections.push_back(std::move(section));
+    }
+
+    if (reader.remaining() != 0) {
+        write_to_log(LogLevel::Fatal, "v2 trace file section table has unexpected trailing bytes.");
+        return false;
+    }
+
+    m_nextSection = 0;
+    m_nextBlock = 0;
+    m_entriesLeftInBlock = 0;
+
+    return true;
+}
+
+template <typename ReadBlock>
+bool TraceFile::read_blocks(const SectionKind kind, ReadBlock&& readBlock) noexcept {
+    std::vector<char> storedBlock;
+    std::vector<char> blockBuffer;
+
+    for (const auto& section : m_sections) {
+        if (section.kind != kind) {
+            continue;
+        }
+
+        for (const auto& block : section.blocks) {
+            storedBlock.resize(block.storedSize);
+
+            const auto blockOffset = static_cast<off_t>(block.offset);
+            if (seek(blockOffset, OffsetInterpretation::Absolute) != blockOffset
+                || ! read_exactly(*this, storedBlock)) {
+                format_and_write_to_log<128>(
+                    LogLevel::Fatal,
+                    "Could not read v2 trace file section of kind %.",
+                    static_cast<std::uint32_t>(kind)
                 );
 
-                return ErrorCode::ReadStackFrameFailed;
+                return false;
+            }
+
+            const auto blockBytes = unpack_v2_block(m_compression, block, std::as_bytes(std::span(storedBlock)), blockBuffer);
+            if (! blockBytes || ! readBlock(*blockBytes, block.entryCount)) {
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+bool TraceFile::read_string_table() noexcept {
+    std::string string;
+    std::size_t nextID = 0;
+
+    return read_blocks(SectionKind::Strings, [&](const std::span<const std::byte> blockBytes, const std::uint32_t entryCount) {
+        MemoryReader reader(blockBytes);
+
+        for (std::uint32_t i = 0; i < entryCount; ++i) {
+            // Strings are stored in ID order, each only once, so interning them gives back the same IDs.
+            if (! read_compact_string(reader, string) || m_strings.intern(string) != nextID++) {
+                write_to_log(LogLevel::Fatal, "Invalid v2 trace file string table.");
+                return false;
+            }
+        }
+
+        if (reader.remaining() != 0) {
+            write_to_log(LogLevel::Fatal, "v2 trace file string table has unexpected trailing bytes.");
+            return false;
+        }
+
+        return true;
+    });
+}
+
+bool TraceFile::read_thread_table() noexcept {
+    return read_blocks(SectionKind::Threads, [this](const std::span<const std::byte> blockBytes, const std::uint32_t entryCount) {
+        MemoryReader reader(blockBytes);
+
+        for (std::uint32_t i = 0; i < entryCount; ++i) {
+            std::uint64_t id = 0;
+            std::uint64_t name = 0;
+
+            // Thread names are in the string table, which is read first.
+            if (! read_varint(reader, id) || ! read_varint(reader, name) || name >= m_strings.size()) {
+                write_to_log(LogLevel::Fatal, "Invalid v2 trace file thread table.");
+                return false;
             }
 
-            return *stackFrame;
+            m_threads.push_back({ static_cast<thread_id_t>(zigzag_decode(id)), static_cast<string_id_t>(name) });
+        }
+
+        if (reader.remaining() != 0) {
+            write_to_log(LogLevel::Fatal, "v2 trace file thread table has unexpected trailing bytes.");
+            return false;
+        }
+
+        return true;
+    });
+}
+
+TraceFile::~TraceFile() {
+    flush();
+}
+
+std::size_t TraceFile::write_entry_data(const std::span<const char> data) noexcept {
+    if (m_writeBufferSize == 0) {
+        return write(data);
+    }
+
+    if (m_writeBuffer.size() + data.size() > m_writeBufferSize) {
+        flush();
+
+        // Anything that wouldn't fit even in an empty buffer may as well go straight out.
+        if (data.size() > m_writeBufferSize) {
+            return write(data);
         }
-    case EntryKind::EndOfFile:
+    }
+
+    m_writeBuffer.insert(m_writeBuffer.end(), data.begin(), data.end());
+    return data.size();
+}
+
+std::optional<ErrorCode> TraceFile::read_next_block() noexcept {
+    // The strings and threads sections aren't made up of entries; they were read when the file was opened.
+    while (m_nextSection < m_sections.size()
+           && (m_sections[m_nextSection].kind == SectionKind::Strings
+               || m_sections[m_nextSection].kind == SectionKind::Threads
+               || m_nextBlock == m_sections[m_nextSection].blocks.size())) {
+        m_nextSection += 1;
+        m_nextBlock = 0;
+    }
+
+    if (m_nextSection == m_sections.size()) {
         return ErrorCode::EndOfFile;
-    case EntryKind::Unknown:
-    default:
-        write_to_log(
-            LogLevel::Debug,
-            "Unknown entry kind detected, bailing."
+    }
+
+    const auto& section = m_sections[m_nextSection];
+    const auto& block = section.blocks[m_nextBlock++];
+
+    m_storedBlock.resize(block.storedSize);
+
+    const auto blockOffset = static_cast<off_t>(block.offset);
+    if (seek(blockOffset, OffsetInterpretation::Absolute) != blockOffset
+        || ! read_exactly(*this, m_storedBlock)) {
+        return ErrorCode::ReadSectionFailed;
+    }
+
+    const auto blockBytes = unpack_v2_block(m_compression, block, std::as_bytes(std::span(m_storedBlock)), m_block);
+    if (! blockBytes) {
+        return ErrorCode::ReadSectionFailed;
+    }
+
+    m_blockBytes = *blockBytes;
+
+    m_entriesLeftInBlock = block.entryCount;
+    m_blockReadOffset = 0;
+    m_currentSectionKind = section.kind;
+    m_currentSectionEncoding = section.encoding;
+    m_previousReadSample = {};
+    m_previousReadBacktraceID = 0;
+
+    return {};
+}
+
+TraceFile::Entry TraceFile::read_next_entry() noexcept {
+    flush();
+
+    if (m_format == Format::V2) {
+        while (m_entriesLeftInBlock == 0) {
+            if (const auto errorCode = read_next_block()) {
+                return *errorCode;
+            }
+        }
+
+        m_entriesLeftInBlock -= 1;
+
+        const auto blockBytes = m_blockBytes.subspan(m_blockReadOffset);
+        MemoryReader reader(blockBytes);
+
+        auto entry = read_entry(
+            reader,
+            to_entry_kind(m_currentSectionKind),
+            m_currentSectionEncoding,
+            m_strings,
+            m_previousReadSample,
+            m_previousReadBacktraceID
         );
 
-        return ErrorCode::UnknownEntryKind;
+        m_blockReadOffset += blockBytes.size() - reader.remaining();
+        return entry;
     }
+
+    return read_entry(
+        *this,
+        read_next_entry_kind(*this),
+        SectionEncoding::Raw,
+        m_strings,
+        m_previousReadSample,
+        m_previousReadBacktraceID
+    );
 }
 
-std::optional<Trace> TraceFile::read_trace() noexcept {
+std::optional<Trace> TraceFile::read_trace(const ReadMode readMode, const TraceSelection selection) noexcept {
+    flush();
+
+    std::optional<MappedFile> mappedFile;
+    if (readMode != ReadMode::Sequential) {
+        mappedFile.emplace(std::string(get_path()));
+        if (! mappedFile->is_mapped()) {
+            mappedFile.reset();
+
+            write_to_log(
+                LogLevel::Debug,
+                "Could not map trace file, falling back to sequential reads."
+            );
+        }
+    }
+
+    if (m_format == Format::V2) {
+        if (readMode == ReadMode::Parallel && mappedFile) {
+            auto trace = read_v2_trace_in_parallel(m_sections, m_strings, m_compression, mappedFile->bytes(), selection);
+            if (trace) {
+                trace->threads = m_threads;
+            }
+
+            return trace;
+        }
+
+        Trace trace;
+        std::vector<char> storedBlockBuffer;
+        std::vector<char> blockBuffer;
+
+        for (const auto& section : m_sections) {
+            if (! is_selected(section.kind, selection)) {
+                continue;
+            }
+
+            auto nextIndex = resize_for_v2_section(section, trace);
+
+            for (const auto& block : section.blocks) {
+                std::span<const std::byte> storedBytes;
+
+                if (mappedFile) {
+                    const auto mappedBytes = get_stored_bytes(mappedFile->bytes(), block);
+                    if (! mappedBytes) {
+                        return {};
+                    }
+
+                    storedBytes = *mappedBytes;
+                } else {
+                    storedBlockBuffer.resize(block.storedSize);
+
+                    const auto blockOffset = static_cast<off_t>(block.offset);
+                    if (seek(blockOffset, OffsetInterpretation::Absolute) != blockOffset
+                        || ! read_exactly(*this, storedBlockBuffer)) {
+                        format_and_write_to_log<128>(
+                            LogLevel::Fatal,
+                            "Could not read v2 trace file block at offset %.",
+                            block.offset
+                        );
+
+                        return {};
+                    }
+
+                    storedBytes = std::as_bytes(std::span(storedBlockBuffer));
+                }
+
+                const auto blockBytes = unpack_v2_block(m_compression, block, storedBytes, blockBuffer);
+                if (! blockBytes || ! read_v2_block(section, block, *blockBytes, m_strings, trace, nextIndex)) {
+                    return {};
+                }
+
+                nextIndex += block.entryCount;
+            }
+        }
+
+        trace.strings = m_strings;
+        trace.threads = m_threads;
+        return trace;
+    }
+
+    if (mappedFile) {
+        return read_v1_trace_from_memory(mappedFile->bytes(), selection);
+    }
+
     if (! goToStartOfFile(*this)) {
         return {};
     }
@@ -592,14 +2375,14 @@ std::optional<Trace> TraceFile::read_trace() noexcept {
         std::visit(
             Visitor{
                 stop,
-                [&trace](auto& backtrace){ trace.backtraces.push_back(backtrace); },
-                [&trace](auto& sample){ trace.samples.push_back(sample); },
-                [&trace](auto& stackFrame){ trace.stackFrames.push_back(stackFrame); },
+                [&trace, &selection](auto& backtrace){ if (selection.backtraces) { trace.backtraces.push_back(backtrace); } },
+                [&trace, &selection](auto& sample){ if (selection.samples) { trace.samples.push_back(sample); } },
+                [&trace, &selection](auto& stackFrame){ if (selection.stackFrames) { trace.stackFrames.push_back(stackFrame); } },
             },
             entry
         );
     }
 
+    trace.strings = m_strings;
     return trace;
 }
-
@@ -1,6 +1,13 @@
 #pragma once
 
 #include <array>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
 #include <vector>
 #include <cstring>
 
@@ -50,6 +57,61 @@ namespace swimps::trace {
     using file_path_length_t = uint32_t;
     static_assert(PATH_MAX < std::numeric_limits<file_path_length_t>::max());
 
+    // Even huge programs have nowhere near 2^32 distinct function names and source file paths.
+    using string_id_t = uint32_t;
+
+    // The same as pid_t, which thread IDs are on Linux. 0 is never a thread's ID, so stands for an unknown thread.
+    using thread_id_t = int32_t;
+
+    //!
+    //! \brief  Stores each distinct string once, handing out small IDs to refer to them by.
+    //!
+    class StringTable {
+    public:
+        //!
+        //! \brief  Creates a string table holding just the empty string, which always has ID 0.
+        //!
+        StringTable();
+
+        StringTable(const StringTable& other);
+        StringTable& operator=(const StringTable& other);
+
+        StringTable(StringTable&&) = default;
+        StringTable& operator=(StringTable&&) = default;
+
+        //!
+        //! \brief  Adds a string to the table, unless it's already there.
+        //!
+        //! \param[in]  string  The string to add.
+        //!
+        //! \returns  The string's ID.
+        //!
+        //! \note  This function is *not* async signal safe.
+        //!
+        string_id_t intern(std::string_view string);
+
+        //!
+        //! \brief  Gets the string with the given ID.
+        //!
+        //! \param[in]  id  The string's ID, which must have come from this table.
+        //!
+        //! \returns  The string, which stays valid for as long as the table does.
+        //!
+        std::string_view get(string_id_t id) const noexcept;
+
+        //!
+        //! \brief  Gets how many strings are in the table.
+        //!
+        //! \returns  The number of strings, including the empty one.
+        //!
+        std::size_t size() const noexcept;
+
+    private:
+        // Elements of a deque never move as it grows, so the views used as keys stay valid.
+        std::deque<std::string> m_strings;
+        std::unordered_map<std::string_view, string_id_t> m_ids;
+    };
+
     struct StackFrame {
         StackFrame() = default;
         explicit constexpr StackFrame(const stack_frame_id_t _id, const signalsampler::instruction_pointer_t _instructionPointer)
@@ -59,27 +121,25 @@ namespace swimps::trace {
         }
 
         stack_frame_id_t id = std::numeric_limits<stack_frame_id_t>::min();
-
-        // TODO: could we get rid of all this extra info
-        //       and just use the instruction pointer now?
-        char functionName[256] = { };
-        function_name_length_t functionNameLength = 0;
-        offset_t offset = 0;
         address_t instructionPointer = 0;
+        offset_t offset = 0;
         line_number_t lineNumber = -1;
-        char sourceFilePath[PATH_MAX + 1 /* null terminator */] = { };
-        file_path_length_t sourceFilePathLength = 0;
+
+        // These refer to the string table of the trace (or trace file) the stack frame belongs to.
+        string_id_t functionName = 0;
+        string_id_t sourceFilePath = 0;
 
         constexpr bool isSameAs(const StackFrame& other) const noexcept {
             return id == other.id && isEquivalentTo(other);
         }
 
+        //
+        // Function names are compared by ID, so this only makes sense for stack frames sharing a string table.
+        //
         constexpr bool isEquivalentTo(const StackFrame& other) const noexcept {
             return offset == other.offset
                 && instructionPointer == other.instructionPointer
-                && 0 == strncmp(&functionName[0],
-                                &other.functionName[0],
-                                sizeof functionName);
+                && functionName == other.functionName;
         }
 
         bool operator==(const StackFrame& other) = delete;
@@ -90,14 +150,72 @@ namespace swimps::trace {
         std::vector<stack_frame_id_t> stackFrameIDs;
     };
 
+    //!
+    //! \brief  Hands out one ID per distinct sequence of stack frame IDs, so that identical backtraces are stored once.
+    //!
+    //! \note  The sequences are hashed by their contents and kept in an open addressing table,
+    //!        so adding a backtrace takes the same time however many are already in there.
+    //!
+    class BacktraceTable {
+    public:
+        //!
+        //! \brief  Adds a backtrace to the table, unless an identical one is already there.
+        //!
+        //! \param[in]  stackFrameIDs  The backtrace's stack frames, innermost first.
+        //!
+        //! \returns  The backtrace's ID; the first distinct backtrace gets ID 1, the next 2, and so on.
+        //!
+        //! \note  This function is *not* async signal safe.
+        //!
+        backtrace_id_t intern(std::span<const stack_frame_id_t> stackFrameIDs);
+
+        //!
+        //! \brief  Gets the stack frames of the backtrace with the given ID.
+        //!
+        //! \param[in]  id  The backtrace's ID, which must have come from this table.
+        //!
+        //! \returns  The backtrace's stack frames, which stay valid until the next call to intern.
+        //!
+        std::span<const stack_frame_id_t> get(backtrace_id_t id) const noexcept;
+
+        //!
+        //! \brief  Gets how many distinct backtraces are in the table.
+        //!
+        //! \returns  The number of backtraces, which is also the highest ID handed out.
+        //!
+        std::size_t size() const noexcept;
+
+    private:
+        void grow();
+
+        // Every backtrace's stack frames, one after the other; backtrace N's run from
+        // m_stackFrameOffsets[N - 1] up to m_stackFrameOffsets[N].
+        std::vector<stack_frame_id_t> m_stackFrameIDs;
+        std::vector<std::size_t> m_stackFrameOffsets{ 0 };
+        std::vector<std::uint64_t> m_hashes;
+
+        // Backtrace IDs, placed by hash and probed linearly; 0 marks an empty slot.
+        std::vector<backtrace_id_t> m_slots;
+    };
+
     struct Sample {
         backtrace_id_t backtraceID = std::numeric_limits<backtrace_id_t>::min();
         signalsafe::time::TimeSpecification timestamp;
+        thread_id_t threadID = 0;
+    };
+
+    struct Thread {
+        thread_id_t id = 0;
+
+        // Refers to the string table of the trace (or trace file) the thread belongs to; 0 if it had no name.
+        string_id_t name = 0;
     };
 
     struct Trace {
         std::vector<Sample> samples;
         std::vector<Backtrace> backtraces;
         std::vector<StackFrame> stackFrames;
+        std::vector<Thread> threads;
+        StringTable strings;
     };
 }
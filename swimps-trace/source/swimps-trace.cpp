@@ -1,2 +1,139 @@
 #include "swimps-trace/swimps-trace.h"
 
+#include <algorithm>
+#include <bit>
+
+#include "swimps-assert/swimps-assert.h"
+
+using swimps::trace::backtrace_id_t;
+using swimps::trace::BacktraceTable;
+using swimps::trace::stack_frame_id_t;
+using swimps::trace::string_id_t;
+using swimps::trace::StringTable;
+
+namespace {
+    // Small enough that tables of a few backtraces stay small, and a power of two so slots can be found by masking.
+    constexpr std::size_t initial_backtrace_slot_count = 64;
+
+    //
+    // Stack frame IDs are small and close together, so each is thoroughly mixed
+    // (with the finaliser from MurmurHash3) to spread similar backtraces across the table.
+    //
+    std::uint64_t hash_stack_frame_ids(const std::span<const stack_frame_id_t> stackFrameIDs) noexcept {
+        std::uint64_t hash = 0xcbf29ce484222325 ^ stackFrameIDs.size();
+
+        for (const auto stackFrameID : stackFrameIDs) {
+            std::uint64_t mixed = static_cast<std::uint64_t>(stackFrameID);
+            mixed ^= mixed >> 33;
+            mixed *= 0xff51afd7ed558ccd;
+            mixed ^= mixed >> 33;
+            mixed *= 0xc4ceb9fe1a85ec53;
+            mixed ^= mixed >> 33;
+
+            hash = std::rotl(hash ^ mixed, 27) * 0x9e3779b97f4a7c15;
+        }
+
+        return hash;
+    }
+}
+
+StringTable::StringTable() {
+    intern({});
+}
+
+StringTable::StringTable(const StringTable& other) {
+    // The views in the other table's index point at its strings, not ours, so it has to be rebuilt.
+    for (const auto& string : other.m_strings) {
+        intern(string);
+    }
+}
+
+StringTable& StringTable::operator=(const StringTable& other) {
+    if (this != &other) {
+        m_strings.clear();
+        m_ids.clear();
+
+        for (const auto& string : other.m_strings) {
+            intern(string);
+        }
+    }
+
+    return *this;
+}
+
+string_id_t StringTable::intern(const std::string_view string) {
+    const auto existing = m_ids.find(string);
+    if (existing != m_ids.cend()) {
+        return existing->second;
+    }
+
+    const auto id = static_cast<string_id_t>(m_strings.size());
+    m_ids.emplace(m_strings.emplace_back(string), id);
+
+    return id;
+}
+
+std::string_view StringTable::get(const string_id_t id) const noexcept {
+    return m_strings[id];
+}
+
+std::size_t StringTable::size() const noexcept {
+    return m_strings.size();
+}
+
+backtrace_id_t BacktraceTable::intern(const std::span<const stack_frame_id_t> stackFrameIDs) {
+    // Kept at most half full, so probe sequences stay short.
+    if ((size() + 1) * 2 > m_slots.size()) {
+        grow();
+    }
+
+    const auto hash = hash_stack_frame_ids(stackFrameIDs);
+    const auto mask = m_slots.size() - 1;
+
+    for (std::size_t slot = hash & mask; ; slot = (slot + 1) & mask) {
+        const auto id = m_slots[slot];
+
+        if (id == 0) {
+            m_stackFrameIDs.insert(m_stackFrameIDs.end(), stackFrameIDs.begin(), stackFrameIDs.end());
+            m_stackFrameOffsets.push_back(m_stackFrameIDs.size());
+            m_hashes.push_back(hash);
+
+            const auto newID = static_cast<backtrace_id_t>(size());
+            m_slots[slot] = newID;
+            return newID;
+        }
+
+        // Comparing the hashes first means the stack frames are only compared for a (likely) match.
+        if (m_hashes[id - 1] == hash && std::ranges::equal(get(id), stackFrameIDs)) {
+            return id;
+        }
+    }
+}
+
+std::span<const stack_frame_id_t> BacktraceTable::get(const backtrace_id_t id) const noexcept {
+    swimps_assert(id >= 1 && static_cast<std::size_t>(id) <= size());
+
+    const auto begin = m_stackFrameOffsets[id - 1];
+    const auto end = m_stackFrameOffsets[id];
+    return { m_stackFrameIDs.data() + begin, end - begin };
+}
+
+std::size_t BacktraceTable::size() const noexcept {
+    return m_hashes.size();
+}
+
+void BacktraceTable::grow() {
+    const auto slotCount = std::max(initial_backtrace_slot_count, m_slots.size() * 2);
+    m_slots.assign(slotCount, 0);
+
+    // The hashes are kept, so growing doesn't have to look at the stack frames again.
+    const auto mask = slotCount - 1;
+    for (std::size_t i = 0; i < m_hashes.size(); ++i) {
+        auto slot = m_hashes[i] & mask;
+        while (m_slots[slot] != 0) {
+            slot = (slot + 1) & mask;
+        }
+
+        m_slots[slot] = static_cast<backtrace_id_t>(i + 1);
+    }
+}
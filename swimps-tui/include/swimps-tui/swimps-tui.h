@@ -1,9 +1,67 @@
 #pragma once
 
+#include <functional>
+#include <optional>
+
 #include "swimps-analysis/swimps-analysis.h"
 #include "swimps-error/swimps-error.h"
-#include "swimps-trace/swimps-trace.h"
 
 namespace swimps::tui {
-    swimps::error::ErrorCode run(const swimps::trace::Trace&, const swimps::analysis::Analysis&);
+    //!
+    //! \brief  Shows an analysis in the terminal, starting with its call tree, until 'q' is pressed.
+    //!
+    //! \note  'f' switches to the flat profile, and 'b' to the bottom up call tree; pressing either again goes back.
+    //!        Going right into a function in the flat profile shows what calls it and what it calls.
+    //!
+    swimps::error::ErrorCode run(const swimps::analysis::Analysis&);
+
+    //!
+    //! \brief  Shows an analysis in the terminal as above, but lets it be narrowed down to a window of time.
+    //!
+    //! \param[in]  analysis    The analysis of the whole trace, which is shown first.
+    //! \param[in]  indexTrace  Reads in and indexes the trace, which each window is analysed from,
+    //!                         or returns nothing if it can't be read.
+    //!
+    //! \note  't' asks for the window, in seconds from the first sample; asking for nothing goes back to the whole trace.
+    //!
+    //! \note  indexTrace is only called the first time 't' is pressed, so the trace is only held in memory
+    //!        if it's going to be narrowed down.
+    //!
+    swimps::error::ErrorCode run(
+        const swimps::analysis::Analysis& analysis,
+        std::function<std::optional<swimps::analysis::TraceIndex>()> indexTrace
+    );
+
+    //!
+    //! \brief  Shows how one run's samples differ from another's in the terminal, starting with their call trees
+    //!         laid over each other, until 'q' is pressed.
+    //!
+    //! \note  Each node shows its share of the baseline's samples, its share of the candidate's, and the change.
+    //!        'f' switches to the table of functions, ranked as by print_diff; pressing it again goes back.
+    //!
+    swimps::error::ErrorCode run(const swimps::analysis::Diff& diff);
+
+    //!
+    //! \brief  Prints how one run's samples differ from another's to stdout, one function per line.
+    //!
+    //! \param[in]  diff  The diff to print.
+    //!
+    //! \note  Functions are ranked by how much their share of self samples grew, so the biggest regressions come first.
+    //!
+    //! \note  This function is *not* async signal safe.
+    //!
+    void print_diff(const swimps::analysis::Diff& diff);
+
+    //!
+    //! \brief  Prints an analysis's flat profile to stdout, one function per line.
+    //!
+    //! \param[in]  analysis  The analysis to print the flat profile of.
+    //!
+    //! \note  This is the same table as the TUI shows (when 'f' is pressed), for when there's no terminal to show it in.
+    //!
+    //! \note  If the samples were taken on more than one thread, each thread's flat profile follows, busiest first.
+    //!
+    //! \note  This function is *not* async signal safe.
+    //!
+    void print_flat_profile(const swimps::analysis::Analysis& analysis);
 }
@@ -1,9 +1,19 @@
 #include "swimps-tui/swimps-tui.h"
 
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <functional>
 #include <optional>
 #include <limits>
-#include <map>
 #include <memory>
+#include <cstdio>
+#include <span>
+#include <string>
+#include <unordered_set>
+#include <utility>
+#include <vector>
 
 #include <cxxabi.h>
 
@@ -11,166 +21,700 @@
 
 #include "swimps-assert/swimps-assert.h"
 
+using signalsafe::time::TimeSpecification;
 using swimps::analysis::Analysis;
-using CallTreeNode = Analysis::CallTreeNode;
+using CallTree = Analysis::CallTree;
+using swimps::analysis::Diff;
+using swimps::analysis::TraceIndex;
 using swimps::error::ErrorCode;
 using swimps::trace::stack_frame_count_t;
-using swimps::trace::stack_frame_id_t;
-using swimps::trace::StackFrame;
-using swimps::trace::Trace;
 
 namespace {
     // We could have as many lines as stack frames, worst case.
     using line_t = stack_frame_count_t;
 
-    using expansion_state_t = std::map<const CallTreeNode*, bool>;
-    using line_mappings_t = std::map<line_t, const CallTreeNode*>;
+    enum class View {
+        CallTree,
+        BottomUpCallTree,
+        FlatProfile,
+        CallGraph
+    };
 
-    const StackFrame* lookup_stack_frame(const Trace& trace, const stack_frame_id_t id) {
-        const auto& stackFrames = trace.stackFrames;
-        const auto iter = std::find_if(stackFrames.cbegin(), stackFrames.cend(), [id](const auto& stackFrame) { return stackFrame.id == id; });
-        return iter != stackFrames.cend() ? &(*iter) : nullptr;
+    constexpr const char* flat_profile_header = "      Self  Self %   Inclusive  Inclusive %  Function";
+    constexpr const char* diff_header = "  Self +/-  Baseline  Candidate  Inclusive +/-  Baseline  Candidate  Function";
+
+    std::string demangle(const std::string& functionName) {
+        int demangleStatus = 0;
+        const std::unique_ptr<const char, void(*)(const char*)> demangledFunctionName(
+            abi::__cxa_demangle(
+                functionName.c_str(),
+                nullptr,
+                nullptr,
+                &demangleStatus
+            ),
+            [](const char* ptr) { free(reinterpret_cast<void*>(const_cast<char*>(ptr))); }
+        );
+
+        const bool demangleFailed = demangledFunctionName == nullptr || demangleStatus != 0;
+        return demangleFailed ? functionName : std::string(demangledFunctionName.get());
     }
 
-    void print_node(WINDOW* const window,
-                    const Trace& trace,
-                    const CallTreeNode* parentNode,
-                    const CallTreeNode& rootNode,
-                    expansion_state_t& expansionState,
-                    line_mappings_t& lineMappings,
-                    const line_t selectedLine,
-                    const line_t linesToSkip,
-                    line_t& currentLine,
-                    const std::size_t indentation) {
-
-        if (currentLine >= linesToSkip) {
-            for(std::size_t i = 0; i < indentation; ++i) {
+    std::string get_function_name(const swimps::trace::StringTable& strings, const swimps::trace::string_id_t function) {
+        const std::string functionName(strings.get(function));
+        return functionName.empty() ? "?" : demangle(functionName);
+    }
+
+    std::string get_function_name(const Analysis::SymbolTable& symbolTable, const swimps::trace::string_id_t function) {
+        return get_function_name(*symbolTable.strings, function);
+    }
+
+    std::string format_function_profile(const Analysis::FunctionProfile& functionProfile,
+                                        const Analysis::SymbolTable& symbolTable,
+                                        const swimps::trace::sample_count_t totalSamples) {
+        const auto percentage = [totalSamples](const swimps::trace::sample_count_t samples) {
+            return totalSamples == 0 ? 0.0 : (samples / static_cast<double>(totalSamples)) * 100;
+        };
+
+        char line[64] = { };
+        snprintf(
+            line,
+            sizeof line,
+            "%10ld %6.2f%% %11ld %11.2f%%  ",
+            static_cast<long>(functionProfile.selfSamples),
+            percentage(functionProfile.selfSamples),
+            static_cast<long>(functionProfile.inclusiveSamples),
+            percentage(functionProfile.inclusiveSamples)
+        );
+
+        return line + get_function_name(symbolTable, functionProfile.functionName);
+    }
+
+    std::string format_function_delta(const Diff::FunctionDelta& functionDelta, const swimps::trace::StringTable& strings) {
+        char line[96] = { };
+        snprintf(
+            line,
+            sizeof line,
+            "%+9.2f%% %8.2f%% %9.2f%% %+13.2f%% %8.2f%% %9.2f%%  ",
+            (functionDelta.candidateSelf - functionDelta.baselineSelf) * 100,
+            functionDelta.baselineSelf * 100,
+            functionDelta.candidateSelf * 100,
+            (functionDelta.candidateInclusive - functionDelta.baselineInclusive) * 100,
+            functionDelta.baselineInclusive * 100,
+            functionDelta.candidateInclusive * 100
+        );
+
+        return line + get_function_name(strings, functionDelta.functionName);
+    }
+
+    std::string format_diff_totals(const Diff& diff) {
+        char line[128] = { };
+        snprintf(
+            line,
+            sizeof line,
+            "Baseline: %ld samples, candidate: %ld samples. Shares are of each run's own samples.",
+            static_cast<long>(diff.baselineSamples),
+            static_cast<long>(diff.candidateSamples)
+        );
+
+        return line;
+    }
+
+    //
+    // The rows of a call tree that are showing: every node whose ancestors are all expanded, in the order they're
+    // drawn. Expanding or collapsing a node only adds or removes the rows below it, so however big the tree is,
+    // nothing but the rows that appear or disappear is walked.
+    //
+    class VisibleRows {
+    public:
+        struct Row {
+            CallTree::node_index_t node = CallTree::no_node;
+            std::size_t depth = 0;
+        };
+
+        explicit VisibleRows(const CallTree& callTree)
+        : m_callTree(&callTree) {
+            insert_rows(0, CallTree::root, 0);
+        }
+
+        const CallTree& get_call_tree() const noexcept {
+            return *m_callTree;
+        }
+
+        std::size_t size() const noexcept {
+            return m_rows.size();
+        }
+
+        const Row& get(const std::size_t row) const noexcept {
+            return m_rows[row];
+        }
+
+        bool is_expanded(const CallTree::node_index_t node) const {
+            return m_expandedNodes.contains(node);
+        }
+
+        void set_expanded(const std::size_t row, const bool expanded) {
+            const auto node = m_rows[row].node;
+            const auto depth = m_rows[row].depth;
+
+            if (m_callTree->get(node).firstChild == CallTree::no_node || is_expanded(node) == expanded) {
+                return;
+            }
+
+            if (expanded) {
+                m_expandedNodes.insert(node);
+                insert_rows(row + 1, node, depth + 1);
+                return;
+            }
+
+            m_expandedNodes.erase(node);
+
+            // The node's descendants are the rows straight after it that are deeper than it.
+            const auto firstDescendant = m_rows.begin() + row + 1;
+            const auto lastDescendant = std::find_if(firstDescendant, m_rows.end(), [depth](const Row& other) {
+                return other.depth <= depth;
+            });
+
+            m_rows.erase(firstDescendant, lastDescendant);
+        }
+
+    private:
+        //
+        // Inserts rows for a node's children, and for those of their descendants that are still expanded
+        // from before (collapsing a node leaves what's below it as it was, for when it's expanded again).
+        //
+        void insert_rows(const std::size_t position, const CallTree::node_index_t parent, std::size_t depth) {
+            std::vector<Row> rows;
+            auto node = m_callTree->get(parent).firstChild;
+
+            while (node != CallTree::no_node) {
+                rows.push_back({ node, depth });
+
+                const auto& callTreeNode = m_callTree->get(node);
+                if (callTreeNode.firstChild != CallTree::no_node && is_expanded(node)) {
+                    node = callTreeNode.firstChild;
+                    depth += 1;
+                    continue;
+                }
+
+                // Climb back up to the nearest node with a sibling still to go, unless that's past the parent.
+                while (node != parent && m_callTree->get(node).nextSibling == CallTree::no_node) {
+                    node = m_callTree->get(node).parent;
+                    depth -= 1;
+                }
+
+                node = node == parent ? CallTree::no_node : m_callTree->get(node).nextSibling;
+            }
+
+            m_rows.insert(m_rows.begin() + position, rows.cbegin(), rows.cend());
+        }
+
+        const CallTree* m_callTree;
+        std::vector<Row> m_rows;
+        std::unordered_set<CallTree::node_index_t> m_expandedNodes;
+    };
+
+    //
+    // Gets how many lines are left in the window below the cursor.
+    //
+    line_t get_lines_left(WINDOW* const window) {
+        return std::max(getmaxy(window) - getcury(window), 1);
+    }
+
+    //
+    // Keeps the selected line within the lines there are, and scrolls so that it's in view.
+    //
+    void scroll_to_selected_line(const std::size_t lineCount, const line_t linesInView, line_t& selectedLine, line_t& firstLine) {
+        selectedLine = std::clamp<line_t>(selectedLine, 0, std::max<line_t>(static_cast<line_t>(lineCount) - 1, 0));
+
+        if (selectedLine < firstLine) {
+            firstLine = selectedLine;
+        } else if (selectedLine >= firstLine + linesInView) {
+            firstLine = selectedLine - linesInView + 1;
+        }
+    }
+
+    //
+    // Draws as many rows of a call tree as fit below the cursor, scrolled so that the selected one is among them.
+    // Only the rows drawn are looked at, so drawing takes as long however many rows there are.
+    // printNode draws the rest of a row's line, after its indentation and markers.
+    //
+    template <typename PrintNode>
+    void print_call_tree_rows(WINDOW* const window,
+                              const VisibleRows& rows,
+                              line_t& selectedLine,
+                              line_t& firstLine,
+                              PrintNode&& printNode) {
+        const auto linesInView = get_lines_left(window);
+        scroll_to_selected_line(rows.size(), linesInView, selectedLine, firstLine);
+
+        const auto lastLine = std::min(firstLine + linesInView, static_cast<line_t>(rows.size()));
+        for (auto line = firstLine; line < lastLine; ++line) {
+            const auto& row = rows.get(line);
+
+            for(std::size_t i = 0; i < row.depth; ++i) {
                 wprintw(window, "    ");
             }
 
-            const auto* const stackFrame = lookup_stack_frame(trace, rootNode.stackFrameID);
-            const char* functionName = stackFrame == nullptr ? "?" : stackFrame->functionName;
-
-            int demangleStatus = 0;
-            const std::unique_ptr<const char, void(*)(const char*)> demangledFunctionName(
-                abi::__cxa_demangle(
-                    stackFrame == nullptr ? "?" : functionName,
-                    nullptr,
-                    nullptr,
-                    &demangleStatus
-                ),
-                [](const char* ptr) { free(reinterpret_cast<void*>(const_cast<char*>(ptr))); }
+            wprintw(
+                window,
+                "%s %s ",
+                selectedLine == line ? "->" : "  ",
+                rows.get_call_tree().get(row.node).firstChild == CallTree::no_node ? "   " : rows.is_expanded(row.node) ? "[-]" : "[+]"
             );
 
-            const bool demangleFailed = demangledFunctionName == nullptr || demangleStatus != 0;
+            printNode(row.node);
+        }
+    }
+
+    void print_node(WINDOW* const window,
+                    const Analysis::SymbolTable& symbolTable,
+                    const CallTree& callTree,
+                    const CallTree::node_index_t nodeIndex) {
+
+        const auto& node = callTree.get(nodeIndex);
 
-            const char* const sourceFilePath = 
-                (stackFrame == nullptr || stackFrame->sourceFilePathLength == 0)
-                    ? nullptr
-                    : stackFrame->sourceFilePath;
+        const auto* const stackFrame = symbolTable.find(node.stackFrameID);
+        const std::string functionName = stackFrame == nullptr ? "?" : demangle(std::string(symbolTable.strings->get(stackFrame->functionName)));
 
-            const std::string lineNumberString =
-                (stackFrame == nullptr || stackFrame->lineNumber == -1)
-                    ? "?"
-                    : std::to_string(stackFrame->lineNumber);
+        const std::string_view sourceFilePath =
+            stackFrame == nullptr
+                ? std::string_view()
+                : symbolTable.strings->get(stackFrame->sourceFilePath);
 
-            const std::string sourceInfo =
-                sourceFilePath == nullptr
-                    ? ""
-                    : (std::string(" | ") + std::string(sourceFilePath) + ":" + lineNumberString);
+        const std::string lineNumberString =
+            (stackFrame == nullptr || stackFrame->lineNumber == -1)
+                ? "?"
+                : std::to_string(stackFrame->lineNumber);
 
-            const std::string percentageOfParent =
-                parentNode == nullptr
-                    ? ""
-                    : ", " + std::to_string((rootNode.frequency / static_cast<float>(parentNode->frequency)) * 100) + "% of parent";
+        const std::string sourceInfo =
+            sourceFilePath.empty()
+                ? ""
+                : (std::string(" | ") + std::string(sourceFilePath) + ":" + lineNumberString);
 
+        // The outermost frames' parent is the root, which isn't shown.
+        const std::string percentageOfParent =
+            node.parent == CallTree::root
+                ? ""
+                : ", " + std::to_string((node.frequency / static_cast<float>(callTree.get(node.parent).frequency)) * 100) + "% of parent";
+
+        wprintw(
+            window,
+            "%s (offset 0x%.8lX, hit %s times%s)%s\n",
+            functionName.c_str(),
+            stackFrame == nullptr ? -1 : stackFrame->offset,
+            stackFrame == nullptr ? "?" : std::to_string(node.frequency).c_str(),
+            percentageOfParent.c_str(),
+            sourceInfo.c_str()
+        );
+    }
+
+    //
+    // Like print_node, but for a diff's call tree: each node shows its share of each run's samples, and the change.
+    //
+    void print_diff_node(WINDOW* const window, const Diff& diff, const CallTree::node_index_t nodeIndex) {
+        const auto share = [](const swimps::trace::sample_count_t samples, const swimps::trace::sample_count_t totalSamples) {
+            return totalSamples == 0 ? 0.0 : (samples / static_cast<double>(totalSamples)) * 100;
+        };
+
+        const auto baselineShare = share(diff.baselineNodeSamples[nodeIndex], diff.baselineSamples);
+        const auto candidateShare = share(diff.candidateNodeSamples[nodeIndex], diff.candidateSamples);
+
+        wprintw(
+            window,
+            "%s (%.2f%% -> %.2f%%, %+.2f%%)\n",
+            get_function_name(diff.strings, static_cast<swimps::trace::string_id_t>(diff.callTree.get(nodeIndex).stackFrameID)).c_str(),
+            baselineShare,
+            candidateShare,
+            candidateShare - baselineShare
+        );
+    }
+
+    void print_flat_profile_rows(WINDOW* const window,
+                                 const Analysis& analysis,
+                                 line_t& selectedLine,
+                                 line_t& firstLine) {
+        wprintw(window, "   %s\n", flat_profile_header);
+
+        const auto linesInView = get_lines_left(window);
+        scroll_to_selected_line(analysis.flatProfile.size(), linesInView, selectedLine, firstLine);
+
+        const auto totalSamples = analysis.callTree.get(CallTree::root).frequency;
+        const auto lastLine = std::min(firstLine + linesInView, static_cast<line_t>(analysis.flatProfile.size()));
+
+        for (auto line = firstLine; line < lastLine; ++line) {
             wprintw(
                 window,
-                "%s %s %s (offset 0x%.8lX, hit %s times%s)%s\n",
-                selectedLine == currentLine ? "->" : "  ",
-                rootNode.children.size() == 0 ? "   " : expansionState[&rootNode] ? "[-]" : "[+]",
-                demangleFailed ? functionName : demangledFunctionName.get(),
-                stackFrame == nullptr ? -1 : stackFrame->offset,
-                stackFrame == nullptr ? "?" : std::to_string(rootNode.frequency).c_str(),
-                percentageOfParent.c_str(),
-                sourceInfo.c_str()
+                "%s %s\n",
+                selectedLine == line ? "->" : "  ",
+                format_function_profile(analysis.flatProfile[line], analysis.symbolTable, totalSamples).c_str()
             );
         }
+    }
+
+    //
+    // Gets the function on a line of the call graph view: its callers first, then its callees.
+    //
+    std::optional<swimps::trace::string_id_t> get_call_graph_line_function(const Analysis& analysis,
+                                                                          const swimps::trace::string_id_t function,
+                                                                          const line_t line) {
+        const auto callers = analysis.callGraph.get_callers(function);
+        const auto callees = analysis.callGraph.get_callees(function);
+        const auto index = static_cast<std::size_t>(line);
+
+        if (index < callers.size()) {
+            return callers[index].function;
+        }
+
+        if (index - callers.size() < callees.size()) {
+            return callees[index - callers.size()].function;
+        }
+
+        return {};
+    }
+
+    //
+    // Shows what calls a function, then what it calls, each caller and callee a line of its own.
+    // Like the other views, only as many lines as fit are drawn, scrolled so that the selected one is among them.
+    //
+    void print_call_graph_rows(WINDOW* const window,
+                               const Analysis& analysis,
+                               const swimps::trace::string_id_t function,
+                               line_t& selectedLine,
+                               line_t& firstLine) {
+        wprintw(window, "   %s\n", get_function_name(analysis.symbolTable, function).c_str());
+
+        const auto callers = analysis.callGraph.get_callers(function);
+        const auto callees = analysis.callGraph.get_callees(function);
+
+        // Each list's title takes two lines, and both are always drawn.
+        constexpr line_t title_lines = 4;
+        const auto linesInView = std::max(get_lines_left(window) - title_lines, 1);
+        scroll_to_selected_line(callers.size() + callees.size(), linesInView, selectedLine, firstLine);
+
+        const auto lastLine = firstLine + linesInView;
 
-        lineMappings[currentLine] = &rootNode;
-        currentLine += 1;
+        const auto printEdges = [&](const char* const title, const std::span<const Analysis::CallGraph::Edge> edges, const line_t edgesFirstLine) {
+            wprintw(window, "\n   %s\n", title);
 
-        if (expansionState[&rootNode]) {
-            for(const auto& childNode : rootNode.children) {
-                print_node(
+            const auto edgesLastLine = edgesFirstLine + static_cast<line_t>(edges.size());
+            for (auto line = std::max(firstLine, edgesFirstLine); line < std::min(lastLine, edgesLastLine); ++line) {
+                const auto& edge = edges[line - edgesFirstLine];
+
+                wprintw(
                     window,
-                    trace,
-                    &rootNode,
-                    childNode,
-                    expansionState,
-                    lineMappings,
-                    selectedLine,
-                    linesToSkip,
-                    currentLine,
-                    indentation + 1
+                    "%s %10ld  %s\n",
+                    selectedLine == line ? "->" : "  ",
+                    static_cast<long>(edge.samples),
+                    get_function_name(analysis.symbolTable, edge.function).c_str()
                 );
             }
+        };
+
+        printEdges("Called by:", callers, 0);
+        printEdges("Calls:", callees, static_cast<line_t>(callers.size()));
+    }
+}
+
+void swimps::tui::print_diff(const Diff& diff) {
+    printf("%s\n\n%s\n", format_diff_totals(diff).c_str(), diff_header);
+
+    for (const auto& functionDelta : diff.functionDeltas) {
+        printf("%s\n", format_function_delta(functionDelta, diff.strings).c_str());
+    }
+}
+
+void swimps::tui::print_flat_profile(const Analysis& analysis) {
+    const auto totalSamples = analysis.callTree.get(CallTree::root).frequency;
+
+    printf("%s\n", flat_profile_header);
+
+    for (const auto& functionProfile : analysis.flatProfile) {
+        printf("%s\n", format_function_profile(functionProfile, analysis.symbolTable, totalSamples).c_str());
+    }
+
+    // With only one thread, its profile is the one above.
+    if (analysis.threadProfiles.size() < 2) {
+        return;
+    }
+
+    for (const auto& threadProfile : analysis.threadProfiles) {
+        const auto threadSamples = threadProfile.callTree.get(CallTree::root).frequency;
+        const auto threadName = analysis.symbolTable.strings->get(threadProfile.threadName);
+
+        printf(
+            "\nThread %d%s%.*s%s: %ld samples (%.2f%%)\n%s\n",
+            threadProfile.threadID,
+            threadName.empty() ? "" : " (",
+            static_cast<int>(threadName.size()),
+            threadName.data(),
+            threadName.empty() ? "" : ")",
+            static_cast<long>(threadSamples),
+            totalSamples == 0 ? 0.0 : (threadSamples / static_cast<double>(totalSamples)) * 100,
+            flat_profile_header
+        );
+
+        for (const auto& functionProfile : threadProfile.flatProfile) {
+            printf("%s\n", format_function_profile(functionProfile, analysis.symbolTable, threadSamples).c_str());
         }
     }
+}
 
-    void print_call_tree(WINDOW* const window,
-                         const Trace& trace,
-                         const std::vector<CallTreeNode>& rootNodes,
-                         expansion_state_t& expansionState,
-                         line_mappings_t& lineMappings,
-                         const line_t selectedLine,
-                         const line_t linesToSkip,
-                         line_t& currentLine) {
-        for(const auto& root : rootNodes) {
-            print_node(
-                window,
-                trace,
-                nullptr,
-                root,
-                expansionState,
-                lineMappings,
-                selectedLine,
-                linesToSkip,
-                currentLine,
-                0
-            );
+namespace {
+    //
+    // Moves a time on by a number of seconds.
+    //
+    TimeSpecification add_seconds(const TimeSpecification& time, const double seconds) {
+        constexpr std::int64_t nanoseconds_per_second = 1'000'000'000;
+
+        const std::int64_t nanoseconds =
+            static_cast<std::int64_t>(time.seconds) * nanoseconds_per_second
+            + static_cast<std::int64_t>(time.nanoseconds)
+            + std::llround(seconds * nanoseconds_per_second);
+
+        TimeSpecification result = time;
+        result.seconds = nanoseconds / nanoseconds_per_second;
+        result.nanoseconds = nanoseconds % nanoseconds_per_second;
+        return result;
+    }
+
+    //
+    // Asks for a window of time, in seconds from the first sample. Asking for nothing gives an empty window,
+    // which means the whole trace; anything that isn't a window at all gives nothing.
+    //
+    std::optional<std::pair<double, double>> prompt_for_time_window(WINDOW* const window) {
+        mvwprintw(window, getmaxy(window) - 1, 0, "Seconds from the start to show, as \"start end\" (or nothing for all of them): ");
+        wclrtoeol(window);
+
+        char input[64] = { };
+        if (wgetnstr(window, input, sizeof input - 1) == ERR) {
+            return {};
+        }
+
+        if (input[0] == '\0') {
+            return std::pair{ 0.0, 0.0 };
         }
+
+        double start = 0;
+        double end = 0;
+        if (sscanf(input, "%lf %lf", &start, &end) != 2 || start < 0 || ! (start < end)) {
+            return {};
+        }
+
+        return std::pair{ start, end };
     }
+
+    ErrorCode run_interactively(const Analysis& wholeAnalysis, std::function<std::optional<TraceIndex>()> indexTrace) {
+        WINDOW* const window = initscr();
+        swimps_assert(window != nullptr);
+        keypad(window, true);
+
+        // The call trees' rows are indexed by Views, each with its own nodes expanded.
+        // Each is only laid out the first time its call tree is shown.
+        std::array<std::optional<VisibleRows>, 2> visibleRows;
+
+        line_t selectedLine = 0;
+
+        // The first line in view; the view scrolls to keep the selected line in it.
+        line_t firstLine = 0;
+
+        View view = View::CallTree;
+
+        // Until a window of time is picked, the whole trace's analysis is shown.
+        std::optional<Analysis> windowAnalysis;
+        const Analysis* analysis = &wholeAnalysis;
+        std::string windowDescription;
+
+        // The trace is only indexed the first time a window of it is asked for.
+        std::optional<TraceIndex> traceIndex;
+
+        swimps::trace::string_id_t callGraphFunction = 0;
+
+        bool quit = false;
+        while(!quit) {
+            werase(window);
+
+            if (! windowDescription.empty()) {
+                wprintw(window, "%s\n\n", windowDescription.c_str());
+            }
+
+            if (view == View::FlatProfile) {
+                print_flat_profile_rows(window, *analysis, selectedLine, firstLine);
+            } else if (view == View::CallGraph) {
+                print_call_graph_rows(window, *analysis, callGraphFunction, selectedLine, firstLine);
+            } else {
+                auto& rows = visibleRows[static_cast<std::size_t>(view)];
+                if (! rows.has_value()) {
+                    // The bottom up call tree is only built the first time it's shown.
+                    rows.emplace(view == View::CallTree ? analysis->callTree : analysis->get_bottom_up_call_tree());
+                }
+
+                print_call_tree_rows(window, *rows, selectedLine, firstLine, [&](const CallTree::node_index_t node) {
+                    print_node(window, analysis->symbolTable, rows->get_call_tree(), node);
+                });
+            }
+
+            wrefresh(window);
+            const int input = wgetch(window);
+            switch(input) {
+            case 'w':
+            case KEY_UP:
+                if (selectedLine > 0) {
+                    selectedLine -= 1;
+                }
+                break;
+            case 's':
+            case KEY_DOWN:
+                if (selectedLine < std::numeric_limits<line_t>::max()) {
+                    selectedLine += 1;
+                }
+                break;
+            case KEY_LEFT:
+            case KEY_RIGHT:
+                if (view == View::FlatProfile) {
+                    // Going into a function shows what calls it, and what it calls.
+                    if (input == KEY_RIGHT && static_cast<std::size_t>(selectedLine) < analysis->flatProfile.size()) {
+                        callGraphFunction = analysis->flatProfile[selectedLine].functionName;
+                        view = View::CallGraph;
+                        selectedLine = 0;
+                    }
+                } else if (view == View::CallGraph) {
+                    // From there, each caller and callee can be gone into in turn.
+                    if (input == KEY_LEFT) {
+                        view = View::FlatProfile;
+                        selectedLine = 0;
+                    } else if (const auto lineFunction = get_call_graph_line_function(*analysis, callGraphFunction, selectedLine); lineFunction.has_value()) {
+                        callGraphFunction = *lineFunction;
+                        selectedLine = 0;
+                    }
+                } else {
+                    auto& rows = visibleRows[static_cast<std::size_t>(view)];
+                    if (rows.has_value() && static_cast<std::size_t>(selectedLine) < rows->size()) {
+                        rows->set_expanded(selectedLine, input == KEY_RIGHT);
+                    }
+                }
+                break;
+            case 'b':
+            case 'f':
+                {
+                    // Pressing the key for the view that's already shown goes back to the call tree.
+                    const auto chosenView = input == 'b' ? View::BottomUpCallTree : View::FlatProfile;
+                    view = view == chosenView ? View::CallTree : chosenView;
+
+                    // The lines mean something else in the other view.
+                    selectedLine = 0;
+                }
+                break;
+            case 't':
+                if (indexTrace) {
+                    wprintw(window, "\nReading the trace...\n");
+                    wrefresh(window);
+
+                    // It's only tried the once; if it couldn't be read, it won't be any more readable next time.
+                    traceIndex = indexTrace();
+                    indexTrace = nullptr;
+
+                    if (! traceIndex.has_value()) {
+                        windowDescription = "The trace couldn't be read, so it can't be narrowed down to a window of time.";
+                    }
+                }
+
+                if (traceIndex.has_value() && ! traceIndex->get_samples().empty()) {
+                    const auto timeWindow = prompt_for_time_window(window);
+                    if (! timeWindow.has_value()) {
+                        break;
+                    }
+
+                    if (timeWindow->first == timeWindow->second) {
+                        windowAnalysis.reset();
+                        analysis = &wholeAnalysis;
+                        windowDescription.clear();
+                    } else {
+                        // Windows are relative to the first sample, so that they can be read off a run's wall clock.
+                        const auto firstTimestamp = traceIndex->get_samples().front().timestamp;
+                        windowAnalysis = swimps::analysis::analyse(
+                            *traceIndex,
+                            add_seconds(firstTimestamp, timeWindow->first),
+                            add_seconds(firstTimestamp, timeWindow->second)
+                        );
+
+                        analysis = &*windowAnalysis;
+
+                        char description[128] = { };
+                        snprintf(description, sizeof description, "Samples from %.3fs to %.3fs (press t to change)", timeWindow->first, timeWindow->second);
+                        windowDescription = description;
+                    }
+
+                    // The call trees' nodes are different in the new analysis, so their rows are laid out again.
+                    for (auto& rows : visibleRows) {
+                        rows.reset();
+                    }
+
+                    selectedLine = 0;
+                }
+                break;
+            case 'q':
+                quit = true;
+                break; 
+            default:
+                break;
+            }
+        }
+
+        endwin();
+
+        return ErrorCode::None;
+    }
+}
+
+ErrorCode swimps::tui::run(const Analysis& analysis) {
+    return run_interactively(analysis, nullptr);
 }
 
-ErrorCode swimps::tui::run(const Trace& trace, const Analysis& analysis) {
+ErrorCode swimps::tui::run(const Analysis& analysis, std::function<std::optional<TraceIndex>()> indexTrace) {
+    return run_interactively(analysis, std::move(indexTrace));
+}
+
+ErrorCode swimps::tui::run(const Diff& diff) {
     WINDOW* const window = initscr();
     swimps_assert(window != nullptr);
     keypad(window, true);
 
-    expansion_state_t expansionState;
-    line_mappings_t lineMappings;
+    VisibleRows visibleRows(diff.callTree);
 
     line_t selectedLine = 0;
-    line_t currentLine = 0;
+    line_t firstLine = 0;
 
+    // Only the call tree and the table of functions (in place of the flat profile) are shown.
+    View view = View::CallTree;
 
-    line_t callTreeOffset = 0;
+    const auto totals = format_diff_totals(diff);
 
     bool quit = false;
     while(!quit) {
         werase(window);
-        currentLine = 0;
-        print_call_tree(
-            window,
-            trace,
-            analysis.callTree,
-            expansionState,
-            lineMappings,
-            selectedLine,
-            callTreeOffset,
-            currentLine
-        );
+
+        wprintw(window, "%s\n\n", totals.c_str());
+
+        if (view == View::FlatProfile) {
+            wprintw(window, "   %s\n", diff_header);
+
+            const auto linesInView = get_lines_left(window);
+            scroll_to_selected_line(diff.functionDeltas.size(), linesInView, selectedLine, firstLine);
+
+            const auto lastLine = std::min(firstLine + linesInView, static_cast<line_t>(diff.functionDeltas.size()));
+            for (auto line = firstLine; line < lastLine; ++line) {
+                wprintw(
+                    window,
+                    "%s %s\n",
+                    selectedLine == line ? "->" : "  ",
+                    format_function_delta(diff.functionDeltas[line], diff.strings).c_str()
+                );
+            }
+        } else {
+            print_call_tree_rows(window, visibleRows, selectedLine, firstLine, [&](const CallTree::node_index_t node) {
+                print_diff_node(window, diff, node);
+            });
+        }
 
         wrefresh(window);
         const int input = wgetch(window);
@@ -189,19 +733,19 @@ ErrorCode swimps::tui::run(const Trace& trace, const Analysis& analysis) {
             break;
         case KEY_LEFT:
         case KEY_RIGHT:
-            {
-                const auto lineMappingIter = lineMappings.find(selectedLine);
-                if (lineMappingIter != lineMappings.end()) {
-                    const auto expansionStateIter = expansionState.find(lineMappingIter->second);
-                    if (expansionStateIter != expansionState.end()) {
-                        expansionStateIter->second = input == KEY_RIGHT;
-                    }
-                }
+            if (view == View::CallTree && static_cast<std::size_t>(selectedLine) < visibleRows.size()) {
+                visibleRows.set_expanded(selectedLine, input == KEY_RIGHT);
             }
             break;
+        case 'f':
+            view = view == View::FlatProfile ? View::CallTree : View::FlatProfile;
+
+            // The lines mean something else in the other view.
+            selectedLine = 0;
+            break;
         case 'q':
             quit = true;
-            break; 
+            break;
         default:
             break;
         }